@@ -32,6 +32,7 @@ enum SimulationPackageCodes   {KNOWNNOT,LEEDS,GRISU,KASCADE,CORSIKA,UCLA};
 #include "TTimer.h"
 #include "TMath.h"
 #include "TSystem.h"
+#include "TStopwatch.h"
 #include "TInterpreter.h"
 #include <TRint.h>
 
@@ -470,6 +471,18 @@ int main( int argc, char **argv )
 				     lVBFRunNum,
 				     iDebugLevel);
 	  VBFwrite->setNumFadcSamples( telData[0]->iNumFADCSamples);  // set numFadcSamples for this telescope
+
+	  //software zero suppression of the data events written to the vbf file
+	  for(UInt_t t=0;t<uNumTelescopes;t++)
+	    {
+	      UInt_t telType = telData[t]->GetTelescopeType();
+	      Float_t fZeroSupThreshold = readConfig->GetFADCZeroSuppressionThreshold(telType);
+	      if(fZeroSupThreshold>=0)
+		{
+		  vector<unsigned> thresholds(readConfig->GetNumberPixels(telType),(unsigned)TMath::CeilNint(fZeroSupThreshold));
+		  VBFwrite->setZeroSuppressionThresholds(t,thresholds);
+		}
+	    }
 	  
 	}
       
@@ -867,9 +880,7 @@ int main( int argc, char **argv )
 		  
 		  /*Write the FADC trace out*/
 		  vector<Int_t> trace = telData[tel]->GetFADCTrace(pix);
-		  for(Int_t i=0;i<(Int_t)trace.size();i++){
-		    VBFwrite->storeSample(i,trace[i]);  // store the sample
-		  }
+		  VBFwrite->storeTrace(trace);  // store the samples
 		} // end pixel loop
 		
 		VBFwrite->storeEvent();
@@ -890,6 +901,22 @@ int main( int argc, char **argv )
       ///////////////////////////////////////////////////////////////////////////////////////////
       
       //Going into the events
+      //keep track of the throughput and of how many pixels get Cherenkov signal at all
+      TStopwatch tEventLoopTimer;
+      Long64_t lNumSignalPixels = 0;
+      Long64_t lNumSimulatedPixels = 0;
+      //bookkeeping of the trigger estimator that skips telescopes which can not trigger
+      vector<Bool_t> bTelescopeCanTrigger(uNumTelescopes,kTRUE);
+      vector<Float_t> fEstimatedPeakSignal;
+      vector<Float_t> fEstimatedPeakVariance;
+      Long64_t lNumEstimatedTelescopes = 0;
+      Long64_t lNumTelescopesCannotTrigger = 0;
+      Long64_t lNumTelescopesNotSimulated = 0;
+      Long64_t lNumTelescopesValidated = 0;
+      Long64_t lNumTelescopesEstimatorWrong = 0;
+      Int_t NumEventsArrayCannotTrigger = 0;
+      Int_t NumEventsArrayEstimatorWrong = 0;
+      tEventLoopTimer.Start();
       for( int i = 0; i < t[0]->GetEntries() ; i++ )
 	{
 	  if(DEBUG_MAIN)
@@ -969,13 +996,23 @@ int main( int argc, char **argv )
 	    {
 	      if(DEBUG_TELTRIGGER)
 		display->ResetTriggerTraces();
-	      //Loop over the telescopes and see if they have triggered
+	      //Find the photoelectrons in all telescopes with the trigger estimator and estimate which telescopes can trigger at all.
+	      //Telescopes without it are done in one go below, with the random numbers drawn in the same order as before the estimator
+	      UInt_t uNumTelescopesCanTrigger = 0;
 	      for(UInt_t n = 0; n<uNumTelescopes; n++)
 		{   
 		  
 		  if(DEBUG_MAIN)
 		    cout<<"Telescope "<<n<<endl;
 		  
+		  Int_t telType = telData[n]->GetTelescopeType();
+		  bTelescopeCanTrigger[n] = kTRUE;
+		  if(readConfig->GetTriggerEstimatorMode(telType)==0)
+		    {
+		      uNumTelescopesCanTrigger++;
+		      continue;
+		    }
+		  
 		  t[n]->SetBranchAddress("eventNumber", &fEventNumber );
 		  t[n]->SetBranchAddress("primaryEnergy", &fPrimaryEnergy );
 		  t[n]->SetBranchAddress("primaryType", &iPrimaryType );
@@ -991,13 +1028,82 @@ int main( int argc, char **argv )
 		      cout<<"Vectors do not have the same size, should never happen, isn't it?"<<endl;
 		    }
 		  
-		  //generate traces with trace generator
+		  traceGenerator[telType]->SetTelData(telData[n]);
+		  traceGenerator[telType]->ConvertPhotonsToPE( v_f_x ,  v_f_y, v_f_time, v_f_lambda, fDelay,dGlobalPhotonEffic);	
+		  
+		  TriggerTelescopeCameraSnapshot * SnapshotTrigger = dynamic_cast<TriggerTelescopeCameraSnapshot*>(Teltrigger[telType]);
+		  traceGenerator[telType]->EstimatePeakSignalInPixels(fEstimatedPeakSignal,fEstimatedPeakVariance);
+		  if (SnapshotTrigger)
+		    bTelescopeCanTrigger[n] = SnapshotTrigger->CanTelescopeTrigger(fEstimatedPeakSignal,fEstimatedPeakVariance,readConfig->GetTriggerEstimatorNumSigma(telType));
+		  else
+		    bTelescopeCanTrigger[n] = Teltrigger[telType]->CanTelescopeTrigger(fEstimatedPeakSignal,fEstimatedPeakVariance,readConfig->GetTriggerEstimatorNumSigma(telType));
+		  lNumEstimatedTelescopes++;
+		  if(!bTelescopeCanTrigger[n])
+		    lNumTelescopesCannotTrigger++;
+		  if(DEBUG_MAIN)
+		    cout<<"Trigger estimator: telescope can trigger "<<bTelescopeCanTrigger[n]<<endl;
+		  if(bTelescopeCanTrigger[n])
+		    uNumTelescopesCanTrigger++;
+		}
+	      
+	      //Not enough telescopes can trigger to fulfill the array multiplicity
+	      Bool_t bArrayCanTrigger = (Int_t)uNumTelescopesCanTrigger >= (readConfig->GetTelescopeMultiplicity() > 1 ? readConfig->GetTelescopeMultiplicity() : 1);
+	      if(!bArrayCanTrigger)
+		NumEventsArrayCannotTrigger++;
+	      
+	      //Loop over the telescopes and see if they have triggered
+	      for(UInt_t n = 0; n<uNumTelescopes; n++)
+		{   
+		  
+		  if(DEBUG_MAIN)
+		    cout<<"Telescope "<<n<<endl;
+		  
 		  Int_t telType = telData[n]->GetTelescopeType();
 		  TriggerTelescopeCameraSnapshot * SnapshotTrigger = dynamic_cast<TriggerTelescopeCameraSnapshot*>(Teltrigger[telType]);
+		  
+		  //Skip trace generation and trigger of a telescope that can not trigger or can not be part of an array trigger,
+		  //in validation mode it is simulated anyway
+		  if(readConfig->GetTriggerEstimatorMode(telType)==1 && (!bTelescopeCanTrigger[n] || !bArrayCanTrigger))
+		    {
+		      if (SnapshotTrigger)
+			SnapshotTrigger->SetTelescopeNotTriggered(telData[n]);
+		      else
+			Teltrigger[telType]->SetTelescopeNotTriggered(telData[n]);
+		      lNumTelescopesNotSimulated++;
+		      
+		      fTelTriggerTimes[n] = telData[n]->GetTelescopeTriggerTime(); 
+		      GroupTriggerBits[n] = telData[n]->GetTriggeredGroups();
+		      vTelescopeTriggerBits[n]=telData[n]->GetTelescopeTrigger();
+		      continue;
+		    }
+		  
+		  //generate traces with trace generator
 		  traceGenerator[telType]->SetTelData(telData[n]);
-		  traceGenerator[telType]->LoadCherenkovPhotons( v_f_x ,  v_f_y, v_f_time, v_f_lambda, fDelay,dGlobalPhotonEffic);	
+		  if(readConfig->GetTriggerEstimatorMode(telType)>0)
+		    traceGenerator[telType]->LoadPhotoelectrons();	
+		  else
+		    {
+		      t[n]->SetBranchAddress("eventNumber", &fEventNumber );
+		      t[n]->SetBranchAddress("primaryEnergy", &fPrimaryEnergy );
+		      t[n]->SetBranchAddress("primaryType", &iPrimaryType );
+		      t[n]->SetBranchAddress("delay", &fDelay );
+		      t[n]->SetBranchAddress("photonX", &v_f_x, &b_v_f_x ); 
+		      t[n]->SetBranchAddress("photonY", &v_f_y, &b_v_f_y ); 
+		      t[n]->SetBranchAddress("time", &v_f_time, &b_v_f_time );
+		      t[n]->SetBranchAddress("wavelength", &v_f_lambda, &b_v_f_lambda );
+		      t[n]->GetEntry( i );
+		      
+		      if( v_f_time->size() != v_f_x->size() )
+			{
+			  cout<<"Vectors do not have the same size, should never happen, isn't it?"<<endl;
+			}
+		      traceGenerator[telType]->LoadCherenkovPhotons( v_f_x ,  v_f_y, v_f_time, v_f_lambda, fDelay,dGlobalPhotonEffic);	
+		    }
 		  traceGenerator[telType]->BuildAllHighGainTraces();	 
 		  
+		  lNumSignalPixels += telData[n]->vSignalPixels.size();
+		  lNumSimulatedPixels += telData[n]->iNumPixels;
+		  
 		  //   TelData->ShowTrace(0,kTRUE); 
 		  
 		  //run the telescope trigger
@@ -1030,6 +1136,17 @@ int main( int argc, char **argv )
 		      if(DEBUG_MAIN)
 			cout<<"done trigger, RFB:"<<Teltrigger[telType]->GetDiscRFBDynamicValue()<<endl;
 		    }
+		  
+		  //validation of the trigger estimator: a telescope that can not trigger must not have triggered
+		  if(readConfig->GetTriggerEstimatorMode(telType)==2 && !bTelescopeCanTrigger[n])
+		    {
+		      lNumTelescopesValidated++;
+		      if(telData[n]->GetTelescopeTrigger())
+			{
+			  lNumTelescopesEstimatorWrong++;
+			  cout<<"Trigger estimator: telescope "<<n<<" in event "<<i<<" triggered although it was estimated that it can not trigger"<<endl;
+			}
+		    }
 		  		  
 		  fTelTriggerTimes[n] = telData[n]->GetTelescopeTriggerTime(); 
 		  GroupTriggerBits[n] = telData[n]->GetTriggeredGroups();
@@ -1047,6 +1164,11 @@ int main( int argc, char **argv )
 	      
 	      arraytrigger->SetTelescopeTriggerBitsAndTimes(vTelescopeTriggerBits,fTelTriggerTimes);
 	      isArrayTriggered = arraytrigger->RunTrigger(); //think of changing this if no array trigger is used
+	      if(isArrayTriggered && !bArrayCanTrigger)
+		{
+		  NumEventsArrayEstimatorWrong++;
+		  cout<<"Trigger estimator: event "<<i<<" triggered the array although it was estimated that it can not"<<endl;
+		}
 	      arrayTriggerBit = 0;
 	      DeltaTL3=1e6;
 	      
@@ -1195,9 +1317,7 @@ int main( int argc, char **argv )
 		  
 		  /*Write the FADC trace out*/
 		  vector<Int_t> trace = telData[tel]->GetFADCTrace(pix);
-		  for(Int_t i=0;i<(Int_t)trace.size();i++){
-		    VBFwrite->storeSample(i,trace[i]);  // store the sample
-		  }	  
+		  VBFwrite->storeTrace(trace);  // store the samples	  
 		  
 		} // pixel loop
 		if(DEBUG_MAIN)
@@ -1216,6 +1336,7 @@ int main( int argc, char **argv )
 	  if(DEBUG_MAIN)
 	    cout<<"Event finished going into next event"<<endl;
 	}//Loop over to the next event
+      tEventLoopTimer.Stop();
       
       
       
@@ -1233,6 +1354,21 @@ int main( int argc, char **argv )
       
       cout<<"Have "<<NumTriggeredEvents<<" triggered events!"<<endl;
       cout<<"Have "<<NumSkippeddEvents<<" events that are skipped because no telescope had the min required number of Cherenkov photons in the focal plane"<<endl;
+      if(tEventLoopTimer.RealTime()>0)
+	cout<<"Processed "<<t[0]->GetEntries()<<" events in "<<tEventLoopTimer.RealTime()<<" s real time ("<<tEventLoopTimer.CpuTime()<<" s CPU time), "
+	    <<t[0]->GetEntries()/tEventLoopTimer.RealTime()<<" events per second"<<endl;
+      if(lNumSimulatedPixels>0)
+	cout<<"Pixels with Cherenkov photoelectrons: "<<lNumSignalPixels<<" of "<<lNumSimulatedPixels<<" simulated pixels ("
+	    <<100.0*lNumSignalPixels/lNumSimulatedPixels<<"%), all others only had noise"<<endl;
+      if(lNumEstimatedTelescopes>0)
+	{
+	  cout<<"Trigger estimator: "<<lNumTelescopesCannotTrigger<<" of "<<lNumEstimatedTelescopes<<" telescopes could not trigger, "
+	      <<lNumTelescopesNotSimulated<<" telescopes were not simulated, in "<<NumEventsArrayCannotTrigger<<" events the array could not trigger"<<endl;
+	  if(lNumTelescopesValidated>0)
+	    cout<<"Trigger estimator validation: "<<lNumTelescopesEstimatorWrong<<" of "<<lNumTelescopesValidated<<" telescopes that could not trigger did trigger ("
+		<<100.0*lNumTelescopesEstimatorWrong/lNumTelescopesValidated<<"%), "<<NumEventsArrayEstimatorWrong<<" of "<<NumEventsArrayCannotTrigger
+		<<" events that could not trigger the array did trigger it"<<endl;
+	}
       
       //Close the GrOptics file
       fO->Close();
@@ -1254,6 +1390,7 @@ int main( int argc, char **argv )
   for(UInt_t t = 0 ; t<uNumTelescopeTypes; t++)
     {
       traceGenerator[t]->PrintHowOftenTheTraceWasTooShort();
+      traceGenerator[t]->PrintNSBLibraryStatistics();
       fadc[t]->PrintHowOftenTheTraceWasTooShort();
     } 
   cout<<"Close output file"<<endl;
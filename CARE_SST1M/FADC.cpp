@@ -142,7 +142,6 @@ void FADC::DigitizePixel( Int_t PixelID )
 
     //Get the right trace
     Float_t fPedestal = fHighGainPedestal; 
-    vector<Float_t> trace;
     if(bLowGain)
       {
         fPedestal = fLowGainPedestal;
@@ -150,7 +149,8 @@ void FADC::DigitizePixel( Int_t PixelID )
         tracegenerator->BuildLowGainTrace(PixelID);        
       }
 
-    trace = telData->fTraceInPixel[PixelID];
+    //no copy needed, the trace is not changed while digitizing
+    const vector<Float_t> &trace = telData->fTraceInPixel[PixelID];
 
     //Write the FADC trace
     Float_t fConversionFactor = -1*fGain * fDCtoPEconversion  ;
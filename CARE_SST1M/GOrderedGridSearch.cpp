@@ -80,6 +80,8 @@ GOrderedGridSearch::GOrderedGridSearch(const vector<double> &xe,
 
   }
 
+  makeEdges();
+
   // make or read the element grid if necessary
   if (iGridOption != 0) {
     pGrid = new GOrderedGrid(*vxe,*vye,*vre,nbinsx,nbinsy,
@@ -193,7 +195,7 @@ int GOrderedGridSearch::getElemNumber(const double &x,const double &y) {
         DEBUGS(sides);DEBUGS(alpha);DEBUGS(radius);
         DEBUGS(xpp);DEBUGS(ypp);
       }
-      bool polyTest = polyInside(sides,alpha,radius,xpp,ypp);
+      bool polyTest = polyInside(pNum,xpp,ypp);
       if (debug) cout << "      polyTest " << polyTest << endl;
 
       if (polyTest) {
@@ -208,73 +210,64 @@ return -1;
 };
 //************************  end of getElemNumber ****************
 
-bool GOrderedGridSearch::polyInside(const int &sides, const double &alpha, 
-                                    const double &radius, 
-                                    const double &x, const double &y) {
-  
-  double PI = (TMath::Pi());   /*   Value of pi */
-
-  double theta,dist;
-  double phi;
-  
-  static double delta[50],beta[50],gamma[50];
-  static int ifirst=0;
-  int iside;
-  double x1,y1;
-  
-  /* initialize constant parameters */
-  if (ifirst==0) {
-    ifirst = 1;
-    delta[0]=delta[1]=delta[2]=0.0;
-    beta[0] = beta[1]= beta[2]=0.0;
-    gamma[0]=gamma[1]=gamma[2]=0.0;
-
-    for (iside=3;iside<50;iside++) {
-      delta[iside] = (PI)*( 0.5 - (1/(double)iside) );
-      gamma[iside] = 2*PI/(double)iside;
-      beta[iside]  = gamma[iside]/2.;
-    }
-  }
-  /* number of valid sides determined by size of arrays 
-     I only went to 49.............. Maybe that's a circle....
-  */
-  if (sides > 49) {
-    cout << " number of sides greater than 49! " << endl;
-    cout << " exiting code" << endl;
-    exit(0);
-  }
-
-  /* if at least three sides, can proceed */
-  /*-------------------------------------------*/
-  if (sides > 2) {
+void GOrderedGridSearch::makeEdges() {
 
-    dist =  sqrt((x*x) + (y*y));
+  /* the polygon with rotation alpha has a point at angle alpha 
+     (clockwise) from the y-axis; edge j has its normal at angle 
+     alpha + beta + j*gamma from the y-axis */
+  double PI = (TMath::Pi());
 
-    /* first see if the distance isn't too large */
-    if (dist > radius) return 0;
+  vEdgeStart.clear();
+  vEdgeNX.clear();
+  vEdgeNY.clear();
+  vApothem.clear();
 
-    /* rotate x and y through alpha, dist doesn't change */
-    x1 = (cos(alpha)*x)- (sin(alpha)*y);
-    y1 = (sin(alpha)*x)+ (cos(alpha)*y);
+  vEdgeStart.push_back(0);
+  for (unsigned e = 0; e < vse->size(); e++) {
+    int sides = (*vse)[e];
+    double alpha = (*vrote)[e];
+    double radius = (*vre)[e];
 
-    /* if you use atan to get theta, phi will be incorrect */
-    theta = acos(y1 / dist);
-  
-    phi = fabs( (fmod((theta + beta[sides]), gamma[sides])) - beta[sides]); 
+    if (sides > 49) {
+      cout << " number of sides greater than 49! " << endl;
+      cout << " exiting code" << endl;
+      exit(0);
+    }
 
-    if (dist<=((sin(delta[sides])*radius)/sin(delta[sides] + phi))) 
-      return true;
-    
+    /* circles (sides = 1 or 2) and sides = 0 have no edges */
+    double apothem = radius;
+    if (sides > 2) {
+      double gamma = 2*PI/(double)sides;
+      double beta  = gamma/2.;
+      apothem = radius*cos(beta);
+      for (int j = 0; j < sides; j++) {
+        double angle = alpha + beta + j*gamma;
+        vEdgeNX.push_back(sin(angle));
+        vEdgeNY.push_back(cos(angle));
+      }
+    }
+    vApothem.push_back(apothem);
+    vEdgeStart.push_back(vEdgeNX.size());
   }
-  /*----------------------------------------------*/
-  /* if sides = 1 or 2, then shape is a circle rather than a polygon */
+};
+//************************  end of makeEdges ****************
 
-  else if (sides > 0 ) {
-    dist =  sqrt(x * x + y * y);
-    if (dist <= radius) return 1;
-  }
+bool GOrderedGridSearch::polyInside(const int &elem, const double &x, 
+                                    const double &y) const {
 
   /* if sides = 0, then always return 0 */
-  return false;
+  if ((*vse)[elem] <= 0) return false;
+
+  /* outside the circle through the points */
+  double radius = (*vre)[elem];
+  if ( (x*x + y*y) > radius*radius) return false;
+
+  /* on the inner side of every edge; no edges for a circle */
+  double apothem = vApothem[elem];
+  bool inside = true;
+  for (int j = vEdgeStart[elem]; j < vEdgeStart[elem+1]; j++) {
+    inside &= ( (x*vEdgeNX[j] + y*vEdgeNY[j]) <= apothem);
+  }
+  return inside;
 };
 /********************  end of polyInside ***************/
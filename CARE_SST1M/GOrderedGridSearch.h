@@ -34,19 +34,29 @@ class GOrderedGridSearch {
   bool bGridOption;     //!< true if grid is active
   string fileNameGrid;  //!< grid filename 
 
+  vector<int> vEdgeStart;  //!< edges of element e: vEdgeStart[e] to vEdgeStart[e+1]-1
+  vector<double> vEdgeNX;  //!< x component of the unit normal of each edge
+  vector<double> vEdgeNY;  //!< y component of the unit normal of each edge
+  vector<double> vApothem; //!< distance from center to edges of each element
+
+  /*!  \brief Sets up the edge normals and apothem of every element
+    polygon, so that polyInside needs no trig functions
+   */
+  void makeEdges();
+
   /*!  \brief Determines if x,y hit location relative to center
     of element falls within the polygon defining the element
 
-    \param sides  number of sides of element
-    \param alpha rotation angle of element (radians) 
-    \param radius radius of element
+    Same result as the polar angle test used before (ulp level
+    differences on the edges), using the edges from makeEdges.
+    Nothing is modified, so it can be called from several threads.
+
+    \param elem element number
     \param x x-location of hit, relative to element center
     \param y y-location of hit, relative to element center
     \return true if hit falls within the element polygon (or circle)
    */
-  bool polyInside(const int &sides, const double &alpha, 
-                  const double &radius, 
-                  const double &x, const double &y);
+  bool polyInside(const int &elem, const double &x, const double &y) const;
  public:
   
   /*! \brief Constructor
@@ -140,6 +140,8 @@ void ReadConfig::resetTelTypeVectors()
   fQESigma.assign( iNumberOfTelescopeTypes, -1 );                    //sigma of the QE distribution
 
   uMinNumPhotonsRequired.assign( iNumberOfTelescopeTypes, 0 );       //The minimum number of photons required in a camera to simulate the event
+  iTriggerEstimatorMode.assign( iNumberOfTelescopeTypes, 0 );        //Skip telescopes that cannot trigger before building the traces
+  fTriggerEstimatorNumSigma.assign( iNumberOfTelescopeTypes, 5 );    //Safety margin of that estimate in standard deviations
   
 
 
@@ -154,6 +156,9 @@ void ReadConfig::resetTelTypeVectors()
                                        //Fit function exp(a+b*x), where a=constant b=slope
   fAfterPulsingSlope.assign( iNumberOfTelescopeTypes, 0 );          //Slope of a fit to the rate vs. threshold curve of a single pe
                                        //Fit function exp(a+b*x), where a=constant b=slope
+  bUseNSBLibrary.assign( iNumberOfTelescopeTypes, 0 );              //Take the NSB out of a pre-generated library
+  fNSBLibraryLength.assign( iNumberOfTelescopeTypes, 0 );           //Length of the NSB library in ns
+  sNSBLibraryFile.assign( iNumberOfTelescopeTypes, "" );            //Cache file of the NSB library
   fSamplingTime.assign( iNumberOfTelescopeTypes, 0 );       //The sampling rate or resolution of the simulated trace
   fTraceLength.assign( iNumberOfTelescopeTypes, 0 );        //the length of the simulated trace per group
   fStartSamplingBeforeAverageTime.assign( iNumberOfTelescopeTypes, 0 );    //Start sampling before the average photon arrival time
@@ -168,6 +173,7 @@ void ReadConfig::resetTelTypeVectors()
   iFADCDynamicRange.assign( iNumberOfTelescopeTypes, 0 );           //The dynamic range of the FADC
   fFADCTimeOffsetFromTrigger.assign( iNumberOfTelescopeTypes, 0 );  //The offset between the trigger time and the start of the readout window
   fFADCHiLoGainThreshold.assign( iNumberOfTelescopeTypes, 0 );      //The Threshold in FADC counts at which switching to the low gain is activated
+  fFADCZeroSuppressionThreshold.assign( iNumberOfTelescopeTypes, -1 );  //The zero suppression threshold in FADC counts for the vbf output (negative: off)
   fFADCLowHiGainRatio.assign( iNumberOfTelescopeTypes, 0 );         //Gain ratio logain/higain
   fFADCHighGainPedestal.assign( iNumberOfTelescopeTypes, 0 );               //The FADC high gain pedestal in dc counts
   fFADCLowGainPedestal.assign( iNumberOfTelescopeTypes, 0 );               //The FADC low gain pedestal in dc counts
@@ -512,6 +518,26 @@ void ReadConfig::ReadLine(string iline, ifstream *inFileStream)
 	  <<fAfterPulsingSlope[i_telType]<<endl;
     }
   
+  //If we want to take the NSB from a pre-generated library
+  if( iline.find( "NSBLIBRARY " ) < iline.size() )
+    {
+      i_stream >> i_char; i_stream >> i_char; 
+      i_stream >> i_telType;
+      int tmp;
+      i_stream >> tmp;
+      bUseNSBLibrary[i_telType] = (Bool_t)tmp;
+      i_stream >> fNSBLibraryLength[i_telType];
+      fNSBLibraryLength[i_telType]*=1000;
+      i_stream >> sNSBLibraryFile[i_telType];
+      if(bUseNSBLibrary[i_telType] && fNSBLibraryLength[i_telType] <= 0)
+	{
+	  cout<<"Telescope type "<<i_telType<<" the length of the NSB library has to be >0"<<endl;
+	  exit(1);
+	}
+      cout<<"Telescope type "<<i_telType<<" Do we take the NSB from a library: "<<bUseNSBLibrary[i_telType]
+	  <<" library length in ns "<<fNSBLibraryLength[i_telType]<<" cache file: "<<sNSBLibraryFile[i_telType]<<endl;
+    }
+  
   
   if( iline.find( "QESIGMA " ) < iline.size() )
     {
@@ -965,6 +991,15 @@ void ReadConfig::ReadLine(string iline, ifstream *inFileStream)
       i_stream >> fFADCHiLoGainThreshold[i_telType];
       cout<<"Telescope type "<<i_telType<<"  The lo gain is activated at dc "<<fFADCHiLoGainThreshold[i_telType]<<endl;
     }
+
+  //the zero suppression threshold of the channels written to the vbf file
+  if( iline.find( "FADCZEROSUPPRESSIONTHRESHOLD " ) < iline.size() )
+    {
+      i_stream >> i_char; i_stream >> i_char; 
+      i_stream >> i_telType;
+      i_stream >> fFADCZeroSuppressionThreshold[i_telType];
+      cout<<"Telescope type "<<i_telType<<"  Channels are zero suppressed in the vbf file below dc "<<fFADCZeroSuppressionThreshold[i_telType]<<endl;
+    }
   
   //the gain ratio of the low gain channel / high gain channel 
   if( iline.find( "FADCLOHIGHGAINRATIO " ) < iline.size() )
@@ -1009,6 +1044,23 @@ void ReadConfig::ReadLine(string iline, ifstream *inFileStream)
       cout<<"Telescope type "<<i_telType<<" If more than "<<uMinNumPhotonsRequired[i_telType]<<" Cherenkov photons are in the focal plane of the camera the event is simulated"<<endl;
     }
   
+  //Estimate from the photoelectrons in the trigger groups if a telescope can trigger at all 
+  //and skip the trace generation and the trigger simulation if it cannot
+  if( iline.find( "TRIGGERESTIMATOR " ) < iline.size() )
+    {
+      i_stream >> i_char; i_stream >> i_char; 
+      i_stream >> i_telType;
+      i_stream >> iTriggerEstimatorMode[i_telType];
+      i_stream >> fTriggerEstimatorNumSigma[i_telType];
+      if(iTriggerEstimatorMode[i_telType]<0 || iTriggerEstimatorMode[i_telType]>2 || fTriggerEstimatorNumSigma[i_telType]<0)
+	{
+	  cout<<"Telescope type "<<i_telType<<" TRIGGERESTIMATOR: the mode has to be 0, 1 or 2 and the number of sigmas >= 0"<<endl;
+	  exit(1);
+	}
+      cout<<"Telescope type "<<i_telType<<" Trigger estimator mode (0 off, 1 on, 2 validation): "<<iTriggerEstimatorMode[i_telType]
+	  <<" safety margin in sigma of the noise: "<<fTriggerEstimatorNumSigma[i_telType]<<endl;
+    }
+  
   
   //Do we use Crosstalk between pixel
   if( iline.find( "USECROSSTALK " ) < iline.size() )
@@ -80,6 +80,9 @@ class ReadConfig
   Bool_t  GetAfterPulsingUsage(UInt_t telType){ return  bUseAfterPulsing[telType]; };
   Float_t GetAfterPulsingConstant(UInt_t telType){ return  fAfterPulsingConstant[telType]; };
   Float_t GetAfterPulsingSlope(UInt_t telType){ return  fAfterPulsingSlope[telType]; };
+  Bool_t  GetNSBLibraryUsage(UInt_t telType){ return bUseNSBLibrary[telType]; };
+  Float_t GetNSBLibraryLength(UInt_t telType){ return fNSBLibraryLength[telType]; };
+  TString GetNameofNSBLibraryFile(UInt_t telType){ return sNSBLibraryFile[telType]; };
 
 
   vector< Float_t > GetRelQE(UInt_t telType);
@@ -92,6 +95,8 @@ class ReadConfig
   vector< vector < int > > GetTelescopeNeighbors(){ return vTelescopeNeighbors; };
 
   UInt_t  GetRequestedMinNumberOfPhotonsInCamera(UInt_t telType){ return uMinNumPhotonsRequired[telType]; };
+  Int_t   GetTriggerEstimatorMode(UInt_t telType){ return iTriggerEstimatorMode[telType]; };
+  Float_t GetTriggerEstimatorNumSigma(UInt_t telType){ return fTriggerEstimatorNumSigma[telType]; };
 
   Bool_t  GetBiasCurveBit(){ return bMakeBiasCurve; };
   UInt_t  GetNumberOfTrialsForBiasCurve(){ return uBiasCurveTrials; };
@@ -115,6 +120,7 @@ class ReadConfig
   Float_t GetFADCOffsetFromTrigger(UInt_t telType){return fFADCTimeOffsetFromTrigger[telType]; };
   Float_t GetFADCDCtoPEconversionFactor(UInt_t telType){return fFADCDCtoPEconversion[telType]; };
   Float_t GetFADCHiLoGainThreshold(UInt_t telType){return fFADCHiLoGainThreshold[telType]; };
+  Float_t GetFADCZeroSuppressionThreshold(UInt_t telType){return fFADCZeroSuppressionThreshold[telType]; };
   Float_t GetFADCLowHiGainRatio(UInt_t telType){return fFADCLowHiGainRatio[telType]; };
   Float_t GetFADCHighGainPedestal(UInt_t telType){return fFADCHighGainPedestal[telType]; };
   Float_t GetFADCLowGainPedestal(UInt_t telType){return fFADCLowGainPedestal[telType]; };
@@ -206,6 +212,9 @@ class ReadConfig
                                        //Fit function exp(a+b*x), where a=constant b=slope
   vector<Float_t> fAfterPulsingSlope;          //Slope of a fit to the rate vs. threshold curve of a single pe
                                        //Fit function exp(a+b*x), where a=constant b=slope
+  vector<Bool_t>  bUseNSBLibrary;              //Take the NSB of each pixel out of a pre-generated library
+  vector<Float_t> fNSBLibraryLength;           //Length of the NSB library in ns
+  vector<TString> sNSBLibraryFile;             //Cache file of the NSB library, "none" if no cache is used
   vector<Float_t>         fSamplingTime;       //The sampling rate or resolution of the simulated trace
   vector<Float_t>         fTraceLength;        //the length of the simulated trace per group
   vector<Float_t>         fStartSamplingBeforeAverageTime;   //start of sampling the trace before the average photon arrival time
@@ -247,6 +256,8 @@ class ReadConfig
   vector< Float_t >  fQESigma;                         //sigma of the QE distribution
 
   vector< UInt_t >  uMinNumPhotonsRequired;
+  vector< Int_t >   iTriggerEstimatorMode;            //0 off, 1 skip telescopes that cannot trigger, 2 validate the estimator
+  vector< Float_t > fTriggerEstimatorNumSigma;        //safety margin of the estimator in standard deviations
 
 
   //Optical PSF bluring 
@@ -277,6 +288,7 @@ class ReadConfig
   vector<Int_t>   iFADCDynamicRange;           //The dynamic range of the FADC
   vector<Float_t> fFADCTimeOffsetFromTrigger;  //The offset between the trigger time and the start of the readout window
   vector<Float_t> fFADCHiLoGainThreshold;      //The Threshold in FADC counts at which switching to the low gain is activated
+  vector<Float_t> fFADCZeroSuppressionThreshold; //The zero suppression threshold in FADC counts for the vbf output (negative: off)
   vector<Float_t> fFADCLowHiGainRatio;         //Gain ratio logain/higain
   vector<Float_t> fFADCHighGainPedestal;        //The FADC high gain pedestal in dc counts
   vector<Float_t> fFADCLowGainPedestal;         //The FADC low gain pedestal in dc counts
@@ -105,6 +105,8 @@ void   TelescopeData::SetupArrays(){
   //create the array with all the vectors, one vector for each pixel
   iFADCTraceInPixel = new vector<Int_t>[iNumPixels];
 
+  vNSBLibraryOffsetsInPixel.resize(iNumPixels);
+
   if(iSnapshotsDiscriminatedGroups)
     {
       delete [] iSnapshotsDiscriminatedGroups;
@@ -135,11 +137,14 @@ void TelescopeData::ResetTraces()
   iQDCInPixel.assign(iNumPixels,0);
   fSumTimeInPixel.assign(iNumPixels,0.0);
   iPEInPixel.assign(iNumPixels,0);
+  vSignalPixels.clear();
+  vCherenkovPEPixel.clear();
+  vCherenkovPETime.clear();
   bInLoGain.assign(iNumPixels,kFALSE);
+  iNumNSBPulsesInPixel.assign(iNumPixels,0);
   bTelescopeHasTriggered = kFALSE;
   vTriggerCluster.resize(0);
   //vSnapshotsDiscriminatedGroups.resize(0);
-  vSnapshotsDiscriminatedClusters.resize(0);
  
   //Clear the trace arrays
   for(Int_t g=0;g<iNumPixels;g++)
@@ -149,6 +154,7 @@ void TelescopeData::ResetTraces()
       fTimesInPixel[g].clear();
       fPileUpAmplitudeForPhoton[g].clear();
       fAmplitudesInPixel[g].clear();
+      vNSBLibraryOffsetsInPixel[g].clear();
       iFADCTraceInPixel[g].assign(iNumFADCSamples,0);
     }
 
@@ -74,6 +74,8 @@ class TelescopeData {
   vector<Float_t> *fTimesInPixel;
   vector<Float_t> *fAmplitudesInPixel;
   vector<Float_t> *fPileUpAmplitudeForPhoton;
+  vector< vector<Int_t> > vNSBLibraryOffsetsInPixel;      //sample offsets of the NSB library trace windows that make up the NSB of each pixel
+  vector<Int_t>   iNumNSBPulsesInPixel;                    //the first iNumNSBPulsesInPixel pulses of a pixel are already in the NSB library trace windows
   Float_t         fAveragePhotonArrivalTime;               //Holds the average photon arrival time of all photons in one event
   Double_t        mean;                                     //trace mean
   Bool_t          bCherenkovPhotonsInCamera;
@@ -97,6 +99,10 @@ class TelescopeData {
 
   vector<Int_t>   iPEInPixel;                          //the number of Cherenkov photoelectrons in each pixel
 
+  vector<Int_t>   vSignalPixels;                       //the pixels with at least one Cherenkov photoelectron, all others only have noise
+  vector<Int_t>   vCherenkovPEPixel;                   //pixel of each Cherenkov photoelectron before it is added to the trace
+  vector<Float_t> vCherenkovPETime;                    //time in the trace of each Cherenkov photoelectron
+
   vector<Float_t>   fSumTimeInPixel;              //the sum of all the Cherenkov photoelectrons arrival times in each pixel
 
   //Trigger related numbers
@@ -112,8 +118,6 @@ class TelescopeData {
   Int_t  iSnapshots;                                      //Number of snapshots (if CameraSnapshot is not used, it is set to -1)
   vector<Int_t>           vTriggerCluster;                  //the IDs of the groups that are in the cluster that triggered the telescope
   vector<Int_t> *iSnapshotsDiscriminatedGroups;    //the IDs of the groups that are in discriminated clusters, snapshot by snapshot (for CameraSnapshot logic)
-  vector < vector< vector<Int_t> > >
-    vSnapshotsDiscriminatedClusters;                      //the IDs of the groups that are discriminated, clusters by cluster, snapshot by snapshot (for CameraSnapshot logic)
 
   //Pixel related variables
   vector< Float_t > fRelQE;
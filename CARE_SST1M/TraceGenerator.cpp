@@ -9,6 +9,7 @@
 #include <math.h>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
 #include <TMath.h>
 #include <TTimer.h>
 #include <Getline.h>
@@ -51,10 +52,28 @@ TraceGenerator::TraceGenerator( ReadConfig *readConfig , int telType, TRandom3 *
   fFWHMofSinglePEPulse = -1;
   fLinearGainmVPerPE = -1;
   fPileUpWindow = -1;
+  bUseNSBLibrary = kFALSE;
+  fNSBLibraryLength = 0;
+  bNSBLibraryTrace = kFALSE;
+  iNSBLibraryMaxOffset = 0;
+  fNSBWindowLength = 0;
+  lNSBLibraryDraws = 0;
+  lNSBLibraryReadouts = 0;
+  iTriggerEstimatorMode = 0;
+  fMeanAmplitudeOfPE = 1.0;
+  fVarianceAmplitudeOfPE = 0.0;
+  fNSBMeanPerRelQE = 0.0;
+  fNSBVariancePerRelQE = 0.0;
+  fMaxNonLinearityFactor = 1.0;
   //Read the config file
   SetParametersFromConfigFile( readConfig );
   
   rand = generator;
+
+  if(bUseNSB && bUseNSBLibrary)
+    SetupNSBLibrary();
+  if(iTriggerEstimatorMode>0)
+    SetupTriggerEstimator();
   string s = "";                                                                             
   
   gridsearch = new GOrderedGridSearch(fXTubeMM,fYTubeMM,fSizeTubeMM,iTubeSides,fRotAngle,19,19,1,s);
@@ -83,6 +102,16 @@ telData = TelData;
 //Loads the PEs into the pixels. If UseNSB is set true NSB is added to the trace
 //which requires that SetNSBRatePerPixel(Float_t rate) has been set before
 void  TraceGenerator::LoadCherenkovPhotons(std::vector< float > *v_f_X,std::vector< float > *v_f_Y,std::vector< float > *v_f_time,std::vector< float > *v_f_lambda, Float_t delay, Double_t dEfficiencyFactor)
+{
+  ConvertPhotonsToPE(v_f_X,v_f_Y,v_f_time,v_f_lambda,delay,dEfficiencyFactor,kTRUE);
+}
+
+//-----------------------------------------------------------------------------------------------------------------------
+//Finds the pixel and time of the photoelectrons of the Cherenkov photons without touching the traces.
+//Fills iPEInPixel and the list of Cherenkov photoelectrons, which LoadPhotoelectrons adds to the traces.
+//With bLoadTraces the NSB is generated first and each photoelectron is added to the trace as soon as it
+//is found, which keeps the order of the random numbers of LoadCherenkovPhotons
+void  TraceGenerator::ConvertPhotonsToPE(std::vector< float > *v_f_X,std::vector< float > *v_f_Y,std::vector< float > *v_f_time,std::vector< float > *v_f_lambda, Float_t delay, Double_t dEfficiencyFactor, Bool_t bLoadTraces)
 {
    
 
@@ -101,12 +130,14 @@ void  TraceGenerator::LoadCherenkovPhotons(std::vector< float > *v_f_X,std::vect
   if(bDebug)
     cout<<"Camera has "<<iNumPixels<<" pixel"<<endl;
 
+  if(bLoadTraces)
+    {
+      //Load the NSB into the Traces, will be skipped in function if no NSB generation is wanted
+      GenerateNSB();
 
-    //Load the NSB into the Traces, will be skipped in function if no NSB generation is wanted
-    GenerateNSB();
- 
-  if(bDebug)
-   cout<<"NSB done"<<endl;
+      if(bDebug)
+        cout<<"NSB done"<<endl;
+    }
 
   //Find the average time of all PEs
   telData->fAveragePhotonArrivalTime = 0;
@@ -189,7 +220,16 @@ void  TraceGenerator::LoadCherenkovPhotons(std::vector< float > *v_f_X,std::vect
  	   cout<<"eff: "<<eff<<" lambda "<<lambda<<"  qe[lambda] "<<qe[lambda]<<" telData->fRelQEwWC[pixID] "<<telData->fRelQEwWC[pixID]<<" efficiency factor: "<<dEfficiencyFactor<<endl;
            if(rand->Uniform()<eff)
                  {
-	          AddPEToTrace(pixID, v_f_time->at(p)-(telData->fAveragePhotonArrivalTime-fStartSamplingBeforeAverageTime)); //Start filling fStartSamplingBeforeAverageTime ns before the average time
+                  Float_t fPETime = v_f_time->at(p)-(telData->fAveragePhotonArrivalTime-fStartSamplingBeforeAverageTime); //Start filling fStartSamplingBeforeAverageTime ns before the average time
+                  if(bLoadTraces)
+                    AddPEToTrace(pixID, fPETime);
+                  else
+                    {
+	              telData->vCherenkovPEPixel.push_back(pixID);
+	              telData->vCherenkovPETime.push_back(fPETime);
+                    }
+                  if(telData->iPEInPixel[pixID]==0)
+                    telData->vSignalPixels.push_back(pixID);
                   telData->iPEInPixel[pixID]++;
                   telData->fSumTimeInPixel[pixID]+=v_f_time->at(p)-telData->fAveragePhotonArrivalTime;
                  }
@@ -208,6 +248,159 @@ void  TraceGenerator::LoadCherenkovPhotons(std::vector< float > *v_f_X,std::vect
 
 }
 
+//-----------------------------------------------------------------------------------------------------------------------
+//Adds the NSB and the Cherenkov photoelectrons found by ConvertPhotonsToPE to the traces.
+//The NSB has to go in first, the NSB library relies on it
+void  TraceGenerator::LoadPhotoelectrons()
+{
+  //Load the NSB into the Traces, will be skipped in function if no NSB generation is wanted
+  GenerateNSB();
+ 
+  if(bDebug)
+   cout<<"NSB done"<<endl;
+
+  for(UInt_t p=0; p<telData->vCherenkovPEPixel.size(); p++)
+    AddPEToTrace(telData->vCherenkovPEPixel[p], telData->vCherenkovPETime[p]);
+}
+
+//-----------------------------------------------------------------------------------------------------------------------
+//Sets up the numbers needed by EstimatePeakSignalInPixels: the moments of the amplitude of a single pe,
+//the NSB noise of a pixel and the largest gain due to the nonlinearity of the pulse shapes
+void  TraceGenerator::SetupTriggerEstimator()
+{
+  if(fHighGainPulse.size()==0 || fSamplingTimeAveragePulse<=0)
+    {
+      cout<<"SetupTriggerEstimator: You need to set the pulse shapes first"<<endl;
+      exit(1);
+    }
+
+  Double_t dMean, dMeanSquare;
+  GetMomentsOfPEAmplitude(1,dMean,dMeanSquare);
+  fMeanAmplitudeOfPE = dMean;
+  fVarianceAmplitudeOfPE = dMeanSquare-dMean*dMean;
+
+  //Moments of the amplitude of one NSB pulse, integrating over the afterpulsing
+  //distribution the same way DrawNumPEOfNSBPulse draws from it
+  Double_t dNSBMean = dMean;
+  Double_t dNSBMeanSquare = dMeanSquare;
+  if(bAfterPulsing)
+    {
+      Double_t dMaxAP = exp(fAPconstant + fAPslope * 1.5);
+      dMaxAP = dMaxAP < 1.0 ? dMaxAP : 1.0;
+      const Int_t iNumSteps = 100000;
+      dNSBMean = (1.0-dMaxAP)*dMean;
+      dNSBMeanSquare = (1.0-dMaxAP)*dMeanSquare;
+      for(Int_t k=0;k<iNumSteps;k++)
+        {
+          Double_t m = (k+0.5)/iNumSteps*dMaxAP;
+          Double_t dAPMean, dAPMeanSquare;
+          GetMomentsOfPEAmplitude(int( ( log(m) - fAPconstant ) / fAPslope +1 ),dAPMean,dAPMeanSquare);
+          dNSBMean += dAPMean*dMaxAP/iNumSteps;
+          dNSBMeanSquare += dAPMeanSquare*dMaxAP/iNumSteps;
+        }
+    }
+
+  //Campbell's theorem: mean and variance of the NSB in a trace sample
+  Double_t dIntegral = 0.0;
+  Double_t dIntegralSquare = 0.0;
+  for(UInt_t i=0;i<fHighGainPulse[0].size();i++)
+    {
+      dIntegral += fabs(fHighGainPulse[0][i])*fSamplingTimeAveragePulse;
+      dIntegralSquare += fHighGainPulse[0][i]*fHighGainPulse[0][i]*fSamplingTimeAveragePulse;
+    }
+  if(bUseNSB)
+    {
+      fNSBMeanPerRelQE = fNSBRatePerPixel*1e-6*dNSBMean*dIntegral;
+      fNSBVariancePerRelQE = fNSBRatePerPixel*1e-6*dNSBMeanSquare*dIntegralSquare;
+    }
+
+  fMaxNonLinearityFactor = 1.0;
+  for(UInt_t i=0;i<fHighGainNonLinearityFactor.size();i++)
+    fMaxNonLinearityFactor = fHighGainNonLinearityFactor[i] > fMaxNonLinearityFactor ? fHighGainNonLinearityFactor[i] : fMaxNonLinearityFactor;
+
+  cout<<"Trigger estimator of telescope type "<<iTelType<<": single pe amplitude "<<fMeanAmplitudeOfPE<<" +- "<<sqrt(fVarianceAmplitudeOfPE)
+      <<", sigma of the NSB in a pixel with relative QE 1 "<<sqrt(fNSBVariancePerRelQE)<<" pe, largest nonlinearity factor "<<fMaxNonLinearityFactor<<endl;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------
+//Mean and mean square of the amplitude drawn by DrawAmplitudeOfPE(NumPE), i.e. of a Gaussian truncated at zero
+void  TraceGenerator::GetMomentsOfPEAmplitude(Int_t NumPE, Double_t &mean, Double_t &meansquare)
+{
+  Double_t mu = NumPE;
+  Double_t sigma = sqrt((Double_t)NumPE)*fSigmaSinglePEPulseHeightDistribution;
+  if(sigma<=0)
+    {
+      mean = mu;
+      meansquare = mu*mu;
+      return;
+    }
+
+  Double_t alpha = -mu/sigma;
+  Double_t lambda = exp(-0.5*alpha*alpha)/sqrt(2*TMath::Pi())/(0.5*TMath::Erfc(alpha/sqrt(2.0)));
+  mean = mu+sigma*lambda;
+  meansquare = sigma*sigma*(1+alpha*lambda-lambda*lambda)+mean*mean;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------
+//Conservative estimate of the largest signal each pixel can have in the trace, from the photoelectrons found by
+//ConvertPhotonsToPE. All Cherenkov photoelectrons of a pixel are assumed to arrive at the same time.
+//fSignal is the mean of that peak signal in pe and fVariance its variance due to the gain fluctuations,
+//the NSB and the electronic noise. Needs SetTelData and ConvertPhotonsToPE to be called before
+void  TraceGenerator::EstimatePeakSignalInPixels(vector<Float_t> &fSignal, vector<Float_t> &fVariance)
+{
+  fSignal.assign(iNumPixels,0.0);
+  fVariance.assign(iNumPixels,telData->fSigmaElectronicNoise*telData->fSigmaElectronicNoise);
+
+  //for an SiPM each fired cell fires on average 1/(1-p) cells due to optical crosstalk
+  vector<Float_t> fCells(iNumPixels,1.0);
+  vector<Float_t> fCellsSquare(iNumPixels,1.0);
+  if(bSiPM)
+    for(Int_t i=0;i<iNumPixels;i++)
+      if(vSiPMOpticalCrosstalk[i]<1)
+        {
+          fCells[i] = 1.0/(1.0-vSiPMOpticalCrosstalk[i]);
+          fCellsSquare[i] = (1.0+vSiPMOpticalCrosstalk[i])*fCells[i]*fCells[i];
+        }
+
+  //NSB noise. The traces are shifted by the mean NSB of the camera, pixels with a larger NSB rate
+  //or gain than average end up with an offset in the direction of the signal
+  if(bUseNSB)
+    {
+      Double_t dMeanNSB = 0.0;
+      for(Int_t i=0;i<iNumPixels;i++)
+        dMeanNSB += telData->fRelQE[i]*telData->fRelGain[i]*fCells[i];
+      dMeanNSB /= iNumPixels;
+
+      for(Int_t i=0;i<iNumPixels;i++)
+        {
+          Float_t fGain = telData->fRelGain[i];
+          fVariance[i] += telData->fRelQE[i]*fGain*fGain*fCellsSquare[i]*fNSBVariancePerRelQE;
+          Float_t fOffset = (telData->fRelQE[i]*fGain*fCells[i]-dMeanNSB)*fNSBMeanPerRelQE;
+          if(fOffset>0)
+            fSignal[i] += fOffset;
+        }
+    }
+
+  //Cherenkov photoelectrons
+  for(UInt_t s=0;s<telData->vSignalPixels.size();s++)
+    {
+      Int_t i = telData->vSignalPixels[s];
+      Float_t fGain = telData->fRelGain[i]*fMaxNonLinearityFactor;
+      Float_t fAmplitude = telData->iPEInPixel[i]*fGain*fCells[i]*fMeanAmplitudeOfPE;
+      Float_t fAmplitudeVariance = telData->iPEInPixel[i]*fGain*fGain*
+                                   (fCells[i]*fVarianceAmplitudeOfPE+(fCellsSquare[i]-fCells[i]*fCells[i])*fMeanAmplitudeOfPE*fMeanAmplitudeOfPE);
+      fSignal[i] += fAmplitude;
+      fVariance[i] += fAmplitudeVariance;
+
+      if(bCrosstalk)
+        for(UInt_t n = 0;n<vNeighbors[i].size(); n++)
+          {
+            fSignal[ vNeighbors[i][n] ] += fAmplitude*fCrosstalk;
+            fVariance[ vNeighbors[i][n] ] += fAmplitudeVariance*fCrosstalk*fCrosstalk;
+          }
+    }
+}
+
 //-------------------------------------------------------------------------------------
 //
 // Function to reset the SiPM
@@ -324,9 +517,7 @@ void TraceGenerator::AddPEToTrace(Int_t PixelID, Float_t time, Int_t NumPE)
   }
 
   //Add some fluctuations to the amplitude
-  Float_t newAmpl=0.;
-  while(newAmpl<=0)
-    newAmpl = rand->Gaus((Float_t)NumPE,sqrt((Float_t)NumPE)*fSigmaSinglePEPulseHeightDistribution);
+  Float_t newAmpl = DrawAmplitudeOfPE(NumPE);
 
   if(bDebug)
     cout<<"Amplitude of signal after PMT fluctuations "<<newAmpl<<endl;
@@ -361,6 +552,42 @@ void TraceGenerator::AddPEToTrace(Int_t PixelID, Float_t time, Int_t NumPE)
 
 }
 
+//--------------------------------------------------------------------------------------------
+//
+//Draws the amplitude of a signal of NumPE photoelectrons including the fluctuations
+//of the single pe pulse height
+Float_t TraceGenerator::DrawAmplitudeOfPE(Int_t NumPE)
+{
+  Float_t newAmpl=0.;
+  while(newAmpl<=0)
+    newAmpl = rand->Gaus((Float_t)NumPE,sqrt((Float_t)NumPE)*fSigmaSinglePEPulseHeightDistribution);
+
+  return newAmpl;
+}
+
+//--------------------------------------------------------------------------------------------
+//
+//Draws the number of photoelectrons of one NSB pulse, which is one unless afterpulsing is simulated
+Int_t TraceGenerator::DrawNumPEOfNSBPulse()
+{
+  int l = 1;
+
+  if(bAfterPulsing==kTRUE)
+    {
+      //mix in some afterpulsing
+      double m = rand->Uniform();
+
+      //convert this into the proper afterpulsing amplitude if we 
+      //are above 1.5 photoelectrons
+      if( m < exp(fAPconstant + fAPslope * 1.5) )
+        l = int( ( log(m) - fAPconstant ) / fAPslope +1 ) ;
+      if(bDebug)
+        cout<<"Afterpulsing added: "<<l<<endl;
+    }
+
+  return l;
+}
+
 //---------------------------------------------------------------------
 //Add NSB to all traces
 void TraceGenerator::GenerateNSB()
@@ -387,6 +614,16 @@ void TraceGenerator::GenerateNSB()
   
   
   //cout<<iNumPixInSumGroup[0]<<endl;
+  //take the NSB out of the library
+  if(bUseNSB && bUseNSBLibrary)
+    {
+      for(Int_t i=0;i<iNumPixels;i++)
+        AddNSBFromLibrary(i);
+
+      lNSBLibraryReadouts++;
+      return;
+    }
+
   //Loop over all pixel
   if(bUseNSB)
     {
@@ -406,20 +643,7 @@ void TraceGenerator::GenerateNSB()
 	      if(t>fTraceLength+fHighGainStartTime[0])
 		break;
 	      
-	      int l = 1;
-	      
-	      if(bAfterPulsing==kTRUE)
-		{
-		  //mix in some afterpulsing
-		  double m = rand->Uniform();
-		  
-		  //convert this into the proper afterpulsing amplitude if we 
-		  //are above 1.5 photoelectrons
-		  if( m < exp(fAPconstant + fAPslope * 1.5) )
-		    l = int( ( log(m) - fAPconstant ) / fAPslope +1 ) ;
-		  if(bDebug)
-		    cout<<"Afterpulsing added: "<<l<<endl;
-		}
+	      int l = DrawNumPEOfNSBPulse();
 	      
 	      AddPEToTrace(i,t,l);
 	    }
@@ -427,6 +651,213 @@ void TraceGenerator::GenerateNSB()
     } //end bUseNSB  
 }
 
+//---------------------------------------------------------------------
+//Sets up the NSB library: one long sequence of NSB pulses at the nominal
+//NSB rate and unit gain, out of which AddNSBFromLibrary takes randomly
+//placed windows. Comes from the cache file if there is a matching one.
+void TraceGenerator::SetupNSBLibrary()
+{
+  if(bSiPM || bCrosstalk)
+    {
+      cout<<"SetupNSBLibrary: The NSB library can not be used with SiPMs or crosstalk between pixel. Every NSB pulse has to be simulated on its own for those"<<endl;
+      exit(1);
+    }
+
+  if(fNSBRatePerPixel<=0)
+    {
+      cout<<"SetupNSBLibrary: You need to set the NSB rate in kHz per pixel before setting up the NSB library"<<endl;
+      exit(1);
+    }
+
+  //the time span each pixel is filled with NSB in GenerateNSB
+  fNSBWindowLength = fTraceLength+fHighGainStartTime[0]+fHighGainStopTime[0];
+
+  //windows start at multiples of the sampling time, so they line up with the samples of the library trace
+  iNSBLibraryMaxOffset = Int_t(fNSBLibraryLength/fSamplingTime);
+  Double_t dLibrarySpan = iNSBLibraryMaxOffset*fSamplingTime+fNSBWindowLength;
+
+  if(!ReadNSBLibraryFromFile(dLibrarySpan))
+    {
+      cout<<"Generating the NSB library for telescope type "<<iTelType<<endl;
+      fNSBLibraryTimes.clear();
+      fNSBLibraryAmplitudes.clear();
+
+      Double_t dNSBRate = fNSBRatePerPixel*1e-6;
+      Double_t t = 0;
+      while(1)
+        {
+          t+= -1*log(rand->Uniform())/dNSBRate;
+
+          if(t>dLibrarySpan)
+            break;
+
+          fNSBLibraryTimes.push_back(t);
+          fNSBLibraryAmplitudes.push_back(DrawAmplitudeOfPE(DrawNumPEOfNSBPulse()));
+        }
+
+      WriteNSBLibraryToFile(dLibrarySpan);
+    }
+
+  cout<<"NSB library of telescope type "<<iTelType<<" has "<<fNSBLibraryTimes.size()<<" pulses in "<<dLibrarySpan<<" ns"<<endl;
+
+  //the electronic noise is white, a window out of a long pre-generated sequence is as good as 
+  //drawing each sample. Pixels that only have noise need no random numbers per sample this way.
+  Int_t iNumSamplesPerTrace = Int_t(fTraceLength/fSamplingTime);
+  fElectronicNoiseLibrary.resize(iNSBLibraryMaxOffset+iNumSamplesPerTrace);
+  for(UInt_t i=0;i<fElectronicNoiseLibrary.size();i++)
+    fElectronicNoiseLibrary[i] = rand->Gaus(0.0,1.0);
+
+  //With one high gain pulse shape the trace is linear in the amplitudes, so the high gain
+  //trace of the library can be built once and scaled with the gain of each pixel
+  bNSBLibraryTrace = fHighGainPulse.size()==1;
+  if(!bNSBLibraryTrace)
+    {
+      cout<<"More than one high gain pulse shape, NSB pulses out of the library are added to the traces one by one"<<endl;
+      return;
+    }
+
+  fNSBLibraryTrace.assign(iNSBLibraryMaxOffset+iNumSamplesPerTrace,0.0);
+  for(UInt_t p=0;p<fNSBLibraryTimes.size();p++)
+    {
+      //the library trace starts where the window with offset zero starts in GenerateNSB.
+      //Fill each pulse relative to a nearby sample to keep the float precision of the time
+      Double_t dTime = fNSBLibraryTimes[p]-fHighGainStopTime[0];
+      Int_t iFirstSample = Int_t((dTime-fHighGainStartTime[0])/fSamplingTime);
+      if(iFirstSample<0)
+        iFirstSample = 0;
+      if(iFirstSample>=(Int_t)fNSBLibraryTrace.size())
+        break;
+
+      AddPulseShapeToTrace(&fNSBLibraryTrace[iFirstSample],fNSBLibraryTrace.size()-iFirstSample,
+                           dTime-iFirstSample*fSamplingTime,fNSBLibraryAmplitudes[p],0,kFALSE);
+    }
+}
+
+//---------------------------------------------------------------------
+//Reads the NSB library from the cache file. Returns false if there is no
+//cache file or if it was made with different NSB settings
+Bool_t TraceGenerator::ReadNSBLibraryFromFile(Double_t dLibrarySpan)
+{
+  if(sNSBLibraryFile == "" || sNSBLibraryFile == "none")
+    return kFALSE;
+
+  std::ifstream LibraryFile(sNSBLibraryFile.Data(),ios::binary);
+  if(!LibraryFile)
+    {
+      cout<<"ReadNSBLibraryFromFile: no NSB library in "<<sNSBLibraryFile.Data()<<" yet, will generate one"<<endl;
+      return kFALSE;
+    }
+
+  Float_t fSettings[5];
+  Double_t dSpan = 0;
+  UInt_t uNumPulses = 0;
+  LibraryFile.read((char*)fSettings,sizeof(fSettings));
+  LibraryFile.read((char*)&dSpan,sizeof(dSpan));
+  LibraryFile.read((char*)&uNumPulses,sizeof(uNumPulses));
+
+  if(!LibraryFile.good() || fSettings[0]!=fNSBRatePerPixel || fSettings[1]!=(Float_t)bAfterPulsing 
+     || fSettings[2]!=fAPconstant || fSettings[3]!=fAPslope || fSettings[4]!=fSigmaSinglePEPulseHeightDistribution
+     || dSpan<dLibrarySpan)
+    {
+      cout<<"ReadNSBLibraryFromFile: the NSB library in "<<sNSBLibraryFile.Data()<<" was made with different settings, will generate a new one"<<endl;
+      return kFALSE;
+    }
+
+  fNSBLibraryTimes.resize(uNumPulses);
+  fNSBLibraryAmplitudes.resize(uNumPulses);
+  if(uNumPulses>0)
+    {
+      LibraryFile.read((char*)&fNSBLibraryTimes[0],uNumPulses*sizeof(Double_t));
+      LibraryFile.read((char*)&fNSBLibraryAmplitudes[0],uNumPulses*sizeof(Float_t));
+    }
+
+  if(!LibraryFile.good())
+    {
+      cout<<"ReadNSBLibraryFromFile: could not read all "<<uNumPulses<<" pulses from "<<sNSBLibraryFile.Data()<<", will generate a new library"<<endl;
+      return kFALSE;
+    }
+
+  //only keep what is needed
+  UInt_t uKeep = upper_bound(fNSBLibraryTimes.begin(),fNSBLibraryTimes.end(),dLibrarySpan)-fNSBLibraryTimes.begin();
+  fNSBLibraryTimes.resize(uKeep);
+  fNSBLibraryAmplitudes.resize(uKeep);
+
+  cout<<"Read the NSB library from "<<sNSBLibraryFile.Data()<<endl;
+  return kTRUE;
+}
+
+//---------------------------------------------------------------------
+//Writes the NSB library into the cache file
+void TraceGenerator::WriteNSBLibraryToFile(Double_t dLibrarySpan)
+{
+  if(sNSBLibraryFile == "" || sNSBLibraryFile == "none")
+    return;
+
+  std::ofstream LibraryFile(sNSBLibraryFile.Data(),ios::binary);
+  if(!LibraryFile)
+    {
+      cout<<"WriteNSBLibraryToFile: could not open "<<sNSBLibraryFile.Data()<<" the NSB library will not be cached"<<endl;
+      return;
+    }
+
+  Float_t fSettings[5] = { fNSBRatePerPixel, (Float_t)bAfterPulsing, fAPconstant, fAPslope, fSigmaSinglePEPulseHeightDistribution };
+  UInt_t uNumPulses = fNSBLibraryTimes.size();
+  LibraryFile.write((char*)fSettings,sizeof(fSettings));
+  LibraryFile.write((char*)&dLibrarySpan,sizeof(dLibrarySpan));
+  LibraryFile.write((char*)&uNumPulses,sizeof(uNumPulses));
+  if(uNumPulses>0)
+    {
+      LibraryFile.write((char*)&fNSBLibraryTimes[0],uNumPulses*sizeof(Double_t));
+      LibraryFile.write((char*)&fNSBLibraryAmplitudes[0],uNumPulses*sizeof(Float_t));
+    }
+
+  cout<<"Wrote the NSB library into "<<sNSBLibraryFile.Data()<<endl;
+}
+
+//---------------------------------------------------------------------
+//Fills the NSB of one pixel with randomly placed windows out of the library.
+//The library has the nominal NSB rate. The relative QE of the pixel is taken
+//care of by int(relQE) full windows plus one window in which each pulse is kept
+//with the probability relQE-int(relQE). Non-overlapping windows are independent
+//Poisson processes, so the sum has the right rate.
+void TraceGenerator::AddNSBFromLibrary(Int_t PixelID)
+{
+  Float_t fRelRate = telData->fRelQE[PixelID];
+  Int_t iFullWindows = Int_t(fRelRate);
+  Float_t fKeepProbability = fRelRate-iFullWindows;
+
+  for(Int_t w=0;w<=iFullWindows;w++)
+    {
+      Bool_t bFullWindow = w<iFullWindows;
+      if(!bFullWindow && fKeepProbability<=0)
+        break;
+
+      Int_t iOffset = rand->Integer(iNSBLibraryMaxOffset+1);
+      lNSBLibraryDraws++;
+
+      Double_t dStart = iOffset*fSamplingTime;
+      UInt_t uFirst = lower_bound(fNSBLibraryTimes.begin(),fNSBLibraryTimes.end(),dStart)-fNSBLibraryTimes.begin();
+      UInt_t uLast = upper_bound(fNSBLibraryTimes.begin()+uFirst,fNSBLibraryTimes.end(),dStart+fNSBWindowLength)-fNSBLibraryTimes.begin();
+
+      for(UInt_t p=uFirst;p<uLast;p++)
+        {
+          if(!bFullWindow && rand->Uniform()>=fKeepProbability)
+            continue;
+
+          //same time axis as in GenerateNSB, the window starts at -fHighGainStopTime[0]
+          telData->fTimesInPixel[PixelID].push_back(fNSBLibraryTimes[p]-dStart-fHighGainStopTime[0]);
+          telData->fAmplitudesInPixel[PixelID].push_back(fNSBLibraryAmplitudes[p]*telData->fRelGain[PixelID]);
+        }
+
+      //the pulses of full windows are already in the library trace, BuildTrace takes them from there
+      if(bFullWindow && bNSBLibraryTrace)
+        {
+          telData->vNSBLibraryOffsetsInPixel[PixelID].push_back(iOffset);
+          telData->iNumNSBPulsesInPixel[PixelID] = telData->fTimesInPixel[PixelID].size();
+        }
+    }
+}
+
 
 
 //--------------------------------------------------------------------------------------------------
@@ -727,8 +1158,27 @@ void TraceGenerator::SetTraceSampleWidthAndLength(Float_t t,Float_t length,Float
 
 void TraceGenerator::BuildTrace(Int_t PixelID,Bool_t bLowGain){
 
+  //get vectors to low gain or high gain pulses and information respectively
+  vector< vector<Float_t> > *vPulse; 
+  vector<Float_t> *vLinearAmplitude;
+  vector<Float_t> *vNonLinearityFactor;
+
+  if(bLowGain)
+   {
+    vPulse = &fLowGainPulse; 
+    vLinearAmplitude = &fLowGainLinearAmplitude;
+    vNonLinearityFactor = &fLowGainNonLinearityFactor;
+   }
+  else
+   {
+    vPulse = &fHighGainPulse;    
+    vLinearAmplitude = &fHighGainLinearAmplitude;
+    vNonLinearityFactor = &fHighGainNonLinearityFactor;
+   }
+
   //First Check if the fPileUpAmplitudeForPhoton array is zero. If it is we have to generate it first
-  if(telData->fPileUpAmplitudeForPhoton[PixelID].size()==0 && telData->fTimesInPixel[PixelID].size()!=0)
+  //It is only needed to pick the pulse shape if there is more than one
+  if(vPulse->size()>1 && telData->fPileUpAmplitudeForPhoton[PixelID].size()==0 && telData->fTimesInPixel[PixelID].size()!=0)
     {
        telData->fPileUpAmplitudeForPhoton[PixelID].assign(telData->fTimesInPixel[PixelID].size(),0);
        //loop over all the photons in that pixel and determine for each photon how many photons are next to it
@@ -755,7 +1205,16 @@ void TraceGenerator::BuildTrace(Int_t PixelID,Bool_t bLowGain){
     }//end building the fPileUpAmplitudeForPhoton array
 
    //add electronic noise to the high gain trace
-   if(telData->fSigmaElectronicNoise>0 && !bLowGain)
+   if(telData->fSigmaElectronicNoise>0 && !bLowGain && fElectronicNoiseLibrary.size()>0)
+     {
+       //window out of the pre-generated electronic noise
+       Float_t *fNoise = &fElectronicNoiseLibrary[rand->Integer(iNSBLibraryMaxOffset+1)];
+       for(Int_t i=0; i<telData->iNumSamplesPerTrace;i++)
+         {
+               telData->fTraceInPixel[PixelID][i]=fNoise[i]*telData->fSigmaElectronicNoise;
+         }
+     }
+   else if(telData->fSigmaElectronicNoise>0 && !bLowGain)
      {
        for(Int_t i=0; i<telData->iNumSamplesPerTrace;i++)
          {
@@ -765,38 +1224,23 @@ void TraceGenerator::BuildTrace(Int_t PixelID,Bool_t bLowGain){
    else
      telData->fTraceInPixel[PixelID].assign(telData->iNumSamplesPerTrace,0.0);
 
+  //NSB that has been taken out of the library comes as windows of the library trace
+  UInt_t uFirstPulse = 0;
+  if(!bLowGain)
+    {
+      for(UInt_t w=0;w<telData->vNSBLibraryOffsetsInPixel[PixelID].size();w++)
+        {
+          Float_t *fWindow = &fNSBLibraryTrace[telData->vNSBLibraryOffsetsInPixel[PixelID][w]];
+          for(Int_t i=0; i<telData->iNumSamplesPerTrace;i++)
+            {
+              telData->fTraceInPixel[PixelID][i]+=fWindow[i]*telData->fRelGain[PixelID];
+            }
+        }
+      uFirstPulse = telData->iNumNSBPulsesInPixel[PixelID];
+    }
 
-  //Now prepare to fill in the photons in the trace
-
-  //get vectors to low gain or high gain pulses and information respectively
-  vector< vector<Float_t> > *vPulse; 
-  //vector<Float_t> *vAreaToPeakConversion;
-  vector<Float_t> *vStartTime;
-  vector<Float_t> *vStopTime;
-  vector<Float_t> *vLinearAmplitude;
-  vector<Float_t> *vNonLinearityFactor;
-
-  if(bLowGain)
-   {
-    vPulse = &fLowGainPulse; 
-    //vAreaToPeakConversion = &fLowGainAreaToPeakConversion;
-    vStartTime = &fLowGainStartTime;
-    vStopTime = &fLowGainStopTime;
-    vLinearAmplitude = &fLowGainLinearAmplitude;
-    vNonLinearityFactor = &fLowGainNonLinearityFactor;
-   }
-  else
-   {
-    vPulse = &fHighGainPulse;    
-    //vAreaToPeakConversion = &fHighGainAreaToPeakConversion;
-    vStartTime = &fHighGainStartTime;
-    vStopTime = &fHighGainStopTime;
-    vLinearAmplitude = &fHighGainLinearAmplitude;
-    vNonLinearityFactor = &fHighGainNonLinearityFactor;
-   }
-
-  //loop over all the photons in the trace
-  for(UInt_t g=0;g<telData->fTimesInPixel[PixelID].size();g++)
+  //Now fill in the photons in the trace
+  for(UInt_t g=uFirstPulse;g<telData->fTimesInPixel[PixelID].size();g++)
     {
       Float_t time = telData->fTimesInPixel[PixelID][g];
 
@@ -848,42 +1292,8 @@ void TraceGenerator::BuildTrace(Int_t PixelID,Bool_t bLowGain){
       if(bDebug)
       cout<<"Use pulse number: "<<uPulseShape<<" non linearity "<<fNonLinearity<<endl;       
 
-      //figure out where we start filling the signal into the Trace
-      Float_t StartTimeInTrace = time-vStartTime->at(uPulseShape);
-      Int_t StartSample = Int_t(StartTimeInTrace/fSamplingTime+1);
-      Int_t StopSample = Int_t((StartTimeInTrace+vStartTime->at(uPulseShape)+vStopTime->at(uPulseShape))/fSamplingTime+1);
-
-      //The time between the start of the Trace and the first sampled value
-      Float_t TimeAveragePulse= StartSample*fSamplingTime-StartTimeInTrace;
-
-      //Catch the case when we get out of the trace window
-      //Trace fully out of window
-      if(StartTimeInTrace<-vStartTime->at(uPulseShape)-vStopTime->at(uPulseShape))
-        continue;
-
-      if(StartSample<0)
-     {
-      TimeAveragePulse = -1.0*StartTimeInTrace;
-      StartTimeInTrace = 0;
-      StartSample = 0;
-     }
-      if(StopSample>telData->iNumSamplesPerTrace)
-     {
-      StopSample = telData->iNumSamplesPerTrace;
-     }
-
-      // cout<<"Fill pe from: "<<StartSample<<" to "<<StopSample<<" Start time is "<<StartTime<<endl;
-
-      //Finally fill the PE into the trace
-      TimeAveragePulse = TimeAveragePulse / fSamplingTimeAveragePulse;
-      Float_t step = fSamplingTime/fSamplingTimeAveragePulse;
-      Float_t amplitude = telData->fAmplitudesInPixel[PixelID][g]*fNonLinearity;
-      for(Int_t i=StartSample;i<StopSample;i++)
-      {
-       Int_t s = (Int_t)(TimeAveragePulse);
-       telData->fTraceInPixel[PixelID][i]+= vPulse->at(uPulseShape)[s]*amplitude;
-       TimeAveragePulse+=step;
-      }
+      AddPulseShapeToTrace(&telData->fTraceInPixel[PixelID][0],telData->iNumSamplesPerTrace,time,
+                           telData->fAmplitudesInPixel[PixelID][g]*fNonLinearity,uPulseShape,bLowGain);
 
     }//go to the next photon.
 
@@ -895,6 +1305,56 @@ void TraceGenerator::BuildTrace(Int_t PixelID,Bool_t bLowGain){
 
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Adds one pulse of shape uPulseShape with amplitude amplitude at time time to a trace 
+// with iNumSamples samples
+//
+
+void TraceGenerator::AddPulseShapeToTrace(Float_t *trace, Int_t iNumSamples, Float_t time, Float_t amplitude, UInt_t uPulseShape, Bool_t bLowGain){
+
+  vector<Float_t> *vPulse = bLowGain ? &fLowGainPulse[uPulseShape] : &fHighGainPulse[uPulseShape]; 
+  Float_t fStartTime = bLowGain ? fLowGainStartTime[uPulseShape] : fHighGainStartTime[uPulseShape];
+  Float_t fStopTime = bLowGain ? fLowGainStopTime[uPulseShape] : fHighGainStopTime[uPulseShape];
+
+  //figure out where we start filling the signal into the Trace
+  Float_t StartTimeInTrace = time-fStartTime;
+  Int_t StartSample = Int_t(StartTimeInTrace/fSamplingTime+1);
+  Int_t StopSample = Int_t((StartTimeInTrace+fStartTime+fStopTime)/fSamplingTime+1);
+
+  //The time between the start of the Trace and the first sampled value
+  Float_t TimeAveragePulse= StartSample*fSamplingTime-StartTimeInTrace;
+
+  //Catch the case when we get out of the trace window
+  //Trace fully out of window
+  if(StartTimeInTrace<-fStartTime-fStopTime)
+    return;
+
+  if(StartSample<0)
+    {
+      TimeAveragePulse = -1.0*StartTimeInTrace;
+      StartTimeInTrace = 0;
+      StartSample = 0;
+    }
+  if(StopSample>iNumSamples)
+    {
+      StopSample = iNumSamples;
+    }
+
+  // cout<<"Fill pe from: "<<StartSample<<" to "<<StopSample<<" Start time is "<<StartTime<<endl;
+
+  //Finally fill the PE into the trace
+  TimeAveragePulse = TimeAveragePulse / fSamplingTimeAveragePulse;
+  Float_t step = fSamplingTime/fSamplingTimeAveragePulse;
+  for(Int_t i=StartSample;i<StopSample;i++)
+    {
+      Int_t s = (Int_t)(TimeAveragePulse);
+      trace[i]+= (*vPulse)[s]*amplitude;
+      TimeAveragePulse+=step;
+    }
+
+}
+
 /////////////////////////////////////////////////////////////////
 //
 //  Assemble the high gain traces for all pixels
@@ -1009,6 +1469,31 @@ void   TraceGenerator::PrintHowOftenTheTraceWasTooShort(){
 
 }
 
+//----------------------------------------------------------------------------------------
+//  Prints how much the NSB library has been reused. Two windows out of the library are only
+//  statistically independent if they do not overlap.
+void   TraceGenerator::PrintNSBLibraryStatistics(){
+
+  if(!bUseNSB || !bUseNSBLibrary)
+    return;
+
+  Double_t dDisjointWindows = fNSBLibraryLength/fNSBWindowLength;
+  Double_t dWindowsPerReadout = lNSBLibraryReadouts>0 ? lNSBLibraryDraws/(1.0*lNSBLibraryReadouts) : 0.0;
+  //probability that two randomly placed windows overlap
+  Double_t dOverlapProbability = TMath::Min(1.0,2.0*fNSBWindowLength/fNSBLibraryLength);
+
+  cout<<"NSB library of telescope type "<<iTelType<<": "<<fNSBLibraryTimes.size()<<" pulses in "<<fNSBLibraryLength*1e-3<<" us, that are "
+      <<dDisjointWindows<<" non-overlapping windows of "<<fNSBWindowLength<<" ns"<<endl;
+  cout<<"Took "<<lNSBLibraryDraws<<" windows out of the library for "<<lNSBLibraryReadouts<<" camera readouts, each part of the library was used "
+      <<lNSBLibraryDraws/dDisjointWindows<<" times on average"<<endl;
+  cout<<"The electronic noise comes out of a pre-generated sequence of the same length, one window per pixel and readout"<<endl;
+  cout<<"Expected number of pixel pairs with overlapping NSB windows in one camera readout: "
+      <<0.5*dWindowsPerReadout*(dWindowsPerReadout-1)*dOverlapProbability<<endl;
+  if(dWindowsPerReadout>dDisjointWindows)
+    cout<<"Warning: one camera readout needs more windows than there are non-overlapping windows in the NSB library. Pixels share their NSB, make the library longer"<<endl;
+
+}
+
 
 
 //----------------------------------------------------------------------------------------
@@ -1078,6 +1563,10 @@ void   TraceGenerator::SetParametersFromConfigFile(ReadConfig *readConfig){
   //NSB
   fNSBRatePerPixel = readConfig->GetNSBRate(iTelType);      //the NSB rate kHz per mm squared in the focal plane;
   bUseNSB = readConfig->GetNSBUsage();
+  bUseNSBLibrary = readConfig->GetNSBLibraryUsage(iTelType);
+  fNSBLibraryLength = readConfig->GetNSBLibraryLength(iTelType);
+  sNSBLibraryFile = readConfig->GetNameofNSBLibraryFile(iTelType);
+  iTriggerEstimatorMode = readConfig->GetTriggerEstimatorMode(iTelType);
 
   iNumPixels = readConfig->GetNumberPixels(iTelType); //Has to be filled with telescope type
   vNeighbors = readConfig->GetNeighbors(iTelType);
@@ -23,8 +23,13 @@ class TraceGenerator {
  
   TraceGenerator(ReadConfig *readConfig, int telType,  TRandom3 *generator, Bool_t debug = kFALSE,  Display *display = NULL);
   void             LoadCherenkovPhotons( std::vector< float > *v_f_X,std::vector< float > *v_f_Y,std::vector< float > *v_f_time,std::vector< float > *v_f_lambda, Float_t delay, Double_t dEfficiencyFactor);      //Loads Photons into traces
+  void             ConvertPhotonsToPE( std::vector< float > *v_f_X,std::vector< float > *v_f_Y,std::vector< float > *v_f_time,std::vector< float > *v_f_lambda, Float_t delay, Double_t dEfficiencyFactor, Bool_t bLoadTraces = kFALSE);      //Finds the Cherenkov photoelectrons without building traces (bLoadTraces: NSB and photoelectrons go into the traces right away)
+  void             LoadPhotoelectrons();      //Adds the NSB and the photoelectrons found by ConvertPhotonsToPE to the traces
   void             GenerateNSB();
 
+                   //Conservative estimate of the peak signal in each pixel and its variance in pe, used to skip telescopes that can not trigger
+  void             EstimatePeakSignalInPixels(vector<Float_t> &fSignal, vector<Float_t> &fVariance);
+
   vector<Float_t>  GetLowGainTrace(Int_t PixelID);
 
   vector<Float_t>  GetTrace(Int_t PixelID,Bool_t bLowGain=kFALSE);
@@ -45,6 +50,8 @@ class TraceGenerator {
 
   void     PrintHowOftenTheTraceWasTooShort();
 
+  void     PrintNSBLibraryStatistics();
+
  protected:
 
 
@@ -56,6 +63,22 @@ class TraceGenerator {
 
   void     ResetSiPM(); 
 
+  Float_t  DrawAmplitudeOfPE(Int_t NumPE);
+
+  Int_t    DrawNumPEOfNSBPulse();
+
+  void     AddPulseShapeToTrace(Float_t *trace, Int_t iNumSamples, Float_t time, Float_t amplitude, UInt_t uPulseShape, Bool_t bLowGain);
+
+           //NSB library
+  void     SetupNSBLibrary();
+  Bool_t   ReadNSBLibraryFromFile(Double_t dLibrarySpan);
+  void     WriteNSBLibraryToFile(Double_t dLibrarySpan);
+  void     AddNSBFromLibrary(Int_t PixelID);
+
+           //trigger estimator
+  void     SetupTriggerEstimator();
+  void     GetMomentsOfPEAmplitude(Int_t NumPE, Double_t &mean, Double_t &meansquare);
+
                                                             
   void     SetGaussianPulse(Float_t fwhm);
   void     SetSigmaofSinglePEPulseHeightDistribution(Float_t sigma);
@@ -162,6 +185,28 @@ class TraceGenerator {
   Float_t fNSBRatePerPixel;                        //the NSB rate kHz per mm squared in the focal plane;
   Bool_t  bUseNSB;
 
+  //NSB library
+  Bool_t  bUseNSBLibrary;                          //take the NSB of each pixel as random windows out of a pre-generated NSB sequence
+  Float_t fNSBLibraryLength;                       //length of the library in ns
+  TString sNSBLibraryFile;                         //cache file of the library
+  vector<Double_t> fNSBLibraryTimes;               //sorted arrival times of the NSB pulses in the library
+  vector<Float_t>  fNSBLibraryAmplitudes;          //amplitudes of the NSB pulses in the library at unit gain
+  vector<Float_t>  fNSBLibraryTrace;               //high gain trace of the whole library at unit gain
+  vector<Float_t>  fElectronicNoiseLibrary;        //pre-generated electronic noise with a sigma of one, used together with the NSB library
+  Bool_t  bNSBLibraryTrace;                        //true if fNSBLibraryTrace can be used, i.e. with a single high gain pulse shape
+  Int_t   iNSBLibraryMaxOffset;                    //largest offset in samples of a window in the library
+  Float_t fNSBWindowLength;                        //the time span in ns that needs to be filled with NSB pulses for one pixel
+  Long64_t lNSBLibraryDraws;                       //number of windows taken out of the library
+  Long64_t lNSBLibraryReadouts;                    //number of camera readouts filled with NSB out of the library
+
+  //Trigger estimator
+  Int_t   iTriggerEstimatorMode;                   //0 off, 1 on, 2 validation
+  Float_t fMeanAmplitudeOfPE;                      //mean amplitude of a single pe after the gain fluctuations
+  Float_t fVarianceAmplitudeOfPE;                  //variance of the amplitude of a single pe
+  Float_t fNSBMeanPerRelQE;                        //mean NSB in a trace sample of a pixel with relative QE and gain 1 in pe
+  Float_t fNSBVariancePerRelQE;                    //variance of the NSB in a trace sample of a pixel with relative QE and gain 1
+  Float_t fMaxNonLinearityFactor;                  //largest nonlinearity factor of the high gain pulse shapes, at least 1
+
   //Shower photons
   Float_t fWinstonConeEfficiency;                 //The efficiency of the Winstoncone
 
@@ -45,6 +45,11 @@ TriggerTelescopeCameraSnapshot::TriggerTelescopeCameraSnapshot(ReadConfig *readC
   iResolutionRange = 0;
   iScalingDivisor = -1;
   iOffset = 0;
+
+  //cluster tables
+  iNumWords = 0;
+  iNumStoredSnapshots = 0;
+  bStoreAllSnapshots = kTRUE;
   
   cout<<"You just bought an excellent camera snapshot trigger"<<endl;
   SetParametersFromConfigFile(readConfig);
@@ -73,7 +78,11 @@ Bool_t  TriggerTelescopeCameraSnapshot::RunTrigger()
   telData->iNumTriggeredGroups = 0;
   telData->bTelescopeHasTriggered = kFALSE;
   telData->vTriggerCluster.clear();
-  telData->vSnapshotsDiscriminatedClusters.clear();
+  iNumStoredSnapshots = 0;
+  if ( (Int_t)uSnapshotClusterBits.size() < telData->iSnapshots*iNumWords )
+    {
+      uSnapshotClusterBits.resize(telData->iSnapshots*iNumWords);
+    }
   Int_t  iPositionInAnalogTrace;
   for( Int_t i=0; i<telData->iSnapshots; i++ )
     { 
@@ -82,12 +91,16 @@ Bool_t  TriggerTelescopeCameraSnapshot::RunTrigger()
 	{
 	  break;
 	}
-      telData->iSnapshotsDiscriminatedGroups[i].clear();
-      telData->iSnapshotsDiscriminatedGroups[i] = DiscriminateCameraSnapshot( iPositionInAnalogTrace );
+      DiscriminateCameraSnapshot( iPositionInAnalogTrace, i );
+      iNumStoredSnapshots++;
       if ( TriggerIsFiring() )
 	{
 	  telData->iNumTriggeredGroups = telData->iSnapshotsDiscriminatedGroups[i].size();
 	  telData->fTelescopeTriggerTime = (i-iSamplingsWindow+1) * fFADCSamplingWidth + telData->fAveragePhotonArrivalTime - fStartSamplingBeforeAverageTime;
+	  if ( !bStoreAllSnapshots ) //nobody looks at the later snapshots, e.g. in the bias curve
+	    {
+	      break;
+	    }
 	}
     }
 
@@ -101,28 +114,120 @@ Bool_t  TriggerTelescopeCameraSnapshot::RunTrigger()
   return telData->bTelescopeHasTriggered;
 }
 
-//To doscriminate the clusters in a snapshot
-vector<Int_t> TriggerTelescopeCameraSnapshot::DiscriminateCameraSnapshot( Int_t iPositionInAnalogTrace )
+//Conservative check if the telescope can trigger at all. The digital sum of a cluster is the average of its groups,
+//so it can only reach the threshold if at least one group does with its peak signal plus fNumSigma standard deviations
+Bool_t  TriggerTelescopeCameraSnapshot::CanTelescopeTrigger(const vector<Float_t> &fSignal, const vector<Float_t> &fVariance, Float_t fNumSigma)
+{
+  for(Int_t g=0; g<iNumSumPixGroups; g++)
+    {
+      Double_t dSignal = 0.0;
+      Double_t dVariance = 0.0;
+      for(UInt_t n = 0; n<iSumGroupMembers[g].size();n++)
+	{
+	  dSignal += fSignal[ iSumGroupMembers[g][n] ];
+	  dVariance += fVariance[ iSumGroupMembers[g][n] ];
+	}
+      Double_t dADC = iOffset+(dSignal+fNumSigma*sqrt(dVariance))*fPEtomVConversion*fFADCconversion;
+      dADC = dADC<iResolutionRange ? dADC : iResolutionRange;
+      if( dADC >= (Int_t)fDiscThreshold )
+	return kTRUE;
+    }
+  return kFALSE;
+}
+
+//Sets the trigger state of a telescope that has not been simulated because it can not trigger
+void  TriggerTelescopeCameraSnapshot::SetTelescopeNotTriggered(TelescopeData *TelData)
+{
+  TriggerTelescopeNextNeighbor::SetTelescopeNotTriggered(TelData);
+  for( Int_t i=0; i<telData->iSnapshots; i++ )
+    telData->iSnapshotsDiscriminatedGroups[i].clear();
+}
+
+//To doscriminate the clusters in a snapshot. The discriminated clusters (by their central group) go into the
+//bitset of snapshot iSnapshot, the groups in them into telData->iSnapshotsDiscriminatedGroups[iSnapshot]
+void TriggerTelescopeCameraSnapshot::DiscriminateCameraSnapshot( Int_t iPositionInAnalogTrace, Int_t iSnapshot )
 {
-  Int_t iClusterDigitalSum;
   Float_t fGain = 1.;  //For future introduction of the low gain option
-  vector < vector<int> > vDiscriminatedClusters; //container of the discriminated clusters found for this snapshot 
-  //Find all possible clusters above the discriminator threshold (in dc counts!)
+  //DigiCam FIRST digitize the group, THEN sum: if not "fFADCconversion"ed each group signal independently, the total sum might have different approximation...
+  //Since the conversion is operated on a negative pulse shape, pedestal-signal*conversion is the correct procedure.
+  //Then must be devided by the number of pixels in the group, because the scaling factor (pedestal hsould be already scaled!) is per group...
   for(Int_t group=0; group<iNumSumPixGroups; group++)
     {
-      //DigiCam FIRST digitize the group, THEN sum: if not "fFADCconversion"ed each group signal independently, the total sum might have different approximation...
-      //Since the conversion is operated on a negative pulse shape, pedestal-signal*conversion is the correct procedure.
-      //Then must be devided by the number of pixels in the group, because the scaling factor (pedestal hsould be already scaled!) is per group...
       Int_t gADC = (Int_t)(iOffset-fGain*fTracesInSumGroups[group][iPositionInAnalogTrace]*fFADCconversion);
       gADC = gADC<iResolutionRange ? gADC : iResolutionRange;
-      iClusterDigitalSum = gADC>0 ? gADC : 0;
+      iGroupADC[group] = gADC>0 ? gADC : 0; //empty signals might have a bad memory allocation: give positive large numbers => iGroupADC<0
+    }
+
+  //Find all possible clusters above the discriminator threshold (in dc counts!)
+  ULong64_t *uClusterBits = &uSnapshotClusterBits[iSnapshot*iNumWords];
+  for ( Int_t w=0; w<iNumWords; w++ )
+    {
+      uClusterBits[w] = 0;
+    }
+  uSnapshotGroupBits.assign(iNumWords,0);
+  for(Int_t group=0; group<iNumSumPixGroups; group++)
+    {
+      Int_t iFirst = iClusterMemberStart[group];
+      Int_t iSize = iClusterMemberStart[group+1]-iFirst;
+      if ( iSize==0 ) //no cluster can be formed around this group
+	{
+	  continue;
+	}
+      Int_t iClusterDigitalSum = 0;
+      for ( Int_t m=iFirst; m<iFirst+iSize; m++ )
+	{
+	  iClusterDigitalSum += iGroupADC[ iClusterMembers[m] ];
+	}
+      iClusterDigitalSum = iClusterDigitalSum/iSize; //Rescaling resolution of the digitized groups
+      iClusterDigitalSum = iClusterDigitalSum>iResolutionRange ? iResolutionRange : iClusterDigitalSum;
+      if ( iClusterDigitalSum >= (Int_t)fDiscThreshold ) //The cluster is discriminated...
+	{
+	  uClusterBits[group>>6] |= 1ULL<<(group&63);
+	  const ULong64_t *uMembers = &uClusterMemberBits[group*iNumWords];
+	  for ( Int_t w=0; w<iNumWords; w++ )
+	    {
+	      uSnapshotGroupBits[w] |= uMembers[w];
+	    }
+	}
+    }
+
+  //array of all triggered groups in this snapshot, sorted for a better show in a root file
+  vector<Int_t> &vDiscriminatedGroups = telData->iSnapshotsDiscriminatedGroups[iSnapshot];
+  vDiscriminatedGroups.clear();
+  for ( Int_t w=0; w<iNumWords; w++ )
+    {
+      ULong64_t uBits = uSnapshotGroupBits[w];
+      while ( uBits )
+	{
+	  vDiscriminatedGroups.push_back( w*64+__builtin_ctzll(uBits) );
+	  uBits &= uBits-1;
+	}
+    }
+}
+
+//Compiles the cluster topology into tables once: the members of the cluster that can be built around each group 
+//(none if the neighbor condition is not fulfilled), the same as bitsets and for each cluster the bitset of all
+//clusters that contain it. Built cluster by cluster exactly the way the trigger logic used to do it for each snapshot
+void TriggerTelescopeCameraSnapshot::BuildClusterTables()
+{
+  iNumWords = (iNumSumPixGroups+63)/64;
+  iClusterMemberStart.assign(iNumSumPixGroups+1,0);
+  iClusterMembers.clear();
+  uClusterMemberBits.assign(iNumSumPixGroups*iNumWords,0);
+  iGroupADC.assign(iNumSumPixGroups,0);
+  uSnapshotGroupBits.assign(iNumWords,0);
+  uTriggerGroupBits.assign(iNumWords,0);
+  vector< vector<Int_t> > vClustersWithGroup(iNumSumPixGroups);
+
+  for(Int_t group=0; group<iNumSumPixGroups; group++)
+    {
+      iClusterMemberStart[group] = iClusterMembers.size();
       vector<int> vGroupsInCluster; //groups forming the cluster built around 'group'
       vGroupsInCluster.push_back(group); //...at least 'group' is inside the cluster!
       //Look for surrounding groups of the central one to form a cluster or iCircles circles
       Int_t circles = iCircles>0 ? iCircles : 0; //how many circles must be in the cluster? Note: at least 0, iCircles<0 should NEVER happen!
-      Bool_t bWrongConditions = kFALSE; //initial assumption: everything will be fine!
       Bool_t bClusterFound = kTRUE; //initial assumption: a cluster will be found
-      while ( circles-- ) //build the pattern circle by circle. If iCircle is 0, this loop is skipped!
+      while ( circles-- && bClusterFound ) //build the pattern circle by circle. If iCircle is 0, this loop is skipped!
 	{
 	  Int_t iCurrentClusterSize = vGroupsInCluster.size(); //how many groups must be cheched to add this new external circle?
 	  for ( int i=0; i<iCurrentClusterSize; i++ ) //check neighbors of each group already part of the cluster to enlarge it of one circle
@@ -130,7 +235,7 @@ vector<Int_t> TriggerTelescopeCameraSnapshot::DiscriminateCameraSnapshot( Int_t
 	      Int_t g = vGroupsInCluster[i]; //group ID currently to be checked
 	      if ( iSumGroupNeighbors[g].size() != uNeighbors ) //minimum condition: at least SNAPSHOTSURROUNDINGNEIGHBORS neighbors of the group 'g'
 		{
-		  bWrongConditions = kTRUE; //no cluster can be formed starting from 'group' as central group becasue the minimum condition!
+		  bClusterFound = kFALSE; //no cluster can be formed starting from 'group' as central group becasue the minimum condition!
 		  break;
 		}
 	      for ( UInt_t n=0; n<uNeighbors; n++ ) //looping over the 'g' neighbors
@@ -138,47 +243,50 @@ vector<Int_t> TriggerTelescopeCameraSnapshot::DiscriminateCameraSnapshot( Int_t
 		  Int_t neighbor = iSumGroupNeighbors[g][n];
 		  if ( find(vGroupsInCluster.begin(), vGroupsInCluster.end(), neighbor) == vGroupsInCluster.end() ) //if 'neighbor' is NOT in already in 'vGroupsInCluster'...
 		    {
-		      //...sum up the signal and include the 'neighbor' in the cluster
-		      Int_t gNeighADC = (Int_t)(iOffset-fGain*fTracesInSumGroups[neighbor][iPositionInAnalogTrace]*fFADCconversion);
-		      gNeighADC = gNeighADC<iResolutionRange ? gNeighADC : iResolutionRange;
-		      iClusterDigitalSum += gNeighADC>=0 ? gNeighADC : 0; //empty signals might have a bad memory allocation: give positive large numbers => iGroupADC<0
 		      vGroupsInCluster.push_back(neighbor); //the found neighbor is part of the vGroupsInCluster vector, now!
 		    }
 		}
 	    }
-	  if ( bWrongConditions ) //Strating from the current central group is not possible to form the wanted cluster => break the loop!
-	    {
-	      bClusterFound = kFALSE; //no cluster can be found!
-	      break;
-	    }
 	}
-      if ( bClusterFound ) //if false, means that bWrongConditions was true for this group => nothing to do, go to the next!
+      if ( bClusterFound )
 	{
-	  iClusterDigitalSum = (Int_t)(iClusterDigitalSum/vGroupsInCluster.size()); //Rescaling resolution of the digitized groups
-	  iClusterDigitalSum = iClusterDigitalSum>iResolutionRange ? iResolutionRange : iClusterDigitalSum;
-	  if ( iClusterDigitalSum >= (Int_t)fDiscThreshold ) //The cluster is discriminated...
+	  sort( vGroupsInCluster.begin(), vGroupsInCluster.end() );
+	  for ( UInt_t m=0; m<vGroupsInCluster.size(); m++ )
 	    {
-	      sort( vGroupsInCluster.begin(), vGroupsInCluster.end() ); //...sort the group IDs in the cluster for a better comparison of clusters between snapshosts
-	      vDiscriminatedClusters.push_back(vGroupsInCluster); //...include this cluster int the clusters container for this snapshot
+	      iClusterMembers.push_back(vGroupsInCluster[m]);
+	      uClusterMemberBits[group*iNumWords+(vGroupsInCluster[m]>>6)] |= 1ULL<<(vGroupsInCluster[m]&63);
+	      vClustersWithGroup[ vGroupsInCluster[m] ].push_back(group);
 	    }
 	}
     }
-  telData->vSnapshotsDiscriminatedClusters.push_back(vDiscriminatedClusters); //no clusters found or none discriminated => empty array for this snapshot
-  vector<int> vDiscriminatedGroups; //array of all triggered groups in this snapshot
-  for ( vector< vector<Int_t> >::iterator itCluster=vDiscriminatedClusters.begin();
-	itCluster!=vDiscriminatedClusters.end(); ++itCluster ) //skipped if no clusters found or none discriminated
+  iClusterMemberStart[iNumSumPixGroups] = iClusterMembers.size();
+
+  //A cluster of the latest snapshot is matched in a previous snapshot if one of the clusters discriminated 
+  //there contains all its groups. Every such cluster contains the central group of the cluster
+  uSupersetClusterBits.assign(iNumSumPixGroups*iNumWords,0);
+  for(Int_t c=0; c<iNumSumPixGroups; c++)
     {
-      for ( vector<Int_t>::iterator itGroup=itCluster->begin();
-	    itGroup!=itCluster->end(); ++itGroup ) //At least a group is inside...
+      const ULong64_t *uMembers = &uClusterMemberBits[c*iNumWords];
+      for ( UInt_t k=0; k<vClustersWithGroup[c].size(); k++ )
 	{
-	  if ( find(vDiscriminatedGroups.begin(), vDiscriminatedGroups.end(), *itGroup) == vDiscriminatedGroups.end() ) //'vTriggeredGroups' must contain unique values...
+	  Int_t cc = vClustersWithGroup[c][k];
+	  const ULong64_t *uOtherMembers = &uClusterMemberBits[cc*iNumWords];
+	  Bool_t bSubset = kTRUE;
+	  for ( Int_t w=0; w<iNumWords && bSubset; w++ )
+	    {
+	      bSubset = (uMembers[w] & ~uOtherMembers[w]) == 0;
+	    }
+	  if ( bSubset )
 	    {
-	      vDiscriminatedGroups.push_back(*itGroup);//...if 'groupID is not already there, push back!
+	      uSupersetClusterBits[c*iNumWords+(cc>>6)] |= 1ULL<<(cc&63);
 	    }
 	}
     }
-  sort( vDiscriminatedGroups.begin(), vDiscriminatedGroups.end() ); //sort 'vTriggeredGroups' for a better show in a root file
-  return vDiscriminatedGroups;
+
+  if(bDebug)
+    {
+      cout<<"Cluster tables: "<<iClusterMembers.size()<<" groups in the clusters of "<<iNumSumPixGroups<<" groups"<<endl;
+    }
 }
 
 //Combining the snapshot so far accumulated according to the selected mode 
@@ -212,59 +320,59 @@ Bool_t   TriggerTelescopeCameraSnapshot::TriggerIsFiring()
 }
 
 //Blind mode logic to combine the snapshots together
+//A cluster discriminated in the latest snapshot is matched if in each of the iSamplingsWindow-1 previous snapshots
+//a discriminated cluster contains all its groups
 Bool_t   TriggerTelescopeCameraSnapshot::BlindMode()
 {
   if ( !IsConsistent() )
     {
       return kFALSE;
     }
-  Int_t iLatest = telData->vSnapshotsDiscriminatedClusters.size()-1;
-  vector< vector<Int_t> > vLatestSnapshot = telData->vSnapshotsDiscriminatedClusters[iLatest];
-  Bool_t bMatchingCluster = kTRUE; //if vLatestSnapshot is empty, doesn't care, if iSamplingsWindow==1, must be true for each cluster in vLatestSnapshot
-  Bool_t bMatchingGroup; //If not filled at least once, there a problem: good if an exception occurs!
-  for ( vector< vector<Int_t> >::iterator itCluster=vLatestSnapshot.begin();
-	itCluster!=vLatestSnapshot.end(); ++itCluster ) //Loop over the latest dicriminated clusters
+  Int_t iLatest = iNumStoredSnapshots-1;
+  const ULong64_t *uLatestSnapshot = &uSnapshotClusterBits[iLatest*iNumWords];
+  uTriggerGroupBits.assign(iNumWords,0);
+  for ( Int_t w=0; w<iNumWords; w++ )
     {
-      for ( Int_t iBack=1; iBack<iSamplingsWindow; iBack++ ) //From 1 snapshot to iSamplingsWindow-1 back
+      ULong64_t uBits = uLatestSnapshot[w];
+      while ( uBits ) //Loop over the latest dicriminated clusters
 	{
-	  vector< vector<int> > vBackSnapshot = telData->vSnapshotsDiscriminatedClusters[iLatest-iBack];
-	  bMatchingCluster = kFALSE; //Not yet found in this previous snapshot
-	  for ( vector< vector<Int_t> >::iterator itBackCluster = vBackSnapshot.begin();
-		itBackCluster!=vBackSnapshot.end(); ++itBackCluster ) // loop over the dicriminated clusters in the previous snapshot
+	  Int_t c = w*64+__builtin_ctzll(uBits);
+	  uBits &= uBits-1;
+	  const ULong64_t *uSuperset = &uSupersetClusterBits[c*iNumWords];
+	  Bool_t bMatchingCluster = kTRUE; //if iSamplingsWindow==1, must be true for each cluster in the latest snapshot
+	  for ( Int_t iBack=1; iBack<iSamplingsWindow && bMatchingCluster; iBack++ ) //From 1 snapshot to iSamplingsWindow-1 back
 	    {
-	      for ( vector<Int_t>::iterator itGroup = itCluster->begin();
-		    itGroup!=itCluster->end(); ++itGroup) // loop over the groups in the dicriminated cluster of the latest snapshot. AT LEAST 1 is there!
+	      const ULong64_t *uBackSnapshot = &uSnapshotClusterBits[(iLatest-iBack)*iNumWords];
+	      bMatchingCluster = kFALSE; //Not yet found in this previous snapshot
+	      for ( Int_t ww=0; ww<iNumWords; ww++ )
 		{
-		  bMatchingGroup = find( itBackCluster->begin(), itBackCluster->end(), *itGroup ) != itBackCluster->end();
-		  if ( !bMatchingGroup ) //If a group is not in itBackCluster, the cluster is not matched: try next cluster in the previous snapshot!
+		  if ( uBackSnapshot[ww] & uSuperset[ww] )
 		    {
+		      bMatchingCluster = kTRUE;
 		      break;
 		    }
 		}
-	      if ( bMatchingGroup ) //If all groups are found, the *itCluster is found. It cannot be found more then once!
-		{
-		  bMatchingCluster = kTRUE;
-		  break;
-		}
-	    }
-	  if ( !bMatchingCluster ) //If no matching cluster is found (bMatchingCluster==kFALSE) in this previous snapshot, no trigger! Pointelss to look further back...
-	    {
-	      break;
 	    }
-	}
-      if ( bMatchingCluster )
-	{
-	  for ( vector<Int_t>::iterator itGroup = itCluster->begin();
-		itGroup!=itCluster->end(); ++itGroup ) //Loop over the contained groups to fill the 'vTriggerCluster' array
+	  if ( bMatchingCluster )
 	    {
-	      if ( find(telData->vTriggerCluster.begin(), telData->vTriggerCluster.end(), *itGroup) == telData->vTriggerCluster.end() ) //Group already stored?
+	      const ULong64_t *uMembers = &uClusterMemberBits[c*iNumWords];
+	      for ( Int_t ww=0; ww<iNumWords; ww++ )
 		{
-		  telData->vTriggerCluster.push_back(*itGroup); //Array filled with unique group IDs (only when trigger is fired for the first time!)
+		  uTriggerGroupBits[ww] |= uMembers[ww];
 		}
 	    }
 	}
     }
-  sort( telData->vTriggerCluster.begin(), telData->vTriggerCluster.end() ); //The groups IDs are shown sorted in the root file!
+  //Fill the 'vTriggerCluster' array with the unique group IDs, sorted as they are shown in the root file
+  for ( Int_t w=0; w<iNumWords; w++ )
+    {
+      ULong64_t uBits = uTriggerGroupBits[w];
+      while ( uBits )
+	{
+	  telData->vTriggerCluster.push_back( w*64+__builtin_ctzll(uBits) );
+	  uBits &= uBits-1;
+	}
+    }
   return telData->vTriggerCluster.size()>0 ? kTRUE : kFALSE;
 }
 
@@ -293,7 +401,7 @@ Bool_t   TriggerTelescopeCameraSnapshot::LevelMode()
 //Check if the data stored so far are consistent with the structure of the logical operation. If everything is used consistently, it returns kTRUE always
 Bool_t   TriggerTelescopeCameraSnapshot::ReadyToFire()
 {
-  if ( telData->vSnapshotsDiscriminatedClusters.size()<(UInt_t)iSamplingsWindow || //if there are not at least iSamplingsWindow snapshots stored, not ready to fire! 
+  if ( iNumStoredSnapshots<iSamplingsWindow || //if there are not at least iSamplingsWindow snapshots stored, not ready to fire! 
        telData->bTelescopeHasTriggered ) //trigger already fired: cannot fire anymore!
     {
       return kFALSE;
@@ -311,10 +419,10 @@ Bool_t   TriggerTelescopeCameraSnapshot::ReadyToFire()
 //Check if the data stored so far are consistent with the structure of the logical operation. If everything is used consistently, it returns kTRUE always
 Bool_t   TriggerTelescopeCameraSnapshot::IsConsistent()
 {
-  if ( telData->vSnapshotsDiscriminatedClusters.size()<(UInt_t)iSamplingsWindow ) // Sanity check! At this point, the number of sotred snapshots MUST BE AT LEAST iSamplingsWindow...
+  if ( iNumStoredSnapshots<iSamplingsWindow ) // Sanity check! At this point, the number of sotred snapshots MUST BE AT LEAST iSamplingsWindow...
     {
       cout << "To check a logic, the snapshots stored MUST BE AT LEAST "<<iSamplingsWindow
-	   <<", but they are "<<telData->vSnapshotsDiscriminatedClusters.size()
+	   <<", but they are "<<iNumStoredSnapshots
 	   <<"! THIS SHOULD NEVER HAPPEN!" << endl;
       exit(1);
     }
@@ -346,6 +454,9 @@ void   TriggerTelescopeCameraSnapshot::SetParametersFromConfigFile(ReadConfig *r
 
   //Create the traces for the summed pixels
   CreateTraces();
+
+  //Compile the cluster topology
+  BuildClusterTables();
 }
 
 void   TriggerTelescopeCameraSnapshot::SetTriggerLogicSettings( ReadConfig *readConfig )
@@ -515,6 +626,8 @@ void TriggerTelescopeCameraSnapshot::RunBiasCurve(UInt_t Trials,Float_t LowerBou
   
   cout<<"Going in loop"<<endl;
   
+  //only the trigger decision counts here, no need to go on after the trigger fired
+  bStoreAllSnapshots = kFALSE;
   for(UInt_t i=1;i<=Trials;i++)
     {
       telData->ResetTraces();
@@ -571,4 +684,5 @@ void TriggerTelescopeCameraSnapshot::RunBiasCurve(UInt_t Trials,Float_t LowerBou
       cout<<"NSB Telescope Trigger rate at "<<LowerBoundary+StepWidth*t<<" ADC threshold "<<fBiasCurve[t]<<"+-"<<fBiasCurveErr[t]<<" Hz"<<endl;
       cout<<"Group rate :"<<fGroupRateVsThreshold[t]<<"+-"<<fGroupRateVsThresholdErr[t]<<" Hz"<<endl;
     }  
+  bStoreAllSnapshots = kTRUE;
 }
@@ -10,6 +10,8 @@ class TriggerTelescopeCameraSnapshot : public TriggerTelescopeNextNeighbor {
   void     SetDiscriminatorThresholdAndWidth(Float_t threshold, Float_t width);
   Bool_t   RunTrigger();
   void     RunBiasCurve(UInt_t Trials,Float_t LowerBoundary,Float_t UpperBoundary,Float_t StepWidth, TraceGenerator *tracegenerator,TelescopeData *TelData);
+  Bool_t   CanTelescopeTrigger(const vector<Float_t> &fSignal, const vector<Float_t> &fVariance, Float_t fNumSigma);
+  void     SetTelescopeNotTriggered(TelescopeData *TelData);
 
  protected:
 
@@ -18,8 +20,9 @@ class TriggerTelescopeCameraSnapshot : public TriggerTelescopeNextNeighbor {
   // Set the internal parameters through *readConfig (overwrite TriggerTelescopeNextNeighbor::SetFromConfigFile)
   void  SetTriggerLogicSettings( ReadConfig *readConfig );
   // Digitized amplitudes at iPositionInAnalogTrace in the traces, find clusters and discriminate them.
-  //void  DiscriminateCameraSnapshot( Int_t iPositionInAnalogTrace );
-  vector<Int_t> DiscriminateCameraSnapshot( Int_t iPositionInAnalogTrace );
+  void  DiscriminateCameraSnapshot( Int_t iPositionInAnalogTrace, Int_t iSnapshot );
+  //Compile the group, neighbor and cluster topology into tables and bitsets (once, at configuration time)
+  void  BuildClusterTables();
   //Check if the telescope is ready to fire. Return false if not enough snapshots (yet) checked or if the trigger has already fired!
   Bool_t  ReadyToFire();
   // Check if the trigger is firing, using the selected 'iComboMode' mode
@@ -52,6 +55,19 @@ class TriggerTelescopeCameraSnapshot : public TriggerTelescopeNextNeighbor {
   Float_t fHiLoGainThreshold;                      //dc counts at which the HiLoGain switch is activated
   Float_t fLowHiGainRatio;                         //Gain ratio logain/higain
 
+  //Cluster tables, the bitsets are over the groups in words of 64 bits
+  Int_t  iNumWords;                            //number of words of a bitset
+  vector<Int_t>     iClusterMemberStart;       //the members of the cluster around group g are iClusterMembers[iClusterMemberStart[g]] up to iClusterMembers[iClusterMemberStart[g+1]-1], none if no cluster can be formed
+  vector<Int_t>     iClusterMembers;
+  vector<ULong64_t> uClusterMemberBits;        //the members of the cluster around each group as bitset
+  vector<ULong64_t> uSupersetClusterBits;      //for each cluster the bitset of the clusters (by central group) that contain all its groups
+  vector<ULong64_t> uSnapshotClusterBits;      //the discriminated clusters (by central group) of each snapshot
+  vector<ULong64_t> uSnapshotGroupBits;        //the groups in discriminated clusters of the current snapshot
+  vector<ULong64_t> uTriggerGroupBits;         //the groups in the clusters that fire the trigger
+  vector<Int_t>     iGroupADC;                 //the digitized and clipped signal of each group in the current snapshot
+  Int_t  iNumStoredSnapshots;                  //number of snapshots discriminated so far in this event
+  Bool_t bStoreAllSnapshots;                   //discriminate all snapshots even after the trigger fired, they all go into the root file
+
   //vector < vector < vector<int> > > vDiscriminatedClustersInSnapshots; //Container of found clusters (of groups) for snapshots: vClustersInSnapshots[iSnapshot][iCluster][iGroup]
   
 };
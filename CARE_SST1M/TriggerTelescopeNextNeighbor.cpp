@@ -29,7 +29,6 @@ TriggerTelescopeNextNeighbor::TriggerTelescopeNextNeighbor(ReadConfig *readConfi
   iTelType = telType;
   fTracesInSumGroups = NULL;
   fTracesInSumGroupsConstantFraction = NULL;	
-  iClusterID = NULL;
   rand = generator;
   bUsePatches = kFALSE;
   iNumSumPixGroups= -1;
@@ -286,6 +285,49 @@ Bool_t  TriggerTelescopeNextNeighbor::RunTrigger()
 }
 
 
+//-----------------------------------------------------------------------------------------------------------------------
+//Conservative check if the telescope can trigger at all, given the estimated peak signal in each pixel in pe and 
+//its variance (TraceGenerator::EstimatePeakSignalInPixels). A group can only fire if its summed peak signal plus
+//fNumSigma standard deviations reaches the threshold, and the telescope needs iMultiplicity of those groups.
+//Clipping and the CFD can only lower the signal and are ignored
+Bool_t  TriggerTelescopeNextNeighbor::CanTelescopeTrigger(const vector<Float_t> &fSignal, const vector<Float_t> &fVariance, Float_t fNumSigma)
+{
+  //the threshold and the traces are negative, the estimated signal is in positive pe
+  Float_t fThresholdInPE = fabs(fDiscThreshold/fPEtomVConversion);
+
+  Int_t iNumGroupsCanFire = 0;
+  for(Int_t g=0;g<iNumSumPixGroups;g++)
+    {
+      Double_t dSignal = 0.0;
+      Double_t dVariance = 0.0;
+      for(UInt_t n = 0; n<iSumGroupMembers[g].size();n++)
+	{
+	  dSignal += fSignal[ iSumGroupMembers[g][n] ];
+	  dVariance += fVariance[ iSumGroupMembers[g][n] ];
+	}
+      if(dSignal+fNumSigma*sqrt(dVariance) >= fThresholdInPE)
+	iNumGroupsCanFire++;
+    }
+
+  if(bDebug)
+    cout<<"Trigger estimator: "<<iNumGroupsCanFire<<" groups can fire, "<<iMultiplicity<<" are needed"<<endl;
+
+  return iNumGroupsCanFire >= (iMultiplicity > 1 ? iMultiplicity : 1);
+}
+
+//-----------------------------------------------------------------------------------------------------------------------
+//Sets the trigger state of a telescope that has not been simulated because it can not trigger
+void  TriggerTelescopeNextNeighbor::SetTelescopeNotTriggered(TelescopeData *TelData)
+{
+  telData = TelData;
+  telData->bTriggeredGroups.assign(iNumSumPixGroups,kFALSE);
+  telData->fDiscriminatorTime.assign(iNumSumPixGroups,-1e6);
+  telData->iNumTriggeredGroups = 0;
+  telData->bTelescopeHasTriggered = kFALSE;
+  telData->fTelescopeTriggerTime = -1e6;
+  telData->vTriggerCluster.clear();
+}
+
 //------------
 //
 // An L2 trigger that does care about patches
@@ -293,38 +335,31 @@ Bool_t  TriggerTelescopeNextNeighbor::RunL2WithPatches()
 {
   // cout<<"Patches"<<endl;
   //Go over all patches and find those which would fullfil the trigger conditions
-  vector< Bool_t > bPatchTrigger(vPatch.size(),kFALSE);
-  Float_t *fPatchTriggertimes = new Float_t[vPatch.size()];
-  for(UInt_t p=0;p<vPatch.size();p++)
+  Int_t iNumPatches = vPatch.size();
+  bPatchTrigger.assign(iNumPatches,kFALSE);
+  for(Int_t p=0;p<iNumPatches;p++)
     {
-      bPatchTrigger[p] = RunL2Patch(p,fPatchTriggertimes);
+      bPatchTrigger[p] = RunL2Patch(p,&fPatchTriggerTimes[0]);
     }
   
   //Find earliest time a patch triggered
-  Int_t* indext = new Int_t[ vPatch.size()  ];
-  TMath::Sort((Int_t)vPatch.size(),fPatchTriggertimes,indext,kFALSE);
-  telData->fTelescopeTriggerTime = fPatchTriggertimes[ indext[0] ];
-
-
-
-  delete [] fPatchTriggertimes;
+  TMath::Sort(iNumPatches,&fPatchTriggerTimes[0],&iPatchIndex[0],kFALSE);
+  telData->fTelescopeTriggerTime = fPatchTriggerTimes[ iPatchIndex[0] ];
                          
   //cout<<"Done with patches"<<endl;
 
-  Bool_t triggered = bPatchTrigger[ indext[0] ];
+  Bool_t triggered = bPatchTrigger[ iPatchIndex[0] ];
 
   if(triggered == kTRUE)
    {
-      telData->vTriggerCluster = iPixelTriggeredInPatch[ indext[0] ];
+      telData->vTriggerCluster = iPixelTriggeredInPatch[ iPatchIndex[0] ];
       if(bDebug)
        {
-	cout<<"we triggered: "<<triggered<<"; Patch that triggered: "<<indext[0]<<"  out of a total of "<<vPatch.size()<<" Patches"<<endl;
-	cout<<"Trigger time: "<<telData->fTelescopeTriggerTime<<"; Patch that triggered: "<<indext[0]<<"  out of a total of "<<vPatch.size()<<" Patches"<<endl;
+	cout<<"we triggered: "<<triggered<<"; Patch that triggered: "<<iPatchIndex[0]<<"  out of a total of "<<vPatch.size()<<" Patches"<<endl;
+	cout<<"Trigger time: "<<telData->fTelescopeTriggerTime<<"; Patch that triggered: "<<iPatchIndex[0]<<"  out of a total of "<<vPatch.size()<<" Patches"<<endl;
        }
    }
 
-  delete [] indext;
-
   return triggered;
 
 }
@@ -332,34 +367,20 @@ Bool_t  TriggerTelescopeNextNeighbor::RunL2WithPatches()
 //----------------------------------------------------------------------------------------
 //
 // An L2 trigger that does care about patches
+// Every triggered group of the patch seeds a cluster of the triggered groups connected to it that have triggered
+// within the width of the discriminator output around the seed. The patch triggers if a cluster has at least
+// iMultiplicity groups, its trigger time is the earliest time one of these clusters reaches the multiplicity
 Bool_t  TriggerTelescopeNextNeighbor::RunL2Patch(Int_t PatchNumber,Float_t *fPatchTriggerTimes)
 {
  if(bDebug)
   cout<<"Running L2 Patch "<<PatchNumber<<endl;
 
-  if(iClusterID)
-    delete [] iClusterID;
-  iClusterID = new Int_t[iNumSumPixGroups];
-
-  Int_t *iNumGroupsInCluster = new Int_t[iNumSumPixGroups]; //How many groups are in each cluster of this patch
-
-  for(Int_t i=0;i<iNumSumPixGroups;i++)
-    {
-      iClusterID[i] = -1;
-      iNumGroupsInCluster[i]=0; 
-    }
-
-  vector< int > i_pix;
-  vGroupsInCluster = new vector< vector<int> >;
-  vGroupsInCluster->assign(iNumSumPixGroups , i_pix );
-
-  vector< float > f_pix;
-  vTriggerTimesInCluster = new vector< vector<float> >;
-  vTriggerTimesInCluster->assign(iNumSumPixGroups , f_pix );
-
-  //cout<<"allocated arrays and vectors"<<endl;
-  //cout<<"Number of summed groups "<<iNumSumPixGroups<<endl;
+  iClusterID.assign(iNumSumPixGroups,-1);
+  iNumGroupsInCluster.assign(iNumSumPixGroups,0);  //How many groups are in each cluster of this patch
+  iGroupsInClusters.clear();
+  fTriggerTimesInClusters.clear();
 
+  Bool_t bAnyGroupTriggered = kFALSE;
   Int_t NGroups = bUsePatches==kTRUE ? vPatch[PatchNumber].size() :  iNumSumPixGroups;
   if(bDebug)
   cout<<"Number of groups in this patch: "<<NGroups<<endl;
@@ -369,6 +390,9 @@ Bool_t  TriggerTelescopeNextNeighbor::RunL2Patch(Int_t PatchNumber,Float_t *fPat
     
       if (telData->bTriggeredGroups[GroupID]==kTRUE) //(summed) pixel has triggered
 	{
+	  bAnyGroupTriggered = kTRUE;
+	  if(iClusterID[GroupID]!=GroupID) //the groups of the cluster are stored the first time the group seeds it
+	    iFirstGroupInCluster[GroupID] = iGroupsInClusters.size();
 	  iNumGroupsInCluster[GroupID] = CalcCluster(GroupID,GroupID,PatchNumber);
 	  // cout<<iNumGroupsInCluster[i]<<endl;       
 	}
@@ -376,16 +400,19 @@ Bool_t  TriggerTelescopeNextNeighbor::RunL2Patch(Int_t PatchNumber,Float_t *fPat
     }
 
   //cout<<"Finished finding all clusters"<<endl<<endl;
+
+  //Nothing has triggered in this patch, which is the usual case for NSB only
+  if(!bAnyGroupTriggered && iMultiplicity>0)
+    {
+      fPatchTriggerTimes[PatchNumber] = 1e6+telData->fAveragePhotonArrivalTime;
+      iPixelTriggeredInPatch[PatchNumber].clear();
+      return kFALSE;
+    }
    
   //Sort all cluster descending
-  Int_t* index = new Int_t[iNumSumPixGroups];
-  TMath::Sort(iNumSumPixGroups,iNumGroupsInCluster,index);
+  Int_t *index = &iClusterIndex[0];
+  TMath::Sort(iNumSumPixGroups,&iNumGroupsInCluster[0],index);
  
-/*  for(int n=0;n<iNumSumPixGroups;n++)
-	 cout<<iNumGroupsInCluster[index[n]]<<"  ";
-	 
-	 cout<<endl;
-  */
   //Find the cluster that triggered first
   Float_t fPatchTriggerTime = 1e6;
   Int_t t = 0;
@@ -393,24 +420,20 @@ Bool_t  TriggerTelescopeNextNeighbor::RunL2Patch(Int_t PatchNumber,Float_t *fPat
   while(iNumGroupsInCluster[index[t]]>=iMultiplicity )
     {
       Int_t igroups = iNumGroupsInCluster[index[t]];
+      Int_t iFirst = iFirstGroupInCluster[index[t]];
 
       if(bDebug)
       cout<<"cluster "<<index[t]<<" has "<<igroups<<" groups"<<endl;
 
       //Find the L2 trigger time of this cluster
-      Float_t *times = new Float_t[ igroups ];
-      for(Int_t i=0;i<igroups;i++)
-	  {
-           times[i] = (vTriggerTimesInCluster->at(index[t]))[i];
-           if(bDebug)
-           cout<<"triggered group in cluster "<<vGroupsInCluster->at(index[t])[i]<<" t: "<<times[i]<<endl;
-	  }
-      // cout<<endl;
-      //sort the times in increasing order
-      Int_t* indext = new Int_t[ igroups  ];
-      TMath::Sort(igroups,times,indext,kFALSE);
+      fTimesInCluster.assign(fTriggerTimesInClusters.begin()+iFirst,fTriggerTimesInClusters.begin()+iFirst+igroups);
+      if(bDebug)
+        for(Int_t i=0;i<igroups;i++)
+          cout<<"triggered group in cluster "<<iGroupsInClusters[iFirst+i]<<" t: "<<fTimesInCluster[i]<<endl;
+
       //Trigger time is determined by the /pixel summed group that triggered last (iMultiplicity-1) 
-      Float_t triggertime = times[ indext[iMultiplicity-1] ];
+      nth_element(fTimesInCluster.begin(),fTimesInCluster.begin()+iMultiplicity-1,fTimesInCluster.end());
+      Float_t triggertime = fTimesInCluster[iMultiplicity-1];
       if(triggertime<fPatchTriggerTime)
 	    {
 	       fPatchTriggerTime = triggertime;
@@ -418,9 +441,6 @@ Bool_t  TriggerTelescopeNextNeighbor::RunL2Patch(Int_t PatchNumber,Float_t *fPat
 	    }
        t++;
 
-       delete [] times;
-       delete [] indext;
-
        if(t==iNumSumPixGroups)
           break;
 
@@ -429,29 +449,16 @@ Bool_t  TriggerTelescopeNextNeighbor::RunL2Patch(Int_t PatchNumber,Float_t *fPat
   
   fPatchTriggerTimes[PatchNumber] = fPatchTriggerTime;
 
-//move the vector with the groups of pixels that are in the trigger cluster to a separate vector
+  //move the groups of pixels that are in the trigger cluster to a separate vector
   //which can be retrieved with GetTriggerCluster()
-  //cout<< vGroupsInCluster->at(index[tmin]).size()<<endl;
-  //cout<<(telData->vTriggerCluster).size()<<endl;
-  iPixelTriggeredInPatch[PatchNumber]=vGroupsInCluster->at(index[tmin]);
-  //cout<<"Have transferred the TriggerCluster"<<telData->vTriggerCluster.size()<<endl;
-  //Now trigger if we have enough groups in the largest cluster
- 
+  if(iNumGroupsInCluster[index[tmin]]>0)
+    iPixelTriggeredInPatch[PatchNumber].assign(iGroupsInClusters.begin()+iFirstGroupInCluster[index[tmin]],
+                                               iGroupsInClusters.begin()+iFirstGroupInCluster[index[tmin]]+iNumGroupsInCluster[index[tmin]]);
+  else
+    iPixelTriggeredInPatch[PatchNumber].clear();
 
-  Bool_t bPatchTrigger = kFALSE;
-
-  if(iNumGroupsInCluster[index[0]]>=iMultiplicity)
-    {
-      //cout<<iNumGroupsInCluster[index[0]]<<endl;
-      bPatchTrigger= kTRUE;
-    }
-
-  delete [] iNumGroupsInCluster;
-  delete vGroupsInCluster;
-  delete vTriggerTimesInCluster;
-  delete [] index;
-
-  return bPatchTrigger;
+  //Now trigger if we have enough groups in the largest cluster
+  return iNumGroupsInCluster[index[0]]>=iMultiplicity;
 }
 
 
@@ -537,9 +544,9 @@ Bool_t TriggerTelescopeNextNeighbor::RunDiscriminator(Int_t GroupID)
 
 // --------------------------------------------------------------------------------------------
 //
-//Helper function to loop over all neighbours to find triggered pixels belonging to the cluster
-//returns the number of pixel in that cluster
-
+//Finds the triggered groups connected to the group GroupID that belong to the cluster ClusterID
+//(depth first, in the same order as a recursion over the neighbors would do it) 
+//returns the number of groups that have been added to that cluster
 Int_t TriggerTelescopeNextNeighbor::CalcCluster(Int_t GroupID, Int_t ClusterID, Int_t PatchID)
 {
 
@@ -549,32 +556,49 @@ Int_t TriggerTelescopeNextNeighbor::CalcCluster(Int_t GroupID, Int_t ClusterID,
   // If we have visited this group in this round ... do nothing.
   if (iClusterID[GroupID]==ClusterID)
     return 0;
-  // Assign the new cluster ID this Group
-  iClusterID[GroupID]=ClusterID;
-  //Put the group in the list of groups that belong to this cluster centered around the group with ID ClusterID
-  vGroupsInCluster->at(ClusterID).push_back(GroupID);
-  
-  
-  //Add the trigger time of the group to the vector of this cluster
-  vTriggerTimesInCluster->at(ClusterID).push_back(telData->fDiscriminatorTime[GroupID]);
-  if(bDebug)
-  {
-	 cout<<"Pixel number: "<<vTriggerTimesInCluster->at(ClusterID).size()<<endl;
-	 cout<<"added group "<<GroupID<<", which triggered at time "<<telData->fDiscriminatorTime[GroupID]<<endl;
-  }
 
-  // Need this to store the number of groups in the cluster
-  Int_t NumGroupsInCluster = 1;
+  Float_t fSeedTime = telData->fDiscriminatorTime[ClusterID];
 
-  // Now do the same with all its neighbors
-  for(UInt_t n = 0; n<iSumGroupNeighbors[GroupID].size();n++)
-    {
-      Int_t GroupIDNeighbor = iSumGroupNeighbors[GroupID][n];
-      if (telData->bTriggeredGroups[GroupIDNeighbor] 
-           && fabs(telData->fDiscriminatorTime[ClusterID]-telData->fDiscriminatorTime[GroupIDNeighbor])<fWidthDiscriminator 
-           && GroupInPatch(GroupIDNeighbor,PatchID))
-	NumGroupsInCluster += CalcCluster(GroupIDNeighbor,ClusterID,PatchID);
+  // Need this to store the number of groups in the cluster
+  Int_t NumGroupsInCluster = 0;
+
+  Int_t iStackSize = 0;
+  Int_t g = GroupID;
+  while(1)
+    {
+      // Assign the new cluster ID to this group, put it in the list of groups of this cluster 
+      // and add its trigger time to the trigger times of this cluster
+      iClusterID[g]=ClusterID;
+      iGroupsInClusters.push_back(g);
+      fTriggerTimesInClusters.push_back(telData->fDiscriminatorTime[g]);
+      NumGroupsInCluster++;
+      if(bDebug)
+	cout<<"added group "<<g<<", which triggered at time "<<telData->fDiscriminatorTime[g]<<endl;
+      iStackGroup[iStackSize] = g;
+      iStackNeighbor[iStackSize] = iNeighborStart[g];
+      iStackSize++;
+
+      // Now go to the next neighbor not yet visited of the latest group that has one
+      g = -1;
+      while(iStackSize>0 && g<0)
+	{
+	  Int_t top = iStackSize-1;
+	  if(iStackNeighbor[top]==iNeighborStart[ iStackGroup[top]+1 ])
+	    {
+	      iStackSize--;
+	      continue;
+	    }
+	  Int_t GroupIDNeighbor = iNeighborList[ iStackNeighbor[top]++ ];
+	  if (telData->bTriggeredGroups[GroupIDNeighbor] 
+	      && iClusterID[GroupIDNeighbor]!=ClusterID
+	      && fabs(fSeedTime-telData->fDiscriminatorTime[GroupIDNeighbor])<fWidthDiscriminator 
+	      && GroupInPatch(GroupIDNeighbor,PatchID))
+	    g = GroupIDNeighbor;
+	}
+      if(g<0)
+	break;
     }
+
  // return the number of groups in this cluster
   return NumGroupsInCluster;
 
@@ -590,13 +614,49 @@ Bool_t TriggerTelescopeNextNeighbor::GroupInPatch(Int_t GroupID,Int_t PatchID)
   if(!bUsePatches)
     return kTRUE;
  
-  for(UInt_t i=0;i<vPatch[PatchID].size();i++)
+  return bGroupInPatch[PatchID*iNumSumPixGroups+GroupID];
+}
+
+//--------------------------------------------------------------------------------------------
+//
+// Sets up the tables and buffers of the L2 trigger once: the neighbors of all groups in one list
+// (the neighbors of group g start at iNeighborStart[g]), which group is in which patch and
+// all the arrays used for each event
+void TriggerTelescopeNextNeighbor::BuildL2Tables()
+{
+  iNeighborStart.assign(iNumSumPixGroups+1,0);
+  iNeighborList.clear();
+  for(Int_t g=0;g<iNumSumPixGroups;g++)
     {
-      if(GroupID==vPatch[PatchID][i])
-	 return kTRUE;
+      iNeighborStart[g] = iNeighborList.size();
+      for(UInt_t n = 0; n<iSumGroupNeighbors[g].size();n++)
+	iNeighborList.push_back(iSumGroupNeighbors[g][n]);
     }
+  iNeighborStart[iNumSumPixGroups] = iNeighborList.size();
 
-  return kFALSE;
+  bGroupInPatch.assign(vPatch.size()*iNumSumPixGroups,kFALSE);
+  for(UInt_t p=0;p<vPatch.size();p++)
+    for(UInt_t i=0;i<vPatch[p].size();i++)
+      {
+	if(vPatch[p][i]<0 || vPatch[p][i]>=iNumSumPixGroups)
+	  {
+	    cout<<"Patch "<<p<<" has the group "<<vPatch[p][i]<<" which does not exist, there are "<<iNumSumPixGroups<<" groups"<<endl;
+	    exit(1);
+	  }
+	bGroupInPatch[p*iNumSumPixGroups+vPatch[p][i]] = kTRUE;
+      }
+
+  iClusterID.assign(iNumSumPixGroups,-1);
+  iNumGroupsInCluster.assign(iNumSumPixGroups,0);
+  iFirstGroupInCluster.assign(iNumSumPixGroups,0);
+  iClusterIndex.assign(iNumSumPixGroups,0);
+  iStackGroup.assign(iNumSumPixGroups,0);
+  iStackNeighbor.assign(iNumSumPixGroups,0);
+  iGroupsInClusters.reserve(iNumSumPixGroups);
+  fTriggerTimesInClusters.reserve(iNumSumPixGroups);
+  fTimesInCluster.reserve(iNumSumPixGroups);
+  fPatchTriggerTimes.assign(vPatch.size()>0 ? vPatch.size() : 1,0.0);
+  iPatchIndex.assign(vPatch.size()>0 ? vPatch.size() : 1,0);
 }
 
 
@@ -811,6 +871,9 @@ void   TriggerTelescopeNextNeighbor::SetParametersFromConfigFile(ReadConfig *rea
 
   //Create the traces for the summed pixels
   CreateTraces();
+
+  //Tables and buffers of the L2 trigger
+  BuildL2Tables();
 }
 
 void   TriggerTelescopeNextNeighbor::SetCommonSettings(ReadConfig *readConfig)
@@ -22,6 +22,10 @@ class TriggerTelescopeNextNeighbor {
   Bool_t   RunTrigger();
   void     RunBiasCurve(UInt_t Trials,Float_t LowerBoundary,Float_t UpperBoundary,Float_t StepWidth,TraceGenerator *tracegenerator,TelescopeData *TelData);
 
+           //Conservative check if the telescope can trigger with the peak signals estimated by the TraceGenerator
+  Bool_t   CanTelescopeTrigger(const vector<Float_t> &fSignal, const vector<Float_t> &fVariance, Float_t fNumSigma);
+  void     SetTelescopeNotTriggered(TelescopeData *TelData);
+
   void     SetDiscriminatorThresholdAndWidth(Float_t threshold, Float_t width);
   void     SetDiscriminatorDelayAndAttenuation(Float_t delay, Float_t attenuation);
   void     SetDiscriminatorRFBConstant(Float_t rfb);
@@ -73,6 +77,8 @@ class TriggerTelescopeNextNeighbor {
 
   Bool_t GroupInPatch(Int_t GroupID,Int_t PatchID);
 
+  void  BuildL2Tables();
+
   TRandom3 *rand;                   //Our random number generator
 
   Bool_t bDebug;
@@ -115,7 +121,7 @@ class TriggerTelescopeNextNeighbor {
 
   Long_t lZeroCrossings;               //holds the number of zerocrossings for one event counted over all pixels in the camera
 
-  Int_t *iClusterID;                   //holds the ClusterID of each sumgroup; -1 if the pixel 
+  vector<Int_t> iClusterID;            //holds the ClusterID of each sumgroup; -1 if the pixel 
                                        //is not assigned to a cluster
   Int_t iMultiplicity;                 //How many groups need to be in a cluster for a trigger  
  
@@ -135,8 +141,21 @@ class TriggerTelescopeNextNeighbor {
   Float_t fSamplingTime;                //The sampling rate or resolution of the simulated trace
   Float_t fSamplingTimeAveragePulse;    //The sampling time of the average PE pulse shape
 
-  vector<vector<int> > *vGroupsInCluster;                //pixel that are in one cluster of triggered pixel 
-  vector<vector<float> > *vTriggerTimesInCluster;        //the trigger times of all pixels in the cluster
+  //L2 trigger tables and buffers, set up once in BuildL2Tables
+  vector<Int_t>   iNeighborStart;                        //the neighbors of group g are iNeighborList[iNeighborStart[g]] up to iNeighborList[iNeighborStart[g+1]-1]
+  vector<Int_t>   iNeighborList;
+  vector<Bool_t>  bGroupInPatch;                         //is group g in patch p: bGroupInPatch[p*iNumSumPixGroups+g]
+  vector<Int_t>   iNumGroupsInCluster;                   //How many groups are in the cluster seeded by each group
+  vector<Int_t>   iFirstGroupInCluster;                  //where the groups of the cluster seeded by each group start in iGroupsInClusters
+  vector<Int_t>   iGroupsInClusters;                     //groups that are in the clusters of triggered groups, cluster after cluster
+  vector<Float_t> fTriggerTimesInClusters;               //the trigger times of those groups
+  vector<Float_t> fTimesInCluster;                       //the trigger times of one cluster
+  vector<Int_t>   iClusterIndex;                         //the clusters sorted by their size
+  vector<Int_t>   iStackGroup;                           //groups and their next neighbor to visit while a cluster is searched
+  vector<Int_t>   iStackNeighbor;
+  vector<Bool_t>  bPatchTrigger;                         //which patch has triggered
+  vector<Float_t> fPatchTriggerTimes;                    //trigger time of each patch
+  vector<Int_t>   iPatchIndex;                           //the patches sorted by their trigger time
 
 
 };
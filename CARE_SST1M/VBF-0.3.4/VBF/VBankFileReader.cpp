@@ -10,17 +10,297 @@
 #include "VBankFileBzip2Reader.h"
 #include "VBankFileGzipReader.h"
 #include "VEventOverflow.h"
+#include "VConstants.h"
 
 #include <unistd.h>
 #include <sys/mman.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
 #include "Adler32.h"
 #include <iostream>
 
+#ifdef HAVE_GZIP
+#include <zlib.h>
+#endif
+
+#ifdef HAVE_BZIP2
+#include <bzlib.h>
+#endif
+
 using namespace std;
 using namespace VBFUtil;
 
+// a block of a compressed file starts with the magic number, the size of
+// the block, the size of the packet and the compression method
+#define BLOCK_HEADER_SIZE 16
+
+// turn a block of a compressed file back into the packet
+static void decompressBlock(const char *block,
+			    uword32 block_size,
+			    vector< char > &packet) {
+    if (block_size<BLOCK_HEADER_SIZE) {
+	throw VBankFileReaderCompressionException("block too small");
+    }
+    uword32 packet_size=bufToWord32(block+8);
+    uword32 method=bufToWord32(block+12);
+    const char *data=block+BLOCK_HEADER_SIZE;
+    uword32 size=block_size-BLOCK_HEADER_SIZE;
+    
+    if (packet_size<8) {
+	throw VBankFileReaderCompressionException("packet size too small");
+    }
+    packet.resize(packet_size);
+    
+    switch (method) {
+    case V_BANK_FILE_NO_COMPRESSION:
+	if (size!=packet_size) {
+	    throw VBankFileReaderCompressionException(
+		"stored packet has the wrong size");
+	}
+	memcpy(&packet[0],data,size);
+	break;
+#ifdef HAVE_GZIP
+    case V_BANK_FILE_ZLIB_COMPRESSION: {
+	uLongf len=packet_size;
+	int res=uncompress((Bytef*)&packet[0],&len,(const Bytef*)data,size);
+	if (res!=Z_OK) {
+	    throw VBankFileReaderCompressionException(zError(res));
+	}
+	if (len!=packet_size) {
+	    throw VBankFileReaderCompressionException(
+		"decompressed packet has the wrong size");
+	}
+	break;
+    }
+#endif
+#ifdef HAVE_BZIP2
+    case V_BANK_FILE_BZIP2_COMPRESSION: {
+	unsigned len=packet_size;
+	int res=BZ2_bzBuffToBuffDecompress(&packet[0],&len,(char*)data,size,
+					   0,0);
+	if (res!=BZ_OK || len!=packet_size) {
+	    ostringstream buf;
+	    buf<<"libbzip2 error "<<res;
+	    throw VBankFileReaderCompressionException(buf.str());
+	}
+	break;
+    }
+#endif
+    default: {
+	ostringstream buf;
+	buf<<"unsupported compression method "<<method;
+	throw VBankFileReaderCompressionException(buf.str());
+    }
+    }
+}
+
+// reads and decodes packets ahead of the caller, using a pool of threads.
+// the threads claim packets in increasing order, starting right after the
+// packet the caller asked for most recently, and stop when the raw size
+// of the packets that were claimed but not yet handed out would exceed
+// the memory budget.  readPacket() waits for the requested packet and
+// hands it out.  if a packet cannot be read or decoded, readPacket()
+// returns NULL and the reader decodes it again on the caller's thread,
+// so that the caller sees the usual exceptions.
+class VBankFileReadAhead {
+ private:
+    
+    struct Slot {
+	VPacket *packet;
+	uword32 size;     // packet size according to the packet header
+	uword32 cost;     // bytes charged against the memory budget
+    };
+    
+    typedef std::map< uword32, Slot > slot_map;
+    
+    VBankFileReader *reader;
+    uword64 memory_budget;
+    
+    std::vector< pthread_t > threads;
+    
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;   // something to claim, or quit
+    pthread_cond_t done_cond;   // a packet is done, or a thread is idle
+    
+    bool quit;
+    bool paused;
+    unsigned busy;              // threads decoding a packet
+    uword32 next_claim;         // next packet for the threads to decode
+    uword32 next_wanted;        // packet the caller should ask for next
+    bool started;
+    uword64 bytes_in_flight;    // cost of all claimed packets
+    slot_map done;
+    
+    VBankFileReadAhead(const VBankFileReadAhead &other) {}
+    void operator=(const VBankFileReadAhead &other) {}
+    
+    static void *threadMain(void *arg) {
+	((VBankFileReadAhead*)arg)->work();
+	return NULL;
+    }
+    
+    bool canClaim(uword32 *cost) {
+	if (paused || next_claim>=reader->num_packets) {
+	    return false;
+	}
+	word64 offset;
+	reader->packetExtent(next_claim,&offset,cost);
+	// always let at least one packet through, however big it is
+	return bytes_in_flight==0
+	    || bytes_in_flight+*cost<=memory_budget;
+    }
+    
+    void work() {
+	pthread_mutex_lock(&lock);
+	for (;;) {
+	    uword32 cost;
+	    while (!quit && !canClaim(&cost)) {
+		pthread_cond_wait(&work_cond,&lock);
+	    }
+	    if (quit) {
+		break;
+	    }
+	    
+	    uword32 index=next_claim++;
+	    bytes_in_flight+=cost;
+	    busy++;
+	    pthread_mutex_unlock(&lock);
+	    
+	    Slot slot;
+	    slot.packet=NULL;
+	    slot.size=0;
+	    slot.cost=cost;
+	    try {
+		word64 offset;
+		uword32 size;
+		reader->packetExtent(index,&offset,&size);
+		std::vector< char > buf;
+		uword32 packet_size;
+		const char *bytes=reader->viewPacket(offset,size,buf,
+						     &packet_size,&slot.size);
+		slot.packet=reader->parsePacket(index,bytes,packet_size);
+	    } catch (...) {
+		// leave it to the caller's thread to report the problem
+		slot.packet=NULL;
+	    }
+	    
+	    pthread_mutex_lock(&lock);
+	    done[index]=slot;
+	    busy--;
+	    pthread_cond_broadcast(&done_cond);
+	}
+	pthread_mutex_unlock(&lock);
+    }
+    
+    // throw away everything and start over at the given packet.  the
+    // lock must be held.
+    void restartAt(uword32 index) {
+	paused=true;
+	while (busy>0) {
+	    pthread_cond_wait(&done_cond,&lock);
+	}
+	for (slot_map::iterator i=done.begin();i!=done.end();++i) {
+	    delete i->second.packet;
+	}
+	done.clear();
+	bytes_in_flight=0;
+	next_claim=index;
+	next_wanted=index;
+	paused=false;
+	pthread_cond_broadcast(&work_cond);
+    }
+    
+ public:
+    
+    VBankFileReadAhead(VBankFileReader *reader,
+		       unsigned num_threads,
+		       uword64 memory_budget):
+	reader(reader),
+	memory_budget(memory_budget),
+	quit(false),
+	paused(false),
+	busy(0),
+	next_claim(reader->num_packets),
+	next_wanted(0),
+	started(false),
+	bytes_in_flight(0)
+    {
+	pthread_mutex_init(&lock,NULL);
+	pthread_cond_init(&work_cond,NULL);
+	pthread_cond_init(&done_cond,NULL);
+	for (unsigned i=0;i<num_threads;++i) {
+	    pthread_t thread;
+	    if (pthread_create(&thread,NULL,threadMain,this)) {
+		break;
+	    }
+	    threads.push_back(thread);
+	}
+	if (threads.empty()) {
+	    pthread_cond_destroy(&done_cond);
+	    pthread_cond_destroy(&work_cond);
+	    pthread_mutex_destroy(&lock);
+	    throw VSystemException(
+		"In VBankFileReadAhead::VBankFileReadAhead(), while "
+		"starting the read ahead threads");
+	}
+    }
+    
+    ~VBankFileReadAhead() {
+	pthread_mutex_lock(&lock);
+	quit=true;
+	pthread_cond_broadcast(&work_cond);
+	pthread_mutex_unlock(&lock);
+	for (unsigned i=0;i<threads.size();++i) {
+	    pthread_join(threads[i],NULL);
+	}
+	for (slot_map::iterator i=done.begin();i!=done.end();++i) {
+	    delete i->second.packet;
+	}
+	pthread_cond_destroy(&done_cond);
+	pthread_cond_destroy(&work_cond);
+	pthread_mutex_destroy(&lock);
+    }
+    
+    // forget everything read so far; the next readPacket() starts over
+    void reset() {
+	pthread_mutex_lock(&lock);
+	restartAt(reader->num_packets);
+	started=false;
+	pthread_mutex_unlock(&lock);
+    }
+    
+    // get the decoded packet with the given index (which must be in
+    // the file), along with its size.  returns NULL if the packet
+    // could not be decoded.
+    VPacket *readPacket(uword32 index,uword32 *packet_size) {
+	pthread_mutex_lock(&lock);
+	if (!started || index!=next_wanted) {
+	    restartAt(index);
+	    started=true;
+	}
+	slot_map::iterator i;
+	while ((i=done.find(index))==done.end()) {
+	    pthread_cond_wait(&done_cond,&lock);
+	}
+	Slot slot=i->second;
+	done.erase(i);
+	bytes_in_flight-=slot.cost;
+	next_wanted=index+1;
+	pthread_cond_broadcast(&work_cond);
+	pthread_mutex_unlock(&lock);
+	
+	*packet_size=slot.size;
+	return slot.packet;
+    }
+    
+};
+
 void VBankFileReader::myRead(word64 offset,char *buf,uword32 len) {
+    if (file_map!=NULL && (uword64)offset+len<=file_map_size) {
+        memcpy(buf,file_map+offset,len);
+        return;
+    }
     int res=::pread(fd,buf,len,(off_t)offset);
     if (res<0) {
         throw VSystemException("In VBankFileReader::myRead()");
@@ -100,7 +380,7 @@ void VBankFileReader::myWrite(word64 offset,uword64 value) {
 void VBankFileReader::skipNextPacket() {
     char buf[4];
     myRead(packet_offset,buf,4);
-    if (memcmp(buf,"VPCK",4)) {
+    if (memcmp(buf,packetMagic(),4)) {
         throw VBankFileReaderBadFormatException(
             "In VBankFileReader::skipNextPacket()");
     }
@@ -119,8 +399,12 @@ VBankFileReader::VBankFileReader(const std::string &filename,
                                  bool map_index,
                                  bool read_only):
     read_only(read_only),
+    compressed(false),
     stream(NULL),
-    next_packet(NULL)
+    next_packet(NULL),
+    read_ahead(NULL),
+    file_map(NULL),
+    file_map_size(0)
 {
     ostringstream buf;
     buf<<"In VBankFileReader::VBankFileReader() for \""
@@ -162,7 +446,10 @@ VBankFileReader::VBankFileReader(const std::string &filename,
 	    throw VBankFileReaderBadMagicNumberException(buf.str());
 	}
 	
-	if (myReadWord32(4)!=0) {
+	uword32 version=myReadWord32(4);
+	if (version==V_BANK_FILE_COMPRESSED_VERSION) {
+	    compressed=true;
+	} else if (version!=V_BANK_FILE_VERSION) {
 	    throw VBankFileReaderBadVersionNumberException(buf.str());
 	}
 	
@@ -228,9 +515,38 @@ VBankFileReader::VBankFileReader(const std::string &filename,
 		   VGetChiLASimulationHeaderBankBuilder());
     putBankBuilder(VGetChiLASimulationDataBankName(),
 		   VGetChiLASimulationDataBankBuilder());
+    
+    // let existing programs map the file without changing them
+    const char *map_mode=getenv("VBF_MMAP");
+    if (map_mode!=NULL && strcmp(map_mode,"0") && stream==NULL) {
+	mapFile(strcmp(map_mode,"random")!=0);
+    }
+    
+    // let existing programs read ahead without changing them
+    const char *threads=getenv("VBF_READ_AHEAD_THREADS");
+    int num_threads=0;
+    if (threads!=NULL) {
+	num_threads=atoi(threads);
+    } else if (compressed) {
+	// decompress in parallel unless told otherwise
+	long num_cpus=sysconf(_SC_NPROCESSORS_ONLN);
+	num_threads=num_cpus<1?1:(num_cpus>8?8:(int)num_cpus);
+    }
+    if (num_threads>0 && hasIndex() && stream==NULL) {
+	uword64 memory_budget=64*1024*1024;
+	const char *memory=getenv("VBF_READ_AHEAD_MEMORY");
+	if (memory!=NULL && atoi(memory)>0) {
+	    memory_budget=(uword64)atoi(memory)*1024*1024;
+	}
+	setReadAhead(num_threads,memory_budget);
+    }
 }
 
 VBankFileReader::~VBankFileReader() {
+    if (read_ahead!=NULL) {
+	delete read_ahead;
+	read_ahead=NULL;
+    }
     if (stream!=NULL) {
 	delete stream;
     }
@@ -238,10 +554,14 @@ VBankFileReader::~VBankFileReader() {
 	delete next_packet;
     }
     unmapIndex();
+    unmapFile();
     ::close(fd);
 }
 
 void VBankFileReader::resetBankBuilders() {
+    if (read_ahead!=NULL) {
+	read_ahead->reset();
+    }
     bank_builders.clear();
     final_bank_builders.clear();
 }
@@ -249,10 +569,16 @@ void VBankFileReader::resetBankBuilders() {
 void VBankFileReader::putBankBuilder(const VBankName &name,
                                      VBankBuilder *bank_builder) {
     V_ASSERT(bank_builder->canRead(name));
+    if (read_ahead!=NULL) {
+	read_ahead->reset();
+    }
     bank_builders[name]=bank_builder;
 }
 
 void VBankFileReader::addFinalBankBuilder(VBankBuilder *bank_builder) {
+    if (read_ahead!=NULL) {
+	read_ahead->reset();
+    }
     final_bank_builders.push_back(bank_builder);
 }
 
@@ -275,6 +601,9 @@ bool VBankFileReader::mapIndex() {
 	    ("Cannot do mapIndex()");
     }
 
+    // the read ahead threads work off the index
+    setReadAhead(0);
+    
     unmapIndex();
     
     // check if there is an index
@@ -384,24 +713,8 @@ bool VBankFileReader::hasPacket(uword32 index) {
     }
 }
 
-VPacket *VBankFileReader::readPacket(uword32 index) {
-    if (!hasIndex()) {
-	if (index<packet_index) {
-	    throw VBankFileReaderNoIndexException();
-	}
-    }
-    
-    if (stream!=NULL) {
-	streamSkipTo(index);
-	if (next_packet==NULL) {
-	    throw VBankFileReaderIndexOutOfBoundsException();
-	} else {
-	    VPacket *result=next_packet;
-	    next_packet=NULL;
-	    return result;
-	}
-    }
-
+word64 VBankFileReader::locatePacket(uword32 index,
+                                     uword32 *packet_size) {
     off_t offset;
     
     if (index!=packet_index) {
@@ -429,16 +742,205 @@ VPacket *VBankFileReader::readPacket(uword32 index) {
     
     char buf[4];
     myRead(offset,buf,4);
-    if (memcmp(buf,"VPCK",4)) {
+    if (memcmp(buf,packetMagic(),4)) {
         throw VBankFileReaderBadFormatException(
-            "In VBankFileReader::readPacket()");
+            "In VBankFileReader::locatePacket()");
     }
     
-    uword32 packet_size=myReadWord32(offset+4);
+    *packet_size=myReadWord32(offset+4);
+    if (*packet_size<8) {
+        throw VBankFileReaderBadFormatException(
+            "In VBankFileReader::locatePacket(): packet size too small");
+    }
     
-    packet_offset=offset+packet_size;
+    packet_offset=offset+*packet_size;
     packet_index=index+1;
     
+    return offset;
+}
+
+void VBankFileReader::packetExtent(uword32 index,
+                                   word64 *offset,
+                                   uword32 *size) const {
+    *offset=(word64)bufToWord64(this->index+(index*8));
+    word64 end;
+    if (index+1<num_packets) {
+        end=(word64)bufToWord64(this->index+((index+1)*8));
+    } else {
+        end=(word64)pre_footer_size;
+    }
+    *size=(end>*offset)?(uword32)(end-*offset):0;
+}
+
+const char *VBankFileReader::viewPacket(word64 offset,
+                                        uword32 size,
+                                        std::vector< char > &buf,
+                                        uword32 *packet_size,
+                                        uword32 *stored_size) {
+    if (size<8) {
+        throw VBankFileReaderBadFormatException(
+            "In VBankFileReader::viewPacket(): packet size too small");
+    }
+    
+    const char *mapped=NULL;
+    if (file_map!=NULL && (uword64)offset+size<=file_map_size) {
+        mapped=file_map+offset;
+    }
+    
+    const char *result;
+    uword32 avail;
+    if (compressed) {
+        std::vector< char > block;
+        const char *bytes=mapped;
+        if (bytes==NULL) {
+            block.resize(size);
+            myRead(offset,&block[0],size);
+            bytes=&block[0];
+        }
+        *stored_size=bufToWord32(bytes+4);
+        if (memcmp(bytes,"VZPK",4) || *stored_size>size) {
+            throw VBankFileReaderBadFormatException(
+                "In VBankFileReader::viewPacket(): bad block");
+        }
+        decompressBlock(bytes,*stored_size,buf);
+        result=&buf[0];
+        avail=buf.size();
+    } else if (mapped!=NULL) {
+        result=mapped;
+        avail=size;
+        *stored_size=bufToWord32(result+4);
+    } else {
+        buf.resize(size);
+        myRead(offset,&buf[0],size);
+        result=&buf[0];
+        avail=size;
+        *stored_size=bufToWord32(result+4);
+    }
+    
+    *packet_size=bufToWord32(result+4);
+    if (memcmp(result,"VPCK",4) || *packet_size<8 || *packet_size>avail
+        || (compressed && *packet_size!=avail)) {
+        throw VBankFileReaderBadFormatException(
+            "In VBankFileReader::viewPacket(): bad packet");
+    }
+    return result;
+}
+
+uword32 VBankFileReader::loadPacket(word64 offset,
+                                    uword32 size,
+                                    std::vector< char > &buf) {
+    uword32 packet_size;
+    uword32 stored_size;
+    const char *bytes=viewPacket(offset,size,buf,&packet_size,&stored_size);
+    if (buf.empty() || bytes!=&buf[0]) {
+        buf.assign(bytes,bytes+packet_size);
+    } else {
+        buf.resize(packet_size);
+    }
+    return stored_size;
+}
+
+VPacket *VBankFileReader::parsePacket(uword32 index,
+                                      const char *buf,
+                                      uword32 size) {
+    VPacket *result=new VPacket();
+    
+    try {
+        uword32 offset=8;
+        while (offset<size) {
+            if (size-offset<16) {
+                throw VBankFileReaderBadFormatException(
+                    "In VBankFileReader::parsePacket(): truncated bank");
+            }
+            
+            VBankName bank_name(buf+offset);
+            if (result->has(bank_name)) {
+                throw VBankFileReaderBadFormatException(
+                    "In VBankFileReader::parsePacket(): duplicate bank name");
+            }
+            
+            uword32 version=bufToWord32(buf+offset+8);
+            uword32 bank_size=bufToWord32(buf+offset+12);
+            if (bank_size<16 || bank_size>size-offset) {
+                throw VBankFileReaderBadFormatException(
+                    "In VBankFileReader::parsePacket(): bad bank size");
+            }
+            
+            VBankBuilder *builder=getBankBuilder(bank_name);
+            if (builder!=NULL) {
+                result->put(bank_name,
+                    builder->readBankFromBuffer(run_number,
+                                                index,
+                                                bank_name,
+                                                version,
+                                                bank_size-16,
+                                                buf+offset+16));
+            }
+            
+            offset+=bank_size;
+        }
+    } catch (...) {
+        delete result;
+        throw;
+    }
+    
+    return result;
+}
+
+bool VBankFileReader::setReadAhead(unsigned num_threads,
+                                   uword64 memory_budget) {
+    if (read_ahead!=NULL) {
+        delete read_ahead;
+        read_ahead=NULL;
+    }
+    if (num_threads==0 || stream!=NULL || !hasIndex()) {
+        return false;
+    }
+    read_ahead=new VBankFileReadAhead(this,num_threads,memory_budget);
+    return true;
+}
+
+VPacket *VBankFileReader::readPacket(uword32 index) {
+    if (!hasIndex()) {
+	if (index<packet_index) {
+	    throw VBankFileReaderNoIndexException();
+	}
+    }
+    
+    if (stream!=NULL) {
+	streamSkipTo(index);
+	if (next_packet==NULL) {
+	    throw VBankFileReaderIndexOutOfBoundsException();
+	} else {
+	    VPacket *result=next_packet;
+	    next_packet=NULL;
+	    return result;
+	}
+    }
+
+    if (read_ahead!=NULL && index<num_packets) {
+        uword32 packet_size;
+        VPacket *result=read_ahead->readPacket(index,&packet_size);
+        if (result!=NULL) {
+            packet_offset=(word64)bufToWord64(this->index+(index*8))
+                +packet_size;
+            packet_index=index+1;
+            return result;
+        }
+        // could not decode it ahead; do it again here to get the error
+    }
+
+    uword32 packet_size;
+    word64 offset=locatePacket(index,&packet_size);
+    
+    if (compressed || file_map!=NULL) {
+        std::vector< char > buf;
+        uword32 size;
+        const char *bytes=viewPacket(offset,packet_size,buf,
+                                     &size,&packet_size);
+        return parsePacket(index,bytes,size);
+    }
+    
     VPacket *result=new VPacket();
     
     // FIXME: memory leak on error!
@@ -476,6 +978,84 @@ VPacket *VBankFileReader::readPacket(uword32 index) {
     return result;
 }
 
+void VBankFileReader::readRawPacket(uword32 index,
+                                    std::vector< char > &buf) {
+    if (!hasIndex()) {
+	if (index<packet_index) {
+	    throw VBankFileReaderNoIndexException();
+	}
+    }
+    
+    if (stream!=NULL) {
+	throw VBankFileReaderStreamedException(
+	    "In VBankFileReader::readRawPacket()");
+    }
+    
+    uword32 packet_size;
+    word64 offset=locatePacket(index,&packet_size);
+    
+    loadPacket(offset,packet_size,buf);
+}
+
+const char *VBankFileReader::getPacketBytes(uword32 index,uword32 *size) {
+    if (file_map==NULL) {
+	throw VBankFileReaderNotMappedException(
+	    "In VBankFileReader::getPacketBytes()");
+    }
+    if (!hasIndex()) {
+	if (index<packet_index) {
+	    throw VBankFileReaderNoIndexException();
+	}
+    }
+    
+    uword32 packet_size;
+    word64 offset=locatePacket(index,&packet_size);
+    
+    uword32 stored_size;
+    return viewPacket(offset,packet_size,view_buf,size,&stored_size);
+}
+
+bool VBankFileReader::mapFile(bool sequential) {
+    if (stream!=NULL) {
+	return false;
+    }
+    
+    // the read ahead threads must not see the mapping change under them
+    if (read_ahead!=NULL) {
+	read_ahead->reset();
+    }
+    unmapFile();
+    
+    size_t size=(size_t)pre_footer_size;
+    if ((uword64)size!=pre_footer_size) {
+	// does not fit into the address space
+	return false;
+    }
+    void *base=::mmap(NULL,size,PROT_READ,MAP_SHARED,fd,0);
+    if (base==MAP_FAILED) {
+	return false;
+    }
+    // only a hint; nothing to do if the kernel doesn't take it
+    ::madvise(base,size,sequential?MADV_SEQUENTIAL:MADV_RANDOM);
+    
+    file_map=(char*)base;
+    file_map_size=pre_footer_size;
+    return true;
+}
+
+void VBankFileReader::unmapFile() {
+    if (file_map==NULL) {
+	return;
+    }
+    // the read ahead threads may be looking at the mapping
+    if (read_ahead!=NULL) {
+	read_ahead->reset();
+    }
+    ::munmap(file_map,(size_t)file_map_size);
+    file_map=NULL;
+    file_map_size=0;
+}
+
 void VBankFileReader::resetSequentialRead() {
     if (stream==NULL) {
 	packet_offset=56;
@@ -515,7 +1095,7 @@ uword32 VBankFileReader::generateIndexAndChecksum() {
         while ((uword64)my_index.back() < pre_footer_size) {
             myRead(my_index.back(),buf,8);
             
-            if (memcmp(buf,"VPCK",4)) {
+            if (memcmp(buf,packetMagic(),4)) {
                 throw VBankFileReaderBadFormatException(
                     "In VBankFileReader::generateIndexAndChecksum()");
             }
@@ -15,6 +15,7 @@
 #include "VBankName.h"
 #include "VBankFileReaderBase.h"
 #include <map>
+#include <vector>
 
 class VBankFileReaderException: public VException {};
 
@@ -99,17 +100,48 @@ public VBankFileReaderBadFormatException {
     }
 };
 
+class VBankFileReaderCompressionException:
+public VBankFileReaderBadFormatException {
+ public:
+    VBankFileReaderCompressionException(const std::string &msg="") {
+	setStrings("A packet of the compressed VBF file could not be "
+		   "decompressed; either the file is corrupt or this build "
+		   "of the VBF library does not support its compression "
+		   "method",
+		   msg);
+    }
+};
+
+class VBankFileReaderNotMappedException: public VBankFileReaderException {
+ public:
+    VBankFileReaderNotMappedException(const std::string &msg="") {
+	setStrings("The VBF file is not mapped into memory, yet the "
+		   "requested operation requires that it be mapped",msg);
+    }
+};
+
 class VBankFileStreamReader;
+class VBankFileReadAhead;
 
 class VBankFileReader: public VBankFileReaderBase {
  private:
+    
+    friend class VBankFileReadAhead;
         
     int fd;
         
     bool read_only;
+    
+    // true if each packet is stored as a compressed block (see
+    // VBankFileWriter::setCompression())
+    bool compressed;
         
     VBankFileStreamReader *stream;
     VPacket *next_packet;
+    
+    // the worker threads that read and decode packets ahead of the
+    // caller; NULL if packets are decoded on the caller's thread
+    VBankFileReadAhead *read_ahead;
 
     // this is the offset of the next packet to read.
     // that is, it is the offset of the packet that
@@ -129,6 +161,15 @@ class VBankFileReader: public VBankFileReaderBase {
     // that we have no index        
     char *index;
 
+    // the body of the file (everything up to the footer), if it was
+    // mapped by mapFile(); NULL if the body is read with preads
+    char *file_map;
+    uword64 file_map_size;
+    
+    // holds the packet handed out by getPacketBytes() for compressed
+    // files
+    std::vector< char > view_buf;
+        
     // if we have an index, this is the number of
     // packets in the file.  otherwise the value here
     // is undefined        
@@ -173,6 +214,47 @@ class VBankFileReader: public VBankFileReaderBase {
     void skipNextPacket();
     void streamSkipTo(uword32 index);
         
+    // the magic number of the packets, or of the blocks of a compressed
+    // file.  either way it is followed by the total size.
+    const char *packetMagic() const throw() {
+	return compressed?"VZPK":"VPCK";
+    }
+        
+    // find the packet with the given index, check its magic number and
+    // leave packet_offset/packet_index pointing past it.  returns the
+    // offset of the packet and puts its total size into packet_size.
+    // for compressed files, that is the offset and size of the block.
+    word64 locatePacket(uword32 index,uword32 *packet_size);
+        
+    // read the packet (or block) at the given offset, which takes up at
+    // most size bytes, into buf, decompressing it if needed.  buf then
+    // holds the raw bytes of the packet, starting with the "VPCK" magic
+    // number.  returns the size of the packet (or block) in the file.
+    // like parsePacket() this can be called from the read ahead threads.
+    uword32 loadPacket(word64 offset,uword32 size,std::vector< char > &buf);
+        
+    // like loadPacket(), but without copying if it can be helped: if the
+    // file is mapped and not compressed, the result points into the
+    // mapping and buf is left alone; otherwise the packet is put into buf
+    // and the result points there.  the packet takes up packet_size
+    // bytes, and the packet (or block) takes up stored_size bytes in the
+    // file.  can be called from the read ahead threads.
+    const char *viewPacket(word64 offset,
+			   uword32 size,
+			   std::vector< char > &buf,
+			   uword32 *packet_size,
+			   uword32 *stored_size);
+        
+    // get the location of the packet (or block) with the given index
+    // from the index.
+    // the size is the distance to the next packet (or to the footer).
+    void packetExtent(uword32 index,word64 *offset,uword32 *size) const;
+        
+    // build a packet from its raw bytes (starting with the "VPCK" magic
+    // number).  does not touch any of the state of the reader, so it can
+    // be called from the read ahead threads.
+    VPacket *parsePacket(uword32 index,const char *buf,uword32 size);
+        
     void unmapIndex();
         
  public:
@@ -227,6 +309,30 @@ class VBankFileReader: public VBankFileReaderBase {
     // exceptions fatal.
     VBankBuilder *getBankBuilder(const VBankName &name);
         
+    // start reading ahead: num_threads threads read and decode the
+    // packets that follow the one most recently asked for, as long as
+    // the raw size of the packets read ahead stays below memory_budget
+    // bytes.  readPacket() then hands out the decoded packets.  this
+    // only pays off if packets are read in increasing order; reading a
+    // packet out of order makes the threads start over from there.
+    // returns false if there is no index or if the file is being
+    // streamed, in which case packets are decoded on the caller's
+    // thread as before.  passing 0 for num_threads stops reading ahead.
+    // the same can be done without changing any code by setting the
+    // VBF_READ_AHEAD_THREADS (and optionally VBF_READ_AHEAD_MEMORY, in
+    // megabytes) environment variables.  compressed files are read
+    // ahead, and so decompressed in parallel, by default, using one
+    // thread per processor (up to 8); set VBF_READ_AHEAD_THREADS to 0
+    // to prevent that.  the memory budget counts compressed bytes for
+    // those files.  all exceptions fatal.
+    bool setReadAhead(unsigned num_threads,
+		      uword64 memory_budget=64*1024*1024);
+    
+    // returns true if packets are read ahead
+    bool hasReadAhead() const throw() {
+	return read_ahead!=NULL;
+    }
+        
     // returns true if the file is being streamed.  this is the equivalent
     // of read-only, except that you cannot compute checksums or get the
     // file/body/footer size.  a file is streamed if it is a bzip2 file.
@@ -234,6 +340,38 @@ class VBankFileReader: public VBankFileReaderBase {
 	return stream!=NULL;
     }
 	
+    // returns true if the packets are stored as compressed blocks.  such
+    // a file is read like any other one, including random access
+    // through the index.
+    bool isCompressed() const throw() {
+	return compressed;
+    }
+	
+    // map the body of the file into memory.  packets are then parsed
+    // straight out of the mapping instead of being read into a buffer
+    // first (blocks of compressed files are decompressed straight out of
+    // it), and getPacketBytes() becomes available.  if sequential is
+    // true, the kernel is told (with madvise()) that the file will be
+    // read from front to back, so that it reads ahead aggressively and
+    // drops the pages behind; pass false for random access.  the packets
+    // returned by readPacket() and readRawPacket() own all of their data,
+    // as before, and stay valid after the file is unmapped.  returns
+    // false if the file is being streamed or if it cannot be mapped (for
+    // example because it does not fit into the address space), in which
+    // case the file is read as before.  the same can be done without
+    // changing any code by setting the VBF_MMAP environment variable to
+    // 1 (or to "random" for random access).  all exceptions fatal.
+    bool mapFile(bool sequential=true);
+    
+    // undo mapFile().  the pointers handed out by getPacketBytes() become
+    // invalid.
+    void unmapFile();
+    
+    // returns true if the body of the file is mapped into memory
+    bool isMapped() const throw() {
+	return file_map!=NULL;
+    }
+	
     // returns true if we have an index; this will always be true if
     // allow_no_index (see constructor above) was false.  if false, this
     // means that: numPackets() will always throw the no index
@@ -276,6 +414,25 @@ class VBankFileReader: public VBankFileReaderBase {
     // index; otherwise exceptions are not fatal.
     VPacket *readPacket(uword32 index);
         
+    // read the packet with the given index without parsing it.  buf
+    // receives the raw bytes of the whole packet, starting with the
+    // "VPCK" magic number and the packet size, and can be handed as
+    // is to VBankFileWriter::writeRawPacket().  the same index rules
+    // as for readPacket() apply.  this does not work if the file is
+    // being streamed.  all exceptions fatal if there is no index;
+    // otherwise exceptions are not fatal.
+    void readRawPacket(uword32 index,std::vector< char > &buf);
+        
+    // like readRawPacket(), but without copying: returns a pointer to
+    // the raw bytes of the packet and puts its size into size.  the file
+    // must have been mapped with mapFile().  the pointer points into the
+    // mapping and stays valid until unmapFile() is called or the reader
+    // is deleted; for compressed files, it points to the decompressed
+    // packet, which stays valid only until the next call.  the same index
+    // rules as for readPacket() apply.  all exceptions fatal if there is
+    // no index; otherwise exceptions are not fatal.
+    const char *getPacketBytes(uword32 index,uword32 *size);
+        
     // reset sequential read.  if there is an index, this has no noticable
     // effect other than perhaps one of performance.  if there is no index,
     // this allows the user to start reading the file from the beginning
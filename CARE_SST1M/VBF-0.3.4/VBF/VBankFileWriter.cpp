@@ -10,12 +10,267 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <string.h>
 #include "Adler32.h"
 #include <iostream>
+#include <deque>
+#include <pthread.h>
+
+#ifdef HAVE_GZIP
+#include <zlib.h>
+#endif
+
+#ifdef HAVE_BZIP2
+#include <bzlib.h>
+#endif
 
 using namespace std;
 using namespace VBFUtil;
 
+// a compressed block starts with the magic number, the size of the block,
+// the size of the packet and the compression method
+#define BLOCK_HEADER_SIZE 16
+
+static bool compressionSupported(uword32 method) {
+    switch (method) {
+#ifdef HAVE_GZIP
+    case V_BANK_FILE_ZLIB_COMPRESSION:
+	return true;
+#endif
+#ifdef HAVE_BZIP2
+    case V_BANK_FILE_BZIP2_COMPRESSION:
+	return true;
+#endif
+    default:
+	return false;
+    }
+}
+
+// turn a serialized packet into a block of a compressed file.  packets
+// that do not get any smaller are stored as they are.
+static void compressBlock(uword32 method,
+			  int level,
+			  const vector< char > &packet,
+			  vector< char > &block) {
+    uword32 packet_size=packet.size();
+    uword32 size=packet_size;
+    
+    switch (method) {
+#ifdef HAVE_GZIP
+    case V_BANK_FILE_ZLIB_COMPRESSION: {
+	uLongf len=compressBound(packet_size);
+	block.resize(BLOCK_HEADER_SIZE+len);
+	int res=compress2((Bytef*)&block[BLOCK_HEADER_SIZE],&len,
+			  (const Bytef*)&packet[0],packet_size,
+			  level<0?Z_DEFAULT_COMPRESSION:level);
+	if (res!=Z_OK) {
+	    throw VBankFileWriterCompressionException(zError(res));
+	}
+	size=len;
+	break;
+    }
+#endif
+#ifdef HAVE_BZIP2
+    case V_BANK_FILE_BZIP2_COMPRESSION: {
+	unsigned len=packet_size;
+	block.resize(BLOCK_HEADER_SIZE+len);
+	int res=BZ2_bzBuffToBuffCompress(&block[BLOCK_HEADER_SIZE],&len,
+					 (char*)&packet[0],packet_size,
+					 (level<1 || level>9)?9:level,0,0);
+	if (res==BZ_OUTBUFF_FULL) {
+	    len=packet_size;
+	} else if (res!=BZ_OK) {
+	    ostringstream buf;
+	    buf<<"libbzip2 error "<<res;
+	    throw VBankFileWriterCompressionException(buf.str());
+	}
+	size=len;
+	break;
+    }
+#endif
+    default:
+	throw VBankFileWriterCompressionException(
+	    "Compression method not supported by this build of VBF");
+    }
+    
+    if (size>=packet_size) {
+	method=V_BANK_FILE_NO_COMPRESSION;
+	size=packet_size;
+	block.resize(BLOCK_HEADER_SIZE+size);
+	memcpy(&block[BLOCK_HEADER_SIZE],&packet[0],size);
+    }
+    
+    block.resize(BLOCK_HEADER_SIZE+size);
+    memcpy(&block[0],"VZPK",4);
+    wordToBuf((uword32)(BLOCK_HEADER_SIZE+size),&block[4]);
+    wordToBuf(packet_size,&block[8]);
+    wordToBuf(method,&block[12]);
+}
+
+class VBankFileCompressor {
+ private:
+    
+    struct Job {
+	vector< char > packet;
+	vector< char > block;
+	bool done;
+	string error;       // not empty if the packet could not be compressed
+    };
+    
+    uword32 method;
+    int level;
+    
+    vector< pthread_t > threads;
+    
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;   // something to compress, or quit
+    pthread_cond_t done_cond;   // a job is done
+    
+    bool quit;
+    deque< Job* > pending;      // jobs no thread has picked up yet
+    deque< Job* > jobs;         // all jobs not handed back yet, in order
+    unsigned max_jobs;
+    
+    VBankFileCompressor(const VBankFileCompressor &other) {}
+    void operator=(const VBankFileCompressor &other) {}
+    
+    static void *threadMain(void *arg) {
+	((VBankFileCompressor*)arg)->work();
+	return NULL;
+    }
+    
+    void work() {
+	pthread_mutex_lock(&lock);
+	for (;;) {
+	    while (!quit && pending.empty()) {
+		pthread_cond_wait(&work_cond,&lock);
+	    }
+	    if (quit) {
+		break;
+	    }
+	    Job *job=pending.front();
+	    pending.pop_front();
+	    pthread_mutex_unlock(&lock);
+	    
+	    try {
+		compressBlock(method,level,job->packet,job->block);
+	    } catch (const exception &e) {
+		job->error=e.what();
+	    } catch (...) {
+		job->error="Unknown error";
+	    }
+	    vector< char >().swap(job->packet);
+	    
+	    pthread_mutex_lock(&lock);
+	    job->done=true;
+	    pthread_cond_broadcast(&done_cond);
+	}
+	pthread_mutex_unlock(&lock);
+    }
+    
+ public:
+    
+    VBankFileCompressor(uword32 method,
+			int level,
+			unsigned num_threads):
+	method(method),
+	level(level),
+	quit(false),
+	max_jobs(4*num_threads)
+    {
+	pthread_mutex_init(&lock,NULL);
+	pthread_cond_init(&work_cond,NULL);
+	pthread_cond_init(&done_cond,NULL);
+	for (unsigned i=0;i<num_threads;++i) {
+	    pthread_t thread;
+	    if (pthread_create(&thread,NULL,threadMain,this)) {
+		break;
+	    }
+	    threads.push_back(thread);
+	}
+	if (num_threads>0 && threads.empty()) {
+	    pthread_cond_destroy(&done_cond);
+	    pthread_cond_destroy(&work_cond);
+	    pthread_mutex_destroy(&lock);
+	    throw VSystemException(
+		"In VBankFileCompressor::VBankFileCompressor(), while "
+		"starting the compression threads");
+	}
+    }
+    
+    ~VBankFileCompressor() {
+	pthread_mutex_lock(&lock);
+	quit=true;
+	pthread_cond_broadcast(&work_cond);
+	pthread_mutex_unlock(&lock);
+	for (unsigned i=0;i<threads.size();++i) {
+	    pthread_join(threads[i],NULL);
+	}
+	for (unsigned i=0;i<jobs.size();++i) {
+	    delete jobs[i];
+	}
+	pthread_cond_destroy(&done_cond);
+	pthread_cond_destroy(&work_cond);
+	pthread_mutex_destroy(&lock);
+    }
+    
+    // queue a serialized packet for compression; the contents of packet
+    // are taken over
+    void submit(vector< char > &packet) {
+	Job *job=new Job();
+	job->done=false;
+	job->packet.swap(packet);
+	
+	if (threads.empty()) {
+	    try {
+		compressBlock(method,level,job->packet,job->block);
+	    } catch (...) {
+		delete job;
+		throw;
+	    }
+	    job->done=true;
+	    jobs.push_back(job);
+	    return;
+	}
+	
+	pthread_mutex_lock(&lock);
+	jobs.push_back(job);
+	pending.push_back(job);
+	pthread_cond_signal(&work_cond);
+	pthread_mutex_unlock(&lock);
+    }
+    
+    // get the block of the oldest packet submitted, if it has been
+    // compressed.  waits for it if wait is true or if too many packets
+    // are queued.  returns false if there is no block to hand back.
+    bool nextBlock(vector< char > &block,bool wait) {
+	pthread_mutex_lock(&lock);
+	while (!jobs.empty() && !jobs.front()->done
+	       && (wait || jobs.size()>max_jobs)) {
+	    pthread_cond_wait(&done_cond,&lock);
+	}
+	Job *job=NULL;
+	if (!jobs.empty() && jobs.front()->done) {
+	    job=jobs.front();
+	    jobs.pop_front();
+	}
+	pthread_mutex_unlock(&lock);
+	
+	if (job==NULL) {
+	    return false;
+	}
+	
+	block.swap(job->block);
+	string error=job->error;
+	delete job;
+	if (!error.empty()) {
+	    throw VBankFileWriterCompressionException(error);
+	}
+	return true;
+    }
+    
+};
+
 void VBankFileWriter::myWrite(const char *buf,uword32 len) {
     int res=::pwrite(fd,buf,len,(off_t)offset);
     if (res<0) {
@@ -66,28 +321,12 @@ void VBankFileWriter::myWrite(word64 offset,uword64 value) {
     myWrite(offset,buf,8);
 }
 
-VBankFileWriter::VBankFileWriter(const string &filename,
-                                 long run_number,
-                                 const vector< bool > &config_mask,
-                                 bool keep_index):
-    count(0),
-    keep_index(keep_index),
-    run_number(run_number),
-    config_mask(config_mask)
-{
-    fd=open(filename.c_str(),O_CREAT|O_WRONLY|O_TRUNC,0644);
-    if (fd<0) {
-        ostringstream buf;
-        buf<<"In VBankFileWriter::VBankFileWriter() for \""
-           <<filename<<"\"";
-        throw VSystemException(buf.str());
-    }
-    
+void VBankFileWriter::writeHeader(uword32 version) {
     adler=::vbf_adler32(0,NULL,0);
     offset=0;
     
     myWrite("VBFF",4);  // magic word
-    myWrite((uword32)0);    // version
+    myWrite(version);   // version
     myWrite((uword32)run_number);   // run number
 
     // write the configuration mask at offset 12
@@ -119,17 +358,113 @@ VBankFileWriter::VBankFileWriter(const string &filename,
     myWrite((uword64)0);    // pre-footer size
 }
 
+VBankFileWriter::VBankFileWriter(const string &filename,
+                                 long run_number,
+                                 const vector< bool > &config_mask,
+                                 bool keep_index):
+    count(0),
+    keep_index(keep_index),
+    compressor(NULL),
+    run_number(run_number),
+    config_mask(config_mask)
+{
+    fd=open(filename.c_str(),O_CREAT|O_WRONLY|O_TRUNC,0644);
+    if (fd<0) {
+        ostringstream buf;
+        buf<<"In VBankFileWriter::VBankFileWriter() for \""
+           <<filename<<"\"";
+        throw VSystemException(buf.str());
+    }
+    
+    writeHeader(V_BANK_FILE_VERSION);
+}
+
 VBankFileWriter::~VBankFileWriter() {
+    if (compressor!=NULL) {
+        delete compressor;
+    }
     if (fd>=0) {
         ::close(fd);
     }
 }
 
+void VBankFileWriter::setCompression(uword32 method,
+                                     unsigned num_threads,
+                                     int level) {
+    if (count>0) {
+        throw VBankFileWriterCompressionException(
+            "setCompression() must be called before the first packet "
+            "is written");
+    }
+    if (compressor!=NULL) {
+        delete compressor;
+        compressor=NULL;
+    }
+    if (method==V_BANK_FILE_NO_COMPRESSION) {
+        writeHeader(V_BANK_FILE_VERSION);
+        return;
+    }
+    if (!compressionSupported(method)) {
+        ostringstream buf;
+        buf<<"Compression method "<<method<<" is not supported by this "
+           <<"build of VBF";
+        throw VBankFileWriterCompressionException(buf.str());
+    }
+    compressor=new VBankFileCompressor(method,level,num_threads);
+    writeHeader(V_BANK_FILE_COMPRESSED_VERSION);
+}
+
+void VBankFileWriter::writeBlocks(bool wait) {
+    vector< char > block;
+    while (compressor->nextBlock(block,wait)) {
+        if (keep_index) {
+            index.push_back(offset);
+        }
+        myWrite(&block[0],block.size());
+    }
+}
+
 uword32 VBankFileWriter::getNextIndex() {
     return count;
 }
 
 void VBankFileWriter::writePacket(VPacket *packet) {
+    if (compressor!=NULL) {
+        uword32 size=8;
+        for (VPacket::iterator i=packet->begin();
+             i!=packet->end();
+             ++i) {
+            if (i->second!=NULL) {
+                size+=16;
+                size+=i->second->getBankSize();
+            }
+        }
+        
+        vector< char > buf(size);
+        memcpy(&buf[0],"VPCK",4);
+        wordToBuf(size,&buf[4]);
+        
+        uword32 pos=8;
+        for (VPacket::iterator i=packet->begin();
+             i!=packet->end();
+             ++i) {
+            if (i->second==NULL) {
+                continue;
+            }
+            uword32 bank_size=i->second->getBankSize();
+            memcpy(&buf[pos],i->first.getName(),8);
+            wordToBuf(i->second->getBankVersion(),&buf[pos+8]);
+            wordToBuf(bank_size+16,&buf[pos+12]);
+            i->second->writeBankToBuffer(&buf[pos+16]);
+            pos+=16+bank_size;
+        }
+        
+        compressor->submit(buf);
+        ++count;
+        writeBlocks(false);
+        return;
+    }
+    
     if (keep_index) {
         index.push_back(offset);
     }
@@ -166,7 +501,38 @@ void VBankFileWriter::writePacket(VPacket *packet) {
     ++count;
 }
 
+void VBankFileWriter::writeRawPacket(const char *buf,uword32 len) {
+    if (len<8 || memcmp(buf,"VPCK",4) || bufToWord32(buf+4)!=len) {
+        throw VBankFileWriterBadPacketException(
+            "In VBankFileWriter::writeRawPacket()");
+    }
+    
+    if (compressor!=NULL) {
+        vector< char > packet(buf,buf+len);
+        compressor->submit(packet);
+        ++count;
+        writeBlocks(false);
+        return;
+    }
+    
+    if (keep_index) {
+        index.push_back(offset);
+    }
+    
+    myWrite(buf,len);
+    
+    ++count;
+}
+
 void VBankFileWriter::writeEmptyPacket() {
+    if (compressor!=NULL) {
+        char buf[8];
+        memcpy(buf,"VPCK",4);
+        wordToBuf((uword32)8,buf+4);
+        writeRawPacket(buf,8);
+        return;
+    }
+    
     if (keep_index) {
         index.push_back(offset);
     }
@@ -189,6 +555,12 @@ void VBankFileWriter::writePacket(uword32 index,
 }
 
 uword32 VBankFileWriter::finish(bool store_index) {
+    if (compressor!=NULL) {
+        writeBlocks(true);
+        delete compressor;
+        compressor=NULL;
+    }
+    
     uword64 pre_footer_size=offset;
     
     if (keep_index && store_index) {
@@ -8,6 +8,7 @@
 
 #include "VException.h"
 #include "VPacket.h"
+#include "VConstants.h"
 
 class VBankFileWriterException: public VException {};
 
@@ -19,6 +20,23 @@ class VBankFileWriterBadIndexException: public VBankFileWriterException {
         }
 };
 
+class VBankFileWriterBadPacketException: public VBankFileWriterException {
+    public:
+        VBankFileWriterBadPacketException(const std::string &msg="") {
+            setStrings("Attempt to write a raw packet that does not start "
+                       "with a valid packet header",msg);
+        }
+};
+
+class VBankFileWriterCompressionException: public VBankFileWriterException {
+    public:
+        VBankFileWriterCompressionException(const std::string &msg="") {
+            setStrings("Could not compress a packet",msg);
+        }
+};
+
+class VBankFileCompressor;
+
 class VBankFileWriter {
     private:
         
@@ -32,6 +50,10 @@ class VBankFileWriter {
         bool keep_index;
         std::vector< uword64 > index;
         
+        // compresses the packets of a compressed file; NULL if the
+        // packets are written as they are
+        VBankFileCompressor *compressor;
+        
         // kept around for convenience
         long run_number;
         std::vector< bool > config_mask;
@@ -51,6 +73,14 @@ class VBankFileWriter {
         void myWrite(word64 offset,uword32 value);
         void myWrite(word64 offset,uword64 value);
         
+        // write the file header, starting over at the beginning of the
+        // file
+        void writeHeader(uword32 version);
+        
+        // write a compressed block for each packet that the compressor
+        // is done with.  if wait is true, waits for all of them.
+        void writeBlocks(bool wait);
+        
     public:
         
         VBankFileWriter(const std::string &filename,
@@ -68,12 +98,39 @@ class VBankFileWriter {
             return config_mask;
         }
         
+        // store the packets as independently compressed blocks, using
+        // the given method (V_BANK_FILE_ZLIB_COMPRESSION or
+        // V_BANK_FILE_BZIP2_COMPRESSION from VConstants.h).  the index
+        // then points at the blocks, so VBankFileReader can still read
+        // the packets in any order.  num_threads threads compress the
+        // packets while the caller goes on; with 0 they are compressed
+        // on the caller's thread.  level is the compression level of
+        // the library (-1 for its default).  this must be called before
+        // the first packet is written.  throws
+        // VBankFileWriterCompressionException if the method is not
+        // supported by this build of the library.
+        void setCompression(uword32 method,
+                            unsigned num_threads=0,
+                            int level=-1);
+        
+        // returns true if the packets are compressed
+        bool isCompressed() const throw() {
+            return compressor!=NULL;
+        }
+        
         // get the index of the next packet to write
         uword32 getNextIndex();
         
         // write another packet.
         void writePacket(VPacket *packet);
         
+        // write a packet that is already serialized, for example one
+        // returned by VBankFileReader::readRawPacket().  the bytes are
+        // copied without being parsed, so it is up to the caller to make
+        // sure that the event numbers in the banks agree with
+        // getNextIndex().
+        void writeRawPacket(const char *buf,uword32 len);
+        
         // write an empty packet
         void writeEmptyPacket();
         
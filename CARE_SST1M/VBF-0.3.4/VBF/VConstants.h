@@ -10,6 +10,16 @@
 #define V_NUM_TELESCOPES                    7
 #define V_ARRAY_TRIGGER_NODE                255
 
+// VBF file versions: packets stored as they are, or each packet stored
+// as an independently compressed block
+#define V_BANK_FILE_VERSION                 0
+#define V_BANK_FILE_COMPRESSED_VERSION      1
+
+// how the blocks of a compressed VBF file are compressed
+#define V_BANK_FILE_NO_COMPRESSION          0
+#define V_BANK_FILE_ZLIB_COMPRESSION        1
+#define V_BANK_FILE_BZIP2_COMPRESSION       2
+
 #endif
 
 // **************************************************************************
@@ -7,6 +7,7 @@
 #include "VWordParsing.h"
 #include "VSampleCompressor.h"
 #include "VSampleDecompressor.h"
+#include "VZeroSuppressor.h"
 
 #include <typeinfo>
 #include <iostream>
@@ -256,10 +257,7 @@ void VEvent::buildCS() const {
     VSampleCompressor sc(numSamples,numChannels);
     for (unsigned i=0;i<numChannels;++i) {
 	ubyte *trace=samples+i*numSamples;
-	unsigned charge=0;
-	for (unsigned j=numSamples;j-->0;) {
-	    charge+=trace[j];
-	}
+	unsigned charge=VZeroSuppressor::traceCharge(trace,numSamples);
 	bool xtra_bit=false;
 	if (pedsAndHiLo[i]!=0 || charges[i]!=charge) {
 	    xtra_bit=true;
@@ -9,6 +9,14 @@
 #include "VException.h"
 #include <iostream>
 #include <inttypes.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 class VSampleCompressor {
 private:
@@ -34,6 +42,127 @@ private:
     uint8_t &at(unsigned i) {
         return buffer[i];
     }
+    
+    // find the smallest and the largest sample of a trace
+    static void minMax(const uint8_t *trace,
+                       unsigned num_samples,
+                       unsigned &min,
+                       unsigned &max) {
+        unsigned j=0;
+        uint8_t lo=255;
+        uint8_t hi=0;
+#ifdef __SSE2__
+        if (num_samples>=16) {
+            __m128i vlo=_mm_set1_epi8((char)0xff);
+            __m128i vhi=_mm_setzero_si128();
+#ifdef __AVX2__
+            if (num_samples>=32) {
+                __m256i wlo=_mm256_set1_epi8((char)0xff);
+                __m256i whi=_mm256_setzero_si256();
+                for (;j+32<=num_samples;j+=32) {
+                    __m256i v=_mm256_loadu_si256((const __m256i*)(trace+j));
+                    wlo=_mm256_min_epu8(wlo,v);
+                    whi=_mm256_max_epu8(whi,v);
+                }
+                vlo=_mm_min_epu8(_mm256_castsi256_si128(wlo),
+                                 _mm256_extracti128_si256(wlo,1));
+                vhi=_mm_max_epu8(_mm256_castsi256_si128(whi),
+                                 _mm256_extracti128_si256(whi,1));
+            }
+#endif
+            for (;j+16<=num_samples;j+=16) {
+                __m128i v=_mm_loadu_si128((const __m128i*)(trace+j));
+                vlo=_mm_min_epu8(vlo,v);
+                vhi=_mm_max_epu8(vhi,v);
+            }
+            vlo=_mm_min_epu8(vlo,_mm_srli_si128(vlo,8));
+            vlo=_mm_min_epu8(vlo,_mm_srli_si128(vlo,4));
+            vlo=_mm_min_epu8(vlo,_mm_srli_si128(vlo,2));
+            vlo=_mm_min_epu8(vlo,_mm_srli_si128(vlo,1));
+            vhi=_mm_max_epu8(vhi,_mm_srli_si128(vhi,8));
+            vhi=_mm_max_epu8(vhi,_mm_srli_si128(vhi,4));
+            vhi=_mm_max_epu8(vhi,_mm_srli_si128(vhi,2));
+            vhi=_mm_max_epu8(vhi,_mm_srli_si128(vhi,1));
+            lo=(uint8_t)_mm_cvtsi128_si32(vlo);
+            hi=(uint8_t)_mm_cvtsi128_si32(vhi);
+        }
+#endif
+        for (;j<num_samples;++j) {
+            if (trace[j]<lo) {
+                lo=trace[j];
+            }
+            if (trace[j]>hi) {
+                hi=trace[j];
+            }
+        }
+        min=lo;
+        max=hi;
+    }
+    
+    // squeeze the eight samples in the bytes of x (first sample in the
+    // lowest byte), each of which fits into bits bits, into the lowest
+    // 8*bits bits of the result, first sample in the lowest bits.  this
+    // is exactly the byte layout that the bit widths 1 to 4 use for
+    // every eight samples.
+    static uint64_t packWord(uint64_t x,
+                             unsigned bits) {
+        x=(x&0x00ff00ff00ff00ffULL)|((x&0xff00ff00ff00ff00ULL)>>(8-bits));
+        x=(x&0x0000ffff0000ffffULL)|((x&0xffff0000ffff0000ULL)>>(16-2*bits));
+        x=(x&0x00000000ffffffffULL)|((x&0xffffffff00000000ULL)>>(32-4*bits));
+        return x;
+    }
+    
+    // pack all complete groups of eight samples, bits bytes per group.
+    // returns the number of samples packed.
+    unsigned packGroups(const uint8_t *trace,
+                        unsigned bits,
+                        unsigned min) {
+        unsigned n=num_samples&~7;
+        unsigned i=0;
+#ifdef __SSE2__
+        __m128i vmin=_mm_set1_epi8((char)min);
+        __m128i shift1=_mm_cvtsi32_si128(8-bits);
+        __m128i shift2=_mm_cvtsi32_si128(16-2*bits);
+        __m128i shift4=_mm_cvtsi32_si128(32-4*bits);
+        __m128i mask1=_mm_set1_epi16(0x00ff);
+        __m128i mask2=_mm_set1_epi32(0x0000ffff);
+        __m128i mask4=_mm_set_epi32(0,-1,0,-1);
+        uint8_t tmp[16];
+        for (;i+16<=n;i+=16) {
+            __m128i x=_mm_sub_epi8(_mm_loadu_si128((const __m128i*)(trace+i)),
+                                   vmin);
+            x=_mm_or_si128(_mm_and_si128(x,mask1),
+                           _mm_srl_epi64(_mm_andnot_si128(mask1,x),shift1));
+            x=_mm_or_si128(_mm_and_si128(x,mask2),
+                           _mm_srl_epi64(_mm_andnot_si128(mask2,x),shift2));
+            x=_mm_or_si128(_mm_and_si128(x,mask4),
+                           _mm_srl_epi64(_mm_andnot_si128(mask4,x),shift4));
+            _mm_storeu_si128((__m128i*)tmp,x);
+            memcpy(cur,tmp,bits);
+            memcpy(cur+bits,tmp+8,bits);
+            cur+=2*bits;
+        }
+#endif
+        uint64_t mins=min*0x0101010101010101ULL;
+        for (;i<n;i+=8) {
+            uint64_t x=0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__==__ORDER_LITTLE_ENDIAN__
+            memcpy(&x,trace+i,8);
+            x=packWord(x-mins,bits);
+            memcpy(cur,&x,bits);
+            cur+=bits;
+#else
+            for (unsigned k=0;k<8;++k) {
+                x|=((uint64_t)trace[i+k])<<(8*k);
+            }
+            x=packWord(x-mins,bits);
+            for (unsigned k=0;k<bits;++k) {
+                push_back((uint8_t)(x>>(8*k)));
+            }
+#endif
+        }
+        return n;
+    }
 
 public:
     VSampleCompressor(unsigned num_samples,
@@ -76,16 +205,10 @@ public:
     template< typename I >
     void add(I trace,
              bool xtra_bit) {
-        unsigned min=255;
-        unsigned max=0;
-        for (unsigned j=0;j<num_samples;++j) {
-            if (trace[j]<min) {
-                min=trace[j];
-            }
-            if (trace[j]>max) {
-                max=trace[j];
-            }
-        }
+        const uint8_t *samples=num_samples>0?&trace[0]:NULL;
+        unsigned min;
+        unsigned max;
+        minMax(samples,num_samples,min,max);
         unsigned range;
         if (min>20) {
             min=20;
@@ -121,17 +244,7 @@ public:
         switch (bits) {
         case 0: break;
         case 1: {
-            unsigned n=num_samples&~7;
-            for (unsigned i=0;i<n;i+=8) {
-                push_back(((trace[i+0]-min)<<0)|
-                          ((trace[i+1]-min)<<1)|
-                          ((trace[i+2]-min)<<2)|
-                          ((trace[i+3]-min)<<3)|
-                          ((trace[i+4]-min)<<4)|
-                          ((trace[i+5]-min)<<5)|
-                          ((trace[i+6]-min)<<6)|
-                          ((trace[i+7]-min)<<7));
-            }
+            unsigned n=packGroups(samples,bits,min);
             if (n!=num_samples) {
                 push_back(((trace[n+0]-min)<<0)|
                           ((trace[n+1]-min)<<1)|
@@ -142,7 +255,7 @@ public:
             break;
         }
         case 2: {
-            for (unsigned i=0;i<num_samples;i+=4) {
+            for (unsigned i=packGroups(samples,bits,min);i<num_samples;i+=4) {
                 push_back(((trace[i+0]-min)<<0)|
                           ((trace[i+1]-min)<<2)|
                           ((trace[i+2]-min)<<4)|
@@ -151,19 +264,7 @@ public:
             break;
         }
         case 3: {
-            unsigned n=num_samples&~7;
-            for (unsigned i=0;i<n;i+=8) {
-                push_back(((trace[i+0]-min)<<0)|
-                          ((trace[i+1]-min)<<3)|
-                          (((trace[i+2]-min)&3)<<6));
-                push_back((((trace[i+2]-min)>>2)&1)|
-                          ((trace[i+3]-min)<<1)|
-                          ((trace[i+4]-min)<<4)|
-                          (((trace[i+5]-min)&1)<<7));
-                push_back((((trace[i+5]-min)>>1)&3)|
-                          ((trace[i+6]-min)<<2)|
-                          ((trace[i+7]-min)<<5));
-            }
+            unsigned n=packGroups(samples,bits,min);
             if (n!=num_samples) {
                 push_back(((trace[n+0]-min)<<0)|
                           ((trace[n+1]-min)<<3)|
@@ -175,15 +276,16 @@ public:
             break;
         }
         case 4: {
-            for (unsigned i=0;i<num_samples;i+=2) {
+            for (unsigned i=packGroups(samples,bits,min);i<num_samples;i+=2) {
                 push_back(((trace[i+0]-min)<<0)|
                           ((trace[i+1]-min)<<4));
             }
             break;
         }
         case 5: {
-            for (unsigned i=0;i<num_samples;++i) {
-                push_back(trace[i]);
+            if (num_samples>0) {
+                memcpy(cur,samples,num_samples);
+                cur+=num_samples;
             }
             break;
         }
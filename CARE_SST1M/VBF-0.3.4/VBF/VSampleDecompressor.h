@@ -10,6 +10,11 @@
 #include <inttypes.h>
 #include <iostream>
 #include <algorithm>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 class VSampleDecompressor {
 private:
@@ -18,6 +23,103 @@ private:
     bool hanging_4;
     unsigned num_samples;
     
+    // the inverse of VSampleCompressor::packWord(): spread the lowest
+    // 8*bits bits of x over the eight bytes of the result, one sample
+    // per byte, first sample in the lowest byte
+    static uint64_t unpackWord(uint64_t x,
+                               unsigned bits) {
+        uint64_t m4=(1ULL<<(4*bits))-1;
+        uint64_t m2=((1ULL<<(2*bits))-1)*0x0000000100000001ULL;
+        uint64_t m1=((1ULL<<bits)-1)*0x0001000100010001ULL;
+        x=(x&m4)|((x<<(32-4*bits))&(m4<<32));
+        x=(x&m2)|((x<<(16-2*bits))&(m2<<16));
+        x=(x&m1)|((x<<(8-bits))&(m1<<8));
+        return x;
+    }
+    
+    // get the bits bytes of a group.  the bytes above them do not
+    // matter to unpackWord(), so if we may read up to limit, we simply
+    // load eight bytes.
+    static uint64_t loadGroup(const uint8_t *buf,
+                              const uint8_t *limit,
+                              unsigned bits) {
+        uint64_t x=0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__==__ORDER_LITTLE_ENDIAN__
+        if (limit-buf>=8) {
+            memcpy(&x,buf,8);
+            return x;
+        }
+#endif
+        for (unsigned k=0;k<bits;++k) {
+            x|=((uint64_t)buf[k])<<(8*k);
+        }
+        return x;
+    }
+    
+    // unpack the given number of complete groups of eight samples,
+    // bits bytes per group
+    template< typename T >
+    static void unpackGroups(const uint8_t *buf,
+                             const uint8_t *limit,
+                             unsigned groups,
+                             unsigned bits,
+                             unsigned min,
+                             T &targ) {
+        uint64_t mins=min*0x0101010101010101ULL;
+        for (unsigned g=0;g<groups;++g) {
+            uint64_t x=unpackWord(loadGroup(buf+g*bits,limit,bits),bits)+mins;
+            for (unsigned k=0;k<8;++k) {
+                *targ++=(uint8_t)(x>>(8*k));
+            }
+        }
+    }
+    
+    static void unpackGroups(const uint8_t *buf,
+                             const uint8_t *limit,
+                             unsigned groups,
+                             unsigned bits,
+                             unsigned min,
+                             uint8_t *&targ) {
+        unsigned g=0;
+#ifdef __SSE2__
+        __m128i vmin=_mm_set1_epi8((char)min);
+        __m128i shift1=_mm_cvtsi32_si128(8-bits);
+        __m128i shift2=_mm_cvtsi32_si128(16-2*bits);
+        __m128i shift4=_mm_cvtsi32_si128(32-4*bits);
+        __m128i m1=_mm_set1_epi16((short)((1<<bits)-1));
+        __m128i m2=_mm_set1_epi32((1<<(2*bits))-1);
+        __m128i m4=_mm_set_epi32(0,(1<<(4*bits))-1,0,(1<<(4*bits))-1);
+        for (;g+2<=groups;g+=2) {
+            __m128i x=_mm_set_epi64x(
+                (long long)loadGroup(buf+(g+1)*bits,limit,bits),
+                (long long)loadGroup(buf+g*bits,limit,bits));
+            x=_mm_or_si128(_mm_and_si128(x,m4),
+                           _mm_and_si128(_mm_sll_epi64(x,shift4),
+                                         _mm_slli_epi64(m4,32)));
+            x=_mm_or_si128(_mm_and_si128(x,m2),
+                           _mm_and_si128(_mm_sll_epi64(x,shift2),
+                                         _mm_slli_epi32(m2,16)));
+            x=_mm_or_si128(_mm_and_si128(x,m1),
+                           _mm_and_si128(_mm_sll_epi64(x,shift1),
+                                         _mm_slli_epi16(m1,8)));
+            _mm_storeu_si128((__m128i*)targ,_mm_add_epi8(x,vmin));
+            targ+=16;
+        }
+#endif
+        uint64_t mins=min*0x0101010101010101ULL;
+        for (;g<groups;++g) {
+            uint64_t x=unpackWord(loadGroup(buf+g*bits,limit,bits),bits)+mins;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__==__ORDER_LITTLE_ENDIAN__
+            memcpy(targ,&x,8);
+            targ+=8;
+#else
+            for (unsigned k=0;k<8;++k) {
+                *targ++=(uint8_t)(x>>(8*k));
+            }
+#endif
+        }
+    }
+    
 public:
     VSampleDecompressor(unsigned num_samples,
                         uint8_t *cur,
@@ -122,18 +224,12 @@ public:
             }
             V_ASSERT(cur+n<=end);
             cur+=n;
+            // every eight samples take up bits bytes
+            unsigned groups=num_samples/8;
+            unpackGroups(buf,buf==bounce?bounce+num_samples:end,
+                         groups,bits,min,targ);
             switch (bits) {
             case 1: {
-                for (unsigned i=0;i<n;++i) {
-                    *targ++=min+((buf[i]>>0)&1);
-                    *targ++=min+((buf[i]>>1)&1);
-                    *targ++=min+((buf[i]>>2)&1);
-                    *targ++=min+((buf[i]>>3)&1);
-                    *targ++=min+((buf[i]>>4)&1);
-                    *targ++=min+((buf[i]>>5)&1);
-                    *targ++=min+((buf[i]>>6)&1);
-                    *targ++=min+((buf[i]>>7)&1);
-                }
                 if (num_samples&4) {
                     *targ++=min+((buf[n]>>0)&1);
                     *targ++=min+((buf[n]>>1)&1);
@@ -143,7 +239,7 @@ public:
                 break;
             }
             case 2: {
-                for (unsigned i=0;i<n;++i) {
+                for (unsigned i=groups*2;i<n;++i) {
                     *targ++=min+((buf[i]>>0)&3);
                     *targ++=min+((buf[i]>>2)&3);
                     *targ++=min+((buf[i]>>4)&3);
@@ -152,16 +248,6 @@ public:
                 break;
             }
             case 3: {
-                for (unsigned i=0;i+2<n;i+=3) {
-                    *targ++=min+((buf[i+0]>>0)&7);
-                    *targ++=min+((buf[i+0]>>3)&7);
-                    *targ++=min+(((buf[i+0]>>6)&3)|((buf[i+1]&1)<<2));
-                    *targ++=min+((buf[i+1]>>1)&7);
-                    *targ++=min+((buf[i+1]>>4)&7);
-                    *targ++=min+(((buf[i+1]>>7)&1)|((buf[i+2]&3)<<1));
-                    *targ++=min+((buf[i+2]>>2)&7);
-                    *targ++=min+((buf[i+2]>>5)&7);
-                }
                 if (num_samples&4) {
                     *targ++=min+((buf[n-1]>>0)&7);
                     *targ++=min+((buf[n-1]>>3)&7);
@@ -171,7 +257,7 @@ public:
                 break;
             }
             case 4: {
-                for (unsigned i=0;i<n;++i) {
+                for (unsigned i=groups*4;i<n;++i) {
                     *targ++=min+((buf[i]>>0)&15);
                     *targ++=min+((buf[i]>>4)&15);
                 }
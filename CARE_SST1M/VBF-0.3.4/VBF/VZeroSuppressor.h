@@ -0,0 +1,203 @@
+/*
+ * VZeroSuppressor.h -- software zero-suppression of FADC traces
+ */
+
+#ifndef V_ZERO_SUPPRESSOR_H
+#define V_ZERO_SUPPRESSOR_H
+
+#include "VDatum.h"
+#include <inttypes.h>
+#include <string.h>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// a channel is kept if its hi/lo bit is set or if any of its samples is at
+// or above the channel's threshold.  the traces are expected the way VEvent
+// stores them: num_samples samples per channel, one channel after the other.
+class VZeroSuppressor {
+public:
+    // threshold of a channel that is suppressed no matter what its samples
+    // and its hi/lo bit are
+    static const unsigned ALWAYS_SUPPRESS=0xffffffffu;
+
+    // the largest sample of a trace
+    static unsigned traceMax(const uint8_t *trace,
+                             unsigned num_samples) {
+        unsigned j=0;
+        uint8_t hi=0;
+#ifdef __SSE2__
+        if (num_samples>=16) {
+            __m128i vhi=_mm_setzero_si128();
+            for (;j+16<=num_samples;j+=16) {
+                vhi=_mm_max_epu8(vhi,
+                                 _mm_loadu_si128((const __m128i*)(trace+j)));
+            }
+            vhi=_mm_max_epu8(vhi,_mm_srli_si128(vhi,8));
+            vhi=_mm_max_epu8(vhi,_mm_srli_si128(vhi,4));
+            vhi=_mm_max_epu8(vhi,_mm_srli_si128(vhi,2));
+            vhi=_mm_max_epu8(vhi,_mm_srli_si128(vhi,1));
+            hi=(uint8_t)_mm_cvtsi128_si32(vhi);
+        }
+#endif
+        for (;j<num_samples;++j) {
+            if (trace[j]>hi) {
+                hi=trace[j];
+            }
+        }
+        return hi;
+    }
+
+    // the sum of the samples of a trace, which is the charge that VEvent
+    // expects unless it is told otherwise
+    static unsigned traceCharge(const uint8_t *trace,
+                                unsigned num_samples) {
+        unsigned j=0;
+        unsigned charge=0;
+#ifdef __SSE2__
+        if (num_samples>=16) {
+            __m128i zero=_mm_setzero_si128();
+            __m128i sum=_mm_setzero_si128();
+            for (;j+16<=num_samples;j+=16) {
+                sum=_mm_add_epi64(sum,
+                    _mm_sad_epu8(_mm_loadu_si128((const __m128i*)(trace+j)),
+                                 zero));
+            }
+            sum=_mm_add_epi64(sum,_mm_srli_si128(sum,8));
+            charge=(unsigned)_mm_cvtsi128_si32(sum);
+        }
+#endif
+        for (;j<num_samples;++j) {
+            charge+=trace[j];
+        }
+        return charge;
+    }
+
+    // decide which of the num_channels traces in samples survive.
+    // thresholds holds one threshold per trace and hi_lo (which may be
+    // NULL) one hi/lo bit per trace.  kept receives one flag per trace.
+    // returns the number of traces kept.
+    static unsigned select(const uint8_t *samples,
+                           unsigned num_samples,
+                           unsigned num_channels,
+                           const unsigned *thresholds,
+                           const bool *hi_lo,
+                           bool *kept) {
+        unsigned num_kept=0;
+        for (unsigned i=0;i<num_channels;++i,samples+=num_samples) {
+            kept[i]=false;
+            if (thresholds[i]==ALWAYS_SUPPRESS) {
+                continue;
+            }
+            if ((hi_lo!=NULL && hi_lo[i])
+                || (num_samples>0 && thresholds[i]<=255
+                    && traceMax(samples,num_samples)>=thresholds[i])) {
+                kept[i]=true;
+                num_kept++;
+            }
+        }
+        return num_kept;
+    }
+
+    // zero-suppress an event in place.  thresholds holds one threshold per
+    // channel number (the numbering of the hit pattern); channels beyond
+    // its end are always suppressed.  the data of the kept channels is
+    // moved down, the hit bits of the others are cleared and the channel
+    // data is shrunk.  returns the number of channels kept.
+    static unsigned suppress(VEvent *event,
+                             const std::vector< unsigned > &thresholds) {
+        unsigned num_samples=event->getNumSamples();
+        unsigned num_channels=event->getNumChannels();
+        if (num_channels==0) {
+            return 0;
+        }
+
+        // thresholds and hi/lo bits of the channels that have data
+        std::vector< unsigned > chan_thresholds(num_channels,
+                                                (unsigned)ALWAYS_SUPPRESS);
+        std::vector< unsigned > chan_numbers(num_channels,0);
+        bool *hi_lo=new bool[2*num_channels];
+        bool *kept=hi_lo+num_channels;
+        for (unsigned k=0,l=0;
+             k<event->getMaxNumChannels() && l<num_channels;
+             ++k) {
+            if (event->getHitBit(k)) {
+                if (k<thresholds.size()) {
+                    chan_thresholds[l]=thresholds[k];
+                }
+                chan_numbers[l]=k;
+                hi_lo[l]=event->getHiLo(l);
+                ++l;
+            }
+        }
+
+        const VEvent *const_event=event;
+        unsigned num_kept=select(const_event->getSamplePtr(0,0),
+                                 num_samples,
+                                 num_channels,
+                                 &chan_thresholds[0],
+                                 hi_lo,
+                                 kept);
+
+        if (num_kept!=num_channels) {
+            for (unsigned l=0,m=0;l<num_channels;++l) {
+                if (!kept[l]) {
+                    event->setHitBit(chan_numbers[l],false);
+                    continue;
+                }
+                if (m!=l) {
+                    if (num_samples>0) {
+                        memcpy(event->getSamplePtr(m,0),
+                               const_event->getSamplePtr(l,0),
+                               num_samples);
+                    }
+                    event->setCharge(m,event->getCharge(l));
+                    event->setPedestalAndHiLo(m,
+                                              event->getPedestalAndHiLo(l));
+                }
+                ++m;
+            }
+            event->resizeChannelData(num_samples,num_kept);
+        }
+
+        delete[] hi_lo;
+        return num_kept;
+    }
+};
+
+#endif
+
+
+// **************************************************************************
+// Copyright (c) 2001, 2002, 2003, 2004, 2005, 2006, 2007, 2008, 2009, 2010,
+// 2011, 2012 Purdue University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//  this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//  this list of conditions and the following disclaimer in the documentation
+//  and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// The views and conclusions contained in the software and documentation are
+// those of the authors and should not be interpreted as representing official
+// policies, either expressed or implied, of Purdue University or the VERITAS
+// Collaboration.
+// **************************************************************************
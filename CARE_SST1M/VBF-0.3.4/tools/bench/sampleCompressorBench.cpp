@@ -0,0 +1,197 @@
+/*
+ * sampleCompressorBench.cpp -- checks and times VSampleCompressor and
+ * VSampleDecompressor against the byte-wise reference copies in
+ * VSampleCompressorRef.h and VSampleDecompressorRef.h.
+ *
+ * Random events (4-128 samples, 1-40 channels, all bit widths, random hi/lo
+ * bits) are compressed with both compressors, which have to give the same
+ * bytes, and decoded with both decompressors (pointer and iterator targets),
+ * which have to give back the original samples.  Then both are timed on
+ * events of 1296 channels with 52, 64 and 100 samples.
+ *
+ * build and run from this directory:
+ *   g++ -O2 -I../.. -I../../VBF sampleCompressorBench.cpp ../../VBF/VException.cpp \
+ *       -o sampleCompressorBench
+ *   ./sampleCompressorBench
+ * add -mavx2 or -mno-sse2 to check the other code paths.
+ */
+
+#include "VBF/VSampleCompressor.h"
+#include "VBF/VSampleDecompressor.h"
+#include "VSampleCompressorRef.h"
+#include "VSampleDecompressorRef.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <vector>
+
+using namespace std;
+
+static double now() {
+    timeval t;
+    gettimeofday(&t,NULL);
+    return t.tv_sec+1e-6*t.tv_usec;
+}
+
+// samples of num_channels channels with random ranges, so that every bit
+// width of the encoding is used
+static void fill(unsigned num_samples,
+                 unsigned num_channels,
+                 vector<uint8_t> &samples,
+                 vector<bool> &hi_lo) {
+    samples.resize(num_samples*num_channels);
+    hi_lo.resize(num_channels);
+    for (unsigned i=0;i<num_channels;++i) {
+        unsigned range=rand()%7;
+        unsigned span=(range==0?0:(1u<<(range-1)));
+        if (range==6) {
+            span=200;
+        }
+        unsigned base=rand()%40;
+        hi_lo[i]=rand()%2;
+        for (unsigned j=0;j<num_samples;++j) {
+            unsigned v=base+(span?rand()%(span+1):0);
+            samples[i*num_samples+j]=(v>255?255:v);
+        }
+    }
+}
+
+template< typename Compressor >
+static vector<uint8_t> compress(unsigned num_samples,
+                                unsigned num_channels,
+                                const vector<uint8_t> &samples,
+                                const vector<bool> &hi_lo) {
+    Compressor c(num_samples,num_channels);
+    for (unsigned i=0;i<num_channels;++i) {
+        c.add(&samples[i*num_samples],hi_lo[i]);
+    }
+    return vector<uint8_t>(c.begin(),c.end());
+}
+
+template< typename Decompressor >
+static void decompress(unsigned num_samples,
+                       unsigned num_channels,
+                       vector<uint8_t> &buffer,
+                       size_t size,
+                       vector<uint8_t> &samples,
+                       vector<bool> &hi_lo) {
+    Decompressor d(num_samples,&buffer[0],&buffer[0]+size);
+    samples.resize(num_samples*num_channels);
+    hi_lo.resize(num_channels);
+    for (unsigned i=0;i<num_channels;++i) {
+        bool b;
+        d.get(&samples[i*num_samples],b);
+        hi_lo[i]=b;
+    }
+}
+
+// same, through the generic iterator version of get()
+static void decompressIter(unsigned num_samples,
+                           unsigned num_channels,
+                           vector<uint8_t> &buffer,
+                           size_t size,
+                           vector<uint8_t> &samples,
+                           vector<bool> &hi_lo) {
+    VSampleDecompressor d(num_samples,&buffer[0],&buffer[0]+size);
+    vector<uint8_t> trace(num_samples);
+    samples.resize(num_samples*num_channels);
+    hi_lo.resize(num_channels);
+    for (unsigned i=0;i<num_channels;++i) {
+        bool b;
+        d.get(trace.begin(),b);
+        memcpy(&samples[i*num_samples],&trace[0],num_samples);
+        hi_lo[i]=b;
+    }
+}
+
+int main() {
+    unsigned bad=0;
+
+    for (unsigned n=0;n<2000;++n) {
+        unsigned num_samples=4*(1+rand()%32);
+        unsigned num_channels=1+rand()%40;
+        vector<uint8_t> samples;
+        vector<bool> hi_lo;
+        fill(num_samples,num_channels,samples,hi_lo);
+
+        vector<uint8_t> ref=
+            compress<VSampleCompressorRef>(num_samples,num_channels,samples,hi_lo);
+        vector<uint8_t> cur=
+            compress<VSampleCompressor>(num_samples,num_channels,samples,hi_lo);
+        if (ref!=cur) {
+            printf("compress mismatch: %u samples, %u channels\n",
+                   num_samples,num_channels);
+            ++bad;
+            continue;
+        }
+
+        // the decompressors may read a few bytes past the end
+        size_t size=ref.size();
+        ref.resize(size+8);
+
+        vector<uint8_t> s1,s2,s3;
+        vector<bool> h1,h2,h3;
+        decompress<VSampleDecompressorRef>(num_samples,num_channels,ref,size,s1,h1);
+        decompress<VSampleDecompressor>(num_samples,num_channels,ref,size,s2,h2);
+        decompressIter(num_samples,num_channels,ref,size,s3,h3);
+        if (s1!=s2 || s1!=s3 || h1!=h2 || h1!=h3) {
+            printf("decompress mismatch: %u samples, %u channels\n",
+                   num_samples,num_channels);
+            ++bad;
+        }
+        if (s2!=samples || h2!=hi_lo) {
+            printf("round trip mismatch: %u samples, %u channels\n",
+                   num_samples,num_channels);
+            ++bad;
+        }
+    }
+    printf("mismatches: %u\n",bad);
+
+    unsigned num_channels=1296;
+    unsigned ns[3]={52,64,100};
+    unsigned num_events=300;
+    for (unsigned k=0;k<3;++k) {
+        unsigned num_samples=ns[k];
+        vector<uint8_t> samples;
+        vector<bool> hi_lo;
+        fill(num_samples,num_channels,samples,hi_lo);
+
+        size_t total=0;
+        double t0=now();
+        for (unsigned i=0;i<num_events;++i) {
+            total+=compress<VSampleCompressorRef>(num_samples,num_channels,samples,hi_lo).size();
+        }
+        double t1=now();
+        for (unsigned i=0;i<num_events;++i) {
+            total+=compress<VSampleCompressor>(num_samples,num_channels,samples,hi_lo).size();
+        }
+        double t2=now();
+
+        vector<uint8_t> buffer=
+            compress<VSampleCompressor>(num_samples,num_channels,samples,hi_lo);
+        size_t size=buffer.size();
+        buffer.resize(size+8);
+        vector<uint8_t> out;
+        vector<bool> out_hi_lo;
+        double t3=now();
+        for (unsigned i=0;i<num_events;++i) {
+            decompress<VSampleDecompressorRef>(num_samples,num_channels,buffer,size,out,out_hi_lo);
+        }
+        double t4=now();
+        for (unsigned i=0;i<num_events;++i) {
+            decompress<VSampleDecompressor>(num_samples,num_channels,buffer,size,out,out_hi_lo);
+        }
+        double t5=now();
+
+        printf("%u channels, %u samples (us per event, reference -> current): "
+               "compress %.1f -> %.1f, decompress %.1f -> %.1f (%lu bytes)\n",
+               num_channels,num_samples,
+               (t1-t0)/num_events*1e6,(t2-t1)/num_events*1e6,
+               (t4-t3)/num_events*1e6,(t5-t4)/num_events*1e6,
+               (unsigned long)(total/(2*num_events)));
+    }
+
+    return bad==0?0:1;
+}
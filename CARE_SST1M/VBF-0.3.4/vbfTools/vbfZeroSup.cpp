@@ -5,11 +5,13 @@
 
 #include "VBF/VBankFileReader.h"
 #include "VBF/VBankFileWriter.h"
+#include "VBF/VZeroSuppressor.h"
 
 #include <math.h>
 #include <iostream>
 #include <stdlib.h>
 #include <map>
+#include <vector>
 
 using namespace std;
 
@@ -54,7 +56,8 @@ int main(int c,char **v) {
 	    usage();
 	}
 
-	map< unsigned, map< unsigned, unsigned > > thresholds;
+	// per telescope, the threshold of each channel
+	map< unsigned, vector< unsigned > > thresholds;
 
 	FILE *flin=fopen(v[optind],"r");
 	if (flin==NULL) {
@@ -72,7 +75,11 @@ int main(int c,char **v) {
 		cerr<<"Parse error in "<<v[optind]<<endl;
 		return 1;
 	    }
-	    thresholds[tele][chan]=(unsigned)ceil(threshold);
+	    vector< unsigned > &chans=thresholds[tele];
+	    if (chans.size()<=chan) {
+		chans.resize(chan+1,(unsigned)VZeroSuppressor::ALWAYS_SUPPRESS);
+	    }
+	    chans[chan]=(unsigned)ceil(threshold);
 	}
 
 	VBankFileReader reader(v[optind+1],false,true);
@@ -97,62 +104,18 @@ int main(int c,char **v) {
 			 ++j) {
 			VEvent *ev=ae->getEventAt(j);
 			
-			map< unsigned, map< unsigned, unsigned > >::iterator
+			map< unsigned, vector< unsigned > >::iterator
 			    iter=thresholds.find(ev->getNodeNumber());
 			
-			unsigned num_kept=0;
-			vector< bool > kept(ev->getMaxNumChannels(),false);
-			for (unsigned k=0,l=0;k<ev->getMaxNumChannels();++k) {
-			    if (ev->getHitBit(k)) {
-				map< unsigned, unsigned >::iterator
-				    iter2=iter->second.find(k);
-				if (iter2!=iter->second.end()) {
-				    bool over=false;
-				    if (ev->getHiLo(l)) {
-					over=true;
-				    } else {
-					for (int m=ev->getNumSamples();
-					     m-->0;) {
-					    if (ev->getSample(l,m)
-						>=iter2->second) {
-						over=true;
-						break;
-					    }
-					}
-				    }
-				    if (over) {
-					kept[k]=true;
-					num_kept++;
-				    }
-				}
-				++l;
-			    }
+			unsigned num_kept;
+			if (iter==thresholds.end()) {
+			    num_kept=VZeroSuppressor::suppress(ev,vector< unsigned >());
+			} else {
+			    num_kept=VZeroSuppressor::suppress(ev,iter->second);
 			}
 
 			n++;
 			sum+=num_kept;
-			
-			VEvent *newEv=ev->copyEvent();
-			newEv->resizeChannelData(newEv->getNumSamples(),
-						 num_kept);
-			for (unsigned k=0,l=0,m=0;k<ev->getMaxNumChannels();++k) {
-			    if (ev->getHitBit(k)) {
-				if (kept[k]) {
-				    newEv->setCharge(m,ev->getCharge(l));
-				    newEv->setPedestalAndHiLo(m,ev->getPedestalAndHiLo(m));
-				    memcpy(newEv->getSamplePtr(m,0),
-					   ev->getSamplePtr(l,0),
-					   ev->getNumSamples());
-				    ++m;
-				}
-				++l;
-			    }
-			    newEv->setHitBit(k,kept[k]);
-			}
-			
-			//cerr<<"flags = "<<newEv->getFlags()<<", compressed = "<<newEv->getCompressedBit()<<endl;
-
-			ae->replaceEventAt(j,newEv);
 		    }
 		}
 	    }
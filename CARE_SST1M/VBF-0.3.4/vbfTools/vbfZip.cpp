@@ -1,5 +1,6 @@
 /*
  * vbfZip.cpp -- compresses a VBF file by applying sample compression
+ *               and/or by storing its packets as compressed blocks
  * by Filip Pizlo, 2005
  */
 
@@ -8,48 +9,120 @@
 
 #include <iostream>
 #include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <vector>
 
 using namespace std;
 
 static void usage() {
-    cerr<<"Usage: vbfZip comp|decomp <in filename> <out filename>"<<endl;
+    cerr<<"Usage: vbfZip [-z|-j|-u] [-t <threads>] [-l <level>] comp|decomp|copy"<<endl;
+    cerr<<"           <in filename> <out filename>"<<endl;
     cerr<<"Description:"<<endl;
     cerr<<"Compresses (or decompresses) a VBF file by applying sample compression."<<endl;
+    cerr<<"With copy, the samples are left as they are.  With -z (zlib) or -j (bzip2),"<<endl;
+    cerr<<"each packet of the output file is stored as a compressed block; such a file"<<endl;
+    cerr<<"can still be read in any order by the VBF library.  -u writes the packets as"<<endl;
+    cerr<<"they are (the default), which also turns a file with compressed blocks back"<<endl;
+    cerr<<"into a plain one.  The blocks are compressed by <threads> threads (default:"<<endl;
+    cerr<<"one per processor) at the given compression level (default: that of the"<<endl;
+    cerr<<"compression library)."<<endl;
     exit(1);
 }
 
 int main(int c,char **v) {
     try {
-	if (c!=4) {
+	uword32 method=V_BANK_FILE_NO_COMPRESSION;
+	long numThreads=sysconf(_SC_NPROCESSORS_ONLN);
+	int level=-1;
+	
+	int optCh;
+	while ((optCh=getopt(c,v,"zjut:l:"))!=-1) {
+	    switch (optCh) {
+	    case 'z':
+		method=V_BANK_FILE_ZLIB_COMPRESSION;
+		break;
+	    case 'j':
+		method=V_BANK_FILE_BZIP2_COMPRESSION;
+		break;
+	    case 'u':
+		method=V_BANK_FILE_NO_COMPRESSION;
+		break;
+	    case 't':
+		if (sscanf(optarg,"%ld",&numThreads)!=1 || numThreads<0) {
+		    cerr<<optarg<<" is not a valid number of threads."<<endl;
+		    return 1;
+		}
+		break;
+	    case 'l':
+		if (sscanf(optarg,"%d",&level)!=1) {
+		    cerr<<optarg<<" is not a valid compression level."<<endl;
+		    return 1;
+		}
+		break;
+	    default:
+		usage();
+		break;
+	    }
+	}
+	
+	if (optind+3!=c) {
 	    usage();
 	}
 	
 	bool compBit=false;
+	bool copy=false;
 	
-	if (!strcasecmp(v[1],"comp")) {
+	if (!strcasecmp(v[optind],"comp")) {
 	    compBit=true;
-	} else if (!strcasecmp(v[1],"decomp")) {
+	} else if (!strcasecmp(v[optind],"decomp")) {
 	    compBit=false;
+	} else if (!strcasecmp(v[optind],"copy")) {
+	    copy=true;
 	} else {
 	    usage();
 	}
 		
-	VBankFileReader reader(v[2],false,true);
-	VBankFileWriter writer(v[3],
+	VBankFileReader reader(v[optind+1],false,true);
+	VBankFileWriter writer(v[optind+2],
 			       reader.getRunNumber(),
 			       reader.getConfigMask());
+	
+	if (method!=V_BANK_FILE_NO_COMPRESSION) {
+	    writer.setCompression(method,
+				  numThreads<1?0:(unsigned)numThreads,
+				  level);
+	}
+	
+	// packets that are only copied don't have to be decoded
+	bool rawCopy=copy && !reader.isStreamed();
+	// copy straight out of the mapped file if we can
+	bool mapped=rawCopy && reader.mapFile();
+	vector< char > raw;
 		
 	for (unsigned i=0;
 	     reader.hasPacket(i);
 	     ++i) {
+	    if (mapped) {
+		uword32 size;
+		const char *bytes=reader.getPacketBytes(i,&size);
+		writer.writeRawPacket(bytes,size);
+		continue;
+	    }
+	    if (rawCopy) {
+		reader.readRawPacket(i,raw);
+		writer.writeRawPacket(&raw[0],raw.size());
+		continue;
+	    }
+	    
 	    VPacket *packet=reader.readPacket(i);
-	    if (packet->has(VGetArrayEventBankName())) {
+	    if (packet->has(VGetArrayEventBankName()) && !copy) {
 		VArrayEvent *ae=packet->get< VArrayEvent >(VGetArrayEventBankName());
 		for (unsigned i=0;i<ae->getNumEvents();++i) {
 		    ae->getEventAt(i)->setCompressedBit(compBit);
 		}
 	    }
-	    if (packet->has(VGetEventOverflowBankName())) {
+	    if (packet->has(VGetEventOverflowBankName()) && !copy) {
 		VEventOverflow *eo=packet->get< VEventOverflow >(VGetEventOverflowBankName());
 		for (unsigned i=0;i<eo->numDatums();++i) {
 		    VEvent *ev=dynamic_cast< VEvent* >(eo->getDatumAt(i));
@@ -8,6 +8,7 @@
 #include "VBF/VCorsikaSimulationData.h"
 
 #include "VBF/VConfigMaskUtil.h"
+#include "VBF/VZeroSuppressor.h"
 #include "VATime.h"
 
 using namespace VConfigMaskUtil;
@@ -148,6 +149,9 @@ void VG_writeVBF::initialize() {
   aztel.resize(fnbr_tel);
   eltel.resize(fnbr_tel);
 
+  // no zero suppression by default
+  fZeroSupThresholds.resize(fnbr_tel);
+
 }
 
 //************************** setTelescopeLocations *************************************
@@ -519,6 +523,13 @@ bool VG_writeVBF::storeEvent() {
     
   }
 
+  // software zero suppression, data events only
+  unsigned tel = (unsigned)event->getNodeNumber();
+  if (!fpedestalevent && tel<fZeroSupThresholds.size() &&
+      !fZeroSupThresholds[tel].empty()) {
+    VZeroSuppressor::suppress(event,fZeroSupThresholds[tel]);
+  }
+
   if (ae!=0) {
     ae->addEvent(event);
   }
@@ -584,6 +595,26 @@ void VG_writeVBF::storeSample(int &ti,int &iDC) {
  
 }
 
+/*************************** storeTrace *******************************/
+void VG_writeVBF::storeTrace(const std::vector<int> &trace) {
+
+  if (fDebugLevel > 3) {
+    std::cerr << "********* store_trace tel pix nsamples:  " 
+              << fcurrent_tel << " " << fcurrent_pix 
+              << " " << trace.size() << std::endl;
+  }
+
+  // same conversion as storeSample, without a call per time bin
+  uint8_t *samples = event->getSamplePtr(fcurrent_pix,0);
+  unsigned nsamples = trace.size();
+  if (nsamples > event->getNumSamples()) {
+    nsamples = event->getNumSamples();
+  }
+  for (unsigned ti=0;ti<nsamples;ti++) {
+    samples[ti] = (uint8_t)trace[ti];
+  }
+}
+
 /*************************** setChargePedHigain *******************************/
 void VG_writeVBF::setChargePedHigain() {
 
@@ -1354,6 +1385,16 @@ void VG_writeVBF::setTriggerBit(bool  btrigger) {
   event->setTriggerBit(fcurrent_pix,btrigger);
 }
 
+//************************ setZeroSuppressionThresholds ********************
+void VG_writeVBF::setZeroSuppressionThresholds(const unsigned &telId,
+                                  const std::vector<unsigned> &thresholds) {
+
+  if (telId >= fnbr_tel) {
+    showXErrorVbfWriter("telescope id out of range in setZeroSuppressionThresholds");
+  }
+  fZeroSupThresholds[telId] = thresholds;
+}
+
 //************************ setTriggeredReadout ********************
 void VG_writeVBF::setTriggeredReadout(const bool &triggered_readout) {
 
@@ -79,6 +79,8 @@ class VG_writeVBF {
   unsigned short fCMaskAll;  //<! vbf config.mask for all telescopes
 
   unsigned fmaxNumChannels;  //!< set by default to 500 (why not 499?)
+
+  std::vector< std::vector<unsigned> > fZeroSupThresholds; //!< zero suppression threshold of each channel, for each telescope (empty: no suppression)
   
   unsigned fcurrent_tel;     //!< current telescope id
   unsigned fcurrent_pix;     //!< current pixel id
@@ -244,6 +246,12 @@ bool makeSimulationHeader(std::string &configFilePlus,
    \param iPC time bin pedestal in digital counts    
  */
  void storeSample(int &ti,int &iDC);
+
+ /*! store the whole trace of the current pixel at once, same as calling
+   storeSample for each time bin
+   \param trace time bin data in digital counts
+ */
+ void storeTrace(const std::vector<int> &trace);
  
  /*! make a VSimulationData class using default values
    and put into the vbf packet. Normally used with pedestal packets
@@ -422,6 +430,16 @@ bool makeSimulationHeader(std::string &configFilePlus,
    fmaxNumChannels = maxNumberChannels;
  };
 
+ /*! set zero suppression thresholds for a telescope. Channels of data
+   events (not pedestal events) with all samples below their threshold and
+   no low gain are removed from the event in storeEvent()
+   \param telId  telescope number, starting from zero
+   \param thresholds  threshold in digital counts for each pixel, 
+                       empty vector: no zero suppression
+ */
+ void setZeroSuppressionThresholds(const unsigned &telId,
+                                   const std::vector<unsigned> &thresholds);
+
  /*! setNumFadcSamples: internally set to 24, set only if !=24, all fadcs have same number of channels
    \param numFadcSamples
  */
@@ -0,0 +1,410 @@
+//
+// l2ClusterBench.cpp
+//
+// Micro benchmark and cross check of the L2 next neighbor clustering of
+// TriggerTelescopeNextNeighbor (RunL2Patch / CalcCluster).
+//
+// The file holds two copies of the clustering, both without ROOT:
+//   - Old: the recursive CalcCluster with per call allocated arrays and
+//          vectors of vectors and the linear GroupInPatch search
+//   - New: the neighbor and patch tables built once (BuildL2Tables), the
+//          iterative CalcCluster and the clusters stored one after the other
+// TMath::Sort is replaced by an index sort with the same ordering. If
+// RunL2Patch or CalcCluster are changed, the new copy has to follow.
+//
+// Both are run on the same random events (hexagonal grids of 441 and 3600
+// groups, with and without patches, multiplicities 1 to 4, occupancies from
+// NSB only to bright showers) and the patch trigger decision, the patch
+// trigger time and the trigger cluster are compared.
+//
+// build and run:
+//   g++ -O2 -std=c++11 l2ClusterBench.cpp -o l2ClusterBench
+//   ./l2ClusterBench
+//
+// It prints the time per event of both versions and the number of patches
+// where they differ, which has to be 0.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <numeric>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+//index sort as TMath::Sort (descending by default)
+template<class T> void Sort(int n, const T *a, int *index, bool down = true)
+{
+  iota(index, index + n, 0);
+  if(down)
+    sort(index, index + n, [&](int i, int j) { return a[i] > a[j]; });
+  else
+    sort(index, index + n, [&](int i, int j) { return a[i] < a[j]; });
+}
+
+//camera and event, shared by both versions
+int iNumSumPixGroups;
+vector< vector<int> > iSumGroupNeighbors;
+vector< vector<int> > vPatch;
+bool bUsePatches;
+float fWidthDiscriminator;
+int iMultiplicity;
+vector<char> bTriggeredGroups;
+vector<float> fDiscriminatorTime;
+
+//----------------------------------------------------------------------------
+//
+// old version
+namespace Old
+{
+  int *iClusterID;
+  vector< vector<int> > *vGroupsInCluster;
+  vector< vector<float> > *vTriggerTimesInCluster;
+
+  bool GroupInPatch(int GroupID, int PatchID)
+  {
+    if(!bUsePatches)
+      return true;
+    for(size_t i = 0; i < vPatch[PatchID].size(); i++)
+      if(GroupID == vPatch[PatchID][i])
+        return true;
+    return false;
+  }
+
+  int CalcCluster(int GroupID, int ClusterID, int PatchID)
+  {
+    if(iClusterID[GroupID] == ClusterID)
+      return 0;
+    iClusterID[GroupID] = ClusterID;
+    vGroupsInCluster->at(ClusterID).push_back(GroupID);
+    vTriggerTimesInCluster->at(ClusterID).push_back(fDiscriminatorTime[GroupID]);
+
+    int NumGroupsInCluster = 1;
+    for(size_t n = 0; n < iSumGroupNeighbors[GroupID].size(); n++)
+      {
+        int GroupIDNeighbor = iSumGroupNeighbors[GroupID][n];
+        if(bTriggeredGroups[GroupIDNeighbor]
+           && fabs(fDiscriminatorTime[ClusterID] - fDiscriminatorTime[GroupIDNeighbor]) < fWidthDiscriminator
+           && GroupInPatch(GroupIDNeighbor, PatchID))
+          NumGroupsInCluster += CalcCluster(GroupIDNeighbor, ClusterID, PatchID);
+      }
+    return NumGroupsInCluster;
+  }
+
+  bool RunL2Patch(int PatchNumber, float *fPatchTriggerTimes, vector<int> &vTriggerCluster)
+  {
+    iClusterID = new int[iNumSumPixGroups];
+    int *iNumGroupsInCluster = new int[iNumSumPixGroups];
+    for(int i = 0; i < iNumSumPixGroups; i++)
+      {
+        iClusterID[i] = -1;
+        iNumGroupsInCluster[i] = 0;
+      }
+    vGroupsInCluster = new vector< vector<int> >(iNumSumPixGroups);
+    vTriggerTimesInCluster = new vector< vector<float> >(iNumSumPixGroups);
+
+    int NGroups = bUsePatches ? vPatch[PatchNumber].size() : iNumSumPixGroups;
+    for(int i = 0; i < NGroups; i++)
+      {
+        int GroupID = bUsePatches ? vPatch[PatchNumber][i] : i;
+        if(bTriggeredGroups[GroupID])
+          iNumGroupsInCluster[GroupID] = CalcCluster(GroupID, GroupID, PatchNumber);
+      }
+
+    int *index = new int[iNumSumPixGroups];
+    Sort(iNumSumPixGroups, iNumGroupsInCluster, index);
+
+    float fPatchTriggerTime = 1e6;
+    int t = 0;
+    int tmin = 0;
+    while(iNumGroupsInCluster[index[t]] >= iMultiplicity)
+      {
+        int igroups = iNumGroupsInCluster[index[t]];
+        float *times = new float[igroups];
+        for(int i = 0; i < igroups; i++)
+          times[i] = (vTriggerTimesInCluster->at(index[t]))[i];
+        int *indext = new int[igroups];
+        Sort(igroups, times, indext, false);
+        float triggertime = times[indext[iMultiplicity - 1]];
+        if(triggertime < fPatchTriggerTime)
+          {
+            fPatchTriggerTime = triggertime;
+            tmin = t;
+          }
+        t++;
+        delete [] times;
+        delete [] indext;
+        if(t == iNumSumPixGroups)
+          break;
+      }
+    fPatchTriggerTimes[PatchNumber] = fPatchTriggerTime;
+    vTriggerCluster = vGroupsInCluster->at(index[tmin]);
+    bool bTriggered = iNumGroupsInCluster[index[0]] >= iMultiplicity;
+
+    delete [] iClusterID;
+    delete [] iNumGroupsInCluster;
+    delete vGroupsInCluster;
+    delete vTriggerTimesInCluster;
+    delete [] index;
+    return bTriggered;
+  }
+}
+
+//----------------------------------------------------------------------------
+//
+// new version
+namespace New
+{
+  vector<int>   iNeighborStart;
+  vector<int>   iNeighborList;
+  vector<bool>  bGroupInPatch;
+  vector<int>   iClusterID;
+  vector<int>   iNumGroupsInCluster;
+  vector<int>   iFirstGroupInCluster;
+  vector<int>   iGroupsInClusters;
+  vector<float> fTriggerTimesInClusters;
+  vector<float> fTimesInCluster;
+  vector<int>   iClusterIndex;
+  vector<int>   iStackGroup;
+  vector<int>   iStackNeighbor;
+
+  void BuildL2Tables()
+  {
+    iNeighborStart.assign(iNumSumPixGroups + 1, 0);
+    iNeighborList.clear();
+    for(int g = 0; g < iNumSumPixGroups; g++)
+      {
+        iNeighborStart[g] = iNeighborList.size();
+        for(size_t n = 0; n < iSumGroupNeighbors[g].size(); n++)
+          iNeighborList.push_back(iSumGroupNeighbors[g][n]);
+      }
+    iNeighborStart[iNumSumPixGroups] = iNeighborList.size();
+
+    bGroupInPatch.assign(vPatch.size() * iNumSumPixGroups, false);
+    for(size_t p = 0; p < vPatch.size(); p++)
+      for(size_t i = 0; i < vPatch[p].size(); i++)
+        bGroupInPatch[p * iNumSumPixGroups + vPatch[p][i]] = true;
+
+    iClusterID.assign(iNumSumPixGroups, -1);
+    iNumGroupsInCluster.assign(iNumSumPixGroups, 0);
+    iFirstGroupInCluster.assign(iNumSumPixGroups, 0);
+    iClusterIndex.assign(iNumSumPixGroups, 0);
+    iStackGroup.assign(iNumSumPixGroups, 0);
+    iStackNeighbor.assign(iNumSumPixGroups, 0);
+  }
+
+  bool GroupInPatch(int GroupID, int PatchID)
+  {
+    if(!bUsePatches)
+      return true;
+    return bGroupInPatch[PatchID * iNumSumPixGroups + GroupID];
+  }
+
+  int CalcCluster(int GroupID, int ClusterID, int PatchID)
+  {
+    if(iClusterID[GroupID] == ClusterID)
+      return 0;
+
+    float fSeedTime = fDiscriminatorTime[ClusterID];
+    int NumGroupsInCluster = 0;
+    int iStackSize = 0;
+    int g = GroupID;
+    while(1)
+      {
+        iClusterID[g] = ClusterID;
+        iGroupsInClusters.push_back(g);
+        fTriggerTimesInClusters.push_back(fDiscriminatorTime[g]);
+        NumGroupsInCluster++;
+        iStackGroup[iStackSize] = g;
+        iStackNeighbor[iStackSize] = iNeighborStart[g];
+        iStackSize++;
+
+        g = -1;
+        while(iStackSize > 0 && g < 0)
+          {
+            int top = iStackSize - 1;
+            if(iStackNeighbor[top] == iNeighborStart[iStackGroup[top] + 1])
+              {
+                iStackSize--;
+                continue;
+              }
+            int GroupIDNeighbor = iNeighborList[iStackNeighbor[top]++];
+            if(bTriggeredGroups[GroupIDNeighbor]
+               && iClusterID[GroupIDNeighbor] != ClusterID
+               && fabs(fSeedTime - fDiscriminatorTime[GroupIDNeighbor]) < fWidthDiscriminator
+               && GroupInPatch(GroupIDNeighbor, PatchID))
+              g = GroupIDNeighbor;
+          }
+        if(g < 0)
+          break;
+      }
+    return NumGroupsInCluster;
+  }
+
+  bool RunL2Patch(int PatchNumber, float *fPatchTriggerTimes, vector<int> &vTriggerCluster)
+  {
+    iClusterID.assign(iNumSumPixGroups, -1);
+    iNumGroupsInCluster.assign(iNumSumPixGroups, 0);
+    iGroupsInClusters.clear();
+    fTriggerTimesInClusters.clear();
+
+    bool bAnyGroupTriggered = false;
+    int NGroups = bUsePatches ? vPatch[PatchNumber].size() : iNumSumPixGroups;
+    for(int i = 0; i < NGroups; i++)
+      {
+        int GroupID = bUsePatches ? vPatch[PatchNumber][i] : i;
+        if(bTriggeredGroups[GroupID])
+          {
+            bAnyGroupTriggered = true;
+            if(iClusterID[GroupID] != GroupID)
+              iFirstGroupInCluster[GroupID] = iGroupsInClusters.size();
+            iNumGroupsInCluster[GroupID] = CalcCluster(GroupID, GroupID, PatchNumber);
+          }
+      }
+
+    if(!bAnyGroupTriggered && iMultiplicity > 0)
+      {
+        fPatchTriggerTimes[PatchNumber] = 1e6;
+        vTriggerCluster.clear();
+        return false;
+      }
+
+    int *index = &iClusterIndex[0];
+    Sort(iNumSumPixGroups, &iNumGroupsInCluster[0], index);
+
+    float fPatchTriggerTime = 1e6;
+    int t = 0;
+    int tmin = 0;
+    while(iNumGroupsInCluster[index[t]] >= iMultiplicity)
+      {
+        int igroups = iNumGroupsInCluster[index[t]];
+        int iFirst = iFirstGroupInCluster[index[t]];
+        fTimesInCluster.assign(fTriggerTimesInClusters.begin() + iFirst, fTriggerTimesInClusters.begin() + iFirst + igroups);
+        nth_element(fTimesInCluster.begin(), fTimesInCluster.begin() + iMultiplicity - 1, fTimesInCluster.end());
+        float triggertime = fTimesInCluster[iMultiplicity - 1];
+        if(triggertime < fPatchTriggerTime)
+          {
+            fPatchTriggerTime = triggertime;
+            tmin = t;
+          }
+        t++;
+        if(t == iNumSumPixGroups)
+          break;
+      }
+    fPatchTriggerTimes[PatchNumber] = fPatchTriggerTime;
+
+    if(iNumGroupsInCluster[index[tmin]] > 0)
+      vTriggerCluster.assign(iGroupsInClusters.begin() + iFirstGroupInCluster[index[tmin]],
+                             iGroupsInClusters.begin() + iFirstGroupInCluster[index[tmin]] + iNumGroupsInCluster[index[tmin]]);
+    else
+      vTriggerCluster.clear();
+
+    return iNumGroupsInCluster[index[0]] >= iMultiplicity;
+  }
+}
+
+//----------------------------------------------------------------------------
+//
+// hexagonal grid of side*side groups (odd rows shifted) with overlapping
+// square patches
+void SetupCamera(int side)
+{
+  iNumSumPixGroups = side * side;
+  iSumGroupNeighbors.assign(iNumSumPixGroups, vector<int>());
+  for(int y = 0; y < side; y++)
+    for(int x = 0; x < side; x++)
+      {
+        int s = (y % 2) ? 0 : -1;  //column offset of the neighbors in the rows above and below
+        int dx[6] = { 1, -1, s, s + 1, s, s + 1 };
+        int dy[6] = { 0, 0, 1, 1, -1, -1 };
+        for(int k = 0; k < 6; k++)
+          {
+            int xx = x + dx[k];
+            int yy = y + dy[k];
+            if(xx >= 0 && xx < side && yy >= 0 && yy < side)
+              iSumGroupNeighbors[y * side + x].push_back(yy * side + xx);
+          }
+      }
+
+  vPatch.clear();
+  int ps = side / 3;
+  for(int py = 0; py < side; py += ps / 2)
+    for(int px = 0; px < side; px += ps / 2)
+      {
+        vector<int> patch;
+        for(int y = py; y < min(side, py + ps); y++)
+          for(int x = px; x < min(side, px + ps); x++)
+            patch.push_back(y * side + x);
+        vPatch.push_back(patch);
+      }
+}
+
+int main()
+{
+  mt19937 rng(7);
+  uniform_real_distribution<float> uniform(0., 1.);
+  const int iNumEvents = 3000;
+  const int sides[2] = { 21, 60 };
+  long iNumDifferences = 0;
+
+  for(int s = 0; s < 2; s++)
+    {
+      int side = sides[s];
+      SetupCamera(side);
+      New::BuildL2Tables();
+      fWidthDiscriminator = 6.;
+
+      for(int p = 0; p < 2; p++)
+        {
+          bUsePatches = (p == 1);
+          int iNumPatches = bUsePatches ? vPatch.size() : 1;
+          vector<float> fTimesOld(iNumPatches), fTimesNew(iNumPatches);
+          vector<bool> bTrigOld(iNumPatches), bTrigNew(iNumPatches);
+          vector< vector<int> > vClusterOld(iNumPatches), vClusterNew(iNumPatches);
+          double tOld = 0.;
+          double tNew = 0.;
+
+          for(int ev = 0; ev < iNumEvents; ev++)
+            {
+              //random triggered groups with a shower blob in every other event
+              iMultiplicity = 1 + ev % 4;
+              float fOccupancy = (ev % 3 == 0) ? 0.002 : (ev % 3 == 1 ? 0.03 : 0.2);
+              int cx = rng() % side;
+              int cy = rng() % side;
+              bTriggeredGroups.assign(iNumSumPixGroups, 0);
+              fDiscriminatorTime.assign(iNumSumPixGroups, 0.);
+              for(int g = 0; g < iNumSumPixGroups; g++)
+                {
+                  int x = g % side;
+                  int y = g / side;
+                  float d2 = (x - cx) * (x - cx) + (y - cy) * (y - cy);
+                  bTriggeredGroups[g] = uniform(rng) < fOccupancy || (ev % 2 && d2 < 4);
+                  fDiscriminatorTime[g] = floor(uniform(rng) * 20);
+                }
+
+              chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+              for(int i = 0; i < iNumPatches; i++)
+                bTrigOld[i] = Old::RunL2Patch(i, &fTimesOld[0], vClusterOld[i]);
+              chrono::steady_clock::time_point t1 = chrono::steady_clock::now();
+              for(int i = 0; i < iNumPatches; i++)
+                bTrigNew[i] = New::RunL2Patch(i, &fTimesNew[0], vClusterNew[i]);
+              chrono::steady_clock::time_point t2 = chrono::steady_clock::now();
+              tOld += chrono::duration<double>(t1 - t0).count();
+              tNew += chrono::duration<double>(t2 - t1).count();
+
+              for(int i = 0; i < iNumPatches; i++)
+                if(bTrigOld[i] != bTrigNew[i] || fTimesOld[i] != fTimesNew[i] || vClusterOld[i] != vClusterNew[i])
+                  iNumDifferences++;
+            }
+          printf("groups %d patches %s (%d): old %.2f us/event new %.2f us/event\n",
+                 iNumSumPixGroups, bUsePatches ? "yes" : "no", iNumPatches,
+                 tOld / iNumEvents * 1e6, tNew / iNumEvents * 1e6);
+        }
+    }
+  printf("differences %ld\n", iNumDifferences);
+
+  return iNumDifferences == 0 ? 0 : 1;
+}
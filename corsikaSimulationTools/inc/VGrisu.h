@@ -8,12 +8,14 @@
 #include <iomanip>
 #include <iostream>
 #include <map>
+#include <sstream>
 #include <string>
 
 #include "VCORSIKARunheader.h"
 
 #include "mc_tel.h"
 #include "sim_cors.h"
+#include "VPhotonBatch.h"
 
 using namespace std;
 
@@ -35,6 +37,7 @@ class VGrisu
      void transformCoord( float&, float&, float& );     //!< transform from CORSIKA to GrIsu coordinates
      void makeParticleMap();              //!< make map with  particle ID transformation matrix
      float redang( float );             //! reduce large angle to intervall 0, 2*pi
+     void writePhotonPosition( ostream&, bunch );   //!< write first part of a "P" line
 
    public:
       VGrisu( string fVersion = "" );
@@ -46,6 +49,7 @@ class VGrisu
       void writeRunHeader( float*, VCORSIKARunheader* );      //!<  write some information about CORSIKA run intot the runheader
       void writeEvent( telescope_array );  //!< write MC information
       void writePhotons( bunch, int );         //!< write next photon to grisu file ("P" line)
+      void writePhotons( const VPhotonBatch&, int, double i_xoff = 0., double i_yoff = 0. );  //!< write all detected photons of a batch
 };
 
 #endif
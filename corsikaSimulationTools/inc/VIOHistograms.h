@@ -18,11 +18,146 @@
 
 #include "mc_tel.h"
 #include "sim_cors.h"
+#include "VPhotonBatch.h"
 
 using namespace std;
 
+/*!  fixed-binning counts of a TH1D or TH2D
+
+     filled without touching the ROOT histogram (same binning and statistics
+     as TH1::Fill()) and added to it in one go with addTo()
+*/
+class VIOHistogramCounts
+{
+   private:
+      int    fNbinsX;
+      int    fNbinsY;                 // 0 for 1D histograms
+      double fXmin;
+      double fXmax;
+      double fYmin;
+      double fYmax;
+
+      vector< double > fCounts;       // ROOT bin numbering (incl. under/overflows)
+      vector< int >    fFilled;       // bins filled since the last addTo()
+
+      double fEntries;
+      double fSumw;
+      double fSumwx;
+      double fSumwx2;
+      double fSumwy;
+      double fSumwy2;
+      double fSumwxy;
+
+   public:
+      VIOHistogramCounts();
+     ~VIOHistogramCounts() {}
+      void init( TH1 *h );
+      void addTo( TH1 *h );
+
+      int findBinX( double x ) const
+      {
+         if( x < fXmin ) return 0;
+         if( !( x < fXmax ) ) return fNbinsX + 1;
+         return 1 + int( fNbinsX * ( x - fXmin ) / ( fXmax - fXmin ) );
+      }
+      int findBinY( double y ) const
+      {
+         if( y < fYmin ) return 0;
+         if( !( y < fYmax ) ) return fNbinsY + 1;
+         return 1 + int( fNbinsY * ( y - fYmin ) / ( fYmax - fYmin ) );
+      }
+
+      void fill( double x ) { fill( findBinX( x ), x ); }
+      void fill( int binx, double x )
+      {
+         fEntries++;
+         if( fCounts[binx]++ == 0. ) fFilled.push_back( binx );
+         if( binx == 0 || binx > fNbinsX ) return;
+         fSumw++;
+         fSumwx += x;
+         fSumwx2 += x * x;
+      }
+      void fill( double x, double y ) { fill( findBinX( x ), findBinY( y ), x, y ); }
+      void fill( int binx, int biny, double x, double y )
+      {
+         fEntries++;
+         int bin = biny * ( fNbinsX + 2 ) + binx;
+         if( fCounts[bin]++ == 0. ) fFilled.push_back( bin );
+         if( binx == 0 || binx > fNbinsX || biny == 0 || biny > fNbinsY ) return;
+         fSumw++;
+         fSumwx += x;
+         fSumwx2 += x * x;
+         fSumwy += y;
+         fSumwy2 += y * y;
+         fSumwxy += x * y;
+      }
+};
+
+/*!  histogram accumulator for one filling thread
+
+     photons are counted in flat arrays (VIOHistogramCounts) and added to the
+     ROOT histograms of VIOHistograms at the end of each event.
+     Use one accumulator per thread (see VIOHistograms::newAccumulator())
+*/
+class VIOHistograms;
+
+class VIOHistogramAccumulator
+{
+   friend class VIOHistograms;
+
+   private:
+      const VIOHistograms *fHistograms;
+      bool bFill;                     // false if there are no histograms
+
+      VIOHistogramCounts cBunch;
+      VIOHistogramCounts cT0;
+      VIOHistogramCounts cZem;
+      VIOHistogramCounts cGXY;
+      VIOHistogramCounts cGZeAz;
+      VIOHistogramCounts cGLambda;
+      VIOHistogramCounts cGProb;
+      VIOHistogramCounts cGZem;
+      VIOHistogramCounts cSXY;
+      VIOHistogramCounts cSZeAz;
+      VIOHistogramCounts cSLambda;
+      VIOHistogramCounts cSProb;
+      VIOHistogramCounts cSZem;
+      vector< VIOHistogramCounts > cCXYZ;
+
+// all photons of a bunch share position, direction and emission height:
+// angles and bins are calculated once per bunch
+      bool   bBunch;
+      float  fBunch[5];               // x, y, cx, cy, zem of the current bunch
+      double fXYx;
+      double fXYy;
+      double fZe;
+      double fAz;
+      int    fGXYbin[2];
+      int    fGZeAzbin[2];
+      int    fGZembin;
+      int    fSXYbin[2];
+      int    fSZeAzbin[2];
+      int    fSZembin;
+      bool   bBunchLevels;
+      vector< int >    fLevelBin;     // per XYZ level: x bin, y bin (-1: not reached)
+      vector< double > fLevelXY;      // per XYZ level: x, y
+
+      void setBunch( const bunch &ph );
+      void setBunchLevels( const bunch &ph );
+
+   public:
+      VIOHistogramAccumulator( const VIOHistograms *iHistograms );
+     ~VIOHistogramAccumulator() {}
+      void fillBunch( const bunch &i_bunch, double itime );
+      void fillGenerated( const bunch &ph, double prob );
+      void fillSurvived( const bunch &ph, double prob );
+      void fill( const VPhotonBatch &iBatch );
+};
+
 class VIOHistograms
 {
+   friend class VIOHistogramAccumulator;
+
    private:
       TList *hisList;
    
@@ -104,19 +239,26 @@ class VIOHistograms
       bool bSmallFile; // reduce output
       bool bMuon;      // adjust histograms for muon input
 
-      double redang( double );
+      VIOHistogramAccumulator *fFill;                    // accumulator used by the fill functions below
+      vector< VIOHistogramAccumulator* > fAccumulators;  // all accumulators (incl. fFill)
+
+      static double redang( double );
       void transformCoord( double&, double&, double& );
+      void initAccumulator( VIOHistogramAccumulator* );
+      void flush();
 
    public:
       VIOHistograms();
-     ~VIOHistograms() {}
+     ~VIOHistograms();
       void init( string, bool );
       void newEvent( float*, telescope_array, int  );
       void initXYZhistograms();
-      void fillBunch( bunch, double );
-      void fillGenerated( bunch, double );
+      VIOHistogramAccumulator* newAccumulator();
+      void fillBunch( bunch i_bunch, double itime ) { fFill->fillBunch( i_bunch, itime ); }
+      void fillGenerated( bunch ph, double prob ) { fFill->fillGenerated( ph, prob ); }
       void fillNPhotons( int iTel, double iphotons );
-      void fillSurvived( bunch, double );
+      void fillSurvived( bunch ph, double prob ) { fFill->fillSurvived( ph, prob ); }
+      void fill( const VPhotonBatch &iBatch ) { fFill->fill( iBatch ); }
       void setCORSIKAcoordinates() { bCORSIKA_coordinates = true; }
       void set_small_file() { bSmallFile = true; }
       void setMuonSettings() { bMuon = true; }
@@ -0,0 +1,73 @@
+//! VPEReader read pe data from root files (both tree layouts of VPEWriter)
+// $Revision $ID$
+
+#ifndef VPEREADER_H
+#define VPEREADER_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "TBranch.h"
+#include "TTree.h"
+
+using namespace std;
+
+class VPEReader
+{
+   private:
+
+   TTree *fTree;
+   TTree *fCurrentTree;           //!< tree of the current file (chains)
+   int    fTreeNumber;            //!< number of the current file in the chain (-1: none yet)
+   bool   bCompact;
+
+// compact layout
+   unsigned int fNPE;
+   double       fTimeOffset;
+   double       fPositionResolution;
+   double       fTimeResolution;
+   double       fWavelengthResolution;
+   std::vector< UInt_t >   fC_pixelIDdelta;
+   std::vector< Int_t >    fC_photonX;
+   std::vector< Int_t >    fC_photonY;
+   std::vector< UInt_t >   fC_time;
+   std::vector< UShort_t > fC_wl;
+   TBranch *fB_nPE;
+   TBranch *fB_pixelIDdelta;
+   TBranch *fB_photonX;
+   TBranch *fB_photonY;
+   TBranch *fB_time;
+   TBranch *fB_wl;
+
+   int    getCompactEntry( Long64_t i );
+   double getResolution( TTree *t, string iName, double iDefault );
+   void   setCompactTree( TTree *t );
+
+   public:
+
+   unsigned int fEventNumber;
+   unsigned int fPrimaryType;
+   float        fPrimaryEnergy;
+   float        fXcore;
+   float        fYcore;
+   float        fXcos;
+   float        fYcos;
+   float        fXsource;
+   float        fYsource;
+   float        fDelay;
+   std::vector< unsigned int > *fPE_pixelID;
+   std::vector< float > *fPE_photonX;
+   std::vector< float > *fPE_photonY;
+   std::vector< float > *fPE_time;
+   std::vector< float > *fPE_wl;
+
+   VPEReader( TTree *t );
+  ~VPEReader();
+   Long64_t     getEntries() { if( fTree ) return fTree->GetEntries(); return 0; }
+   int          getEntry( Long64_t i );
+   bool         isCompact() { return bCompact; }
+   unsigned int usePixelNumbers();
+};
+
+#endif
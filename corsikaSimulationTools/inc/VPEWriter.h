@@ -8,6 +8,7 @@
 #include <string>
 #include <vector>
 
+#include "TBranch.h"
 #include "TFile.h"
 #include "TTree.h"
 
@@ -39,15 +40,40 @@ class VPEWriter
 
    unsigned int fUsePixelNumbers;
 
+// compact mode (fixed-point and delta encoded arrays, see VPEWriter.cpp)
+   bool         bCompact;
+   unsigned int fNPE;
+   double       fTimeOffset;
+   std::vector< unsigned int >   fC_index;
+   std::vector< UInt_t >         fC_pixelIDdelta;
+   std::vector< Int_t >          fC_photonX;
+   std::vector< Int_t >          fC_photonY;
+   std::vector< UInt_t >         fC_time;
+   std::vector< UShort_t >       fC_wl;
+   TBranch *fB_pixelIDdelta;
+   TBranch *fB_photonX;
+   TBranch *fB_photonY;
+   TBranch *fB_time;
+   TBranch *fB_wl;
+
+   int          add_compact_event();
+   void         initCompactTree( unsigned int iNInitEvents );
+   void         setBasketSize( const char *iBranchName, unsigned int iNInitEvents, unsigned int iSize );
+
    public:
 
-   VPEWriter( unsigned int iTelID = 0, unsigned int iUsePixelNumbers = 1, unsigned int iNInitEvents = 100000 );
+   static const double fPositionResolution;      //!< compact mode: resolution of photon positions [mm]
+   static const double fTimeResolution;          //!< compact mode: resolution of photon times [ns]
+   static const double fWavelengthResolution;    //!< compact mode: resolution of photon wavelengths [nm]
+
+   VPEWriter( unsigned int iTelID = 0, unsigned int iUsePixelNumbers = 1, unsigned int iNInitEvents = 100000, bool iCompact = false );
+  ~VPEWriter();
    void         add_pe( unsigned int iPE_pixelID, float iPE_photonX, float iPE_photonY, float iPE_time, float iPE_wl = 0. );
    int          add_event( unsigned int iEventNumber, unsigned int iPrimaryType, float iPrimaryEnergy, float iXcore, float iYcore, float iXcos, float iYcos, float iXsource, float iYsource, float iDelay );
    TTree*       getDataTree() { return fTree; }
+   bool         isCompact() { return bCompact; }
    unsigned int usePixelNumbers() { return fUsePixelNumbers; }
-   
+
 };
 
 #endif
-
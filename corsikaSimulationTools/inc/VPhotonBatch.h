@@ -0,0 +1,120 @@
+//! VPhotonBatch  Cherenkov photons of one telescope and event (structure of arrays)
+
+#ifndef VPHOTONBATCH_H
+#define VPHOTONBATCH_H
+
+#include <vector>
+
+#include "mc_tel.h"
+
+using namespace std;
+
+/*!  all Cherenkov photons generated for a range of bunches of one telescope
+
+     filled by the photon filter in corsikaIOreader (wavelengths, atmospheric
+     extinction and quantum efficiency) and read by the writers
+     (VGrisu::writePhotons(), VIOHistograms::fill())
+
+     photons of the same bunch share position, direction, time and emission
+     height and follow each other
+*/
+class VPhotonBatch
+{
+   public:
+
+      enum E_status { kGenerated = 0, kSurvived = 1, kDetected = 2 };  //!< survived: atmospheric extinction; detected: extinction and QE
+
+      int fTelescope;                       //!< telescope number (CORSIKA numbering)
+
+// bunches
+      vector< float >  fBunchSize;          //!< number of photons in bunch
+      vector< float >  fBunchZem;           //!< emission height [cm]
+      vector< double > fBunchTime;          //!< arrival time at ground [ns]
+
+// photons
+      vector< unsigned int > fBunch;        //!< bunch (index into the bunch vectors)
+      vector< float >  fX;                  //!< position [m] (x to north)
+      vector< float >  fY;                  //!< position [m] (y to west)
+      vector< float >  fCx;                 //!< direction cosine
+      vector< float >  fCy;                 //!< direction cosine
+      vector< float >  fTime;               //!< arrival time at ground [ns]
+      vector< float >  fZem;                //!< emission height [m]
+      vector< float >  fLambda;             //!< wavelength [nm]
+      vector< double > fProb;               //!< survival probability (atmospheric extinction)
+      vector< double > fProbSurvived;       //!< survival probability incl. bunch fraction (photons surviving extinction only)
+      vector< unsigned char > fStatus;      //!< see E_status
+
+      VPhotonBatch() { fTelescope = 0; }
+     ~VPhotonBatch() {}
+
+      void clear()
+      {
+         fBunchSize.clear();
+         fBunchZem.clear();
+         fBunchTime.clear();
+         fBunch.clear();
+         fX.clear();
+         fY.clear();
+         fCx.clear();
+         fCy.clear();
+         fTime.clear();
+         fZem.clear();
+         fLambda.clear();
+         fProb.clear();
+         fProbSurvived.clear();
+         fStatus.clear();
+      }
+
+      unsigned int getNBunches() const { return fBunchSize.size(); }
+      unsigned int size() const { return fX.size(); }
+
+      void addBunch( const bunch &i_bunch, double itime )
+      {
+         fBunchSize.push_back( i_bunch.photons );
+         fBunchZem.push_back( i_bunch.zem );
+         fBunchTime.push_back( itime );
+      }
+
+      //! add a photon of the last bunch
+      void addPhoton( const bunch &ph, double prob, double probSurvived, unsigned char status )
+      {
+         fBunch.push_back( fBunchSize.size() - 1 );
+         fX.push_back( ph.x );
+         fY.push_back( ph.y );
+         fCx.push_back( ph.cx );
+         fCy.push_back( ph.cy );
+         fTime.push_back( ph.ctime );
+         fZem.push_back( ph.zem );
+         fLambda.push_back( ph.lambda );
+         fProb.push_back( prob );
+         fProbSurvived.push_back( probSurvived );
+         fStatus.push_back( status );
+      }
+
+      //! photon i as bunch of size one
+      bunch getPhoton( unsigned int i ) const
+      {
+         bunch ph;
+         ph.photons = 1.;
+         ph.x = fX[i];
+         ph.y = fY[i];
+         ph.cx = fCx[i];
+         ph.cy = fCy[i];
+         ph.ctime = fTime[i];
+         ph.zem = fZem[i];
+         ph.lambda = fLambda[i];
+         return ph;
+      }
+
+      //! bunch i (size and emission height only)
+      bunch getBunch( unsigned int i ) const
+      {
+         bunch b;
+         b.photons = fBunchSize[i];
+         b.x = b.y = b.cx = b.cy = b.ctime = b.lambda = 0.;
+         b.zem = fBunchZem[i];
+         return b;
+      }
+};
+
+#endif
@@ -228,7 +228,70 @@ void VGrisu::writeEvent( telescope_array array )
 */
 void VGrisu::writePhotons( bunch i_bunch, int i_tel  )
 {
+   ostream &iOut = ( bSTDOUT ? cout : of_file );
+
+   iOut.setf(ios::showpos);
+   writePhotonPosition( iOut, i_bunch );
+   iOut << (int)i_bunch.lambda  << " " ;                          // in nanometer
+   iOut << 3  << " ";                                             // the type of the particle emitting the photon, 
+								  // (not know from CORSIKA)
+   iOut << i_tel+1;                                               // the detector hit (negative integer number)
+   iOut << endl;
+   iOut.unsetf(ios::showpos);
+}
+
+/*!
+    write all detected photons of a batch to grisu file ("P" lines)
+
+    \param iBatch  photons (only photons with status VPhotonBatch::kDetected are written)
+    \param i_tel   telescope number
+    \param i_xoff  offset subtracted from all photon x positions [m]
+    \param i_yoff  offset subtracted from all photon y positions [m]
+
+    the lines are formatted into one buffer (the first part of the line only
+    once per bunch) and written at once
+*/
+void VGrisu::writePhotons( const VPhotonBatch &iBatch, int i_tel, double i_xoff, double i_yoff )
+{
+   ostream &iOut = ( bSTDOUT ? cout : of_file );
 
+   ostringstream iBuffer;
+   iBuffer.flags( iOut.flags() | ios::showpos );
+   ostringstream iPosition;
+   iPosition.flags( iBuffer.flags() );
+   string iPositionString;
+
+   unsigned int iBunch = 0;
+   bool bPosition = false;
+   for( unsigned int i = 0; i < iBatch.size(); i++ )
+   {
+      if( iBatch.fStatus[i] != VPhotonBatch::kDetected ) continue;
+
+      if( !bPosition || iBatch.fBunch[i] != iBunch )
+      {
+         bunch ph = iBatch.getPhoton( i );
+         ph.x -= i_xoff;
+         ph.y -= i_yoff;
+         iPosition.str( "" );
+         writePhotonPosition( iPosition, ph );
+         iPositionString = iPosition.str();
+         iBunch = iBatch.fBunch[i];
+         bPosition = true;
+      }
+      iBuffer << iPositionString;
+      iBuffer << (int)iBatch.fLambda[i] << " " << 3 << " " << i_tel+1 << "\n";
+   }
+   if( !bPosition ) return;
+
+   iOut << iBuffer.str();
+   iOut.flush();
+}
+
+/*!
+    write everything but wavelength, particle type and telescope of a "P" line
+*/
+void VGrisu::writePhotonPosition( ostream &iOut, bunch i_bunch )
+{
    float x = i_bunch.x;
    float y = i_bunch.y;
    float az = atan2( i_bunch.cy, i_bunch.cx );
@@ -239,45 +302,14 @@ void VGrisu::writePhotons( bunch i_bunch, int i_tel  )
 
    transformCoord( az, x, y );
 
-   if( !bSTDOUT )
-   {
-      of_file.setf(ios::showpos);
-      of_file << "P" << " ";
-      of_file << setprecision( 7 ) << x << " ";
-      of_file << setprecision( 7 ) << y << " ";
-      of_file << setprecision( 7 ) << sin( ze ) * cos( az ) << " ";	
-      of_file << setprecision( 7 ) << sin( ze ) * sin( az ) << " ";	
-      of_file << setprecision( 7 ) << i_bunch.zem << " "; 
-      of_file << setprecision( 7 ) << i_bunch.ctime << " ";             // !! not relative time since emission,
-									// but time since first interaction
-      of_file << (int)i_bunch.lambda  << " " ;                          // in nanometer
-      of_file << 3  << " ";                                             // the type of the particle emitting the photon, 
-									// (not know from CORSIKA)
-      of_file << i_tel+1;                                                     // the detector hit (negative integer number)
-      of_file << endl;
-
-      of_file.unsetf(ios::showpos);
-   }
-   else
-   {
-      cout.setf(ios::showpos);
-      cout << "P" << " ";
-      cout << setprecision( 7 ) << x << " ";
-      cout << setprecision( 7 ) << y << " ";
-      cout << setprecision( 7 ) << sin( ze ) * cos( az ) << " ";
-      cout << setprecision( 7 ) << sin( ze ) * sin( az ) << " ";
-      cout << setprecision( 7 ) << i_bunch.zem << " "; 
-      cout << setprecision( 7 ) << i_bunch.ctime << " ";             // !! not relative time since emission,
-									// but time since first interaction
-      cout << (int)i_bunch.lambda  << " " ;                          // in nanometer
-      cout << 3  << " ";                                             // the type of the particle emitting the photon, 
-									// (not know from CORSIKA)
-      cout << i_tel+1;                                                     // the detector hit (negative integer number)
-      cout << endl;
-
-
-      cout.unsetf(ios::showpos);
-   }
+   iOut << "P" << " ";
+   iOut << setprecision( 7 ) << x << " ";
+   iOut << setprecision( 7 ) << y << " ";
+   iOut << setprecision( 7 ) << sin( ze ) * cos( az ) << " ";	
+   iOut << setprecision( 7 ) << sin( ze ) * sin( az ) << " ";	
+   iOut << setprecision( 7 ) << i_bunch.zem << " "; 
+   iOut << setprecision( 7 ) << i_bunch.ctime << " ";             // !! not relative time since emission,
+								  // but time since first interaction
 }
 
 /*! 
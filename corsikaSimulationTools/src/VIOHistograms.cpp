@@ -6,6 +6,10 @@
 
     \date
          26/04/04
+
+    Photons are not filled into the ROOT histograms directly but counted in
+    flat arrays (VIOHistogramAccumulator), which are added to the histograms
+    at the end of each event (before the tree is filled).
 */
 
 #include "VIOHistograms.h"
@@ -16,10 +20,97 @@ VIOHistograms::VIOHistograms()
    nevent = 0;
    degrad = 45. / atan( 1. );
 
+   fout = 0;
+   fTree = 0;
+   hCXYZ = 0;
+   bShort = false;
+
    bCORSIKA_coordinates = false;
 
    bSmallFile = false;
    bMuon = false;
+
+   fFill = newAccumulator();
+}
+
+VIOHistograms::~VIOHistograms()
+{
+   for( unsigned int i = 0; i < fAccumulators.size(); i++ ) delete fAccumulators[i];
+}
+
+/*!
+    new accumulator for filling histograms from another thread
+
+    the accumulator is owned by this class; it must not be filled while
+    newEvent() or terminate() is called
+*/
+VIOHistogramAccumulator* VIOHistograms::newAccumulator()
+{
+   VIOHistogramAccumulator *iA = new VIOHistogramAccumulator( this );
+   initAccumulator( iA );
+   fAccumulators.push_back( iA );
+   return iA;
+}
+
+void VIOHistograms::initAccumulator( VIOHistogramAccumulator *iA )
+{
+   if( !iA ) return;
+
+   iA->bFill = ( fTree && !bShort );
+   iA->bBunch = false;
+   if( !iA->bFill ) return;
+
+   iA->cBunch.init( hBunch );
+   iA->cT0.init( hT0 );
+   iA->cZem.init( hZem );
+   iA->cGXY.init( hGXY );
+   iA->cGZeAz.init( hGZeAz );
+   iA->cGLambda.init( hGLambda );
+   iA->cGProb.init( hGProb );
+   iA->cGZem.init( hGZem );
+   iA->cSXY.init( hSXY );
+   iA->cSZeAz.init( hSZeAz );
+   iA->cSLambda.init( hSLambda );
+   iA->cSProb.init( hSProb );
+   iA->cSZem.init( hSZem );
+
+   iA->cCXYZ.clear();
+   if( hCXYZ )
+   {
+      iA->cCXYZ.resize( hCXYZ->GetLast() + 1 );
+      for( int i = 0; i <= hCXYZ->GetLast(); i++ ) iA->cCXYZ[i].init( (TH2D*)hCXYZ->At( i ) );
+   }
+}
+
+/*!
+    add the counts of all accumulators to the ROOT histograms
+*/
+void VIOHistograms::flush()
+{
+   if( bShort || !fTree ) return;
+
+   for( unsigned int a = 0; a < fAccumulators.size(); a++ )
+   {
+      VIOHistogramAccumulator *iA = fAccumulators[a];
+
+      iA->cBunch.addTo( hBunch );
+      iA->cT0.addTo( hT0 );
+      iA->cZem.addTo( hZem );
+      iA->cGXY.addTo( hGXY );
+      iA->cGZeAz.addTo( hGZeAz );
+      iA->cGLambda.addTo( hGLambda );
+      iA->cGProb.addTo( hGProb );
+      iA->cGZem.addTo( hGZem );
+      iA->cSXY.addTo( hSXY );
+      iA->cSZeAz.addTo( hSZeAz );
+      iA->cSLambda.addTo( hSLambda );
+      iA->cSProb.addTo( hSProb );
+      iA->cSZem.addTo( hSZem );
+      if( hCXYZ )
+      {
+         for( unsigned int i = 0; i < iA->cCXYZ.size(); i++ ) iA->cCXYZ[i].addTo( (TH2D*)hCXYZ->At( i ) );
+      }
+   }
 }
 
 void VIOHistograms::init( string i_outfile, bool iShort )
@@ -209,10 +300,12 @@ void VIOHistograms::init( string i_outfile, bool iShort )
       fTree->Branch( "hSZem", "TH1D", &hSZem, 32000,0);   
    }
 
+   for( unsigned int i = 0; i < fAccumulators.size(); i++ ) initAccumulator( fAccumulators[i] );
 }    
 
 void VIOHistograms::newEvent( float *evth, telescope_array array, int i_array )
 {
+   flush();
    if( nevent > 0 ) fTree->Fill();
 
    if( !bShort )
@@ -296,87 +389,6 @@ void VIOHistograms::newEvent( float *evth, telescope_array array, int i_array )
    nevent++;
 }
    
-void VIOHistograms::fillBunch( bunch i_bunch, double itime )
-{
-   if( !bShort )
-   {
-      hBunch->Fill( i_bunch.photons );
-      hT0->Fill( itime );
-      hZem->Fill( i_bunch.zem * 0.01 );
-   }
-}
-
-/*!
-    in corsika coordinates
-*/
-void VIOHistograms::fillGenerated( bunch ph, double prob )
-{
-   if( !bShort )
-   {
-      double az = 0.;
-      double ze = 0.;
-
-      az = atan2( ph.cy, ph.cx );
-      az = redang( az );
-      if( ph.cy != 0. ) ze = asin( ph.cy / sin( az ) );
-      else              ze = asin( ph.cy / cos( az ) );
-      ze *= degrad;
-      az *= degrad;
-      if( az < 0 ) az = 360. - az;
-
-      if( !bCORSIKA_coordinates ) hGXY->Fill( ph.x, ph.y );
-      else                        hGXY->Fill( ph.y, -ph.x );
-      hGZeAz->Fill( ze, az );
-      hGProb->Fill( prob );
-      hGLambda->Fill( ph.lambda );
-      hGZem->Fill( ph.zem );
-   }
-}
-
-void VIOHistograms::fillSurvived( bunch ph, double prob )
-{
-   if( !bShort )
-   {
-      double az = 0.;
-      double ze = 0.;
-
-      az = atan2( ph.cy, ph.cx );
-      az = redang( az );
-      if( ph.cy != 0. )   ze = asin( ph.cy / sin( az ) );
-      else                ze = asin( ph.cy / cos( az ) );
-      ze *= degrad;
-      az *= degrad;
-      if( az < 0 ) az = 360. - az;
-
-      if( !bCORSIKA_coordinates ) hSXY->Fill( ph.x, ph.y );
-      else                        hSXY->Fill( ph.y, -ph.x );
-      hSZeAz->Fill( ze, az );
-      hSProb->Fill( prob );
-      hSLambda->Fill( ph.lambda );
-      hSZem->Fill( ph.zem );
-
-      if( !hCXYZ ) return;
-
-// fill xyz histograms
-      double xp, yp;
-      TH2D *it;
-      for( unsigned int i = 0; i < fXYZlevelsHeight.size(); i++ )
-      {
-         if( fXYZlevelsHeight[i] > ph.zem ) continue;
-         xp = ph.x + fXYZlevelsHeight[i] * ph.cx;
-         yp = ph.y + fXYZlevelsHeight[i] * ph.cy;
-
-         it = (TH2D*)hCXYZ->At(i);
-	 if( it )
-	 {
-	    if( !bCORSIKA_coordinates ) it->Fill( xp, yp );
-	    else                        it->Fill( yp, -xp );
-         }
-      }
-
-   }
-}
-
 void VIOHistograms::fillNPhotons( int iTel, double iphotons ) 
 {
    if( iTel < telNumber ) NCp[iTel] = iphotons;
@@ -384,6 +396,7 @@ void VIOHistograms::fillNPhotons( int iTel, double iphotons )
 
 void VIOHistograms::terminate()
 {
+   flush();
    if( fTree ) fTree->Fill();  // write last event
    
    if( fout )
@@ -490,6 +503,253 @@ void VIOHistograms::initXYZhistograms()
    }
 
    fTree->Branch("hCXYZ",&hCXYZ,256000,0);
+
+   for( unsigned int i = 0; i < fAccumulators.size(); i++ ) initAccumulator( fAccumulators[i] );
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+VIOHistogramCounts::VIOHistogramCounts()
+{
+   fNbinsX = 0;
+   fNbinsY = 0;
+   fXmin = 0.;
+   fXmax = 0.;
+   fYmin = 0.;
+   fYmax = 0.;
+   fEntries = 0.;
+   fSumw = 0.;
+   fSumwx = 0.;
+   fSumwx2 = 0.;
+   fSumwy = 0.;
+   fSumwy2 = 0.;
+   fSumwxy = 0.;
+}
+
+/*!
+    take the (fixed) binning from a TH1D or TH2D
+*/
+void VIOHistogramCounts::init( TH1 *h )
+{
+   fCounts.clear();
+   fFilled.clear();
+   if( !h ) return;
+
+   fNbinsX = h->GetXaxis()->GetNbins();
+   fXmin = h->GetXaxis()->GetXmin();
+   fXmax = h->GetXaxis()->GetXmax();
+   fNbinsY = 0;
+   fYmin = 0.;
+   fYmax = 0.;
+   if( h->GetDimension() == 2 )
+   {
+      fNbinsY = h->GetYaxis()->GetNbins();
+      fYmin = h->GetYaxis()->GetXmin();
+      fYmax = h->GetYaxis()->GetXmax();
+   }
+   fCounts.assign( ( fNbinsX + 2 ) * ( fNbinsY > 0 ? fNbinsY + 2 : 1 ), 0. );
+   fEntries = fSumw = fSumwx = fSumwx2 = fSumwy = fSumwy2 = fSumwxy = 0.;
+}
+
+/*!
+    add counts and statistics to the histogram and reset them
+*/
+void VIOHistogramCounts::addTo( TH1 *h )
+{
+   if( !h || fEntries == 0. ) return;
+
+   Double_t stats[13];            // large enough for all histogram types
+   for( int i = 0; i < 13; i++ ) stats[i] = 0.;
+   h->GetStats( stats );
+
+// TH1D and TH2D keep their bin contents in a TArrayD
+   TArrayD *iArray = dynamic_cast< TArrayD* >( h );
+   Double_t *iC = ( iArray ? iArray->GetArray() : 0 );
+   for( unsigned int i = 0; i < fFilled.size(); i++ )
+   {
+      if( iC ) iC[fFilled[i]] += fCounts[fFilled[i]];
+      else     h->AddBinContent( fFilled[i], fCounts[fFilled[i]] );
+      fCounts[fFilled[i]] = 0.;
+   }
+   fFilled.clear();
+
+// unit weights: sum of weights squared is the sum of weights
+   stats[0] += fSumw;
+   stats[1] += fSumw;
+   stats[2] += fSumwx;
+   stats[3] += fSumwx2;
+   if( fNbinsY > 0 )
+   {
+      stats[4] += fSumwy;
+      stats[5] += fSumwy2;
+      stats[6] += fSumwxy;
+   }
+   h->PutStats( stats );
+   h->SetEntries( h->GetEntries() + fEntries );
+
+   fEntries = fSumw = fSumwx = fSumwx2 = fSumwy = fSumwy2 = fSumwxy = 0.;
 }
 
+/////////////////////////////////////////////////////////////////////////////
+
+VIOHistogramAccumulator::VIOHistogramAccumulator( const VIOHistograms *iHistograms )
+{
+   fHistograms = iHistograms;
+   bFill = false;
+   bBunch = false;
+   bBunchLevels = false;
+   for( int i = 0; i < 5; i++ ) fBunch[i] = 0.;
+   fXYx = fXYy = fZe = fAz = 0.;
+   fGXYbin[0] = fGXYbin[1] = fGZeAzbin[0] = fGZeAzbin[1] = fGZembin = 0;
+   fSXYbin[0] = fSXYbin[1] = fSZeAzbin[0] = fSZeAzbin[1] = fSZembin = 0;
+}
 
+/*!
+    positions, angles and bins of the photons of a bunch
+*/
+void VIOHistogramAccumulator::setBunch( const bunch &ph )
+{
+   if( bBunch && fBunch[0] == ph.x && fBunch[1] == ph.y && fBunch[2] == ph.cx
+       && fBunch[3] == ph.cy && fBunch[4] == ph.zem ) return;
+
+   bBunch = true;
+   bBunchLevels = false;
+   fBunch[0] = ph.x;
+   fBunch[1] = ph.y;
+   fBunch[2] = ph.cx;
+   fBunch[3] = ph.cy;
+   fBunch[4] = ph.zem;
+
+   double az = 0.;
+   double ze = 0.;
+
+   az = atan2( ph.cy, ph.cx );
+   az = VIOHistograms::redang( az );
+   if( ph.cy != 0. ) ze = asin( ph.cy / sin( az ) );
+   else              ze = asin( ph.cy / cos( az ) );
+   ze *= fHistograms->degrad;
+   az *= fHistograms->degrad;
+   if( az < 0 ) az = 360. - az;
+   fZe = ze;
+   fAz = az;
+
+   if( !fHistograms->bCORSIKA_coordinates )
+   {
+      fXYx = ph.x;
+      fXYy = ph.y;
+   }
+   else
+   {
+      fXYx = ph.y;
+      fXYy = -ph.x;
+   }
+
+   fGXYbin[0] = cGXY.findBinX( fXYx );
+   fGXYbin[1] = cGXY.findBinY( fXYy );
+   fGZeAzbin[0] = cGZeAz.findBinX( fZe );
+   fGZeAzbin[1] = cGZeAz.findBinY( fAz );
+   fGZembin = cGZem.findBinX( ph.zem );
+   fSXYbin[0] = cSXY.findBinX( fXYx );
+   fSXYbin[1] = cSXY.findBinY( fXYy );
+   fSZeAzbin[0] = cSZeAz.findBinX( fZe );
+   fSZeAzbin[1] = cSZeAz.findBinY( fAz );
+   fSZembin = cSZem.findBinX( ph.zem );
+}
+
+/*!
+    positions and bins of the photons of a bunch at the XYZ levels
+*/
+void VIOHistogramAccumulator::setBunchLevels( const bunch &ph )
+{
+   bBunchLevels = true;
+
+   const vector< double > &iL = fHistograms->fXYZlevelsHeight;
+   fLevelBin.assign( 2 * cCXYZ.size(), -1 );
+   fLevelXY.assign( 2 * cCXYZ.size(), 0. );
+
+   double xp, yp;
+   for( unsigned int i = 0; i < cCXYZ.size() && i < iL.size(); i++ )
+   {
+      if( iL[i] > ph.zem ) continue;
+      xp = ph.x + iL[i] * ph.cx;
+      yp = ph.y + iL[i] * ph.cy;
+      if( !fHistograms->bCORSIKA_coordinates )
+      {
+         fLevelXY[2*i] = xp;
+         fLevelXY[2*i+1] = yp;
+      }
+      else
+      {
+         fLevelXY[2*i] = yp;
+         fLevelXY[2*i+1] = -xp;
+      }
+      fLevelBin[2*i] = cCXYZ[i].findBinX( fLevelXY[2*i] );
+      fLevelBin[2*i+1] = cCXYZ[i].findBinY( fLevelXY[2*i+1] );
+   }
+}
+
+void VIOHistogramAccumulator::fillBunch( const bunch &i_bunch, double itime )
+{
+   if( !bFill ) return;
+
+   cBunch.fill( i_bunch.photons );
+   cT0.fill( itime );
+   cZem.fill( i_bunch.zem * 0.01 );
+}
+
+/*!
+    in corsika coordinates
+*/
+void VIOHistogramAccumulator::fillGenerated( const bunch &ph, double prob )
+{
+   if( !bFill ) return;
+
+   setBunch( ph );
+
+   cGXY.fill( fGXYbin[0], fGXYbin[1], fXYx, fXYy );
+   cGZeAz.fill( fGZeAzbin[0], fGZeAzbin[1], fZe, fAz );
+   cGProb.fill( prob );
+   cGLambda.fill( ph.lambda );
+   cGZem.fill( fGZembin, ph.zem );
+}
+
+void VIOHistogramAccumulator::fillSurvived( const bunch &ph, double prob )
+{
+   if( !bFill ) return;
+
+   setBunch( ph );
+
+   cSXY.fill( fSXYbin[0], fSXYbin[1], fXYx, fXYy );
+   cSZeAz.fill( fSZeAzbin[0], fSZeAzbin[1], fZe, fAz );
+   cSProb.fill( prob );
+   cSLambda.fill( ph.lambda );
+   cSZem.fill( fSZembin, ph.zem );
+
+   if( cCXYZ.size() == 0 ) return;
+
+// fill xyz histograms
+   if( !bBunchLevels ) setBunchLevels( ph );
+   for( unsigned int i = 0; i < cCXYZ.size(); i++ )
+   {
+      if( fLevelBin[2*i] < 0 ) continue;
+      cCXYZ[i].fill( fLevelBin[2*i], fLevelBin[2*i+1], fLevelXY[2*i], fLevelXY[2*i+1] );
+   }
+}
+
+/*!
+    all bunches and photons of a photon batch
+*/
+void VIOHistogramAccumulator::fill( const VPhotonBatch &iBatch )
+{
+   if( !bFill ) return;
+
+   for( unsigned int i = 0; i < iBatch.getNBunches(); i++ ) fillBunch( iBatch.getBunch( i ), iBatch.fBunchTime[i] );
+
+   bunch ph;
+   for( unsigned int i = 0; i < iBatch.size(); i++ )
+   {
+      ph = iBatch.getPhoton( i );
+      fillGenerated( ph, iBatch.fProb[i] );
+      if( iBatch.fStatus[i] != VPhotonBatch::kGenerated ) fillSurvived( ph, iBatch.fProbSurvived[i] );
+   }
+}
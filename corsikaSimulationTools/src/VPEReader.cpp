@@ -0,0 +1,225 @@
+/*! \class VPEReader
+    \brief read pe data from root files
+
+    reads both tree layouts written by VPEWriter (default and compact)
+    into the same data vectors
+
+    compact trees are read branch by branch: nPE first, then the arrays
+    into buffers of the right size, which are decoded afterwards
+
+    \author Gernot Maier
+*/
+
+#include "VPEReader.h"
+#include "VPEWriter.h"
+
+#include "TList.h"
+#include "TParameter.h"
+
+VPEReader::VPEReader( TTree *t )
+{
+    fTree = t;
+    fCurrentTree = 0;
+    fTreeNumber = -1;
+    bCompact = false;
+
+    fNPE = 0;
+    fTimeOffset = 0.;
+    fPositionResolution = VPEWriter::fPositionResolution;
+    fTimeResolution = VPEWriter::fTimeResolution;
+    fWavelengthResolution = VPEWriter::fWavelengthResolution;
+    fB_nPE = 0;
+    fB_pixelIDdelta = 0;
+    fB_photonX = 0;
+    fB_photonY = 0;
+    fB_time = 0;
+    fB_wl = 0;
+
+    fEventNumber = 0;
+    fPrimaryType = 0;
+    fPrimaryEnergy = 0.;
+    fXcore = 0.;
+    fYcore = 0.;
+    fXcos = 0.;
+    fYcos = 0.;
+    fXsource = 0.;
+    fYsource = 0.;
+    fDelay = 0.;
+    fPE_pixelID = 0;
+    fPE_photonX = 0;
+    fPE_photonY = 0;
+    fPE_time = 0;
+    fPE_wl = 0;
+
+    if( !fTree ) return;
+
+    bCompact = ( fTree->GetBranch( "nPE" ) != 0 );
+
+    if( bCompact )
+    {
+       fPE_pixelID = new std::vector< unsigned int >();
+       fPE_photonX = new std::vector< float >();
+       fPE_photonY = new std::vector< float >();
+       fPE_time = new std::vector< float >();
+       fPE_wl = new std::vector< float >();
+       return;
+    }
+
+    fTree->SetBranchAddress( "eventNumber", &fEventNumber );
+    fTree->SetBranchAddress( "primaryType", &fPrimaryType );
+    fTree->SetBranchAddress( "primaryEnergy", &fPrimaryEnergy );
+    fTree->SetBranchAddress( "Xcore", &fXcore );
+    fTree->SetBranchAddress( "Ycore", &fYcore );
+    fTree->SetBranchAddress( "Xcos", &fXcos );
+    fTree->SetBranchAddress( "Ycos", &fYcos );
+    fTree->SetBranchAddress( "Xsource", &fXsource );
+    fTree->SetBranchAddress( "Ysource", &fYsource );
+    if( fTree->GetBranch( "delay" ) ) fTree->SetBranchAddress( "delay", &fDelay );
+    fTree->SetBranchAddress( "pixelID", &fPE_pixelID );
+    fTree->SetBranchAddress( "photonX", &fPE_photonX );
+    fTree->SetBranchAddress( "photonY", &fPE_photonY );
+    fTree->SetBranchAddress( "time", &fPE_time );
+    fTree->SetBranchAddress( "wavelength", &fPE_wl );
+}
+
+VPEReader::~VPEReader()
+{
+    if( !bCompact ) return;
+
+    delete fPE_pixelID;
+    delete fPE_photonX;
+    delete fPE_photonY;
+    delete fPE_time;
+    delete fPE_wl;
+}
+
+/*!
+    1 if pe are stored as pixel numbers, 0 for photon positions
+*/
+unsigned int VPEReader::usePixelNumbers()
+{
+    if( !fTree ) return 1;
+    if( bCompact ) return ( fTree->GetBranch( "pixelIDdelta" ) != 0 );
+
+    return 1;
+}
+
+int VPEReader::getEntry( Long64_t i )
+{
+    if( !fTree ) return 0;
+    if( bCompact ) return getCompactEntry( i );
+
+    return fTree->GetEntry( i );
+}
+
+/*!
+    resolution of a fixed-point quantity (from the user info of the tree)
+*/
+double VPEReader::getResolution( TTree *t, string iName, double iDefault )
+{
+    if( !t || !t->GetUserInfo() ) return iDefault;
+
+    TParameter< double > *p = (TParameter< double >*)t->GetUserInfo()->FindObject( iName.c_str() );
+    if( p ) return p->GetVal();
+
+    return iDefault;
+}
+
+/*!
+    branch addresses, branches and resolutions for a new tree (new file in a chain)
+*/
+void VPEReader::setCompactTree( TTree *t )
+{
+    fCurrentTree = t;
+
+    t->SetBranchAddress( "eventNumber", &fEventNumber );
+    t->SetBranchAddress( "primaryType", &fPrimaryType );
+    t->SetBranchAddress( "primaryEnergy", &fPrimaryEnergy );
+    t->SetBranchAddress( "Xcore", &fXcore );
+    t->SetBranchAddress( "Ycore", &fYcore );
+    t->SetBranchAddress( "Xcos", &fXcos );
+    t->SetBranchAddress( "Ycos", &fYcos );
+    t->SetBranchAddress( "Xsource", &fXsource );
+    t->SetBranchAddress( "Ysource", &fYsource );
+    t->SetBranchAddress( "delay", &fDelay );
+    t->SetBranchAddress( "nPE", &fNPE );
+    t->SetBranchAddress( "timeOffset", &fTimeOffset );
+
+    fB_nPE = t->GetBranch( "nPE" );
+    fB_pixelIDdelta = t->GetBranch( "pixelIDdelta" );
+    fB_photonX = t->GetBranch( "photonXfp" );
+    fB_photonY = t->GetBranch( "photonYfp" );
+    fB_time = t->GetBranch( "timefp" );
+    fB_wl = t->GetBranch( "wavelengthfp" );
+
+    fPositionResolution = getResolution( t, "positionResolution", VPEWriter::fPositionResolution );
+    fTimeResolution = getResolution( t, "timeResolution", VPEWriter::fTimeResolution );
+    fWavelengthResolution = getResolution( t, "wavelengthResolution", VPEWriter::fWavelengthResolution );
+}
+
+/*!
+    read and decode one entry of a compact tree
+*/
+int VPEReader::getCompactEntry( Long64_t i )
+{
+    Long64_t iLocal = fTree->LoadTree( i );
+    if( iLocal < 0 ) return 0;
+// new file in a chain: the old tree and its branches are deleted by LoadTree
+// (the new tree might have the same address, therefore check the tree number)
+    if( fTree->GetTreeNumber() != fTreeNumber || !fCurrentTree )
+    {
+       fTreeNumber = fTree->GetTreeNumber();
+       setCompactTree( fTree->GetTree() );
+    }
+    if( !fB_nPE || !fB_time || !fB_wl ) return 0;
+
+// array sizes first
+    int nbytes = fB_nPE->GetEntry( iLocal );
+
+    unsigned int n = ( fNPE > 0 ? fNPE : 1 );
+    fC_time.resize( n );
+    fC_wl.resize( n );
+    fB_time->SetAddress( &fC_time[0] );
+    fB_wl->SetAddress( &fC_wl[0] );
+    if( fB_pixelIDdelta )
+    {
+       fC_pixelIDdelta.resize( n );
+       fB_pixelIDdelta->SetAddress( &fC_pixelIDdelta[0] );
+    }
+    if( fB_photonX && fB_photonY )
+    {
+       fC_photonX.resize( n );
+       fC_photonY.resize( n );
+       fB_photonX->SetAddress( &fC_photonX[0] );
+       fB_photonY->SetAddress( &fC_photonY[0] );
+    }
+    nbytes += fCurrentTree->GetEntry( iLocal );
+
+// decode
+    fPE_pixelID->resize( fNPE );
+    fPE_photonX->resize( fNPE );
+    fPE_photonY->resize( fNPE );
+    fPE_time->resize( fNPE );
+    fPE_wl->resize( fNPE );
+    unsigned int iPixelID = 0;
+    for( unsigned int p = 0; p < fNPE; p++ )
+    {
+       if( fB_pixelIDdelta )
+       {
+          iPixelID += fC_pixelIDdelta[p];
+          (*fPE_pixelID)[p] = iPixelID;
+          (*fPE_photonX)[p] = 0.;
+          (*fPE_photonY)[p] = 0.;
+       }
+       else
+       {
+          (*fPE_pixelID)[p] = 0;
+          (*fPE_photonX)[p] = (float)( fC_photonX[p] * fPositionResolution );
+          (*fPE_photonY)[p] = (float)( fC_photonY[p] * fPositionResolution );
+       }
+       (*fPE_time)[p] = (float)( fTimeOffset + fC_time[p] * fTimeResolution );
+       (*fPE_wl)[p] = (float)( fC_wl[p] * fWavelengthResolution );
+    }
+
+    return nbytes;
+}
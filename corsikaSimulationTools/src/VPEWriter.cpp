@@ -3,15 +3,61 @@
 
     Revision $Id: VPEWriter.cpp,v 1.1.1.1 2011/07/21 20:35:56 gmaier Exp $
 
+    two tree layouts:
+
+    default: one std::vector per pe quantity (pixelID, photonX, photonY, time, wavelength)
+
+    compact: fixed-point arrays with nPE entries per event
+       - pixelIDdelta: pe sorted by pixel ID (stable), difference to the ID of the previous pe
+                       (first pe: pixel ID; pixel mode only)
+       - photonXfp, photonYfp: photon positions in units of fPositionResolution (position mode only)
+       - timefp: time minus timeOffset (earliest pe of the event) in units of fTimeResolution
+       - wavelengthfp: wavelength in units of fWavelengthResolution
+
+       resolutions are stored in the user info of the tree (read back by VPEReader)
+       basket sizes and the auto flush size are set from the expected number of pe per event
+       file size and speed gains of the compact layout are model estimates, not yet measured
+       with real data (see README.writeGRISU_pe_to_root)
+
     \author Gernot Maier
 */
 
 #include "VPEWriter.h"
 
-VPEWriter::VPEWriter( unsigned int iTelID, unsigned int iUsePixelNumbers, unsigned int iNInitEvents )
+#include <algorithm>
+#include <cmath>
+
+#include "TList.h"
+#include "TParameter.h"
+
+const double VPEWriter::fPositionResolution = 0.01;
+const double VPEWriter::fTimeResolution = 0.01;
+const double VPEWriter::fWavelengthResolution = 0.1;
+
+/*!
+    sort pe by pixel ID (used with stable_sort)
+*/
+class VPEWriter_sortPixelID
+{
+   public:
+   const std::vector< unsigned int > *fPixelID;
+
+   VPEWriter_sortPixelID( const std::vector< unsigned int > *iPixelID ) { fPixelID = iPixelID; }
+   bool operator()( unsigned int a, unsigned int b ) const { return (*fPixelID)[a] < (*fPixelID)[b]; }
+};
+
+VPEWriter::VPEWriter( unsigned int iTelID, unsigned int iUsePixelNumbers, unsigned int iNInitEvents, bool iCompact )
 {
     fTelID = iTelID;
     fUsePixelNumbers = iUsePixelNumbers;
+    bCompact = iCompact;
+    fNPE = 0;
+    fTimeOffset = 0.;
+    fB_pixelIDdelta = 0;
+    fB_photonX = 0;
+    fB_photonY = 0;
+    fB_time = 0;
+    fB_wl = 0;
 
 // data vectors
     fPE_pixelID = new std::vector< unsigned int >();
@@ -35,8 +81,9 @@ VPEWriter::VPEWriter( unsigned int iTelID, unsigned int iUsePixelNumbers, unsign
     char htitle[400];
 
     sprintf( hname, "tPE_T%d", fTelID );
-    sprintf( htitle, "pe data for telescope %d", fTelID );
-    
+    if( bCompact ) sprintf( htitle, "pe data for telescope %d (compact)", fTelID );
+    else           sprintf( htitle, "pe data for telescope %d", fTelID );
+
     fTree = new TTree( hname, htitle );
 
     fTree->Branch( "eventNumber", &fEventNumber, "eventNumber/i" );
@@ -49,6 +96,11 @@ VPEWriter::VPEWriter( unsigned int iTelID, unsigned int iUsePixelNumbers, unsign
     fTree->Branch( "Xsource", &fXsource, "Xsource/F" );
     fTree->Branch( "Ysource", &fYsource, "Ysource/F" );
     fTree->Branch( "delay", &fDelay, "delay/F" );
+    if( bCompact )
+    {
+       initCompactTree( iNInitEvents );
+       return;
+    }
     fTree->Branch( "pixelID", &fPE_pixelID );
     fTree->Branch( "photonX", &fPE_photonX );
     fTree->Branch( "photonY", &fPE_photonY );
@@ -57,6 +109,82 @@ VPEWriter::VPEWriter( unsigned int iTelID, unsigned int iUsePixelNumbers, unsign
 
 }
 
+VPEWriter::~VPEWriter()
+{
+    delete fPE_pixelID;
+    delete fPE_photonX;
+    delete fPE_photonY;
+    delete fPE_time;
+    delete fPE_wl;
+}
+
+/*!
+    branches, basket sizes and user info of the compact tree layout
+
+    \param iNInitEvents  expected number of pe per event
+*/
+void VPEWriter::initCompactTree( unsigned int iNInitEvents )
+{
+    if( iNInitEvents < 1 ) iNInitEvents = 1;
+
+// arrays have at least one element (branch addresses)
+    fC_index.reserve( iNInitEvents );
+    fC_pixelIDdelta.reserve( iNInitEvents );
+    fC_pixelIDdelta.resize( 1, 0 );
+    fC_photonX.resize( 1, 0 );
+    fC_photonY.resize( 1, 0 );
+    fC_time.reserve( iNInitEvents );
+    fC_time.resize( 1, 0 );
+    fC_wl.reserve( iNInitEvents );
+    fC_wl.resize( 1, 0 );
+
+    fTree->Branch( "nPE", &fNPE, "nPE/i" );
+    fTree->Branch( "timeOffset", &fTimeOffset, "timeOffset/D" );
+    unsigned int iBytesPerPE = sizeof( UInt_t ) + sizeof( UShort_t );
+    if( fUsePixelNumbers )
+    {
+       fB_pixelIDdelta = fTree->Branch( "pixelIDdelta", &fC_pixelIDdelta[0], "pixelIDdelta[nPE]/i" );
+       setBasketSize( "pixelIDdelta", iNInitEvents, sizeof( UInt_t ) );
+       iBytesPerPE += sizeof( UInt_t );
+    }
+    else
+    {
+       fC_photonX.reserve( iNInitEvents );
+       fC_photonY.reserve( iNInitEvents );
+       fB_photonX = fTree->Branch( "photonXfp", &fC_photonX[0], "photonXfp[nPE]/I" );
+       fB_photonY = fTree->Branch( "photonYfp", &fC_photonY[0], "photonYfp[nPE]/I" );
+       setBasketSize( "photonXfp", iNInitEvents, sizeof( Int_t ) );
+       setBasketSize( "photonYfp", iNInitEvents, sizeof( Int_t ) );
+       iBytesPerPE += 2 * sizeof( Int_t );
+    }
+    fB_time = fTree->Branch( "timefp", &fC_time[0], "timefp[nPE]/i" );
+    fB_wl = fTree->Branch( "wavelengthfp", &fC_wl[0], "wavelengthfp[nPE]/s" );
+    setBasketSize( "timefp", iNInitEvents, sizeof( UInt_t ) );
+    setBasketSize( "wavelengthfp", iNInitEvents, sizeof( UShort_t ) );
+
+// flush (and compress, in parallel with implicit MT) about every 30 MB of expected data;
+// a fixed number of events keeps ROOT from resizing the baskets set above
+    Long64_t iAutoFlush = 30000000 / ( (Long64_t)iNInitEvents * iBytesPerPE );
+    if( iAutoFlush < 1 ) iAutoFlush = 1;
+    fTree->SetAutoFlush( iAutoFlush );
+
+    fTree->GetUserInfo()->Add( new TParameter< double >( "positionResolution", fPositionResolution ) );
+    fTree->GetUserInfo()->Add( new TParameter< double >( "timeResolution", fTimeResolution ) );
+    fTree->GetUserInfo()->Add( new TParameter< double >( "wavelengthResolution", fWavelengthResolution ) );
+}
+
+/*!
+    basket size of an array branch: expected data of one event (between 32 kB and 8 MB)
+*/
+void VPEWriter::setBasketSize( const char *iBranchName, unsigned int iNInitEvents, unsigned int iSize )
+{
+    double iBasketSize = (double)iNInitEvents * iSize;
+    if( iBasketSize < 32000. )   iBasketSize = 32000.;
+    if( iBasketSize > 8000000. ) iBasketSize = 8000000.;
+
+    fTree->SetBasketSize( iBranchName, (Int_t)iBasketSize );
+}
+
 
 int VPEWriter::add_event( unsigned int iEventNumber, unsigned int iPrimaryType, float iPrimaryEnergy, float iXcore, float iYcore, float iXcos, float iYcos, float iXsource, float iYsource, float iDelay )
 {
@@ -73,7 +201,9 @@ int VPEWriter::add_event( unsigned int iEventNumber, unsigned int iPrimaryType,
     fYsource = iYsource;
     fDelay = iDelay;
 
-    int r = fTree->Fill();
+    int r = 0;
+    if( bCompact ) r = add_compact_event();
+    else           r = fTree->Fill();
 
     fPE_pixelID->clear();
     fPE_photonX->clear();
@@ -84,6 +214,64 @@ int VPEWriter::add_event( unsigned int iEventNumber, unsigned int iPrimaryType,
     return r;
 }
 
+/*!
+    encode the pe of the current event and fill the compact tree
+*/
+int VPEWriter::add_compact_event()
+{
+    fNPE = fPE_time->size();
+
+// earliest pe defines the time offset
+    fTimeOffset = 0.;
+    if( fNPE > 0 ) fTimeOffset = *min_element( fPE_time->begin(), fPE_time->end() );
+
+// pe order: sorted by pixel ID in pixel mode, as filled otherwise
+    fC_index.resize( fNPE );
+    for( unsigned int i = 0; i < fNPE; i++ ) fC_index[i] = i;
+    if( fUsePixelNumbers ) stable_sort( fC_index.begin(), fC_index.end(), VPEWriter_sortPixelID( fPE_pixelID ) );
+
+    unsigned int n = ( fNPE > 0 ? fNPE : 1 );
+    fC_time.resize( n, 0 );
+    fC_wl.resize( n, 0 );
+    if( fUsePixelNumbers ) fC_pixelIDdelta.resize( n, 0 );
+    else
+    {
+       fC_photonX.resize( n, 0 );
+       fC_photonY.resize( n, 0 );
+    }
+
+    unsigned int iPixelID = 0;
+    double iWL = 0.;
+    for( unsigned int i = 0; i < fNPE; i++ )
+    {
+       unsigned int j = fC_index[i];
+       if( fUsePixelNumbers )
+       {
+          fC_pixelIDdelta[i] = (*fPE_pixelID)[j] - iPixelID;
+          iPixelID = (*fPE_pixelID)[j];
+       }
+       else
+       {
+          fC_photonX[i] = (Int_t)floor( (*fPE_photonX)[j] / fPositionResolution + 0.5 );
+          fC_photonY[i] = (Int_t)floor( (*fPE_photonY)[j] / fPositionResolution + 0.5 );
+       }
+       fC_time[i] = (UInt_t)floor( ( (*fPE_time)[j] - fTimeOffset ) / fTimeResolution + 0.5 );
+       iWL = floor( (*fPE_wl)[j] / fWavelengthResolution + 0.5 );
+       if( iWL < 0. )     iWL = 0.;
+       if( iWL > 65535. ) iWL = 65535.;
+       fC_wl[i] = (UShort_t)iWL;
+    }
+
+// vectors might have been reallocated
+    if( fB_pixelIDdelta ) fB_pixelIDdelta->SetAddress( &fC_pixelIDdelta[0] );
+    if( fB_photonX )      fB_photonX->SetAddress( &fC_photonX[0] );
+    if( fB_photonY )      fB_photonY->SetAddress( &fC_photonY[0] );
+    if( fB_time )         fB_time->SetAddress( &fC_time[0] );
+    if( fB_wl )           fB_wl->SetAddress( &fC_wl[0] );
+
+    return fTree->Fill();
+}
+
 
 void VPEWriter::add_pe( unsigned int iPE_pixelID, float iPE_photonX, float iPE_photonY, float iPE_time, float iPE_wl )
 {
@@ -16,8 +16,10 @@
 #include "mc_tel.h"
 #include "atmo.h"
 #include "sim_cors.h"
+#include "fileopen.h"     /* Transparent (and in-process) decompression. */
 
 #include <cmath>
+#include <algorithm>
 #include <bitset>
 #include <fstream>
 #include <iostream>
@@ -29,12 +31,16 @@
 #include "VCORSIKARunheader.h"
 #include "VIOHistograms.h"           // histogramming class (only needed for test histograms)
 #include "VGrisu.h"                  // writing of grisu format
+#include "VPhotonBatch.h"            // photons of one telescope
 
 #include "TRandom3.h"                 // if you don't like root -> use your own random generator
                                      // + delete all VIOHistograms lines
 
 #define MAX_BUNCHES 50000000   // (GM) why this limitation? (original 50000)
 
+// number of bunches filtered and written in one go (see fillPhotonBatch())
+static const int fPhotonBatchBunches = 10000;
+
 static double airlightspeed = 29.9792458/1.0002256; /* [cm/ns] at H=2200 m */
 
 /*! Refraction index of air as a function of height in km (0km<=h<=8km) */
@@ -175,6 +181,117 @@ vector< double > getXYZlevels( double istart, double idiff )
     return iL;
 }
 
+/*!
+    photon filter for a range of bunches of one telescope: wavelengths,
+    atmospheric extinction and quantum efficiency
+
+    all generated photons are stored in iBatch (cleared first), with their
+    status (see VPhotonBatch::E_status). Uses no other state than its
+    arguments, so different telescopes can be filtered in parallel (each
+    with its own random generator and batch)
+*/
+void fillPhotonBatch( const bunch *iBunches, int nbunches, int itel, const telescope_array &array,
+                      double wl_lower_limit, double wl_upper_limit, double queff,
+		      VAtmosAbsorption &fAtabso, TRandom3 &fRandom, VPhotonBatch &iBatch )
+{
+   iBatch.clear();
+   iBatch.fTelescope = itel;
+
+   double wl_bunch, airmass, cx, cy, cz;
+   double tel_dist, tel_delay, corstime;
+   double lambda, prob, probGenerated, probSurvived;
+   unsigned char iStatus;
+   float iPhotons;
+   bunch Chphoton;
+
+   for( int ibunch = 0; ibunch < nbunches; ibunch++ )
+   {
+      wl_bunch = iBunches[ibunch].lambda;     
+      cx = iBunches[ibunch].cx;
+      cy = iBunches[ibunch].cy;
+      cz = -1.*sqrt(1.-cx*cx-cy*cy); /* direction is downwards */
+      /* Use secans(zenith angle) for airmass, */
+      /* i.e. assume a plane atmosphere. */
+      if( cz != 0. ) airmass = -1./cz;
+      else           airmass = 1.e16;
+      /* Distance between CORSIKA observation level and */
+      /* telescope fixed position. */
+      tel_dist = array.ztel[itel] * airmass;
+      /* Note that, although tracing starts at the CORSIKA */
+      /* level, the bunch time corresponds to the crossing */
+      /* of the telescope level. */
+      tel_delay = tel_dist / airlightspeed;
+      /* Note also that the photon bunch might be created */
+      /* behind the telescope mirror. Check in raytracing. */
+
+      // (GM) restore arrival time at ground: 
+      // add travel time from telescope plane to ground plane
+      corstime = iBunches[ibunch].ctime + tel_delay;
+
+      iBatch.addBunch( iBunches[ibunch], corstime );
+
+// now loop over bunch
+      for( iPhotons = iBunches[ibunch].photons; iPhotons > 0; iPhotons -= 1. )
+      {
+// photon wavelength
+         if ( wl_bunch == 0. )
+         {
+            /* get photon wavelength according to 1./lambda^2 distribution */
+            lambda = 1./(1./wl_lower_limit-fRandom.Uniform( 1. )* (1./wl_lower_limit-1./wl_upper_limit));
+         }
+         else if ( wl_bunch < 0. )
+         /* This indicates that quantum efficiency, mirror */
+         /* reflectivity, and atmospheric transmission */
+         /* have already been applied in CORSIKA (which */
+         /* was CMZ extracted then with the CEFFIC option). */
+         /* (GM) IGNORE CEFFIC!!!! */
+         {
+            lambda = 1./(1./wl_lower_limit-fRandom.Uniform( 1. )* (1./wl_lower_limit-1./wl_upper_limit));
+         }
+         else 
+            /* Wavelength already generated in Corsika */ // (GM) for non-standard CORSIKA
+            lambda = wl_bunch;
+
+// atmospheric extinction
+         if ( lambda >= 1000 ) continue;
+         else if ( lambda >= 0 )
+         {
+            prob = fAtabso.probAtmAbsorbed( lambda, (double)iBunches[ibunch].zem * 0.01, -1. * cz );
+         }
+         else prob = 1.;
+// fill photon structure
+         Chphoton.photons = 1.;
+         Chphoton.x = iBunches[ibunch].x * 0.01 + array.xtel[itel] * 0.01;
+         Chphoton.y = iBunches[ibunch].y * 0.01 + array.ytel[itel] * 0.01;
+         Chphoton.cx = iBunches[ibunch].cx;
+         Chphoton.cy = iBunches[ibunch].cy;
+         Chphoton.ctime = corstime;
+         Chphoton.zem = iBunches[ibunch].zem * 0.01;
+         Chphoton.lambda = lambda;
+
+         probGenerated = prob;
+         probSurvived = 0.;
+         iStatus = VPhotonBatch::kGenerated;
+// extinction + efficiencies
+         if ( iPhotons < 1. ) prob *= iPhotons;
+         if ( prob <= 1. )
+         {
+            double iRand = fRandom.Uniform( 1. );
+            if ( iRand <= prob )
+            {
+// survived atmospheric extinction
+               iStatus = VPhotonBatch::kSurvived;
+               probSurvived = prob;
+// apply global quantum efficiency
+               prob *= queff;
+               if ( iRand <= prob ) iStatus = VPhotonBatch::kDetected;
+            }
+         }
+         iBatch.addPhoton( Chphoton, probGenerated, probSurvived, iStatus );
+      }
+   }
+}
+
 
 /**********************************************************************************
 
@@ -191,13 +308,10 @@ int main(int argc, char **argv)
    bool bstdout = false;
    bool bHisto = false;    // if true, tree and histograms are filled
    bool bPrintHeaders = false;
-   double distance;
    int nbunches;
    int itc, iarray, jarray, ibunch;
-   double lambda;
    double photons;
-   double wl_bunch, airmass, cx, cy, cz, prob;
-   double tel_dist, tel_delay;
+   double cx, cy, cz;
    FILE *data_file;
    static double elow;
    static struct bunch bunches[MAX_BUNCHES];
@@ -209,8 +323,7 @@ int main(int argc, char **argv)
    double az = 0.;
    static int have_atm_profile = 0;
    double toffset = 0.;
-   double corstime;
-   bunch Chphoton;
+   VPhotonBatch fPhotonBatch;                           // photons of one telescope (one chunk of bunches)
    string fCorsikaIO = "";                              // corsika io file
    string fAtmosModel = "modtran4";                     
    string fAtmosFile  = "data/us76.50km.ext";
@@ -455,7 +568,7 @@ int main(int argc, char **argv)
 // try to open Corsika file 
    data_file = 0;
    if( !bstdout ) printf("Input file: %s\n", fCorsikaIO.c_str() );
-   if ( (data_file = fopen(fCorsikaIO.c_str(),"r")) == NULL )
+   if ( (data_file = fileopen(fCorsikaIO.c_str(),"r")) == NULL )
    {
       perror(fCorsikaIO.c_str());
       exit(1);
@@ -726,112 +839,26 @@ int main(int argc, char **argv)
 // check if this telescope should be analysed
 	       if( itel < (int)fTelescopeMatrix.size() && fTelescopeMatrix[itel] < 0 ) continue;
 
-// loop over all bunches
-               for ( ibunch=0; ibunch<nbunches; ibunch++ )   // loop over all bunches for this telescope
+// loop over all bunches for this telescope (in chunks of fPhotonBatchBunches bunches)
+               for ( ibunch=0; ibunch<nbunches; ibunch+=fPhotonBatchBunches )
                {
-                  wl_bunch = bunches[ibunch].lambda;     
-                  cx = bunches[ibunch].cx;
-                  cy = bunches[ibunch].cy;
-                  cz = -1.*sqrt(1.-cx*cx-cy*cy); /* direction is downwards */
-                  /* Use secans(zenith angle) for airmass, */
-                  /* i.e. assume a plane atmosphere. */
-		  if( cz != 0. ) airmass = -1./cz;
-		  else           airmass = 1.e16;
-                  /* Distance between point of emission and */
-                  /* the CORSIKA observation level */
-                  distance = (bunches[ibunch].zem-array.obs_height) * airmass;      // bunches[ibunch].zem is above sea level
-                  /* Distance between CORSIKA observation level and */
-                  /* telescope fixed position. */
-                  tel_dist = array.ztel[itel] * airmass;
-                  /* Note that, although tracing starts at the CORSIKA */
-                  /* level, the bunch time corresponds to the crossing */
-                  /* of the telescope level. */
-                  tel_delay = tel_dist / airlightspeed;
-		  /* Note also that the photon bunch might be created */
-		  /* behind the telescope mirror. Check in raytracing. */
-
-		  // (GM) restore arrival time at ground: 
-		  // add travel time from telescope plane to ground plane
-		  corstime = bunches[ibunch].ctime + tel_delay;
-
-// fill all bunch specific stuff into histograms
-                  if( bHisto ) fHisto->fillBunch( bunches[ibunch], corstime ); 
-// now loop over bunch
-                  for (; bunches[ibunch].photons>0; bunches[ibunch].photons-=1.)
+                  fillPhotonBatch( bunches+ibunch, min( fPhotonBatchBunches, nbunches-ibunch ), itel, array,
+                                   wl_lower_limit, wl_upper_limit, queff, fAtabso, fRandom, fPhotonBatch );
+// fill histograms (generated photons and photons surviving atmospheric extinction)
+                  if( bHisto ) fHisto->fill( fPhotonBatch );
+// write photons to grisu output file (after quantum efficiency)
+                  if( bGRISU )
                   {
-// photon wavelength
-                     if ( wl_bunch == 0. )
-                     {
-                        /* get photon wavelength according to 1./lambda^2 distribution */
-                        lambda = 1./(1./wl_lower_limit-fRandom.Uniform( 1. )* (1./wl_lower_limit-1./wl_upper_limit));
-                     }
-		     else if ( wl_bunch < 0. )
-		        /* This indicates that quantum efficiency, mirror */
-			/* reflectivity, and atmospheric transmission */
-			/* have already been applied in CORSIKA (which */
-			/* was CMZ extracted then with the CEFFIC option). */
+                     if( nTel > -2 )
                      {
-// IGNORE CEFFIC!!!!
-//		        if( cherenkov_flag == 6175 )
-			{
-			   lambda = 1./(1./wl_lower_limit-fRandom.Uniform( 1. )* (1./wl_lower_limit-1./wl_upper_limit));
-                        }
-/*			else
-			{
-			   lambda = -1.;
-                        } */
+                        if( fGrisu.size() == 1 ) fGrisu[0]->writePhotons( fPhotonBatch, fTelescopeMatrix[itel] );
                      }
-                     else 
-                        /* Wavelength already generated in Corsika */ // (GM) for non-standard CORSIKA
-                        lambda = wl_bunch;
-
-// atmospheric extinction
-                     if ( lambda >= 1000 ) continue;
-                     else if ( lambda >= 0 )
-		     {
-			prob = fAtabso.probAtmAbsorbed( lambda, (double)bunches[ibunch].zem * 0.01, -1. * cz );
-		     }
-		     else prob = 1.;
-// fill photon structure
-		     Chphoton.photons = 1.;
-		     Chphoton.x = bunches[ibunch].x * 0.01 + array.xtel[itel] * 0.01;
-		     Chphoton.y = bunches[ibunch].y * 0.01 + array.ytel[itel] * 0.01;
-		     Chphoton.cx = bunches[ibunch].cx;
-		     Chphoton.cy = bunches[ibunch].cy;
-		     Chphoton.ctime = corstime;
-		     Chphoton.zem = bunches[ibunch].zem * 0.01;
-		     Chphoton.lambda = lambda;
-// fill generated photons into histograms
-		     if( bHisto ) fHisto->fillGenerated( Chphoton, prob );
-// extinction + efficiencies
-                     if ( bunches[ibunch].photons < 1. ) prob *= bunches[ibunch].photons;
-                     if ( prob <= 1. )
+                     else if( nTel == -2 )
                      {
-		         double iRand = fRandom.Uniform( 1. );
-			 if ( iRand > prob ) continue;
-     // fill histograms without quantum efficiency applied (only atm.extinction)
-		         if( bHisto ) fHisto->fillSurvived( Chphoton, prob );
-     // apply global quantum efficiency
-                         prob *= queff;
-			 if ( iRand > prob ) continue;
-     // write photons to iotxt output file (after quantum efficiency)
-			 if( bGRISU )
-			 {
-			    if( nTel > -2 )
-			    {
-			        if( fGrisu.size() == 1 ) fGrisu[0]->writePhotons( Chphoton, fTelescopeMatrix[itel] ); 
-                            }
-			    else if( nTel == -2 )
-			    {
-// move all photons around coordinates centre
-                                Chphoton.x -= array.xtel[itel]/1.e2;
-                                Chphoton.y -= array.ytel[itel]/1.e2;
-// telescope ID is always 0
-				if( itel < (int)fGrisu.size() ) fGrisu[itel]->writePhotons( Chphoton, 0 );
-                            }
-                         }
+// move all photons around coordinates centre, telescope ID is always 0
+                        if( itel < (int)fGrisu.size() ) fGrisu[itel]->writePhotons( fPhotonBatch, 0, array.xtel[itel]/1.e2, array.ytel[itel]/1.e2 );
                      }
-		  }
+                  }
 	       }
             } /* End of loop over telescopes */
             end_read_tel_array(iobuf, &item_header);
@@ -859,7 +886,7 @@ int main(int argc, char **argv)
       } /* End of switch over all input data types */
       if( readNevent >= nevents && nevents > 0 ) break;
     } /* End of loop over all data in the input file */          
-    fclose(iobuf->input_file);
+    fileclose(iobuf->input_file);
     iobuf->input_file = NULL;
    if( bHisto && fHisto ) fHisto->terminate();  
       if( fRunHeader ) fRunHeader->printHeader( cout );
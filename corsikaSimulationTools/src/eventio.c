@@ -4300,9 +4300,8 @@ int skip_io_block (IO_BUFFER *iobuf, IO_ITEM_HEADER *item_header)
       {
          if ( iobuf->regular == 0 )
          {
-            fstat(iobuf->input_fileno,&st);
 #ifdef S_IFREG
-            if ( st.st_mode & S_IFREG )
+            if ( fstat(iobuf->input_fileno,&st) == 0 && (st.st_mode & S_IFREG) )
                iobuf->regular = 1;
             else
 #endif
@@ -4332,9 +4331,10 @@ int skip_io_block (IO_BUFFER *iobuf, IO_ITEM_HEADER *item_header)
       {
          if ( iobuf->regular == 0 )
          {
-            fstat(fileno(iobuf->input_file),&st);
 #ifdef S_IFREG
-            if ( st.st_mode & S_IFREG )
+            /* Streams without a file handle (e.g. in-process */
+            /* decompression, see fileopen()) are not seekable. */
+            if ( fstat(fileno(iobuf->input_file),&st) == 0 && (st.st_mode & S_IFREG) )
                iobuf->regular = 1;
             else
 #endif
@@ -39,6 +39,12 @@
  *      ( @c .gz and @c .bz2 ) will be
  *      automatically decompressed when reading or compressed when
  *      writing (in a pipe, i.e. without producing temporary copies).
+ *  @li When compiled with @c WITH_ZLIB and/or @c WITH_BZIP2, files
+ *      compressed with @c gzip or @c bzip2 are decompressed for reading
+ *      within the process (no @c gzip or @c bzip2 process, no pipe),
+ *      on a separate thread that decompresses ahead of the reader.
+ *      Setting the environment variable @c FILEOPEN_USE_PIPE falls back
+ *      to the external programs.
  *  @li In the same way, files compressed with @c lzop (for extension
  *      @c .lzo ) and @c lzma (for extension  @c .lzma ) are handled
  *      on the fly. No check is made if these programs are installed.
@@ -58,6 +64,10 @@
  *  @version @verbatim CVS $Revision: 1.2 $ @endverbatim 
  */
 
+#if ( defined(WITH_ZLIB) || defined(WITH_BZIP2) ) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE 1 /* for fopencookie() */
+#endif
+
 #include "../inc/initial.h"
 #include "../inc/straux.h"
 #include "../inc/fileopen.h"
@@ -65,6 +75,20 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 
+#if ( defined(WITH_ZLIB) || defined(WITH_BZIP2) ) && \
+    ( defined(__GLIBC__) || defined(__APPLE__) || defined(__FreeBSD__) )
+#define WITH_INPROC_DECOMPRESSION 1
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef WITH_BZIP2
+#include <bzlib.h>
+#endif
+#endif
+
 /** An element in a linked list of include paths. */
 struct incpath
 {
@@ -277,6 +301,531 @@ static FILE *cmp_popen (const char *fname, const char *mode, int compression)
    return f;
 }
 
+#ifdef WITH_INPROC_DECOMPRESSION
+
+/* In-process decompression of gzip and bzip2 files for reading.      */
+/* A thread reads the compressed file and decompresses it into a ring */
+/* of chunks, ahead of the reader. The reader gets a stdio stream     */
+/* (see fopencookie()/funopen()) which takes its data from the ring.  */
+
+#define DCMP_NUM_CHUNKS 8            /**< Chunks in the ring */
+#define DCMP_CHUNK_SIZE (1024*1024)  /**< Decompressed bytes per chunk */
+#define DCMP_INPUT_SIZE (256*1024)   /**< Compressed bytes per read() */
+
+/** State of one file being decompressed in-process. */
+struct dcmp_stream
+{
+   int fd;                  /**< The compressed file */
+   int compression;         /**< 1: gzip, 2: bzip2 */
+   char *fname;             /**< File name, for error messages */
+   pthread_t thread;        /**< The decompressing thread */
+   pthread_mutex_t lock;    /**< Protects the ring and the flags */
+   pthread_cond_t cond;     /**< Ring changed or reader went away */
+   char *chunk[DCMP_NUM_CHUNKS];      /**< The ring of chunks */
+   size_t chunk_len[DCMP_NUM_CHUNKS]; /**< Bytes in each full chunk */
+   int head;                /**< Chunk the reader is reading */
+   int count;               /**< Number of full chunks, from head on */
+   size_t pos;              /**< Read position in the head chunk */
+   int done;                /**< No more chunks will follow */
+   int error;               /**< Set if decompression failed */
+   int quit;                /**< Reader closed the stream */
+   FILE *f;                 /**< The stream handed out */
+   struct dcmp_stream *next; /**< Next open stream */
+};
+
+/** All open in-process decompression streams (for fileclose()). */
+static struct dcmp_stream *dcmp_streams = NULL;
+static pthread_mutex_t dcmp_streams_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Read more compressed data; returns bytes read, 0 at EOF, -1 on error. */
+
+static ssize_t dcmp_fill (struct dcmp_stream *s, char *in)
+{
+   ssize_t n;
+   do
+      n = read(s->fd,in,DCMP_INPUT_SIZE);
+   while ( n < 0 && errno == EINTR );
+   return n;
+}
+
+/** 
+ *  @short Get an empty chunk to decompress into, or NULL if the reader
+ *  went away. Waits while the ring is full.
+ */
+
+static char *dcmp_empty_chunk (struct dcmp_stream *s, int *ichunk)
+{
+   char *c = NULL;
+   pthread_mutex_lock(&s->lock);
+   while ( s->count == DCMP_NUM_CHUNKS && !s->quit )
+      pthread_cond_wait(&s->cond,&s->lock);
+   if ( !s->quit )
+   {
+      *ichunk = (s->head+s->count) % DCMP_NUM_CHUNKS;
+      c = s->chunk[*ichunk];
+   }
+   pthread_mutex_unlock(&s->lock);
+   return c;
+}
+
+/** Hand a chunk with len decompressed bytes over to the reader. */
+
+static void dcmp_put_chunk (struct dcmp_stream *s, int ichunk, size_t len)
+{
+   pthread_mutex_lock(&s->lock);
+   s->chunk_len[ichunk] = len;
+   s->count++;
+   pthread_cond_broadcast(&s->cond);
+   pthread_mutex_unlock(&s->lock);
+}
+
+/** 
+ *  @short The decompressing thread.
+ *
+ *  Concatenated gzip members or bzip2 streams are decompressed one
+ *  after the other, as by @c gzip @c -d and @c bzip2 @c -d, and like
+ *  those, anything after the end of a member that does not start a new
+ *  one is ignored with a warning.
+ */
+
+static void *dcmp_thread (void *arg)
+{
+   struct dcmp_stream *s = (struct dcmp_stream *) arg;
+   char *in = malloc(DCMP_INPUT_SIZE);
+   char *out = NULL;
+   int ichunk = 0;
+   size_t avail_in = 0, avail_out = 0;
+   const char *next_in = in;
+   int at_end = 0;     /* No more input */
+   int in_member = 0;  /* Inside a gzip member or bzip2 stream */
+   int members = 0;    /* Number of complete members so far */
+   int failed = 0;
+   const char *msg = NULL;
+#ifdef WITH_ZLIB
+   z_stream zs;
+#endif
+#ifdef WITH_BZIP2
+   bz_stream bs;
+#endif
+
+   if ( in == NULL )
+      failed = 1;
+
+   while ( !failed )
+   {
+      size_t used_in, made_out;
+
+      if ( avail_in == 0 && !at_end )
+      {
+         ssize_t n = dcmp_fill(s,in);
+         if ( n < 0 )
+         {
+            msg = strerror(errno);
+            failed = 1;
+            break;
+         }
+         if ( n == 0 )
+            at_end = 1;
+         next_in = in;
+         avail_in = (size_t) n;
+      }
+      if ( !in_member )
+      {
+         if ( avail_in == 0 && at_end )
+            break; /* Regular end of the file */
+         /* Start a new member */
+#ifdef WITH_ZLIB
+         if ( s->compression == 1 )
+         {
+            memset(&zs,0,sizeof(zs));
+            if ( inflateInit2(&zs,15+16) != Z_OK )
+            {
+               failed = 1;
+               break;
+            }
+         }
+#endif
+#ifdef WITH_BZIP2
+         if ( s->compression == 2 )
+         {
+            memset(&bs,0,sizeof(bs));
+            if ( BZ2_bzDecompressInit(&bs,0,0) != BZ_OK )
+            {
+               failed = 1;
+               break;
+            }
+         }
+#endif
+         in_member = 1;
+      }
+      if ( avail_out == 0 )
+      {
+         if ( out != NULL )
+            dcmp_put_chunk(s,ichunk,DCMP_CHUNK_SIZE);
+         if ( (out = dcmp_empty_chunk(s,&ichunk)) == NULL )
+            break; /* Reader went away */
+         avail_out = DCMP_CHUNK_SIZE;
+      }
+
+      used_in = made_out = 0;
+#ifdef WITH_ZLIB
+      if ( s->compression == 1 )
+      {
+         int rc;
+         zs.next_in = (Bytef *) next_in;
+         zs.avail_in = (uInt) avail_in;
+         zs.next_out = (Bytef *) (out + DCMP_CHUNK_SIZE - avail_out);
+         zs.avail_out = (uInt) avail_out;
+         rc = inflate(&zs,Z_NO_FLUSH);
+         used_in = avail_in - zs.avail_in;
+         made_out = avail_out - zs.avail_out;
+         if ( rc == Z_STREAM_END )
+         {
+            inflateEnd(&zs);
+            in_member = 0;
+            members++;
+         }
+         else if ( rc == Z_BUF_ERROR && avail_in == 0 && at_end )
+         {
+            inflateEnd(&zs);
+            msg = "unexpected end of file";
+            failed = 1;
+         }
+         else if ( rc != Z_OK && rc != Z_BUF_ERROR )
+         {
+            inflateEnd(&zs);
+            in_member = 0;
+            if ( members > 0 && zs.total_out == 0 )
+               fprintf(stderr,"%s: trailing garbage ignored\n",s->fname);
+            else
+            {
+               msg = zs.msg != NULL ? zs.msg : "invalid compressed data";
+               failed = 1;
+            }
+            break;
+         }
+      }
+#endif
+#ifdef WITH_BZIP2
+      if ( s->compression == 2 )
+      {
+         int rc;
+         bs.next_in = (char *) next_in;
+         bs.avail_in = (unsigned int) avail_in;
+         bs.next_out = out + DCMP_CHUNK_SIZE - avail_out;
+         bs.avail_out = (unsigned int) avail_out;
+         rc = BZ2_bzDecompress(&bs);
+         used_in = avail_in - bs.avail_in;
+         made_out = avail_out - bs.avail_out;
+         if ( rc == BZ_STREAM_END )
+         {
+            BZ2_bzDecompressEnd(&bs);
+            in_member = 0;
+            members++;
+         }
+         else if ( rc == BZ_OK && avail_in == 0 && at_end &&
+                   made_out == 0 )
+         {
+            BZ2_bzDecompressEnd(&bs);
+            msg = "unexpected end of file";
+            failed = 1;
+         }
+         else if ( rc != BZ_OK )
+         {
+            int total_out = bs.total_out_lo32 != 0 || bs.total_out_hi32 != 0;
+            BZ2_bzDecompressEnd(&bs);
+            in_member = 0;
+            if ( members > 0 && !total_out )
+               fprintf(stderr,"%s: trailing garbage after EOF ignored\n",
+                  s->fname);
+            else
+            {
+               msg = "invalid compressed data";
+               failed = 1;
+            }
+            break;
+         }
+      }
+#endif
+      next_in += used_in;
+      avail_in -= used_in;
+      avail_out -= made_out;
+   }
+
+   if ( in_member && !failed )
+   {
+#ifdef WITH_ZLIB
+      if ( s->compression == 1 )
+         inflateEnd(&zs);
+#endif
+#ifdef WITH_BZIP2
+      if ( s->compression == 2 )
+         BZ2_bzDecompressEnd(&bs);
+#endif
+   }
+   if ( failed )
+      fprintf(stderr,"%s: %s\n",s->fname,msg != NULL ? msg :
+         "decompression failed");
+
+   pthread_mutex_lock(&s->lock);
+   if ( out != NULL && !s->quit )
+   {
+      s->chunk_len[ichunk] = DCMP_CHUNK_SIZE - avail_out;
+      s->count++;
+   }
+   s->done = 1;
+   s->error = failed;
+   pthread_cond_broadcast(&s->cond);
+   pthread_mutex_unlock(&s->lock);
+
+   free(in);
+   return NULL;
+}
+
+/** Stream read function: hand out decompressed data from the ring. */
+
+static ssize_t dcmp_read (void *cookie, char *buf, size_t size)
+{
+   struct dcmp_stream *s = (struct dcmp_stream *) cookie;
+   size_t n = 0;
+
+   while ( n < size )
+   {
+      size_t k;
+      char *c;
+
+      pthread_mutex_lock(&s->lock);
+      while ( s->count == 0 && !s->done )
+         pthread_cond_wait(&s->cond,&s->lock);
+      if ( s->count == 0 )
+      {
+         int error = s->error;
+         pthread_mutex_unlock(&s->lock);
+         if ( error && n == 0 )
+         {
+            errno = EIO;
+            return -1;
+         }
+         break;
+      }
+      c = s->chunk[s->head];
+      k = s->chunk_len[s->head] - s->pos;
+      pthread_mutex_unlock(&s->lock);
+
+      /* The head chunk belongs to the reader until it is given back. */
+      if ( k > size - n )
+         k = size - n;
+      memcpy(buf+n,c+s->pos,k);
+      n += k;
+      s->pos += k;
+
+      pthread_mutex_lock(&s->lock);
+      if ( s->pos == s->chunk_len[s->head] )
+      {
+         s->head = (s->head+1) % DCMP_NUM_CHUNKS;
+         s->count--;
+         s->pos = 0;
+         pthread_cond_broadcast(&s->cond);
+      }
+      pthread_mutex_unlock(&s->lock);
+   }
+
+   return (ssize_t) n;
+}
+
+/** Free everything belonging to a stream (the thread must be gone). */
+
+static void dcmp_free (struct dcmp_stream *s)
+{
+   int i;
+   for ( i=0; i<DCMP_NUM_CHUNKS; i++ )
+      if ( s->chunk[i] != NULL )
+         free(s->chunk[i]);
+   if ( s->fname != NULL )
+      free(s->fname);
+   if ( s->fd >= 0 )
+      close(s->fd);
+   pthread_cond_destroy(&s->cond);
+   pthread_mutex_destroy(&s->lock);
+   free(s);
+}
+
+/** Stream close function: stop the thread and clean up. */
+
+static int dcmp_close (void *cookie)
+{
+   struct dcmp_stream *s = (struct dcmp_stream *) cookie;
+   struct dcmp_stream **p;
+
+   pthread_mutex_lock(&s->lock);
+   s->quit = 1;
+   pthread_cond_broadcast(&s->cond);
+   pthread_mutex_unlock(&s->lock);
+   pthread_join(s->thread,NULL);
+
+   pthread_mutex_lock(&dcmp_streams_lock);
+   for ( p = &dcmp_streams; *p != NULL; p = &(*p)->next )
+      if ( *p == s )
+      {
+         *p = s->next;
+         break;
+      }
+   pthread_mutex_unlock(&dcmp_streams_lock);
+
+   dcmp_free(s);
+   return 0;
+}
+
+#if defined(__GLIBC__)
+static ssize_t dcmp_cookie_read (void *cookie, char *buf, size_t size)
+{
+   return dcmp_read(cookie,buf,size);
+}
+#else
+static int dcmp_funopen_read (void *cookie, char *buf, int size)
+{
+   return (int) dcmp_read(cookie,buf,(size_t)size);
+}
+#endif
+
+/** Check if a stream was opened by dcmp_open(). */
+
+static int dcmp_is_stream (FILE *f)
+{
+   struct dcmp_stream *s;
+   int found = 0;
+   pthread_mutex_lock(&dcmp_streams_lock);
+   for ( s = dcmp_streams; s != NULL; s = s->next )
+      if ( s->f == f )
+      {
+         found = 1;
+         break;
+      }
+   pthread_mutex_unlock(&dcmp_streams_lock);
+   return found;
+}
+
+/** 
+ *  @short Open a gzip (compression=1) or bzip2 (compression=2) file for
+ *  reading with in-process decompression.
+ *
+ *  Returns NULL with errno set to ENOSYS if the compression method is
+ *  not supported by this build.
+ */
+
+static FILE *dcmp_open (const char *fname, int compression)
+{
+   struct dcmp_stream *s;
+   int i;
+
+#ifndef WITH_ZLIB
+   if ( compression == 1 )
+   {
+      errno = ENOSYS;
+      return NULL;
+   }
+#endif
+#ifndef WITH_BZIP2
+   if ( compression == 2 )
+   {
+      errno = ENOSYS;
+      return NULL;
+   }
+#endif
+   if ( compression != 1 && compression != 2 )
+   {
+      errno = ENOSYS;
+      return NULL;
+   }
+
+   if ( (s = calloc(1,sizeof(struct dcmp_stream))) == NULL )
+      return NULL;
+   s->compression = compression;
+   pthread_mutex_init(&s->lock,NULL);
+   pthread_cond_init(&s->cond,NULL);
+   if ( (s->fd = open(fname,O_RDONLY)) < 0 )
+   {
+      int k = errno;
+      dcmp_free(s);
+      errno = k;
+      return NULL;
+   }
+   if ( (s->fname = strdup(fname)) == NULL )
+   {
+      dcmp_free(s);
+      errno = ENOMEM;
+      return NULL;
+   }
+   for ( i=0; i<DCMP_NUM_CHUNKS; i++ )
+      if ( (s->chunk[i] = malloc(DCMP_CHUNK_SIZE)) == NULL )
+      {
+         dcmp_free(s);
+         errno = ENOMEM;
+         return NULL;
+      }
+
+   if ( pthread_create(&s->thread,NULL,dcmp_thread,s) != 0 )
+   {
+      fprintf(stderr,"%s: cannot start decompression thread\n",fname);
+      dcmp_free(s);
+      errno = EAGAIN;
+      return NULL;
+   }
+
+   {
+#if defined(__GLIBC__)
+      cookie_io_functions_t io;
+      memset(&io,0,sizeof(io));
+      io.read = dcmp_cookie_read;
+      io.close = dcmp_close;
+      s->f = fopencookie(s,"r",io);
+#else
+      s->f = funopen(s,dcmp_funopen_read,NULL,NULL,dcmp_close);
+#endif
+   }
+   if ( s->f == NULL )
+   {
+      int k = errno;
+      pthread_mutex_lock(&s->lock);
+      s->quit = 1;
+      pthread_cond_broadcast(&s->cond);
+      pthread_mutex_unlock(&s->lock);
+      pthread_join(s->thread,NULL);
+      dcmp_free(s);
+      errno = k;
+      return NULL;
+   }
+
+   pthread_mutex_lock(&dcmp_streams_lock);
+   s->next = dcmp_streams;
+   dcmp_streams = s;
+   pthread_mutex_unlock(&dcmp_streams_lock);
+
+   return s->f;
+}
+
+#endif
+
+/** 
+ *  @short Open a compressed file for reading: in-process if possible,
+ *  otherwise through a fifo from the external program.
+ */
+
+static FILE *cmp_open_read (const char *fname, int compression)
+{
+#ifdef WITH_INPROC_DECOMPRESSION
+   if ( getenv("FILEOPEN_USE_PIPE") == NULL )
+   {
+      FILE *f;
+      if ( access(fname,R_OK) != 0 )
+         return NULL;
+      if ( (f = dcmp_open(fname,compression)) != NULL || errno != ENOSYS )
+         return f;
+   }
+#endif
+   return cmp_popen(fname,"r",compression);
+}
+
 /** Helper function for opening a file with a URI (http:// etc.). */
 
 static FILE *uri_popen (const char *fname, const char *mode, int compression);
@@ -499,11 +1048,11 @@ FILE *fileopen (const char *fname, const char *mode)
 #endif
             break;
 
-         case 1: /* Create FIFO from gunzip from file */
-         case 2: /* Create FIFO from bunzip2 from file */
+         case 1: /* Decompress (or create FIFO from gunzip) from file */
+         case 2: /* Decompress (or create FIFO from bunzip2) from file */
          case 3: /* Create FIFO from lzop from file */
          case 4: /* Create FIFO from lzma from file */
-            return cmp_popen(fname,mode,compression);
+            return cmp_open_read(fname,compression);
             break;
 
          default:
@@ -557,11 +1106,11 @@ FILE *fileopen (const char *fname, const char *mode)
       	       return f;
             break;
 
-         case 1: /* Create FIFO from gunzip from file */
-         case 2: /* Create FIFO from bunzip2 from file */
+         case 1: /* Decompress (or create FIFO from gunzip) from file */
+         case 2: /* Decompress (or create FIFO from bunzip2) from file */
          case 3: /* Create FIFO from lzop from file */
          case 4: /* Create FIFO from lzma from file */
-            if ( (f = cmp_popen(try_fname,"r",compression)) != NULL )
+            if ( (f = cmp_open_read(try_fname,compression)) != NULL )
                return f;
             break;
 
@@ -609,6 +1158,12 @@ int fileclose (FILE *f)
    if ( f == stdin || f == stdout || f == stderr )
       return 0;
 
+#ifdef WITH_INPROC_DECOMPRESSION
+   /* In-process decompression has no file handle of its own. */
+   if ( dcmp_is_stream(f) )
+      return fclose(f);
+#endif
+
       /* Check what kind of stream we have */
    if ( fileno(f) == -1 )
    {
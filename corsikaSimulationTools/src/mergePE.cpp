@@ -1,6 +1,9 @@
 /*! \file mergePE.cpp
     \short merge several pe files into one
 
+    trees in the compact layout of VPEWriter are decoded with VPEReader
+    and written again in the compact layout (event numbers are reset)
+
     Revision $Id: mergePE.cpp,v 1.1.1.1 2011/07/21 20:35:57 gmaier Exp $
 
     \author Gernot Maier
@@ -10,23 +13,64 @@
 #include <iostream>
 #include <string>
 
+#include "VPEReader.h"
+#include "VPEWriter.h"
+
 #include "TChain.h"
 #include "TFile.h"
+#include "TROOT.h"
 #include "TTree.h"
 
 using namespace std;
 
 void help()
 {
-   cout << "mergePE <number of telescopes> <input files> <file with merged tree>" << endl;
+   cout << "mergePE <number of telescopes> <input files> <file with merged tree> [threads]" << endl;
    cout << endl;
    cout << "\t use UNIX wildcards to specify a number of files" << endl;
+   cout << "\t threads: number of threads for (implicit multi-threaded) compression (default: 0)" << endl;
    cout << endl;
    exit( 0 );
 }
+/*!
+    merge trees in the compact layout (decode and encode again)
+*/
+void mergeCompact( TChain *c, unsigned int iTelID )
+{
+   VPEReader iReader( c );
+   VPEWriter iWriter( iTelID, iReader.usePixelNumbers(), 100000, true );
+   TTree *f = iWriter.getDataTree();
+   f->SetMaxTreeSize(1000*Long64_t(2000000000));
+
+   for( Long64_t i = 0; i < iReader.getEntries(); i++ )
+   {
+      iReader.getEntry( i );
+
+      for( unsigned int p = 0; p < iReader.fPE_time->size(); p++ )
+      {
+         iWriter.add_pe( iReader.fPE_pixelID->at( p ), iReader.fPE_photonX->at( p ), iReader.fPE_photonY->at( p ),
+                         iReader.fPE_time->at( p ), iReader.fPE_wl->at( p ) );
+      }
+      iWriter.add_event( (unsigned int)i, iReader.fPrimaryType, iReader.fPrimaryEnergy, iReader.fXcore, iReader.fYcore,
+                         iReader.fXcos, iReader.fYcos, iReader.fXsource, iReader.fYsource, iReader.fDelay );
+   }
+
+   cout << "\t writing merged tree (compact) with " << f->GetEntries() << " entries" << endl;
+   f->Write();
+   f->Delete();
+}
+
 int main( int argc, char **argv )
 {
-   if( argc != 4 ) help();
+   if( argc != 4 && argc != 5 ) help();
+
+   unsigned int nThreads = 0;
+   if( argc == 5 ) nThreads = (unsigned int)atoi( argv[4] );
+#ifdef R__USE_IMT
+   if( nThreads > 0 ) ROOT::EnableImplicitMT( nThreads );
+#else
+   if( nThreads > 0 ) cout << "ROOT without implicit multi-threading, ignoring number of threads" << endl;
+#endif
 
    TFile *fOut = new TFile( argv[3], "RECREATE" );
    if( fOut->IsZombie() )
@@ -57,6 +101,16 @@ int main( int argc, char **argv )
 
       c = new TChain( hname );
       c->Add( argv[2] );
+
+// compact tree layout
+      if( c->GetBranch( "nPE" ) )
+      {
+          if( fOut->cd() ) mergeCompact( c, t );
+          c->Delete();
+          fOut->Close();
+          continue;
+      }
+
       c->SetBranchAddress( "eventNumber", &eventNumber );
 
       if( fOut->cd() ) 
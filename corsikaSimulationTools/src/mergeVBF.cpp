@@ -5,6 +5,14 @@
 
     copied from Peter Cogan.
 
+    Packets are copied without decoding them: the raw packet bytes are read,
+    the run and event numbers in the array event bank are overwritten in
+    place and the packet is written as it is (the writer recalculates the
+    checksum and the index). Reading and writing are done in two threads.
+    Packets are only decoded for streamed (bzip2/gzip) input files, for the
+    simulation header when a new simulation header file is given, and for
+    array events with an unknown layout.
+
 */
 
 
@@ -13,6 +21,7 @@
 #include <VPacket.h>
 #include <VArrayEvent.h>
 #include <VDatum.h>
+#include <VConstants.h>
 
 // include the simulation data structure
 #include <VSimulationData.h>
@@ -20,7 +29,13 @@
 // include the configuration mask utilities, which give us parseConfigMask()
 #include <VConfigMaskUtil.h>
 
+// little endian word access, as used by VBF for all words
+#include <VBFUtil.h>
+
+#include <pthread.h>
+#include <string.h>
 
+#include <deque>
 #include <fstream>
 #include <iostream>
 #include <string>
@@ -29,20 +44,270 @@
 using namespace std;
 
 using namespace VConfigMaskUtil;
+using namespace VBFUtil;
+
+// maximum number of packets read ahead of the writer
+const unsigned int fMaxQueuedPackets = 256;
 
+// one packet on its way from the reading to the writing thread
+// (either raw bytes or a decoded packet)
+struct mergePacket
+{
+  vector< char > raw;
+  VPacket *packet;
+};
+
+// state shared by the reading and the writing thread
+struct mergeQueue
+{
+  pthread_mutex_t mutex;
+  pthread_cond_t  notEmpty;
+  pthread_cond_t  notFull;
+  deque< mergePacket* > packets;
+  bool finished;              // reading thread is done
+  bool writeFailed;           // writing thread gave up
+
+  vector<string> fileNames;
+  int newRunNumber;
+  string simConfig;           // new simulation header (empty: keep)
+};
 
 void usage(char *prog){
   cout<<"Usage: "<<prog<<" <listOfFiles> <output.vbf> <newRunNumber> [optional: simulation header file] "<<endl;
   exit(-1);
 }
 
+// 16 bit little endian word (size of AUG_2004 datums)
+static uword32 bufToWord16( const char *p )
+{
+  const unsigned char *b = (const unsigned char*)p;
+  return ((uword32)b[0]) | (((uword32)b[1])<<8);
+}
+
+/*
+   overwrite run and event numbers of all datums (array trigger and telescope
+   events) of an array event bank (see VDatum::writeTo()/writeToBufferImpl())
+
+   returns false if the bank has an unknown version or is malformed
+*/
+static bool patchArrayEvent( char *bank, uword32 size, uword32 version, int runNumber, int eventNumber )
+{
+  // datum header size and the offset of the run number in the trigger body
+  uword32 headerSize = 0;
+  uword32 runOffset = 0;
+  if( version == 0 )         // AUG_2004: magic, node, mask, 16 bit size
+  {
+    headerSize = 8;
+    runOffset = 24;
+  }
+  else if( version == 1 )    // AUG_2005: magic, node, mask, flags, 32 bit size
+  {
+    headerSize = 12;
+    runOffset = 20;
+  }
+  else return false;
+
+  uword32 pos = 0;
+  while( pos < size )
+  {
+    if( size - pos < headerSize || memcmp( bank + pos, "VEVN", 4 ) ) return false;
+
+    ubyte nodeNumber = (ubyte)bank[pos+4];
+    uword32 bodySize = ( version == 0 ) ? bufToWord16( bank + pos + 6 ) : bufToWord32( bank + pos + 8 );
+    char *body = bank + pos + headerSize;
+    if( bodySize > size - pos - headerSize || bodySize < 4 ) return false;
+
+    wordToBuf( (uword32)eventNumber, body );
+    if( nodeNumber == V_ARRAY_TRIGGER_NODE )
+    {
+      if( bodySize < runOffset + 4 ) return false;
+      wordToBuf( (uword32)runNumber, body + runOffset );
+    }
+    pos += headerSize + bodySize;
+  }
+  return true;
+}
+
+/*
+   walk through the banks of a raw packet, patch the array event bank
+   and look for a simulation header
+
+   returns false if the packet has to be decoded
+*/
+static bool patchRawPacket( vector< char > &raw, int runNumber, int eventNumber, bool *hasSimHeader )
+{
+  *hasSimHeader = false;
+
+  uword32 packetSize = raw.size();
+  uword32 pos = 8;
+  while( pos < packetSize )
+  {
+    if( packetSize - pos < 16 ) return false;
+    VBankName name( &raw[pos] );
+    uword32 version = bufToWord32( &raw[pos+8] );
+    uword32 bankSize = bufToWord32( &raw[pos+12] );
+    if( bankSize < 16 || bankSize > packetSize - pos ) return false;
+
+    if( name == VGetArrayEventBankName() )
+    {
+      if( !patchArrayEvent( &raw[pos+16], bankSize - 16, version, runNumber, eventNumber ) ) return false;
+    }
+    else if( name == VGetSimulationHeaderBankName() )
+    {
+      *hasSimHeader = true;
+    }
+    pos += bankSize;
+  }
+  return true;
+}
+
+// decoded packets: set run and event numbers (and the simulation header)
+static void renumberPacket( VPacket *packet, int runNumber, int eventNumber, const string &simConfig )
+{
+  if(packet->hasArrayEvent()){
+    VArrayEvent *arrayEvent = packet->getArrayEvent();
+    if(arrayEvent){
+      VArrayTrigger *trigger = arrayEvent->getTrigger();
+      if(trigger){
+        trigger->setRunNumber(runNumber);
+        trigger->setEventNumber(eventNumber);
+      }
+      for (unsigned i=0; i<arrayEvent->getNumEvents(); i++){
+        VEvent *telEvent = arrayEvent->getEvent(i);
+        if(telEvent){
+          telEvent->setEventNumber(eventNumber);
+        }
+      }
+    }
+  }
+
+  if(packet->hasSimulationData()){
+    VSimulationData *sim = packet->getSimulationData();
+    if(sim){
+      sim->fRunNumber = runNumber;
+      sim->fEventNumber=  eventNumber;
+    }
+  }
+
+  if(packet->hasSimulationHeader()){
+    VSimulationHeader *header = packet->getSimulationHeader();
+    if(header){
+      header->fRunNumber = runNumber;
+      // add sim config string to MC header if a file was specified
+      if( simConfig.size() > 0 )
+        header->fSimConfigFile = simConfig;
+    }
+  }
+}
+
+// hand a packet to the writing thread; returns false if the writer gave up
+static bool queuePacket( mergeQueue *q, mergePacket *p )
+{
+  pthread_mutex_lock( &q->mutex );
+  while( q->packets.size() >= fMaxQueuedPackets && !q->writeFailed )
+    pthread_cond_wait( &q->notFull, &q->mutex );
+  bool ok = !q->writeFailed;
+  if( ok )
+  {
+    q->packets.push_back( p );
+    pthread_cond_signal( &q->notEmpty );
+  }
+  pthread_mutex_unlock( &q->mutex );
+  return ok;
+}
+
+// reading thread: read, renumber and queue all packets of all files
+static void *readFiles( void *arg )
+{
+  mergeQueue *q = (mergeQueue*)arg;
+
+  bool wroteSimHeader=false;
+  int globalEventCount=0;
+  bool writerOK = true;
+
+  for (unsigned fileIndex=0; fileIndex<q->fileNames.size() && writerOK; fileIndex++)
+  {
+    cout << "reading file " << fileIndex << ": " << q->fileNames[fileIndex] << endl;
+
+    mergePacket *p = 0;
+    try{
+
+      VBankFileReader reader(q->fileNames.at(fileIndex).c_str() );
+      int numPackets = reader.numPackets();
+      cout<<"\t Packets: "<<numPackets<<endl;
+
+      for (int pack=0; pack<numPackets && writerOK; pack++){
+        p = new mergePacket;
+        p->packet = 0;
+
+        bool decode = reader.isStreamed();
+        bool hasSimHeader = false;
+        if( !decode )
+        {
+          reader.readRawPacket( pack, p->raw );
+          decode = !patchRawPacket( p->raw, q->newRunNumber, globalEventCount, &hasSimHeader );
+          // new simulation header: changes the bank size, decode it
+          if( hasSimHeader && !wroteSimHeader && q->simConfig.size() > 0 ) decode = true;
+        }
+        if( decode )
+        {
+          p->raw.clear();
+          p->packet = reader.readPacket( pack );
+          if( p->packet )
+          {
+            hasSimHeader = p->packet->hasSimulationHeader();
+            renumberPacket( p->packet, q->newRunNumber, globalEventCount, q->simConfig );
+          }
+        }
+
+        // write only the first simulation header
+        bool writePacket = ( p->packet || p->raw.size() > 0 );
+        if( hasSimHeader )
+        {
+          if(wroteSimHeader)
+            writePacket=false;
+          wroteSimHeader=true;
+        }
+
+        if(writePacket && queuePacket( q, p )){
+          globalEventCount++;
+        }
+        else
+        {
+          writerOK = writerOK && ( !writePacket );
+          delete p->packet;
+          delete p;
+        }
+        p = 0;
+      }
+    }
+    catch (const std::exception&ex)
+      {
+        if( p )
+        {
+          delete p->packet;
+          delete p;
+        }
+        cerr <<"For file "<<q->fileNames.at(fileIndex)<<endl;
+        cout << ex.what() << endl;
+      }
+  }
+
+  pthread_mutex_lock( &q->mutex );
+  q->finished = true;
+  pthread_cond_signal( &q->notEmpty );
+  pthread_mutex_unlock( &q->mutex );
+
+  return 0;
+}
+
 int main(int argc, char **argv){
-  
+
   if(argc<4)
     usage(argv[0]);
 
-  vector<string> fileNames;
-  
+  mergeQueue q;
+
   ifstream infile;
   infile.open(argv[1]);
   if(!infile.is_open()){
@@ -50,151 +315,102 @@ int main(int argc, char **argv){
     exit(-1);
   }
 
-  int newRunNumber=0;
-  sscanf(argv[3], "%d", &newRunNumber);
+  q.newRunNumber=0;
+  sscanf(argv[3], "%d", &q.newRunNumber);
 
   while(true){
     char buffer[1000];
     infile.getline(buffer, 1000);
     if(infile.eof())
       break;
-    fileNames.push_back(buffer);
+    q.fileNames.push_back(buffer);
   }
 
-  cout << "Collected " << fileNames.size() << " files" << endl;
+  cout << "Collected " << q.fileNames.size() << " files" << endl;
 
   string simufile="None";
   if(argc==5)
   {
       simufile=argv[4];
       cout << "Reading CORSIKA/GrISU simulation header from file " << simufile << endl;
-  }
 
-  try{  
+      string iline;
+      ifstream in( simufile.c_str() );
+      while( getline(in,iline) )
+      {
+	  q.simConfig += iline;
+	  q.simConfig += "\n";
+      }
+  }
 
-    VBankFileWriter writer(argv[2], newRunNumber, parseConfigMask("0,1,2,3"));
+  pthread_mutex_init( &q.mutex, 0 );
+  pthread_cond_init( &q.notEmpty, 0 );
+  pthread_cond_init( &q.notFull, 0 );
+  q.finished = false;
+  q.writeFailed = false;
 
-    VPacket *packet=NULL;
-    VArrayTrigger *trigger=NULL;
-    VArrayEvent *arrayEvent=NULL;
-    VSimulationData *sim=NULL;
-    VSimulationHeader *header=NULL;
-    VEvent *telEvent = NULL;
-  
-    bool wroteSimHeader=false;
+  pthread_t readThread;
+  bool threadStarted = false;
 
-    int globalEventCount=0;
+  try{
 
-    bool writePacket=true;
+    VBankFileWriter writer(argv[2], q.newRunNumber, parseConfigMask("0,1,2,3"));
 
-    for (unsigned fileIndex=0; fileIndex<fileNames.size(); fileIndex++)
+    if( pthread_create( &readThread, 0, readFiles, &q ) != 0 )
     {
-      cout << "reading file " << fileIndex << ": " << fileNames[fileIndex] << endl;
+      cerr << "Couldn't start reading thread" << endl;
+      exit(EXIT_FAILURE);
+    }
+    threadStarted = true;
 
-      try{
+    while(true){
+      pthread_mutex_lock( &q.mutex );
+      while( q.packets.empty() && !q.finished )
+        pthread_cond_wait( &q.notEmpty, &q.mutex );
+      if( q.packets.empty() )
+      {
+        pthread_mutex_unlock( &q.mutex );
+        break;
+      }
+      mergePacket *p = q.packets.front();
+      q.packets.pop_front();
+      pthread_cond_signal( &q.notFull );
+      pthread_mutex_unlock( &q.mutex );
 
-//	VBankFileReader reader(fileNames.at(fileIndex).c_str(), false, false );
-	VBankFileReader reader(fileNames.at(fileIndex).c_str() );
-//	reader.generateIndexAndChecksum();
-	int numPackets = reader.numPackets();
-	cout<<"\t Packets: "<<numPackets<<endl;
-    
-      
-	for (int pack=0; pack<numPackets; pack++){
-	  packet = reader.readPacket(pack);
-	  if(packet){
-	  
-	    writePacket=true;
-	  
-	    if(packet->hasArrayEvent()){
-	      arrayEvent = packet->getArrayEvent();
-	      if(arrayEvent){
-		trigger = arrayEvent->getTrigger();
-		if(trigger){
-		  trigger->setRunNumber(newRunNumber);
-		  trigger->setEventNumber(globalEventCount);
-		}
-		for (unsigned i=0; i<arrayEvent->getNumEvents(); i++){
-		  telEvent = arrayEvent->getEvent(i);
-		  if(telEvent){
-		    telEvent->setEventNumber(globalEventCount);
-		  }
-		}
-	      }
-	    }
-	  
-	    if(packet->hasSimulationData()){
-	      sim = packet->getSimulationData();
-	      if(sim){
-		sim->fRunNumber = newRunNumber;
-		sim->fEventNumber=  globalEventCount;
-	      }
-	    }
-	  
-	    if(packet->hasSimulationHeader()){
-	      header = packet->getSimulationHeader();
-	      if(header){
-		header->fRunNumber = newRunNumber;
-		// add sim config string to MC header if a file was specified
-		if( simufile!="None")
-		{
-		    string icontent;
-		    string iline;
-		    ifstream in( simufile.c_str() );
-		    while( getline(in,iline) )
-		    {
-			icontent += iline;
-			icontent += "\n";
-		    }
-		    header->fSimConfigFile = icontent;
-		} 
-	      }
-	    
-	      if(wroteSimHeader)
-		writePacket=false;
-	    
-	      wroteSimHeader=true;
-	    
-	    }
-	  
-	    if(writePacket){
-	      writer.writePacket(packet);
-	      globalEventCount++;
-	    }
-	  
-	    delete packet;
-	  }
-    
-	}
+      try{
+        if( p->packet ) writer.writePacket( p->packet );
+        else            writer.writeRawPacket( &p->raw[0], p->raw.size() );
       }
-      catch (const std::exception&ex)
-	{
-	  cerr <<"For file "<<fileNames.at(fileIndex)<<endl;
-	  cout << ex.what() << endl;
-//	  cerr <<ex<<endl;
-	}
-    } 
+      catch (...)
+      {
+        delete p->packet;
+        delete p;
+        throw;
+      }
+      delete p->packet;
+      delete p;
+    }
+
+    pthread_join( readThread, 0 );
+    threadStarted = false;
     writer.finish();
   }
   catch (const std::exception &ex)
     {
-//      cerr<<ex<<endl;
-      exit(EXIT_FAILURE);
-    }
-/*  catch (const std::exception &ex)
-    {
-//      cerr<<ex<<endl;
+      cerr<<ex.what()<<endl;
+      if( threadStarted )
+      {
+        pthread_mutex_lock( &q.mutex );
+        q.writeFailed = true;
+        pthread_cond_signal( &q.notFull );
+        pthread_mutex_unlock( &q.mutex );
+      }
       exit(EXIT_FAILURE);
     }
-  catch (const std::exception& e)
-    {
-//      cerr<<e.what()<<endl;
-      exit(EXIT_FAILURE);
-    } */
   catch(...)
     {
 //      cerr<<"Unknown exception caught! Program crashing and burning"<<endl;
       exit(EXIT_FAILURE);
-    } 
-  
+    }
+
 }
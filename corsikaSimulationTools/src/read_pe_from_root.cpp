@@ -1,12 +1,16 @@
 /*! \file read_pe_from_root.cpp
     \short read pe format from root tree and dump to screen
 
+    reads both tree layouts of VPEWriter (default and compact)
+
     Revision $Id: read_pe_from_root.cpp,v 1.1.1.1 2011/07/21 20:35:57 gmaier Exp $
 
     \author
     Gernot Maier
 */
 
+#include "VPEReader.h"
+
 #include "TFile.h"
 #include "TROOT.h"
 #include "TTree.h"
@@ -58,46 +62,23 @@ int main( int argc, char **argv )
 	cout << "...exiting" << endl;
 	exit( -1 );
     }
-    unsigned int fEventNumber = 0;
-    float fPrimaryEnergy = 0.;
-    float fXcore = 0.;
-    float fYcore = 0.;
-    float fXcos = 0.;
-    float fYcos = 0.;
-    float fXsource = 0.;
-    float fYsource = 0.;
-    std::vector< unsigned > *v_f_ID = 0;
-    std::vector< float > *v_f_x = 0;
-    std::vector< float > *v_f_y = 0;
-    std::vector< float > *v_f_time = 0;
-    std::vector< float > *v_f_wl = 0;
-    TBranch *b_v_f_ID;
-    TBranch *b_v_f_time = 0;
-    TBranch *b_v_f_x = 0;
-    TBranch *b_v_f_y = 0;
-    TBranch *b_v_f_wl = 0;
-    t->SetBranchAddress("eventNumber", &fEventNumber );
-    t->SetBranchAddress("primaryEnergy", &fPrimaryEnergy );
-    t->SetBranchAddress("Xcore", &fXcore );
-    t->SetBranchAddress("Ycore", &fYcore );
-    t->SetBranchAddress("Xcos", &fXcos );
-    t->SetBranchAddress("Ycos", &fYcos );
-    t->SetBranchAddress("Xsource", &fXsource );
-    t->SetBranchAddress("Ysource", &fYsource );
-    t->SetBranchAddress("pixelID", &v_f_ID, &b_v_f_ID );
-    t->SetBranchAddress("photonX", &v_f_x, &b_v_f_x );
-    t->SetBranchAddress("photonY", &v_f_y, &b_v_f_y );
-    t->SetBranchAddress("time", &v_f_time, &b_v_f_time );
-    t->SetBranchAddress("wavelength", &v_f_wl, &b_v_f_wl );
-
-    cout << "total number of entries: " << t->GetEntries() << endl;
-    for( int i = 0; i < t->GetEntries(); i++ )
-    {
-        t->GetEntry( i );
+// default or compact tree layout (see VPEWriter)
+    VPEReader fPE( t );
+    if( fPE.isCompact() ) cout << "compact tree layout" << endl;
 
-	cout << "entry " << i << "\t, event number: " << fEventNumber << ", primary energy [TeV]: " << fPrimaryEnergy << endl;
-	cout << "\t core position [m]: " << fXcore << ", " << fYcore << endl;
-	cout << "\t source direction and offsets: " << fXcos << "\t" << fYcos << "\t" << fXsource << "\t" << fYsource << endl;
+    cout << "total number of entries: " << fPE.getEntries() << endl;
+    for( Long64_t i = 0; i < fPE.getEntries(); i++ )
+    {
+        fPE.getEntry( i );
+
+	cout << "entry " << i << "\t, event number: " << fPE.fEventNumber << ", primary energy [TeV]: " << fPE.fPrimaryEnergy << endl;
+	cout << "\t core position [m]: " << fPE.fXcore << ", " << fPE.fYcore << endl;
+	cout << "\t source direction and offsets: " << fPE.fXcos << "\t" << fPE.fYcos << "\t" << fPE.fXsource << "\t" << fPE.fYsource << endl;
+	std::vector< unsigned > *v_f_ID = fPE.fPE_pixelID;
+	std::vector< float > *v_f_x = fPE.fPE_photonX;
+	std::vector< float > *v_f_y = fPE.fPE_photonY;
+	std::vector< float > *v_f_time = fPE.fPE_time;
+	std::vector< float > *v_f_wl = fPE.fPE_wl;
 	if( v_f_time && v_f_ID )
 	{
 	   cout << "\t vector sizes: " << v_f_time->size() << "\t" << v_f_ID->size() << "\t" << v_f_x->size();
@@ -107,8 +88,8 @@ int main( int argc, char **argv )
 	      for( unsigned int v = 0; v < v_f_time->size(); v++ )
 	      {
 		  cout << "\t\t" << v_f_ID->at(v) << "\t" << v_f_time->at( v );
-		  cout << "\t" << v_f_x->at( v ) << "\t" << v_f_x->at( v ) << "\t" << v_f_wl->at( v ); 
-		  cout << endl;
+		  cout << "\t" << v_f_x->at( v ) << "\t" << v_f_y->at( v ) << "\t" << v_f_wl->at( v ); 
+		  cout << "\n";
 	      }
 	      cout << endl;
            }
@@ -27,12 +27,16 @@ using namespace std;
 
 void help()
 {
-     cout << "writeGRISU_pe_to_root <ntel> <outputfile.root> <pix> " << endl;
+     cout << "writeGRISU_pe_to_root <ntel> <outputfile.root> <pix> [compact] [threads]" << endl;
      cout << endl;
      cout << "command line options: " << endl;
      cout << "\t <ntel> \t maximum number of telescope " << endl;
      cout << "\t <outputfile.root> \t ROOT output file" << endl;
      cout << "\t <pix> \t 0=x/y postion of photon [mm], 1=pixel number" << endl;
+     cout << "\t [compact] \t 1=compact tree layout (fixed-point positions, times and wavelengths, delta encoded pixel numbers; default: 0)" << endl;
+     cout << "\t [threads] \t number of threads for (implicit multi-threaded) compression (default: 0)" << endl;
+     cout << endl;
+     cout << "file sizes and run times of the compact layout are estimates, not measured (see README.writeGRISU_pe_to_root)" << endl;
      cout << endl;
      exit( 0 );
 }
@@ -44,13 +48,22 @@ void fillEvent( VPEWriter* f, unsigned int iEventNumber, unsigned int iPrimaryTy
 
 int main( int argc, char **argv )
 {
-    if( argc != 4 ) help();
+    if( argc < 4 || argc > 6 ) help();
 
     gROOT->ProcessLine("#include <vector>");
 
     unsigned int fNTel = (unsigned int)(atoi( argv[1] ) );
     string fOutputFileName = argv[2];
     unsigned int fPixel = (unsigned int)atoi( argv[3] );
+    bool bCompact = false;
+    if( argc > 4 ) bCompact = ( atoi( argv[4] ) == 1 );
+    unsigned int nThreads = 0;
+    if( argc > 5 ) nThreads = (unsigned int)atoi( argv[5] );
+#ifdef R__USE_IMT
+    if( nThreads > 0 ) ROOT::EnableImplicitMT( nThreads );
+#else
+    if( nThreads > 0 ) cout << "ROOT without implicit multi-threading, ignoring number of threads" << endl;
+#endif
 
     TFile *fO = new TFile( fOutputFileName.c_str(), "RECREATE" );
     if( fO->IsZombie() )
@@ -61,7 +74,7 @@ int main( int argc, char **argv )
     }
 
     vector< VPEWriter* > fpe_data;
-    for( unsigned int t = 0; t < fNTel; t++ ) fpe_data.push_back( new VPEWriter( t, fPixel ) );
+    for( unsigned int t = 0; t < fNTel; t++ ) fpe_data.push_back( new VPEWriter( t, fPixel, 100000, bCompact ) );
 
     string iLine;
     string iT;
@@ -19,6 +19,77 @@ class TCanvas;
 #include "Math/Vector3Dfwd.h"
 #include "Math/GenVector/Rotation3Dfwd.h"
 
+/*! \brief GPhotonBatch holds the photons of a shower read from the
+         photon reader, one array per photon parameter, so that they
+         can be checked against all telescopes before ray tracing.
+ */
+struct GPhotonBatch {
+
+  vector<double> grdX;     //!< photon grd.loc.ground coors.
+  vector<double> grdY;
+  vector<double> grdZ;
+  vector<double> dcosX;    //!< photon dir.cos.ground coors.
+  vector<double> dcosY;
+  vector<double> dcosZ;
+  vector<double> az;
+  vector<double> zn;
+  vector<double> hgtEmiss;
+  vector<double> grdTime;
+  vector<double> waveLgt;
+  vector<int> type;
+  vector<int> tel;
+  vector<char> accept;     //!< if 0, photon can not reach the camera
+
+  // filled by GArrayTel::transformPhotons
+  vector<double> relLocX;  //!< photon grd.loc.rel.to tel, tel.coors.
+  vector<double> relLocY;
+  vector<double> relLocZ;
+  vector<double> dcosTX;   //!< photon dir.cos.tel.coors.
+  vector<double> dcosTY;
+  vector<double> dcosTZ;
+
+  void clear() {
+    grdX.clear(); grdY.clear(); grdZ.clear();
+    dcosX.clear(); dcosY.clear(); dcosZ.clear();
+    az.clear(); zn.clear(); hgtEmiss.clear(); grdTime.clear();
+    waveLgt.clear(); type.clear(); tel.clear(); accept.clear();
+    relLocX.clear(); relLocY.clear(); relLocZ.clear();
+    dcosTX.clear(); dcosTY.clear(); dcosTZ.clear();
+  };
+
+  /*! \brief makeTelCoor sizes the telescope coordinate arrays to the
+        number of photons in the batch
+   */
+  void makeTelCoor() {
+    unsigned n = size();
+    relLocX.resize(n); relLocY.resize(n); relLocZ.resize(n);
+    dcosTX.resize(n); dcosTY.resize(n); dcosTZ.resize(n);
+  };
+
+  unsigned size() {
+    return tel.size();
+  };
+};
+
+/*! \brief GTelescopeTestScan holds the field angle and wavelength scan
+         of GArrayTel::makeTelescopeTest, from the TESTTELSCAN pilot record
+ */
+struct GTelescopeTestScan {
+
+  int numAngles;        //!< number of field angles, 0: default for telType
+  double deltaDeg;      //!< field angle step (deg)
+  int numPhotons;       //!< photons per field angle and wavelength
+  int numProcesses;     //!< number of worker processes
+  bool psfTable;        //!< if true, write the baseName_psf.txt table
+  vector<double> vLambda;  //!< wavelengths (nm)
+  bool reseedTasks;     //!< if true (TESTTELSCAN record), each task reseeds
+                        //!< TR3 and gRandom, needed for worker processes
+
+  GTelescopeTestScan() : numAngles(0),deltaDeg(0.5),numPhotons(5000),
+                         numProcesses(1),psfTable(false),
+                         vLambda(1,400.0),reseedTasks(false) {};
+};
+
 class GArrayTel {
 
   ROOT::Math::XYZVector telLocGrdGC;  //!< tel.loc.ground coor.
@@ -47,6 +118,8 @@ class GArrayTel {
 
   ROOT::Math::Rotation3D rotGrdToTel;  //!< rotation matrix, grd to tel coor.
   ROOT::Math::Rotation3D rotGrdToShower;  //!< rot. matrix, grd to shower coor.
+  double fRotGrdToTel[9]; //!< rotGrdToTel components, row by row
+  double fTelLocTC[3];    //!< telLocGrdTC components
   double fAzTel;          //!< azimuthal angle (radians) for telescope
   double fZnTel;          //!< zenith angle (radians) for telescope
   ROOT::Math::XYZVector vTelDcosGC; //!< tel.dirCos. ground coor.  
@@ -89,6 +162,36 @@ class GArrayTel {
 
   GTelescope *tel;  //!< pointer to associated telescope 
 
+  // photon culling before ray tracing
+  unsigned long iNumPhotonsChecked; //!< photons checked against the envelope
+  unsigned long iNumPhotonsCulled;  //!< photons outside the envelope
+
+  // photon bundles
+  vector<double> vBundleLambda;  //!< wavelengths of the bundle (nm)
+  vector<double> vBundleWeight;  //!< mirror reflectivity per wavelength
+
+  /*! \brief tracePhoton injects the photon (vPhotonRelLocTC, 
+        vPhotonDcosTC, fPhotWaveLgt) into the telescope and gets the 
+        camera location and the total photon time
+   */
+  void tracePhoton();
+
+  /*! \brief traceTestPhotons injects the photon grid of makeTelescopeTest
+        at one field angle and wavelength
+
+      \param deg field angle (deg)
+      \param lambda wavelength (nm)
+      \param spot filled with x, y (arcmin, relative to the field angle)
+             and transit time less the ideal transit time (ns) of
+             each photon on the camera
+   */
+  void traceTestPhotons(const double &deg,const double &lambda,
+                        const vector<double> &vX,const vector<double> &vY,
+                        const vector<double> &vZ,
+                        const double &idealTransitTime,
+                        const double &plateScaleFactor,
+                        vector<double> *spot);
+
  protected:
 
  public:
@@ -130,6 +233,64 @@ class GArrayTel {
                  const double &pWaveLgt, const int &pType,
                  const int &pTel);
   
+  /*! \brief setPhoton ray traces photon k of the batch, using the
+        telescope coordinates from transformPhotons
+   */
+  void setPhoton(const GPhotonBatch &batch, const unsigned &k);
+
+  /*! \brief setPhotonBundles switches photon bundle tracing on in the
+        telescope, see GTelescope::setPhotonBundles
+        \return false if the telescope can not trace bundles
+   */
+  bool setPhotonBundles() {
+    return tel->setPhotonBundles();
+  };
+
+  /*! \brief setPhotonBundle ray traces the num photons of the batch
+        from photon first on, all with the same location, direction and
+        time, as one ray. The mirror reflectivity is applied to each
+        photon at its wavelength: vSurvive[i] is 1 if photon first+i
+        reaches the camera, at the location from getCameraPhotonLocation.
+        \return false if the telescope can not trace bundles
+   */
+  bool setPhotonBundle(const GPhotonBatch &batch, const unsigned &first,
+                       const unsigned &num, vector<char> *vSurvive);
+
+  /*! \brief getTelTransform copies the ground to telescope rotation
+        (9 values, row by row) and the telescope location in telescope
+        coordinates (3 values) set by setPrimary
+   */
+  void getTelTransform(double *transform);
+
+  /*! \brief transformPhotons rotates all photons of the batch to the
+        coordinates of their telescopes in one pass: location relative
+        to the telescope and direction cosines, stored in the batch.
+
+        \param batch photons of the shower, makeTelCoor already called
+        \param telTransform getTelTransform values, 12 per telescope,
+               telescope number tel at 12*tel
+   */
+  static void transformPhotons(GPhotonBatch *batch,
+                               const vector<double> &telTransform);
+
+  /*! \brief cullPhotons sets accept to 0 for the photons iPhot of the 
+        batch that miss the bounding sphere or the aperture envelope 
+        of the telescope and thus can not reach the camera. Uses the
+        telescope coordinates from transformPhotons.
+
+        \param batch photons of the shower
+        \param iPhot indices of the photons for this telescope
+   */
+  void cullPhotons(GPhotonBatch *batch, const vector<unsigned> &iPhot);
+
+  unsigned long getNumPhotonsChecked() {
+    return iNumPhotonsChecked;
+  };
+
+  unsigned long getNumPhotonsCulled() {
+    return iNumPhotonsCulled;
+  };
+
   /*!
    */
   void printArrayTel();
@@ -138,9 +299,11 @@ class GArrayTel {
    */
   void setPhotonHistory(const string &rootFile,
                         const string &treeName,
-                        const int &option = 0) {
+                        const int &option = 0,
+                        const int &sampleEvery = 1,
+                        const int &select = -1) {
 
-    tel->setPhotonHistory(rootFile,treeName,option);
+    tel->setPhotonHistory(rootFile,treeName,option,sampleEvery,select);
   };
 
   void writePhotonHistory() {
@@ -172,7 +335,14 @@ class GArrayTel {
     return tel->getAvgTransitTime();
   };
 
-  void makeTelescopeTest(const string& testfile);
+  /*! \brief makeTelescopeTest makes spot and transit time histograms
+        and graphs for a scan of field angles and wavelengths. The scan
+        is shared among scan.numProcesses worker processes, each 
+        tracing with its own copy of the telescope.
+   */
+  void makeTelescopeTest(const string& testfile,
+                         const GTelescopeTestScan &scan = 
+                         GTelescopeTestScan());
 
   void getTelLocTC(ROOT::Math::XYZVector *telLocTC) {
     *telLocTC = telLocGrdTC;
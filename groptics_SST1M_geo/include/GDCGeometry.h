@@ -54,6 +54,12 @@ class GDCGeometry : public GGeometryBase {
 
   double cameraRadius;  //!< camera radius
 
+  /*! shadowing by the telescope structure: 0 analytic model,
+      1 root geometry navigation (default), 2 both with root deciding and the
+      disagreements counted (validation of the analytic model)
+   */
+  int shadowModel;
+
   /*! \brief GDCGeometry constructor
    */
   GDCGeometry();
@@ -54,6 +54,11 @@ class GDCRayTracer : public GRayTracerBase {
 
   GOrderedGrid *facetGrid;
 
+  // photon location on the facet planes of the facets tested in findFacet
+  vector<double> vFacetPhotonX;
+  vector<double> vFacetPhotonY;
+  vector<double> vFacetPhotonR; //!< distance from the facet plane center
+
   int iFacet;  //!< facet number of photon hit
   ROOT::Math::XYZVector vPhotonOnFacT; //!< photon location on facet
   double fTimeOnFacet;  //!< time change from tel.hit to facet hit(meters)
@@ -63,6 +68,13 @@ class GDCRayTracer : public GRayTracerBase {
   GRootDCNavigator *geoT; //!< root geometry ray tracer from GrISU  
 
   double fTopVolOrigin2FocBox;  //!< distance from topvolOrigin to focBox
+
+  int iShadowModel;      //!< 0 analytic, 1 root, 2 both (GDCGeometry)
+  long lShadowChecksIn;  //!< photons checked with both models, incoming
+  long lShadowChecksOut; //!< photons checked with both models, outgoing
+  long lShadowDiffIn;    //!< disagreements of the models, incoming
+  long lShadowDiffOut;   //!< disagreements of the models, outgoing
+
   /*!<  \brief  determine the location of the photon on the tel.sphere
 
    */
@@ -76,6 +88,18 @@ class GDCRayTracer : public GRayTracerBase {
   
   bool getPhotonOnCamera();
 
+  /*! \brief shadowing of the incoming photon by the telescope structure
+      \param pos photon position, focal point coor.
+      \param dir photon direction
+      \return true if the photon is shadowed
+   */
+  bool getShadowIn(double *pos,double *dir);
+
+  /*! \brief shadowing of the photon reflected from the facet: true unless
+        the photon reaches the bottom of the focus box
+   */
+  bool getShadowOut(double *pos,double *dir);
+
  public:
 
   GDCRayTracer(GDCTelescope *dcTel);
@@ -0,0 +1,137 @@
+/*
+VERSION3.1
+2March2015
+*/
+/*!  /brief GDCShadowModel class, analytic model of the DC telescope
+     structure (focus box, edge boxes, shutter, quad arms, cross arms,
+     support wires) used for the shadowing of photons in place of
+     the TGeo navigation of GRootDCNavigator.
+
+     The occluders are the volumes placed by GRootDCNavigator: tubes,
+     hexagonal prisms (possibly hollow) and trapezoidal prisms, each with
+     the rotation matrix and translation of its node in the top volume.
+     All coordinates are top volume coordinates, as in the navigator.
+     An occluder is identified by the TGeo node number of its volume;
+     0 means that the photon leaves the top volume without hitting any
+     occluder. The occluder bounding boxes are kept in a small bounding
+     volume hierarchy.
+ */
+
+#ifndef GDCSHADOWMODEL
+#define GDCSHADOWMODEL
+
+class GDCShadowModel {
+
+  /*! \brief one occluder. The solid is the convex region inside all
+        planes (and inside the cylinder for a tube) minus the convex
+        region inside all hole planes (or inside the hole cylinder).
+   */
+  struct Occluder {
+    int id;              //!< TGeo node number
+    string name;         //!< TGeo node name
+    double rot[9];       //!< rotation matrix, master = rot*local + tr
+    double tr[3];        //!< translation
+    bool bCylinder;      //!< true for a tube
+    double rmax;         //!< tube outer radius
+    double rmin;         //!< tube inner radius
+    vector<double> planes;     //!< nx,ny,nz,d: inside if n.x <= d
+    vector<double> holePlanes; //!< same for the hole, no hole if empty
+    double lo[3];        //!< bounding box, top volume coor.
+    double hi[3];
+  };
+
+  /*! \brief node of the bounding volume hierarchy: either two children
+        or a range of occluders in vIndex
+   */
+  struct BVHNode {
+    double lo[3];
+    double hi[3];
+    int left;     //!< child nodes, -1 for a leaf
+    int right;
+    int first;    //!< leaf: first entry in vIndex
+    int count;    //!< leaf: number of entries
+  };
+
+  vector<Occluder> vOcc;
+  vector<BVHNode> vNode;
+  vector<int> vIndex;    //!< occluder indices, leaf after leaf
+
+  double fTopDim[3];     //!< top volume half dimensions
+
+  void setBoundingBox(Occluder *occ,const double *localLo,
+                      const double *localHi);
+
+  int buildNode(const int &first,const int &count);
+
+  /*! \brief first distance >= 0 along the ray at which it is inside
+        the occluder, pos and dir in top volume coordinates.
+        Returns false if the ray misses the occluder.
+   */
+  bool intersect(const Occluder &occ,const double *pos,const double *dir,
+                 double *dist) const;
+
+ public:
+
+  GDCShadowModel();
+
+  ~GDCShadowModel();
+
+  /*! \brief set the top volume half dimensions; photons leaving it
+        are not shadowed
+   */
+  void setTopVolume(const double *halfDim);
+
+  /*! \brief add a tube along the local z axis
+      \param id  TGeo node number
+      \param name TGeo node name
+      \param rmin inner radius
+      \param rmax outer radius
+      \param dz half length
+      \param rot rotation matrix of the node (9 values)
+      \param tr translation of the node
+   */
+  void addTube(const int &id,const string &name,
+               const double &rmin,const double &rmax,const double &dz,
+               const double *rot,const double *tr);
+
+  /*! \brief add a prism with regular polygon cross section, as a TGeoPgon
+         with two sections of the same radii: the radii are distances from
+         the axis to the middle of the edges, edge i has its middle at
+         angle phi1 + (i+0.5)*360/nedges degrees
+   */
+  void addPgon(const int &id,const string &name,
+               const int &nedges,const double &phi1,
+               const double &rmin,const double &rmax,
+               const double &zmin,const double &zmax,
+               const double *rot,const double *tr);
+
+  /*! \brief add a prism with planar faces given by 8 vertices as in
+        TGeoArb8: vertices 0-3 at z = -dz, 4-7 at z = +dz, (x,y) pairs
+   */
+  void addArb8(const int &id,const string &name,
+               const double *vertices,const double &dz,
+               const double *rot,const double *tr);
+
+  /*! \brief make the bounding volume hierarchy, after all occluders
+        have been added
+   */
+  void build();
+
+  /*! \brief find the first occluder hit by the photon
+      \param pos photon position, top volume coor.
+      \param dir photon direction
+      \param dist distance to the hit (if any)
+      \return node number of the occluder, 0 if none
+   */
+  int findOccluder(const double *pos,const double *dir,double *dist) const;
+
+  /*! \brief TGeo node name of the occluder, "" if unknown id
+   */
+  const char * getOccluderName(const int &id) const;
+
+  int getNumOccluders() const {
+    return vOcc.size();
+  };
+};
+
+#endif
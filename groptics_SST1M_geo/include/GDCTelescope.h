@@ -15,6 +15,7 @@ telescopes
 // forward declarations
 class TFile;
 class TTree;
+class GPhotonHistoryFile;
 #include "Math/Vector3Dfwd.h"
 #include "Math/GenVector/Rotation3Dfwd.h"
 #include "Math/GenVector/RotationXfwd.h"
@@ -89,10 +90,44 @@ struct DCStdFacet {
                       surface and the ideal sphere.*/
   double reflect;   /*!< Mirror element reflectivity degradation factor*/
   int rflctid;   /*!< Mirror element reflectivity curve identifier*/
+  const GUtilityFuncts::ReflTable *reflTable; /*!< curve rflctid, set by
+                                                GDCTelescope::makeReflTables */
 
 };
 /**************************end of DCStdFacet ******************************/
 
+/*! \brief DCFacetArrays holds the facet parameters used in the facet 
+         search, one array per parameter. The facets are stored grid bin 
+         after grid bin in the order of the grid bin lists (a facet appears
+         in all bins it covers), so that the facets of a bin are contiguous. 
+         Without a grid there is a single bin with all facets.
+ */
+struct DCFacetArrays {
+
+  vector<int> binStart;  /*!< facets of bin b: binStart[b] to binStart[b+1]-1 */
+  int maxBinSize;        /*!< largest number of facets in a bin */
+
+  vector<int> facNum;    /*!< facet number, index in the facet vector */
+  vector<int> sides;     /*!< number of sides of the facet polygon */
+  vector<double> plX;    /*!< facet plane center */
+  vector<double> plY;
+  vector<double> plZ;
+  vector<double> nX;     /*!< unit vector: facet plane to cur.cent. */
+  vector<double> nY;
+  vector<double> nZ;
+  vector<double> ccX;    /*!< center of curvature */
+  vector<double> ccY;
+  vector<double> ccZ;
+  vector<double> radius; /*!< external radius */
+  vector<double> curv;   /*!< curvature radius */
+  vector<double> alpha;  /*!< rotation of the facet polygon */
+  vector<GUtilityFuncts::PolyEdges> poly; /*!< edges of the facet polygon */
+
+  DCFacetArrays() {
+    maxBinSize = 0;
+  };
+};
+
 /*! \brief GDCTelescope contains the full description of a single
        telescope, including a ray-tracing method. Class inherits from
        GTelescope
@@ -101,6 +136,7 @@ struct DCStdFacet {
 // forward declarations
 class GGeometryBase;
 class GRayTracerBase;
+class GOrderedGrid;
 enum TelType;
 enum GeoType;
 enum RayTracerType;
@@ -114,6 +150,12 @@ class GDCTelescope : public GTelescope {
   friend class GRootDCNavigator;
 
   void makePhotonHistoryBranches();
+
+  /*! \brief addHistoryField adds a history branch to hisT, or a field
+        to the compact history file hisC
+   */
+  void addHistoryField(const string &name,double *address);
+  void addHistoryField(const string &name,int *address);
   //public:
   
   // parameters common to all concrete classes
@@ -138,9 +180,13 @@ class GDCTelescope : public GTelescope {
   bool bPhotonHistoryFlag; //*< if false, no photon history file written
 
   string historyTreeName;
-  int historyOption;
+  int historyOption;      //!< 0: root tree, 1: compact history file
   TFile *hisF;
   TTree *hisT;
+  GPhotonHistoryFile *hisC; //!< compact history file if historyOption 1
+  int iHistorySample;     //!< record every iHistorySample-th photon
+  int iHistorySelect;     //!< if >= 0, record only photons on this facet
+  unsigned long iHistoryOffered; //!< photons passing the selection
 
   TelType eTelType; //!< telescope type enum
 
@@ -158,12 +204,27 @@ class GDCTelescope : public GTelescope {
   // map of reflection coeff. wavelgts and coeffs.
   map<int, vector<double> > *mVReflWaveLgts;
   map<int, vector<double> > *mVCoeffs;
+  map<int, GUtilityFuncts::ReflTable> mReflTables; //!< curves used by the facets, by id
 
   bool bGridOption; //!< if false, will loop through all facets, no grid search.
   //int nbinsx;  //!< number of grid bins in x direction for ordered hash table used in selecting a facet
   //int nbinsy;  //!< number of grid bins in y direction for ordered hash table used in selecting a facet
   
   vector<DCStdFacet> facet; //!< mirror element array  
+  DCFacetArrays facetArrays; //!< facet parameters for the facet search
+
+  /*! \brief makeFacetArrays fills facetArrays from the facets once their
+         curvature centers and planes are final.
+         \param grid facet grid of the ray tracer, 0 if no grid is used
+   */
+  void makeFacetArrays(GOrderedGrid *grid);
+
+  /*! \brief makeReflTables prepares the reflectivity curves of the facets
+         from mVReflWaveLgts and mVCoeffs and sets the facet reflTable 
+         pointers.
+   */
+  void makeReflTables();
+
   bool bEditAlignFlag;    // true if facet misalign parameter differs from standard misalignment.
   bool bEditReflectFlag;  // true if facet refl details differ from standard parameter.
 
@@ -266,11 +327,16 @@ double fTransitTime;                //!< photon total transit time (from inject
   */
   void setPrintMode(ostream &oStr=cout,const int prtMode=0);
     
-  /*! \brief 
-    
+  /*! \brief setPhotonHistory opens the photon history file; the
+        telescope number is added to the file name.
+      \param option 0: root tree, 1: compact history file (extension
+             .phist, see GPhotonHistoryFile)
+      \param sampleEvery record every sampleEvery-th photon
+      \param select if >= 0, record only photons hitting this facet
    */ 
   void setPhotonHistory(const string &rootFile,const string &treeName,
-                        const int &option = 0);
+                        const int &option = 0,const int &sampleEvery = 1,
+                        const int &select = -1);
 
   void writePhotonHistory();
 
@@ -302,6 +368,13 @@ double fTransitTime;                //!< photon total transit time (from inject
   void setRayPlotMode(const enum RayPlotType &eRayPlot) {
 
   };
+
+  /*! \brief getApertureEnvelope gives the cylinder around the telescope
+        axis that contains all facet planes. No envelope if a photon 
+        history file is written, all photons have to appear there.
+  */
+  bool getApertureEnvelope(double *envRadius, double *envZMin,
+                           double *envZMax);
 };
 
 
@@ -70,6 +70,24 @@ class GOrderedGrid {
   bool getGridBinList(const double &x, const double &y,
                  list<GridFacet> *&gridList);
 
+  /*! \brief getGridBinKey gives the key of the grid bin for the location
+         x,y, the same bin getGridBinList would return.
+         \return false if x,y is outside the grid
+   */
+  bool getGridBinKey(const double &x, const double &y, int *gridKey);
+
+  /*! \brief getNumGridBins number of grid bins, 0 if there is no grid
+   */
+  int getNumGridBins() {
+    return vGrid.size();
+  };
+
+  /*! \brief getGridBin list of facets for the grid bin with key gridKey
+   */
+  list<GridFacet> *getGridBin(const int &gridKey) {
+    return vGrid[gridKey];
+  };
+
 };
 
 #endif
@@ -0,0 +1,107 @@
+/*
+VERSION3.1
+2March2015
+*/
+/*! \brief GPhotonHistoryFile class: compact photon history file with
+      one fixed size record of floats per photon, an alternative to the
+      photon history TTree of the telescopes.
+
+    The fields are registered like TTree branches, with the address of
+    a double or int telescope variable; fill() copies them as floats.
+    The file starts with a header: the 8 characters "GPHIST01", the
+    number of fields (int), the tree name and, for each field, the
+    branch type ('D' or 'I', one char) and the branch name (strings are
+    an int length followed by the characters). The records follow, one
+    float per field, in the byte order of the writing machine. The file
+    is append only: a record cut short by a crash is ignored on reading.
+    photonHistoryToRoot converts the file to the TTree layout.
+ */
+
+#ifndef GPHOTONHISTORYFILE
+#define GPHOTONHISTORYFILE
+
+class GPhotonHistoryFile {
+
+  FILE *pFile;          //!< history file, 0 if not open
+  bool bWrite;          //!< true if open for writing
+  string sFileName;
+  string sTreeName;     //!< tree name for the conversion
+
+  vector<string> vName;         //!< field (branch) names
+  vector<char> vType;           //!< 'D' double branch, 'I' int branch
+  vector<const double *> vAddrD; //!< field address if 'D', else 0
+  vector<const int *> vAddrI;    //!< field address if 'I', else 0
+
+  vector<float> vBuffer;        //!< records not yet written
+  unsigned iBufferRecords;      //!< number of records in vBuffer to write
+
+  unsigned long iNumRecords;    //!< records written or read
+
+  void writeString(const string &str);
+
+  bool readString(string *str);
+
+  void flushBuffer();
+
+ public:
+
+  GPhotonHistoryFile();
+
+  ~GPhotonHistoryFile();
+
+  /*! \brief addField registers a double field, as TTree::Branch; call
+        before openWrite
+   */
+  void addField(const string &name,const double *address);
+
+  /*! \brief addField registers an int field
+   */
+  void addField(const string &name,const int *address);
+
+  /*! \brief openWrite creates the file and writes the header
+      \param fileName history file name
+      \param treeName tree name used by the conversion to root
+      \return false file can not be created
+   */
+  bool openWrite(const string &fileName,const string &treeName);
+
+  /*! \brief fill appends a record with the current field values
+   */
+  void fill();
+
+  /*! \brief openRead opens a history file and reads its header
+      \return false file can not be opened or is not a history file
+   */
+  bool openRead(const string &fileName);
+
+  /*! \brief readRecord reads the next record, one float per field
+      \return false no complete record left
+   */
+  bool readRecord(vector<float> *record);
+
+  /*! \brief close writes the remaining records and closes the file
+   */
+  void close();
+
+  string getTreeName() {
+    return sTreeName;
+  };
+
+  int getNumFields() {
+    return vName.size();
+  };
+
+  string getFieldName(const int &i) {
+    return vName.at(i);
+  };
+
+  char getFieldType(const int &i) {
+    return vType.at(i);
+  };
+
+  unsigned long getNumRecords() {
+    return iNumRecords;
+  };
+};
+
+#endif
@@ -24,7 +24,14 @@ class GReadPhotonGrISU: public GReadPhotonBase {
   double fGlobalEffic; //!< global efficiency from R record
   unsigned int iParticleType; //!< primary particle type from header record
 
-  string sFileLine;  //!< current record, filled by getLine() method
+  // input is read in large blocks; records are scanned in place
+  vector<char> vBuffer;   //!< block buffer, one extra byte for a '\0'
+  unsigned long iBufBeg;  //!< start of the unscanned data in vBuffer
+  unsigned long iBufEnd;  //!< end of the data in vBuffer
+  bool bInputEOF;         //!< true when the input stream is exhausted
+
+  const char *pRec;     //!< current record, filled by getLine() method
+  const char *pRecEnd;  //!< end of the current record (the '\n')
 
   GrISURecType eRecType;  //<! enum for record most recently read
 
@@ -57,10 +64,30 @@ class GReadPhotonGrISU: public GReadPhotonBase {
   double fWobbleR;
   double fLatitude;
 
+  /*! \brief fillBuffer moves the unscanned data to the front of
+        vBuffer (enlarging it if it is full) and appends the next block
+        of the input stream. Sets bInputEOF at the end of the input.
+   */
+  void fillBuffer();
+
+  /*! \brief nextLine finds the next line in the buffer, same lines as
+        getline(*pInStream,line,'\n'). The line stays valid until the
+        next call.
+      \param beg start of the line
+      \param end end of the line, excluding the '\n'
+      \return false no line available
+   */
+  bool nextLine(const char **beg,const char **end);
+
+  /*! \brief readLine copies the next line to a string, used for the
+        header records
+   */
+  bool readLine(string *line);
+
   /*!  \brief getLine.  Get the next input record. This record becomes
                      the current record.
 
-      Place the string in the sFileLine variable. Set the eRecType
+      Set pRec and pRecEnd to the record in the buffer. Set the eRecType
       enum variable to identify the record type for the current record.
       Only options are S line, P line, or EOF types.
 
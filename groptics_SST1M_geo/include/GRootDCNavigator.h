@@ -18,6 +18,7 @@ class TGeoRotation;
 class TVector3;
 class GDCTelescope;
 class GDCGeometry;
+class GDCShadowModel;
 
 class GRootDCNavigator {
 
@@ -55,6 +56,9 @@ class GRootDCNavigator {
   TVector3 *fQuadArmR2R1V[4]; // r2-r1 vector for each quad arm
              
   bool fMakeFacetsFlag;
+
+  GDCShadowModel *fShadow;  // analytic copy of the volumes, 0 if not made
+  int fFocBoxNum;           // node number of fFocBoxVol_1
   // ========== photon location, direction, node variables
 
   double fPosC[3];  // current position
@@ -80,6 +84,11 @@ class GRootDCNavigator {
   void makeFacets();
   void makeCrossArms();      // make and place cross arms
   void makeSupportWires();
+  void makeShadowModel();    // copy the placed volumes to fShadow
+
+  // copy position and direction to fPosC/fDirC in TOP coordinates,
+  // moved to the top of the TOP volume if dir[2] < 0
+  void setTopVolPositionDirection(double *pos, double *dir);
 
  public:
 
@@ -106,6 +115,20 @@ class GRootDCNavigator {
 
   void movePositionToTopOfTopVol();
 
+  // true if the analytic shadowing model could be made from the volumes
+  bool hasShadowModel() { return (fShadow != 0); };
+
+  // analytic shadowing: position and direction as for setPositionDirection,
+  // returns node number of the first volume hit, 0 if the photon leaves
+  // the top volume. hitPos is the hit location in TOP coordinates.
+  int getOccluder(double *pos, double *dir, double *hitPos);
+
+  // node name for a node number from getOccluder, "fTopVol_1" for 0
+  const char * getOccluderName(const int &nodeNum);
+
+  // node number of the focus box
+  int getFocusBoxNodeNumber() { return fFocBoxNum; };
+
   // draw the telescope volumes
   void drawTelescope(const int &option = 0);
   
@@ -17,8 +17,10 @@ telescope.  Inherits from GTelescope base class.
 // forward declarations
 class TFile;
 class TTree;
+class GPhotonHistoryFile;
 class ARay;
 class TGraph;
+class TGeoVolume;
 
 #include "Math/Vector3Dfwd.h"
 #include "Math/GenVector/Rotation3Dfwd.h"
@@ -44,6 +46,10 @@ class GSCTelescope : public GTelescope {
   ARay *ray;
   TFile *hisF;
   TTree *hisT;
+  GPhotonHistoryFile *hisC; //!< compact history file if iHistoryOption 1
+  int iHistorySample;     //!< record every iHistorySample-th photon
+  int iHistorySelect;     //!< if >= 0, record only photons with this status
+  unsigned long iHistoryOffered; //!< photons passing the selection
 
   double fTX;  //!< top volume dimensions
   double fTY;
@@ -72,6 +78,12 @@ class GSCTelescope : public GTelescope {
   double fSeconMaxLmda;
   double fSeconMinLmda;
 
+  // photon bundles: the mirror reflectivities are taken out of the
+  // mirrors and applied per wavelength after the ray tracing
+  map<TGeoVolume *, TGraph *> mMirrorRefl; //!< reflectivity of each mirror
+  bool bPhotonBundles;   //!< if true, mirrors own no reflectivity graph
+  vector<double> vBundleLambda; //!< bundle wavelengths (cm)
+
   string historyFileName; /*!< name of photon history file, 
                             if "", no history written */
   string historyTreeName;
@@ -148,12 +160,29 @@ class GSCTelescope : public GTelescope {
 
   void makePhotonHistoryBranches();
 
+  /*! \brief addHistoryField adds a history branch to hisT, or a field
+        to the compact history file hisC
+   */
+  void addHistoryField(const string &name,Double_t *address);
+  void addHistoryField(const string &name,Int_t *address);
+
   void fillPhotonHistory();
 
   void initializePhotonHistoryParms();
 
   void movePositionToTopOfTopVol();
 
+  /*! \brief traceRay ray traces the photon from fphotonInjectLoc, 
+        fphotonInjectDir and fphotWaveLgt
+   */
+  void traceRay();
+
+  /*! \brief getMirrorWeights multiplies, for each wavelength (cm), the
+        reflectivities of the mirrors hit by the traced ray
+   */
+  void getMirrorWeights(const vector<double> &vLambda,
+                        vector<double> *vWeight);
+
   void initialization();
 
  public:
@@ -183,6 +212,19 @@ class GSCTelescope : public GTelescope {
                     const ROOT::Math::XYZVector &photonDirT,
                     const double &photWaveLgt);
 
+  /*! \brief setPhotonBundles moves the reflectivity graphs from the
+        mirrors to mMirrorRefl, see GTelescope::setPhotonBundles
+   */
+  bool setPhotonBundles();
+
+  /*! \brief injectPhotonBundle traces one ray for a bundle of photons,
+        see GTelescope::injectPhotonBundle
+   */
+  bool injectPhotonBundle(const ROOT::Math::XYZVector &photonLocT,
+                          const ROOT::Math::XYZVector &photonDirT,
+                          const vector<double> &vWaveLgt,
+                          vector<double> *vWeight);
+
   /*! \brief getCameraPhotonLocation gets camera location following ray tracing. 
          RETURN FALSE IN CASE PHOTON DOESN'T REACH CAMERA
 
@@ -217,11 +259,18 @@ class GSCTelescope : public GTelescope {
   */
   void setPrintMode(ostream &oStr=cout,const int prtMode=0);
    
-  /*! \brief 
-    
+  /*! \brief setPhotonHistory opens the photon history file; the
+        telescope number is added to the file name.
+      \param option 0: root tree, 1: compact history file (extension
+             .phist, see GPhotonHistoryFile)
+      \param sampleEvery record every sampleEvery-th photon
+      \param select if >= 0, record only photons with this final status
+             (1 stopped by an obscuration, 2 exited, 3 focused, 
+              5 absorbed)
    */ 
   void setPhotonHistory(const string &rootFile,const string &treeName,
-                        const int &option = 0);
+                        const int &option = 0,const int &sampleEvery = 1,
+                        const int &select = -1);
 
   void writePhotonHistory();
 
@@ -33,11 +33,13 @@ enum TelType;
 class mirrorSegmentDetails;
 class TFile;
 class TTree;
+class GPhotonHistoryFile;
 class ARay;
 class TGraph;
 class AGeoAsphericDisk;
 class SegmentedMirror;
 class SegmentedObscuration;
+class TGeoVolume;
 
 class GSegSCTelescope : public GTelescope {
 
@@ -51,6 +53,10 @@ class GSegSCTelescope : public GTelescope {
   ARay *ray;
   TFile *hisF;
   TTree *hisT;
+  GPhotonHistoryFile *hisC; //!< compact history file if iHistoryOption 1
+  int iHistorySample;     //!< record every iHistorySample-th photon
+  int iHistorySelect;     //!< if >= 0, record only photons with this status
+  unsigned long iHistoryOffered; //!< photons passing the selection
 
   //!< top volume dimensions
   Double_t fTX;  // set at 30.0 for now, in SCTelescope = 15.0. make graphs first
@@ -121,6 +127,12 @@ class GSegSCTelescope : public GTelescope {
   map<int, TGraph *> *mGRefl;
   Int_t iReflect;
 
+  // photon bundles: the mirror reflectivities are taken out of the
+  // mirrors and applied per wavelength after the ray tracing
+  map<TGeoVolume *, TGraph *> mMirrorRefl; //!< reflectivity of each mirror
+  bool bPhotonBundles;   //!< if true, mirrors own no reflectivity graph
+  vector<double> vBundleLambda; //!< bundle wavelengths (cm)
+
   string historyFileName; /*!< name of photon history file, 
                             if "", no history written */
   string historyTreeName;
@@ -172,12 +184,29 @@ class GSegSCTelescope : public GTelescope {
 
   void makePhotonHistoryBranches();
 
+  /*! \brief addHistoryField adds a history branch to hisT, or a field
+        to the compact history file hisC
+   */
+  void addHistoryField(const string &name,Double_t *address);
+  void addHistoryField(const string &name,Int_t *address);
+
   void fillPhotonHistory();
 
   void initializePhotonHistoryParms();
 
   void movePositionToTopOfTopVol();
 
+  /*! \brief traceRay ray traces the photon from fphotonInjectLoc, 
+        fphotonInjectDir and fphotWaveLgt
+   */
+  void traceRay();
+
+  /*! \brief getMirrorWeights multiplies, for each wavelength (cm), the
+        reflectivities of the mirrors hit by the traced ray
+   */
+  void getMirrorWeights(const vector<double> &vLambda,
+                        vector<double> *vWeight);
+
   void initialize();
 
   void makePrimarySecondaryDisks();
@@ -228,6 +257,19 @@ class GSegSCTelescope : public GTelescope {
                     const ROOT::Math::XYZVector &photonDirT,
                     const double &photWaveLgt);
 
+  /*! \brief setPhotonBundles moves the reflectivity graphs from the
+        mirrors to mMirrorRefl, see GTelescope::setPhotonBundles
+   */
+  bool setPhotonBundles();
+
+  /*! \brief injectPhotonBundle traces one ray for a bundle of photons,
+        see GTelescope::injectPhotonBundle
+   */
+  bool injectPhotonBundle(const ROOT::Math::XYZVector &photonLocT,
+                          const ROOT::Math::XYZVector &photonDirT,
+                          const vector<double> &vWaveLgt,
+                          vector<double> *vWeight);
+
   /*! \brief getCameraPhotonLocation gets camera location following ray tracing. 
          RETURN FALSE IN CASE PHOTON DOESN'T REACH CAMERA
 
@@ -262,11 +304,18 @@ class GSegSCTelescope : public GTelescope {
   */
   void setPrintMode(ostream &oStr=cout,const int prtMode=0);
    
-  /*! \brief 
-    
+  /*! \brief setPhotonHistory opens the photon history file; the
+        telescope number is added to the file name.
+      \param option 0: root tree, 1: compact history file (extension
+             .phist, see GPhotonHistoryFile)
+      \param sampleEvery record every sampleEvery-th photon
+      \param select if >= 0, record only photons with this final status
+             (1 stopped by an obscuration, 2 exited, 3 focused, 
+              5 absorbed)
    */ 
   void setPhotonHistory(const string &rootFile,const string &treeName,
-                        const int &option = 0);
+                        const int &option = 0,const int &sampleEvery = 1,
+                        const int &select = -1);
 
   void writePhotonHistory();
 
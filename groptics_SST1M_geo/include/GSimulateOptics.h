@@ -102,6 +102,36 @@ class GSimulateOptics {
   int    iPhotType;
   int    iPhotTelHitNum;
   bool photonFlag;
+
+  // photons are read in batches, checked against the telescope 
+  // envelopes and then ray traced
+  GPhotonBatch photonBatch;
+  unsigned iPhotonBatchSize;  //!< maximum number of photons in a batch
+  map<int, vector<unsigned> > mBatchPhotons; //!< batch photons per telescope
+  vector<double> vTelTransform; //!< GArrayTel::getTelTransform per telescope
+
+  // photon bundles: the photons of a CORSIKA bunch, expanded into 
+  // photons with the same location, direction and time, are ray traced
+  // as one ray by the telescopes that can trace bundles
+  unsigned iPhotonBundleSize;  //!< max. photons per bundle, <= 1 no bundles
+  map<int, bool> mBundleTel;   //!< true if the telescope traces bundles
+  vector<char> vBundleSurvive; //!< GArrayTel::setPhotonBundle result
+
+  /*! \brief findBundle gives the number of photons of the batch, from
+        photon first on, that form a bundle with photon first
+   */
+  unsigned findBundle(const unsigned &first);
+
+  /*! \brief addPhotonToBatch adds the photon read last to the batch
+   */
+  void addPhotonToBatch();
+
+  /*! \brief traceBatch culls and ray traces the photons in the batch,
+         adds them to the writers and clears the batch
+
+         \return number of culled photons
+   */
+  int traceBatch();
   
   /*!
    */
@@ -145,6 +175,13 @@ class GSimulateOptics {
     fLatitude = latitude;
   };
 
+  /*! \brief setPhotonBundleSize switches photon bundle tracing on
+        for the telescopes that support it (SC, SEGSC)
+        \param bundleSize maximum number of photons per bundle, 
+               <= 1: each photon is ray traced
+   */
+  void setPhotonBundleSize(const int &bundleSize);
+
   /*!  returns true if complete simulations successfully
    */
   bool startSimulations(const int &numShowers,
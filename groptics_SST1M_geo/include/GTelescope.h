@@ -59,7 +59,9 @@ class GTelescope {
   virtual void setPrintMode(ostream &oStr=cout,const int prtMode=0) = 0;
 
   virtual void setPhotonHistory(const string &rootFile,const string &treeName,
-                                const int &option = 0) = 0;
+                                const int &option = 0,
+                                const int &sampleEvery = 1,
+                                const int &select = -1) = 0;
 
   virtual void writePhotonHistory() = 0;
 
@@ -74,6 +76,49 @@ class GTelescope {
   virtual double getPlateScaleFactor() = 0;
 
   virtual void setRayPlotMode(const enum RayPlotType &eRayPlot) = 0;
+
+  /*! \brief getApertureEnvelope gives a cylinder around the telescope
+        axis (telescope coor. relative to the telescope location, meters)
+        that contains everything a photon has to hit to reach the camera.
+        Photons whose path stays outside of it can be skipped. 
+
+        \param envRadius radius of the cylinder
+        \param envZMin   lower z of the cylinder
+        \param envZMax   upper z of the cylinder
+        \return false if no envelope is available and all photons
+                have to be ray traced
+  */
+  virtual bool getApertureEnvelope(double *envRadius, double *envZMin,
+                                   double *envZMax) {
+    return false;
+  };
+
+  /*! \brief setPhotonBundles switches photon bundle tracing on: the
+        mirror reflectivities are no longer applied during the ray
+        tracing but afterwards, per wavelength, by injectPhotonBundle
+        (injectPhoton applies them to its single wavelength).
+        \return false if the telescope can not trace bundles
+  */
+  virtual bool setPhotonBundles() {
+    return false;
+  };
+
+  /*! \brief injectPhotonBundle ray traces one geometric ray for a
+        bundle of photons with the same location and direction and
+        different wavelengths. getCameraPhotonLocation then gives the
+        camera location common to the bundle.
+        \param vWaveLgt wavelengths of the bundle (nm); the ray is traced
+               at the first one
+        \param vWeight  probability, per wavelength, that the photon is
+               reflected by all mirrors on the path of the ray
+        \return false if photon bundles are not switched on
+  */
+  virtual bool injectPhotonBundle(const ROOT::Math::XYZVector &photonLocT,
+                                  const ROOT::Math::XYZVector &photonDirT,
+                                  const vector<double> &vWaveLgt,
+                                  vector<double> *vWeight) {
+    return false;
+  };
 };
 
 #endif
@@ -52,6 +52,58 @@ namespace GUtilityFuncts {
                   const double &radius, 
                   const double &x, const double &y); 
 
+  /*! \brief half-plane description of a regular polygon, made by 
+    polyEdges and used by the polyInside overloads below. 
+
+    A point (x,y) is inside when x*x+y*y <= radius2 and, for every 
+    edge j, x*nx[j] + y*ny[j] <= apothem. The content never changes 
+    after polyEdges, so one PolyEdges can be shared between threads.
+  */
+  struct PolyEdges {
+    int sides;          /*!< as in polyInside */
+    double radius2;     /*!< radius*radius */
+    double apothem;     /*!< distance from center to the edges */
+    vector<double> nx;  /*!< unit normals of the edges */
+    vector<double> ny;
+
+    PolyEdges() {
+      sides = 0;
+      radius2 = 0.0;
+      apothem = 0.0;
+    };
+  };
+
+  /*! \brief set up the edge normals of the polygon polyInside would
+    test with the same sides, alpha, and radius. Trig functions are
+    only called here.
+  */
+  void polyEdges(const int &sides, const double &alpha, 
+                 const double &radius, PolyEdges *edges);
+
+  /*! \brief same test as polyInside, using the edge normals from 
+    polyEdges: only multiplications, additions and comparisons.
+  */
+  inline bool polyInside(const PolyEdges &edges,
+                         const double &x, const double &y) {
+    if (edges.sides <= 0) return false;
+    if ( (x*x + y*y) > edges.radius2) return false;
+    const double *nx = edges.nx.empty() ? 0 : &(edges.nx[0]);
+    const double *ny = edges.ny.empty() ? 0 : &(edges.ny[0]);
+    int nEdges = edges.nx.size();
+    bool inside = true;
+    for (int j = 0; j < nEdges; j++) {
+      inside &= ( (x*nx[j] + y*ny[j]) <= edges.apothem);
+    }
+    return inside;
+  };
+
+  /*! \brief batch version: tests n points (x[i],y[i]), relative to 
+    the polygon center, against one polygon; inside[i] is set to 
+    the result for point i.
+  */
+  void polyInside(const PolyEdges &edges, const int &n,
+                  const double *x, const double *y, bool *inside);
+
 
 
   /*! \brief tokenizer function, converts to string to token vector.
@@ -219,6 +271,30 @@ namespace GUtilityFuncts {
                       const vector<double> &refWaveLgt,
                       const double &reflect,
                       const double &photonWaveLgt );
+
+   /*! \brief reflectivity curve prepared for photonReflect: nodes in
+    increasing wavelength with slope and intercept of each interval.
+    Interval n goes from waveLgt[n-1] to waveLgt[n].
+   */
+   struct ReflTable {
+     vector<double> waveLgt;    /*!< curve nodes */
+     vector<double> slope;      /*!< slope of interval n */
+     vector<double> intercept;  /*!< intercept of interval n */
+   };
+
+   /*! \brief make the ReflTable of a reflectivity curve, once per 
+    curve; stops the code if the wavelengths are not in increasing order
+   */
+   void makeReflTable(const vector<double> &refCoeff,
+                      const vector<double> &refWaveLgt,
+                      ReflTable *table);
+
+   /*! \brief same as photonReflect above (same interpolation and same 
+    use of TR3), with a binary search for the interval of the table
+   */
+   bool photonReflect(const ReflTable &table,
+                      const double &reflect,
+                      const double &photonWaveLgt );
                          
 
    void reflectDirection(const ROOT::Math::XYZVector &vnormUnit,
@@ -22,6 +22,9 @@ VERSION3.1
 #include <bitset>
 #include <iomanip>
 #include <limits>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/wait.h>
 
 using namespace std;
 
@@ -74,6 +77,8 @@ GArrayTel::GArrayTel() {
 
   tel = 0;
   fDelay = 0;
+  iNumPhotonsChecked = 0;
+  iNumPhotonsCulled  = 0;
   
 };
 /**************end of GArrayTel ***************************/
@@ -116,6 +121,10 @@ GArrayTel::GArrayTel(const ROOT::Math::XYZVector telLocGrd,
   fSrcRelToCameraY = 0.0;
   dStoreLoc = 0;
   dStorePix = 0;
+  iNumPhotonsChecked = 0;
+  iNumPhotonsCulled  = 0;
+  for (int i = 0;i < 9;i++) fRotGrdToTel[i] = 0.0;
+  for (int i = 0;i < 3;i++) fTelLocTC[i] = 0.0;
 
   // initialize rotation matrix
   // will use later in setting up rotation matrix for telCoors.
@@ -224,6 +233,10 @@ void GArrayTel::setPrimary(const ROOT::Math::XYZVector &vSCorec,
 
   // get telescope grd.location in telescope coordinates
   telLocGrdTC = rotGrdToTel*telLocGrdGC;
+
+  // plain copies for the photon transformation
+  rotGrdToTel.GetComponents(fRotGrdToTel);
+  telLocGrdTC.GetCoordinates(fTelLocTC);
   // get core location in telescope coordinates
   vSCoreTC = rotGrdToTel*vSCoreGC;
   vSDcosTC = rotGrdToTel*vSDcosGC;
@@ -360,6 +373,72 @@ void GArrayTel::setPhoton(const ROOT::Math::XYZVector &pGrd,
     GUtilityFuncts::printGenVector(vPhotonRelLocTC); *oLog << endl << endl;;
   }    
 
+  tracePhoton();
+};  
+/************** end of setPhoton ***************************/
+
+void GArrayTel::setPhoton(const GPhotonBatch &batch, const unsigned &k) {
+
+  // only the parameters needed for the ray tracing, the photon
+  // is already in telescope coordinates
+  fPhotGrdTime   = batch.grdTime[k];
+  fPhotWaveLgt   = batch.waveLgt[k];
+  iPhotTelHitNum = batch.tel[k];
+
+  vPhotonRelLocTC.SetCoordinates(batch.relLocX[k],batch.relLocY[k],
+                                 batch.relLocZ[k]);
+  vPhotonDcosTC.SetCoordinates(batch.dcosTX[k],batch.dcosTY[k],
+                               batch.dcosTZ[k]);
+  tracePhoton();
+};  
+/************** end of setPhoton ***************************/
+
+bool GArrayTel::setPhotonBundle(const GPhotonBatch &batch, 
+                                const unsigned &first, const unsigned &num,
+                                vector<char> *vSurvive) {
+
+  bool debug = false;
+  if (debug) {
+    *oLog << "  -- GArrayTel::setPhotonBundle: telID: " << telID 
+          << "  photons " << num << endl;
+  }
+  fPhotGrdTime   = batch.grdTime[first];
+  fPhotWaveLgt   = batch.waveLgt[first];
+  iPhotTelHitNum = batch.tel[first];
+
+  vPhotonRelLocTC.SetCoordinates(batch.relLocX[first],batch.relLocY[first],
+                                 batch.relLocZ[first]);
+  vPhotonDcosTC.SetCoordinates(batch.dcosTX[first],batch.dcosTY[first],
+                               batch.dcosTZ[first]);
+  vBundleLambda.assign(batch.waveLgt.begin() + first,
+                       batch.waveLgt.begin() + first + num);
+
+  if (!tel->injectPhotonBundle(vPhotonRelLocTC,vPhotonDcosTC,
+                               vBundleLambda,&vBundleWeight)) {
+    return false;
+  }
+
+  double netTelescopeTime;
+  bOnCamera = tel->getCameraPhotonLocation(&vPhotonCameraLoc,
+					   &vPhotonCameraDcos,
+					   &netTelescopeTime);
+  fTotalPhotonTime = netTelescopeTime + fPhotGrdTime;
+
+  // same test as the mirror reflection in the ray tracing
+  vSurvive->assign(num,0);
+  if (bOnCamera) {
+    for (unsigned i = 0;i<num;i++) {
+      if (vBundleWeight[i] >= gRandom->Uniform(1)) (*vSurvive)[i] = 1;
+    }
+  }
+  return true;
+};  
+/************** end of setPhotonBundle ***************************/
+
+void GArrayTel::tracePhoton() {
+
+  bool debugShort = false;
+
   tel->injectPhoton(vPhotonRelLocTC,vPhotonDcosTC,fPhotWaveLgt);
 
   double netTelescopeTime;
@@ -384,7 +463,136 @@ void GArrayTel::setPhoton(const ROOT::Math::XYZVector &pGrd,
   }
 
 };  
-/************** end of setPhoton ***************************/
+/************** end of tracePhoton ***************************/
+
+void GArrayTel::getTelTransform(double *transform) {
+
+  for (int i = 0;i < 9;i++) {
+    transform[i] = fRotGrdToTel[i];
+  }
+  for (int i = 0;i < 3;i++) {
+    transform[9 + i] = fTelLocTC[i];
+  }
+};
+/************** end of getTelTransform ***************************/
+
+void GArrayTel::transformPhotons(GPhotonBatch *batch, 
+                                 const vector<double> &telTransform) {
+
+  const unsigned n = batch->size();
+  if (n == 0) return;
+
+  const double *grdX = &(batch->grdX[0]);
+  const double *grdY = &(batch->grdY[0]);
+  const double *grdZ = &(batch->grdZ[0]);
+  const double *dcosX = &(batch->dcosX[0]);
+  const double *dcosY = &(batch->dcosY[0]);
+  const double *dcosZ = &(batch->dcosZ[0]);
+  const int *tel = &(batch->tel[0]);
+  double *relX = &(batch->relLocX[0]);
+  double *relY = &(batch->relLocY[0]);
+  double *relZ = &(batch->relLocZ[0]);
+  double *dTX = &(batch->dcosTX[0]);
+  double *dTY = &(batch->dcosTY[0]);
+  double *dTZ = &(batch->dcosTZ[0]);
+  const double *trans = &telTransform[0];
+
+  // same products as rotGrdToTel*vector in setPhoton, the photons
+  // are read in order so all arrays are streamed once
+  for (unsigned k = 0; k < n; k++) {
+    const double *r = trans + 12*tel[k];
+    const double gx = grdX[k], gy = grdY[k], gz = grdZ[k];
+    const double ux = dcosX[k], uy = dcosY[k], uz = dcosZ[k];
+    relX[k] = (r[0]*gx + r[1]*gy + r[2]*gz) - r[9];
+    relY[k] = (r[3]*gx + r[4]*gy + r[5]*gz) - r[10];
+    relZ[k] = (r[6]*gx + r[7]*gy + r[8]*gz) - r[11];
+    dTX[k] = r[0]*ux + r[1]*uy + r[2]*uz;
+    dTY[k] = r[3]*ux + r[4]*uy + r[5]*uz;
+    dTZ[k] = r[6]*ux + r[7]*uy + r[8]*uz;
+  }
+};
+/************** end of transformPhotons ***************************/
+
+void GArrayTel::cullPhotons(GPhotonBatch *batch, 
+                            const vector<unsigned> &iPhot) {
+
+  bool debug = false;
+  if (debug) {
+    *oLog << "  -- GArrayTel::cullPhotons: telID: " << telID 
+          << "  photons " << iPhot.size() << endl;
+  }
+
+  iNumPhotonsChecked += iPhot.size();
+
+  double envR = 0.0;
+  double envZMin = 0.0;
+  double envZMax = 0.0;
+  if (!tel->getApertureEnvelope(&envR,&envZMin,&envZMax) ) return;
+
+  // bounding sphere of the envelope cylinder
+  double sphZ = 0.5*(envZMin + envZMax);
+  double sphR2 = envR*envR + 0.25*(envZMax - envZMin)*(envZMax - envZMin);
+  double envR2 = envR*envR;
+
+  // photons in telescope coordinates from transformPhotons
+  const double *relX = &(batch->relLocX[0]);
+  const double *relY = &(batch->relLocY[0]);
+  const double *relZ = &(batch->relLocZ[0]);
+  const double *dTX = &(batch->dcosTX[0]);
+  const double *dTY = &(batch->dcosTY[0]);
+  const double *dTZ = &(batch->dcosTZ[0]);
+  char *accept = &(batch->accept[0]);
+
+  unsigned long nCulled = 0;
+  for (unsigned i = 0; i < iPhot.size(); i++) {
+    unsigned k = iPhot[i];
+    // photon location relative to the sphere center and direction,tel.coor.
+    double px = relX[k];
+    double py = relY[k];
+    double pz = relZ[k] - sphZ;
+    double ux = dTX[k];
+    double uy = dTY[k];
+    double uz = dTZ[k];
+
+    // closest approach of the photon path to the sphere center
+    double pu = px*ux + py*uy + pz*uz;
+    double pp = px*px + py*py + pz*pz;
+    bool bMiss = (pp - pu*pu/(ux*ux + uy*uy + uz*uz) > sphR2);
+
+    // closest approach to the telescope axis while crossing the envelope
+    if ( (!bMiss) && (fabs(uz) > 1.0e-9) ) {
+      double t1 = (envZMin - sphZ - pz)/uz;
+      double t2 = (envZMax - sphZ - pz)/uz;
+      double ax = px + t1*ux;
+      double ay = py + t1*uy;
+      double bx = (t2 - t1)*ux;
+      double by = (t2 - t1)*uy;
+      double bb = bx*bx + by*by;
+      double s = 0.0;
+      if (bb > 0.0) {
+        s = -(ax*bx + ay*by)/bb;
+        if (s < 0.0) s = 0.0;
+        if (s > 1.0) s = 1.0;
+      }
+      double cx = ax + s*bx;
+      double cy = ay + s*by;
+      bMiss = (cx*cx + cy*cy > envR2);
+    }
+
+    if (bMiss) {
+      accept[k] = 0;
+      nCulled++;
+    }
+  }
+  iNumPhotonsCulled += nCulled;
+
+  if (debug) {
+    *oLog << "        envelope R zMin zMax " << envR << " " << envZMin
+          << " " << envZMax << endl;
+    *oLog << "        culled " << nCulled << endl;
+  }
+};
+/************** end of cullPhotons ***************************/
 
 bool GArrayTel::getCameraPhotonLocation(ROOT::Math::XYZVector *photonLoc,
 					ROOT::Math::XYZVector *photonDcos,
@@ -405,7 +613,77 @@ bool GArrayTel::getCameraPhotonLocation(ROOT::Math::XYZVector *photonLoc,
 };
 /************** end of getCameraPhotonLocation ***************************/
 
-void GArrayTel::makeTelescopeTest(const string& testfile) {
+void GArrayTel::traceTestPhotons(const double &deg,const double &lambda,
+                                 const vector<double> &vX,
+                                 const vector<double> &vY,
+                                 const vector<double> &vZ,
+                                 const double &idealTransitTime,
+                                 const double &plateScaleFactor,
+                                 vector<double> *spot) {
+
+  bool debug = false;
+  if (debug) {
+    *oLog << endl << "  -- GArrayTel::traceTestPhotons for deg = " 
+          << deg << "  lambda = " << lambda << endl;
+  }
+  spot->clear();
+
+  // set directions
+  double theta = deg*(TMath::DegToRad());
+  double dl = sin(theta);
+  double dm = 0.0;
+  double dn = -cos(theta);
+  ROOT::Math::XYZVector photonDir(dl,dm,dn);
+
+  for (unsigned iph = 0;iph<vX.size();iph++) {
+      
+    // set locations of photon (put inside loop
+    ROOT::Math::XYZVector photonLoc(vX.at(iph),vY.at(iph),vZ.at(iph));
+      
+    if (debug) {
+      *oLog << "         photonLoc  ";       
+      GUtilityFuncts::printGenVector(photonLoc); *oLog << endl;
+      *oLog << "         photonDir  ";       
+      GUtilityFuncts::printGenVector(photonDir); *oLog << endl;
+    } 
+    
+    tel->injectPhoton(photonLoc,photonDir,lambda);
+      
+    ROOT::Math::XYZVector cameraLoc(0.0,0.0,0.0);
+    ROOT::Math::XYZVector cameraDir(0.0,0.0,0.0);
+    double cameraTime = 0.0;
+    bool onCamera = false;
+      
+    onCamera = tel->getCameraPhotonLocation(&cameraLoc,&cameraDir,
+                                            &cameraTime);
+
+    if (onCamera) {
+      // convert to minutes of arc, first subtract focus location since 
+      // we just want spread
+      double xMin = (cameraLoc.X() / 10.0) / plateScaleFactor;  // degrees
+      double yMin = (cameraLoc.Y() / 10.0) / plateScaleFactor;  // degrees
+
+      xMin = (xMin - theta*TMath::RadToDeg()) * 60.0; // minutes of arc
+      yMin = yMin*60.0;
+      if (debug) {
+        *oLog << "              camera location from telescope " 
+              << cameraLoc.X() << "  " << cameraLoc.Y() << endl;
+        *oLog << "              onCamera location in minutes of arc "
+              << xMin << "  " << yMin << endl;
+        *oLog << "              cameraDir  ";       
+        GUtilityFuncts::printGenVector(cameraDir); *oLog << endl;
+        *oLog << "              cameraTime " << cameraTime << endl << endl;
+      }
+      spot->push_back(xMin);
+      spot->push_back(yMin);
+      spot->push_back(cameraTime - idealTransitTime);
+    }  // onCamera
+  }  // iph
+};
+/************** end of traceTestPhotons ***************************/
+
+void GArrayTel::makeTelescopeTest(const string& testfile,
+                                  const GTelescopeTestScan &scan) {
   
   string baseName = testfile;
 
@@ -422,9 +700,11 @@ void GArrayTel::makeTelescopeTest(const string& testfile) {
   Double_t rmsXT = 0.0;
   Double_t rmsYT = 0.0;
   Double_t degT  = 0.0;
+  Double_t lambdaT = 0.0;
   ttree->Branch("rmsX",&rmsXT,"rmsX/D");
-  ttree->Branch("rmsY",&rmsXT,"rmsY/D");
+  ttree->Branch("rmsY",&rmsYT,"rmsY/D");
   ttree->Branch("deg",&degT,"deg/D");
+  ttree->Branch("lambda",&lambdaT,"lambda/D");
 
   bool debug = false;
   if (debug) {
@@ -441,8 +721,8 @@ void GArrayTel::makeTelescopeTest(const string& testfile) {
           make plots first.
    */
 
-  // make vector of directions, must come from method parameter above(make vector from min,max,delta)
-  // numDegBins must not exceed 8
+  // make vector of directions from the scan, or the telType defaults.
+  // histograms are made for the first 8 field angles only
   int numDegBins;
   if (debug) *oLog << "   telType  " << telType << endl;
 
@@ -484,8 +764,12 @@ void GArrayTel::makeTelescopeTest(const string& testfile) {
     timeHistXY = 10.0;
      // fill in the rest later if have time
   }
+  if (scan.numAngles > 0) {
+    numDegBins = scan.numAngles;
+    deltaDeg = scan.deltaDeg;
+  }
   // set number of photons
-  int nPhotons = 5000;
+  int nPhotons = scan.numPhotons;
 
   vector<double> vDeg;
   double setdeg = 0.0;
@@ -493,9 +777,18 @@ void GArrayTel::makeTelescopeTest(const string& testfile) {
     vDeg.push_back(setdeg);
     setdeg+=deltaDeg;
   }
+  vector<double> vLambda = scan.vLambda;
+  if (vLambda.size() == 0) {
+    vLambda.push_back(400.0);
+  }
+
+  // one task for each wavelength and field angle, all field angles
+  // of the first wavelength first
+  const int numDeg = vDeg.size();
+  const int numTasks = vLambda.size()*numDeg;
 
   // create hist point arrays
-  const int kN = vDeg.size();
+  const int kN = (numTasks < 8) ? numTasks : 8;
 
   //TH1D* histT[kN];   // time histograms
   TGraph* graRMS = new TGraph;
@@ -506,11 +799,15 @@ void GArrayTel::makeTelescopeTest(const string& testfile) {
   double spot = spotHistXY;
   for(Int_t n = 0; n < kN; n++){
     
-    double deg = vDeg[n];
+    double deg = vDeg[n % numDeg];
+    string angle = Form("#it{#theta} = %4.1f (deg)",deg);
+    if (vLambda.size() > 1) {
+      angle += Form(", #lambda = %5.1f (nm)",vLambda[n / numDeg]);
+    }
 
-    vHist.push_back(new TH2D(Form("hist%d", n), Form("#it{#theta} = %4.1f (deg);X (arcmin);Y (arcmin)", deg), 1000, -spot, spot, 1000, -spot, spot) );
+    vHist.push_back(new TH2D(Form("hist%d", n), Form("%s;X (arcmin);Y (arcmin)", angle.c_str()), 1000, -spot, spot, 1000, -spot, spot) );
  
-    vHistT.push_back(new TH1D(Form("histT%d",n), Form("#it{#theta} = %4.1f (deg);Propagation delay (ns);Entries", deg), 120, -timeHistXY, timeHistXY) );
+    vHistT.push_back(new TH1D(Form("histT%d",n), Form("%s;Propagation delay (ns);Entries", angle.c_str()), 120, -timeHistXY, timeHistXY) );
   }
   // get estimated transit time
   double idealTransitTime = tel->getIdealTransitTime();
@@ -559,83 +856,251 @@ void GArrayTel::makeTelescopeTest(const string& testfile) {
     }
   }
 
-  // set direction and wavelength of incoming photons
-  double lambda = 400.0;
+  // seeds for TR3 and gRandom for each task: the results do not 
+  // depend on the number of processes. Without the TESTTELSCAN record
+  // the generators run on as before.
+  vector<UInt_t> vSeed;
+  if (scan.reseedTasks) {
+    vSeed.resize(2*numTasks);
+    for (unsigned i = 0;i<vSeed.size();i++) {
+      vSeed[i] = 1 + TR3.Integer(kMaxInt);  // seed 0 would use the clock
+    }
+  }
 
-  for (unsigned ideg=0;ideg<vDeg.size();ideg++) {
-    // set directions
-    double theta = vDeg[ideg]*(TMath::DegToRad());
-    if (debug) {
-      *oLog << endl << "           start of ideg loop for deg = " 
-	    << vDeg[ideg] << endl;
+  // x, y (arcmin) and time (ns) of the photons on camera for each task
+  vector< vector<double> > vSpot(numTasks);
+
+  int numProc = scan.numProcesses;
+  if (numProc > numTasks) numProc = numTasks;
+  if ( (numProc < 1) || !scan.reseedTasks ) numProc = 1;
+
+  *oLog << "  -- GArrayTel::makeTelescopeTest: " << numDeg 
+        << " field angles, " << vLambda.size() << " wavelengths, "
+        << numProc << " processes" << endl;
+
+  if (numProc == 1) {
+    for (int k = 0;k<numTasks;k++) {
+      if (scan.reseedTasks) {
+        TR3.SetSeed(vSeed[2*k]);
+        gRandom->SetSeed(vSeed[2*k+1]);
+      }
+      traceTestPhotons(vDeg[k % numDeg],vLambda[k / numDeg],vX,vY,vZ,
+                       idealTransitTime,fPlateScaleFactor,&vSpot[k]);
+    }
+  }
+  else {
+    // the worker processes trace with their own copy of the telescope
+    // (ROOT geometry managers and random generators are global) and 
+    // write their tasks to a temporary file: task, number of values, 
+    // values.
+    *oLog << flush;
+    cout << flush;
+    cerr << flush;
+
+    vector<FILE *> vTmpFile(numProc);
+    vector<pid_t> vPid(numProc);
+    for (int w = 0;w<numProc;w++) {
+      vTmpFile[w] = tmpfile();
+      if (vTmpFile[w] == 0) {
+        *oLog << "  -- GArrayTel::makeTelescopeTest " << endl;
+        *oLog << "     could not make temporary file for process " << w
+              << endl;
+        *oLog << "     stopping code" << endl;
+        exit(0);
+      }
+    }
+    for (int w = 0;w<numProc;w++) {
+      vPid[w] = fork();
+      if (vPid[w] < 0) {
+        *oLog << "  -- GArrayTel::makeTelescopeTest " << endl;
+        *oLog << "     could not start process " << w << endl;
+        *oLog << "     stopping code" << endl;
+        exit(0);
+      }
+      if (vPid[w] == 0) {
+        // worker: round robin over the tasks. _exit so that the
+        // parent's open root file is left alone
+        bool okWrite = true;
+        for (int k = w;(k<numTasks) && okWrite;k+=numProc) {
+          TR3.SetSeed(vSeed[2*k]);
+          gRandom->SetSeed(vSeed[2*k+1]);
+          traceTestPhotons(vDeg[k % numDeg],vLambda[k / numDeg],vX,vY,vZ,
+                           idealTransitTime,fPlateScaleFactor,&vSpot[k]);
+          int numValues = vSpot[k].size();
+          okWrite = (fwrite(&k,sizeof(int),1,vTmpFile[w]) == 1);
+          okWrite = okWrite && 
+            (fwrite(&numValues,sizeof(int),1,vTmpFile[w]) == 1);
+          if (numValues > 0) {
+            okWrite = okWrite && 
+              ((int)fwrite(&vSpot[k][0],sizeof(double),numValues,
+                           vTmpFile[w]) == numValues);
+          }
+        }
+        okWrite = okWrite && (fflush(vTmpFile[w]) == 0);
+        *oLog << flush;
+        _exit( (okWrite) ? 0 : 1);
+      }
+    }
+
+    // wait for all workers, then collect the tasks
+    bool okWorkers = true;
+    for (int w = 0;w<numProc;w++) {
+      int status = 0;
+      waitpid(vPid[w],&status,0);
+      if ( !WIFEXITED(status) || (WEXITSTATUS(status) != 0) ) {
+        *oLog << "  -- GArrayTel::makeTelescopeTest " << endl;
+        *oLog << "     process " << w << " failed, status " << status
+              << endl;
+        okWorkers = false;
+      }
+    }
+    if (!okWorkers) {
+      *oLog << "     stopping code" << endl;
+      exit(0);
+    }
+    for (int w = 0;w<numProc;w++) {
+      rewind(vTmpFile[w]);
+      int k = 0;
+      int numValues = 0;
+      while ( (fread(&k,sizeof(int),1,vTmpFile[w]) == 1) &&
+              (fread(&numValues,sizeof(int),1,vTmpFile[w]) == 1) ) {
+        vSpot[k].resize(numValues);
+        if ( (numValues > 0) && 
+             ((int)fread(&vSpot[k][0],sizeof(double),numValues,
+                         vTmpFile[w]) != numValues) ) {
+          *oLog << "  -- GArrayTel::makeTelescopeTest " << endl;
+          *oLog << "     short read from process " << w << endl;
+          *oLog << "     stopping code" << endl;
+          exit(0);
+        }
+      }
+      fclose(vTmpFile[w]);
+    }
+  }
+
+  // merge the tasks in task order; the rms values of the graphs and tree
+  // are those of the histograms (photons within the histogram ranges), 
+  // the psf table uses all photons on the camera
+  ofstream psfTable;
+  if (scan.psfTable) {
+    string psfTableFile = baseName + "_psf.txt";
+    psfTable.open(psfTableFile.c_str());
+    if (!psfTable) {
+      *oLog << "  -- GArrayTel::makeTelescopeTest " << endl;
+      *oLog << "     could not open " << psfTableFile << endl;
+      *oLog << "     stopping code" << endl;
+      exit(0);
+    }
+    psfTable << "# lambda(nm) deg nPhotons nOnCamera xCentroid(arcmin) "
+             << "yCentroid(arcmin) d80(arcmin) rmsX(arcmin) rmsY(arcmin) "
+             << "tMean(ns) tRms(ns)" << endl;
+  }
+
+  for (int k = 0;k<numTasks;k++) {
+    const vector<double> &taskSpot = vSpot[k];
+    const int numOnCamera = taskSpot.size()/3;
+
+    if (k < kN) {
+      for (int i = 0;i<numOnCamera;i++) {
+        vHist[k]->Fill(taskSpot[3*i],taskSpot[3*i+1]);
+        vHistT[k]->Fill(taskSpot[3*i+2]);
+      }
+    }
+
+    // spot and time rms within the histogram ranges
+    double sumX = 0.0, sumXX = 0.0, sumY = 0.0, sumYY = 0.0;
+    double sumT = 0.0, sumTT = 0.0;
+    int numXY = 0;
+    int numT = 0;
+    for (int i = 0;i<numOnCamera;i++) {
+      double x = taskSpot[3*i];
+      double y = taskSpot[3*i+1];
+      double t = taskSpot[3*i+2];
+      if ( (x >= -spot) && (x < spot) && (y >= -spot) && (y < spot) ) {
+        sumX += x; sumXX += x*x;
+        sumY += y; sumYY += y*y;
+        numXY++;
+      }
+      if ( (t >= -timeHistXY) && (t < timeHistXY) ) {
+        sumT += t; sumTT += t*t;
+        numT++;
+      }
+    }
+    double rmsx = 0.0;
+    double rmsy = 0.0;
+    double rmst = 0.0;
+    if (numXY > 0) {
+      double mx = sumX/numXY;
+      double my = sumY/numXY;
+      rmsx = sqrt(fabs(sumXX/numXY - mx*mx));
+      rmsy = sqrt(fabs(sumYY/numXY - my*my));
+    }
+    if (numT > 0) {
+      double mt = sumT/numT;
+      rmst = sqrt(fabs(sumTT/numT - mt*mt));
     }
-    double dl = sin(theta);
-    double dm = 0.0;
-    double dn = -cos(theta);
-    ROOT::Math::XYZVector photonDir(dl,dm,dn);
-    
-    for (int iph = 0;iph<nPhotons;iph++) {
-      
-     // set locations of photon (put inside loop
-      ROOT::Math::XYZVector photonLoc(vX.at(iph),vY.at(iph),vZ.at(iph));
-      
-      if (debug) {
-	*oLog << "         photonLoc  ";       
-      GUtilityFuncts::printGenVector(photonLoc); *oLog << endl;
-      *oLog << "         photonDir  ";       
-      GUtilityFuncts::printGenVector(photonDir); *oLog << endl;
-      } 
-    
-      tel->injectPhoton(photonLoc,photonDir,lambda);
-      
-      ROOT::Math::XYZVector cameraLoc(0.0,0.0,0.0);
-      ROOT::Math::XYZVector cameraDir(0.0,0.0,0.0);
-      double cameraTime = 0.0;
-      bool onCamera = false;
-      
-      onCamera = tel->getCameraPhotonLocation(&cameraLoc,&cameraDir,&cameraTime);
-
-      if (onCamera) {
-	// convert to minutes of arc, first subtract focus location since we just want spread
-	double xMin = (cameraLoc.X() / 10.0) / fPlateScaleFactor;  // xMin now in degrees
-	double yMin = (cameraLoc.Y() / 10.0) / fPlateScaleFactor;  // yMin now in degrees
-
-	//double xMin = (cameraLoc.X() / (fLgt*1000.))*TMath::RadToDeg();
-	//double yMin = (cameraLoc.Y() / (fLgt*1000.))*TMath::RadToDeg();
-	
-	xMin = (xMin - theta*TMath::RadToDeg()) * 60.0; // converting to minutes of arc
-	yMin = yMin*60.0;
-	if (debug) {
-          *oLog << "              camera location from telescope " << cameraLoc.X()
-                << "  " << cameraLoc.Y() << endl;
-	  *oLog << "              onCamera location in minutes of arc "
-		<< xMin << "  " << yMin << endl;
-	  *oLog << "              cameraDir  ";       
-	  GUtilityFuncts::printGenVector(cameraDir); *oLog << endl;
-	  *oLog << "              cameraTime " << cameraTime << endl << endl;
-	}
-	vHist[ideg]->Fill(xMin,yMin);
-	vHistT[ideg]->Fill(cameraTime - idealTransitTime);
-	//*oLog << "hist fill " << ideg << " " << xMin << " " << yMin << endl;
-	//histT[ideg]->Fill(cameraTime - idealTransitTime);
-      }  // onCamera
-    }  // iph
-    Double_t rmsx = vHist[ideg]->GetRMS(1);
-    Double_t rmsy = vHist[ideg]->GetRMS(2);
 
     rmsXT = rmsx;
     rmsYT = rmsy;
-    degT = vDeg[ideg];
+    degT = vDeg[k % numDeg];
+    lambdaT = vLambda[k / numDeg];
     ttree->Fill();
     if (debug) {
-      *oLog << "                   rmsx  rmsy " << rmsx << "  " 
-	    << rmsy << endl;
+      *oLog << "                   deg lambda rmsx  rmsy " << degT << "  "
+            << lambdaT << "  " << rmsx << "  " << rmsy << endl;
+    }
+    // graphs are functions of the field angle for the first wavelength
+    if (k < numDeg) {
+      graRMS->SetPoint(graRMS->GetN(),degT, (rmsx > rmsy ? rmsx: rmsy)*2);
+      graT->SetPoint(graT->GetN(),degT,rmst);
     }
-    graRMS->SetPoint(graRMS->GetN(),vDeg[ideg], (rmsx > rmsy ? rmsx: rmsy)*2);
-    graT->SetPoint(graT->GetN(),vDeg[ideg],vHistT[ideg]->GetRMS());
-
 
-  } //ideg
+    if (scan.psfTable) {
+      // centroid, d80 (diameter of the circle about the centroid holding
+      // 80% of the photons on camera), rms and time spread
+      double cx = 0.0, cy = 0.0, cxx = 0.0, cyy = 0.0;
+      double tMean = 0.0, tt = 0.0;
+      for (int i = 0;i<numOnCamera;i++) {
+        cx += taskSpot[3*i];
+        cy += taskSpot[3*i+1];
+        tMean += taskSpot[3*i+2];
+      }
+      if (numOnCamera > 0) {
+        cx = cx/numOnCamera;
+        cy = cy/numOnCamera;
+        tMean = tMean/numOnCamera;
+      }
+      vector<double> vR2(numOnCamera);
+      for (int i = 0;i<numOnCamera;i++) {
+        double dx = taskSpot[3*i] - cx;
+        double dy = taskSpot[3*i+1] - cy;
+        double dt = taskSpot[3*i+2] - tMean;
+        cxx += dx*dx;
+        cyy += dy*dy;
+        tt += dt*dt;
+        vR2[i] = dx*dx + dy*dy;
+      }
+      double d80 = 0.0;
+      if (numOnCamera > 0) {
+        int i80 = (int)ceil(0.8*numOnCamera) - 1;
+        nth_element(vR2.begin(),vR2.begin() + i80,vR2.end());
+        d80 = 2.0*sqrt(vR2[i80]);
+        cxx = sqrt(cxx/numOnCamera);
+        cyy = sqrt(cyy/numOnCamera);
+        tt = sqrt(tt/numOnCamera);
+      }
+      psfTable << setw(8) << lambdaT << " " << setw(8) << degT << " "
+               << setw(7) << nPhotons << " " << setw(7) << numOnCamera 
+               << setprecision(5)
+               << " " << setw(11) << cx << " " << setw(11) << cy
+               << " " << setw(11) << d80 << " " << setw(11) << cxx
+               << " " << setw(11) << cyy << " " << setw(11) << tMean
+               << " " << setw(11) << tt << setprecision(6) << endl;
+    }
+  }
+  if (scan.psfTable) {
+    psfTable.close();
+  }
   //ttree->Write();
 
   string imageFilename;
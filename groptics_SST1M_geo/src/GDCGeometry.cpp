@@ -75,6 +75,7 @@ GDCGeometry::GDCGeometry() {
   }
   // other details
   cameraRadius = 0.0;
+  shadowModel = 1;
 
 };
 /************************* end of GDCGeometry **********************/
@@ -126,6 +127,7 @@ GDCGeometry::GDCGeometry(const GDCGeometry &c) {
  
  type = c.type;
  cameraRadius = c.cameraRadius;
+ shadowModel = c.shadowModel;
 
 };
 /************************* end of GDCGeometry **********************/
@@ -176,6 +178,7 @@ void GDCGeometry::printGeometry() {
     DEBUGW(quadArmX);DEBUGW(quadArmY);
     DEBUGW(quadArmOffset);
     DEBUGW(cameraRadius);
+    DEBUGW(shadowModel);
 
     *oLog << " -- End of printGeometry" << endl << endl;
 };
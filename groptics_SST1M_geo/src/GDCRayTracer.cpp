@@ -30,6 +30,7 @@ using namespace std;
 #include "GOrderedGrid.h"
 #include "GRootDCNavigator.h"
 #include "GGeometryBase.h"
+#include "GDCGeometry.h"
 #include "GDCRayTracer.h"
 
 #define DEBUG(x) *oLog << #x << " = " << x << endl
@@ -65,6 +66,12 @@ GDCRayTracer::GDCRayTracer(GDCTelescope *dcTel)
   fTimeFacetToCamera = 0.0;
   fTopVolOrigin2FocBox = 0.0;
 
+  iShadowModel = 1;
+  lShadowChecksIn = 0;
+  lShadowChecksOut = 0;
+  lShadowDiffIn = 0;
+  lShadowDiffOut = 0;
+
   // make the navigator if necessary
   if ( (dcTel->eRayTracerType == RTDCROOT) && 
        ( dcTel->geoStruct->type != NOSTRUCT ) ){
@@ -73,6 +80,15 @@ GDCRayTracer::GDCRayTracer(GDCTelescope *dcTel)
     fTopVolOrigin2FocBox = geoT->getFocalBoxZBottomTopVolCoor() + 0.001;
  
     bDoGeoStruct = true;
+
+    // analytic shadowing unless root navigation is requested or
+    // some volume has no analytic model
+    GDCGeometry *gDC = dynamic_cast<GDCGeometry*>(dcTel->geoStruct);
+    iShadowModel = gDC->shadowModel;
+    if ( (iShadowModel != 1) && (!geoT->hasShadowModel()) ) {
+      iShadowModel = 1;
+    }
+    geoT->setTrackingDebug(false);
   }
 
 };
@@ -84,6 +100,15 @@ GDCRayTracer::~GDCRayTracer() {
   if (debug) {
     *oLog << "  -- GDCRayTracer::~GDCRayTracer " << endl;
   }
+  if ( (iShadowModel == 2) && bDoGeoStruct ) {
+    *oLog << "  -- GDCRayTracer::~GDCRayTracer, telescope "
+          << DCTel->iTelID << endl;
+    *oLog << "       shadowing, analytic model vs. root navigation" << endl;
+    *oLog << "       incoming photons: " << lShadowChecksIn
+          << "  disagreements: " << lShadowDiffIn << endl;
+    *oLog << "       outgoing photons: " << lShadowChecksOut
+          << "  disagreements: " << lShadowDiffOut << endl;
+  }
   SafeDelete(geoT);
 
 };
@@ -183,212 +208,141 @@ bool GDCRayTracer::findFacet() {
   double x = vPhotonOnTelT.X();
   double y = vPhotonOnTelT.Y();
 
-  // grid facet parameters, will use if grid flag is true
-  list<GridFacet> *gridList = 0;
-  list<GridFacet>::iterator gridIter;
-  bool facetFlag;
-
-  // maximum number of facets for looping, either all facets, or grid facets
-  int maxfac;
+  // the facets to test: either all facets or the facets of the grid bin,
+  // stored one after the other in the facet arrays
+  const DCFacetArrays &fa = DCTel->facetArrays;
+  int gridKey = 0;
 
   if (DCTel->bGridOption) {
-  
-    facetFlag = facetGrid->getGridBinList(x,y,gridList);
-
-    if (debug) {
-      *oLog << "         facetFlag " << facetFlag << endl;
-      if (facetFlag) {
-        *oLog << "         number of grid elements " << gridList->size() << endl;
-        *oLog << "         facet num ";
-        for (gridIter = gridList->begin();
-             gridIter != gridList->end(); gridIter++) {
-          *oLog << (*gridIter).facetNum << " ";
-        }
-        *oLog << endl;
-      }
-    }
-
-  }
-  // we now have a group of grid elements to loop over, built in 
-  // loop over all facets for testing.
-
-  if (!DCTel->bGridOption) {
-    // will loop over all facets
-    maxfac = DCTel->facet.size();  // maxfac = number of facets
-  }
-  else {
-    if (facetFlag) {
-      maxfac = gridList->size();   // maxfac = number of facets in the gridbin
-      gridIter = gridList->begin();
-    }
-    else {
+    if ( (!facetGrid->getGridBinKey(x,y,&gridKey)) ||
+         (gridKey >= (int)fa.binStart.size() - 1) ) {
       //*oLog << "points outside the grid" << endl; // no gridbin available
       return false;  // points are outside the grid
     }
   }
+  int kStart = fa.binStart[gridKey];
+  int maxfac = fa.binStart[gridKey+1] - kStart;
 
-  // loop over selected facets or all facets
-  int fNum; 
-  for (int k1 = 0;k1 < maxfac;k1++) {
-
-    // set up facet number for this value of k1
-    if (!DCTel->bGridOption) {
-      fNum = k1;    // loop over all facets
-    }
-    else {
-      // get the k1th grinbin list element
-      GridFacet gFacet = *gridIter;
-      fNum = gFacet.facetNum;
-       if (debug) {
-	 DCTel->facet[gFacet.facetNum].printDCStdFacet(*oLog);
-        *oLog << "       gFacet " << fNum << "  "
-              << gFacet.dist << endl;
-        *oLog << "       photonOnT ";
-        GUtilityFuncts::printGenVector(vPhotonOnTelT);*oLog << endl;
-      }
-      gridIter++;
+  if (debug) {
+    *oLog << "         gridKey " << gridKey << endl;
+    *oLog << "         number of grid elements " << maxfac << endl;
+    *oLog << "         facet num ";
+    for (int k1 = 0;k1 < maxfac;k1++) {
+      *oLog << fa.facNum[kStart + k1] << " ";
     }
+    *oLog << endl;
+  }
 
-    //DCTel->facet[k1].vFacPlLoc facet plane center
-    //vPhotonDirT  photon direction cosines
-    //DCTel->facet[k1].vUnitFacPlToCC unit vector
-    //vPhotonOnTelT photon telescope impact 
-    if (debug) {
-      *oLog << "       DCTel->facet[fNum].vFacPlLoc  ";
-      *oLog << " fNum " << fNum << endl;
-    }
+  if ( (int)vFacetPhotonX.size() < fa.maxBinSize) {
+    vFacetPhotonX.resize(fa.maxBinSize);
+    vFacetPhotonY.resize(fa.maxBinSize);
+    vFacetPhotonR.resize(fa.maxBinSize);
+  }
 
-    ROOT::Math::XYZVector vDelta = vPhotonOnTelT 
-      - DCTel->facet[fNum].vFacPlLoc;
-    double dot1 = vDelta.Dot(DCTel->facet[fNum].vUnitFacPlToCC);
-    double dot2 =DCTel->facet[fNum].vUnitFacPlToCC.Dot(vPhotonDirT);
-    
-    double dd = dot1/dot2;
-    
-    // get location of photon on the facet plane
-    ROOT::Math::XYZVector vPhotonFP = vDelta - dd*vPhotonDirT;
-    
-    // get distance from facet center and see if too large
-    double r = sqrt(vPhotonFP.Dot(vPhotonFP));
-    if (debug) {
-      *oLog << "       print during find photon loc. on facet plane"
-            << endl;
-      *oLog << "         facet number k1 facNum " 
-            << fNum << "  " << DCTel->facet[fNum].facNum << endl;;
-      
-      *oLog << "         vPhotonOnTelT  ";
-      GUtilityFuncts::printGenVector(vPhotonOnTelT); *oLog << endl;
-      
-      *oLog << "         vPhotonDirT ";
-      GUtilityFuncts::printGenVector(vPhotonDirT); *oLog << endl;
-      
-      *oLog << "         DCTel->facet[k1].vFacPlLoc ";
-      GUtilityFuncts::printGenVector(DCTel->facet[fNum].vFacPlLoc); 
-      *oLog << endl;
-      
-      *oLog << "         vDelta  ";
-      GUtilityFuncts::printGenVector(vDelta); *oLog << endl;
-      *oLog << "         DCTel->facet[k1].vUnitFacPlToCC  ";
-      GUtilityFuncts::printGenVector(DCTel->facet[fNum].vUnitFacPlToCC); 
-      *oLog << endl;
-      
-      *oLog << "         dot1 " << dot1 << endl;
-      *oLog << "         dot2 " << dot2 << endl;
-      *oLog << "         dd   " << dd << endl;
-      
-      *oLog << "         vPhotonFP   ";
-      GUtilityFuncts::printGenVector(vPhotonFP); *oLog << endl;
-      *oLog << "       distance from facet center " << r << endl;
-      
+  // location of the photon on the plane of the facets and its distance 
+  // from the facet center, computed for a block of facets at once. Then 
+  // look in the block for the first facet within reach with the photon 
+  // inside its polygon
+  double px = vPhotonOnTelT.X();
+  double py = vPhotonOnTelT.Y();
+  double pz = vPhotonOnTelT.Z();
+  double ux = vPhotonDirT.X();
+  double uy = vPhotonDirT.Y();
+  double uz = vPhotonDirT.Z();
+
+  const double *plX = &(fa.plX[kStart]);
+  const double *plY = &(fa.plY[kStart]);
+  const double *plZ = &(fa.plZ[kStart]);
+  const double *nX = &(fa.nX[kStart]);
+  const double *nY = &(fa.nY[kStart]);
+  const double *nZ = &(fa.nZ[kStart]);
+  double *fpX = &(vFacetPhotonX[0]);
+  double *fpY = &(vFacetPhotonY[0]);
+  double *fpR = &(vFacetPhotonR[0]);
+
+  const int iBlock = 8;
+  int kHit = -1;
+  for (int kb = 0; (kb < maxfac) && (kHit < 0); kb += iBlock) {
+    int kbEnd = kb + iBlock;
+    if (kbEnd > maxfac) kbEnd = maxfac;
+
+    for (int k1 = kb;k1 < kbEnd;k1++) {
+      double dx = px - plX[k1];
+      double dy = py - plY[k1];
+      double dz = pz - plZ[k1];
+      double dot1 = dx*nX[k1] + dy*nY[k1] + dz*nZ[k1];
+      double dot2 = nX[k1]*ux + nY[k1]*uy + nZ[k1]*uz;
+      double dd = dot1/dot2;
+      double fx = dx - dd*ux;
+      double fy = dy - dd*uy;
+      double fz = dz - dd*uz;
+      fpX[k1] = fx;
+      fpY[k1] = fy;
+      fpR[k1] = sqrt(fx*fx + fy*fy + fz*fz);
     }
-    
-    if (r < DCTel->facet[fNum].radius) {
-      // found a facet within reach
-      // but is the location within the facet polygon
-      double alpha = DCTel->facet[fNum].ftprot;
-      double radius = DCTel->facet[fNum].radius;
-      int sides = DCTel->facet[fNum].sides;
-
-      double xfp = vPhotonFP.X();
-      double yfp = vPhotonFP.Y();
-      if (debug) {
-        *oLog << "   Found a facet within reach: number " 
-              << fNum << endl;
-        DEBUGS(alpha);DEBUGS(radius);DEBUGS(sides);
-        DEBUGS(xfp); DEBUGS(yfp);
-        *oLog << "   ready to run polyInside " << endl;
-        
-      }
-      
-      bool polyTest = GUtilityFuncts::polyInside(sides,alpha,
-                                                 radius,xfp,yfp);
-      if (debug) {
-        *oLog << "    polyTest " << polyTest << endl;
-
-      }
 
-      if (polyTest) {
-        // find intersection of photon with facet.
-        // same method as finding intersection of photon 
-        // with telescope sphere. Use center of curvature
-        // as origin
-
-        ROOT::Math::XYZVector vPhotonCC = vPhotonOnTelT - 
-          DCTel->facet[fNum].vFacCentrCurv;
-        
+    for (int k1 = kb;k1 < kbEnd;k1++) {
+      int k = kStart + k1;
+      if (fpR[k1] < fa.radius[k]) {
         if (debug) {
-          *oLog << "    vPhotonOnTelT " << endl;
-          GUtilityFuncts::printGenVector(vPhotonOnTelT); *oLog << endl;
- 
-          *oLog << "    vFacCentrCurv ";
-          GUtilityFuncts::printGenVector(DCTel->facet[fNum].vFacCentrCurv); 
-          *oLog << endl;
-
-          *oLog << "    vPhotonCC ";
-         GUtilityFuncts::printGenVector(vPhotonCC); *oLog << endl;
-
-          *oLog << "    vPhotonDirT ";
-         GUtilityFuncts::printGenVector(vPhotonDirT); *oLog << endl;
+          *oLog << "   Found a facet within reach: number " 
+                << fa.facNum[k] << endl;
+          DEBUGS(fa.alpha[k]);DEBUGS(fa.radius[k]);DEBUGS(fa.sides[k]);
+          DEBUGS(fpX[k1]); DEBUGS(fpY[k1]);
+        }
+        if (GUtilityFuncts::polyInside(fa.poly[k],fpX[k1],fpY[k1])) {
+          kHit = k;
+          break;
         }
+      }
+    }
+  }
+
+  if (kHit >= 0) {
+    // find intersection of photon with facet.
+    // same method as finding intersection of photon 
+    // with telescope sphere. Use center of curvature
+    // as origin
+    int fNum = fa.facNum[kHit];
+    ROOT::Math::XYZVector vFacCentrCurv(fa.ccX[kHit],fa.ccY[kHit],
+                                        fa.ccZ[kHit]);
+    ROOT::Math::XYZVector vPhotonCC = vPhotonOnTelT - vFacCentrCurv;
         
-        double rLTotal = vPhotonCC.Dot(vPhotonDirT);
-        double rp2 = vPhotonCC.Dot(vPhotonCC);
-        double d2 = rp2 - (rLTotal*rLTotal);
-        double curvR = DCTel->facet[fNum].curv;
+    double rLTotal = vPhotonCC.Dot(vPhotonDirT);
+    double rp2 = vPhotonCC.Dot(vPhotonCC);
+    double d2 = rp2 - (rLTotal*rLTotal);
+    double curvR = fa.curv[kHit];
 
-        double l2 = curvR*curvR - d2;
-        l2 = sqrt(l2);
+    double l2 = curvR*curvR - d2;
+    l2 = sqrt(l2);
 
-        double del = rLTotal - l2;  
-        ROOT::Math::XYZVector vPhotonOnFacCC = vPhotonCC 
-          - del*vPhotonDirT;  // photon on facet wrt center of curv.
+    double del = rLTotal - l2;  
+    ROOT::Math::XYZVector vPhotonOnFacCC = vPhotonCC 
+      - del*vPhotonDirT;  // photon on facet wrt center of curv.
 
-        vPhotonOnFacT = vPhotonOnFacCC + DCTel->facet[fNum].vFacCentrCurv;
-        fTimeOnFacet = -del;
-	DCTel->fTimeOnTelToFacet = -del;
+    vPhotonOnFacT = vPhotonOnFacCC + vFacCentrCurv;
+    fTimeOnFacet = -del;
+    DCTel->fTimeOnTelToFacet = -del;
 
-        bOnFacetFlag = true;  
-        iFacet = fNum;
+    bOnFacetFlag = true;  
+    iFacet = fNum;
         
-        if (debug) {
-          DEBUGS(rLTotal);DEBUGS(rp2);DEBUGS(d2);
-          DEBUGS(curvR);DEBUGS(l2);DEBUGS(del);
-          DEBUGS(DCTel->fTimeOnTelToFacet);
+    if (debug) {
+      DEBUGS(rLTotal);DEBUGS(rp2);DEBUGS(d2);
+      DEBUGS(curvR);DEBUGS(l2);DEBUGS(del);
+      DEBUGS(DCTel->fTimeOnTelToFacet);
           
-          *oLog << "    vPhotonOnFacCC " << endl;
-          GUtilityFuncts::printGenVector(vPhotonOnFacCC); *oLog << endl;
-          *oLog << "    vPhotonOnFacT " << endl;
-          GUtilityFuncts::printGenVector(vPhotonOnFacT); *oLog << endl;
-        }
-        if (DCTel->bPhotonHistoryFlag) {
-          DCTel->onFacetFlag = 1;
-          DCTel->facetNum = iFacet;
-          DCTel->facetX = vPhotonOnFacT.X();
-          DCTel->facetY = vPhotonOnFacT.Y();
-          DCTel->facetZ = vPhotonOnFacT.Z();
-        }
-        break;
-      }
+      *oLog << "    vPhotonOnFacCC " << endl;
+      GUtilityFuncts::printGenVector(vPhotonOnFacCC); *oLog << endl;
+      *oLog << "    vPhotonOnFacT " << endl;
+      GUtilityFuncts::printGenVector(vPhotonOnFacT); *oLog << endl;
+    }
+    if (DCTel->bPhotonHistoryFlag) {
+      DCTel->onFacetFlag = 1;
+      DCTel->facetNum = iFacet;
+      DCTel->facetX = vPhotonOnFacT.X();
+      DCTel->facetY = vPhotonOnFacT.Y();
+      DCTel->facetZ = vPhotonOnFacT.Z();
     }
   }
 
@@ -407,16 +361,12 @@ bool GDCRayTracer::getPhotonReflect() {
   DCTel->bFacetReflectFlag = false;
 
   // set variablesa and parameters
-  int reflctid = DCTel->facet[iFacet].rflctid;
+  const GUtilityFuncts::ReflTable *reflTable = DCTel->facet[iFacet].reflTable;
   double reflect = DCTel->facet[iFacet].reflect;
   double wavelgt = DCTel->fPhotWaveLgt;
 
-  // use Utility function
-  vector<double> vRefWaveLgt = (*DCTel->mVReflWaveLgts)[reflctid];
-  vector<double> vRefCoeffs    = (*DCTel->mVCoeffs)[reflctid];
-  
-  DCTel->bFacetReflectFlag = GUtilityFuncts::photonReflect(vRefCoeffs,
-                                                           vRefWaveLgt,
+  // use Utility function with the facet reflectivity table
+  DCTel->bFacetReflectFlag = GUtilityFuncts::photonReflect(*reflTable,
                                                            reflect, 
                                                            wavelgt);
   
@@ -578,27 +528,7 @@ bool GDCRayTracer::getPhotonLocCamera(ROOT::Math::XYZVector *pCam,
       // place the photon at the top of fTopVol_1 if dir[2] < 0.0 
       // and make current position and direction.
       
-      geoT->setTrackingDebug(false);
-      geoT->setPositionDirection(pos,dir);
-      string sNodeName = geoT->getNextNodeName();
-      if (debug) *oLog << "sNodeName In Check" << sNodeName << endl;
-      
-      if (sNodeName != "fTopVol_1" ){
-	if (sNodeName.find("FocBox") ) {
-	  bOnFocusBoxIn = true;
-	}
-	else if (sNodeName.find("Quad") ) {
-	  bOnQuadArmFlagIn = true;
-	}
-	else if (sNodeName.find("Cross") ) {
-	  bOnCrossArmFlagIn = true;
-	}
-	else if (sNodeName.find("EdgeBox") ) {
-	  bOnEdgeBoxFlagIn = true;
-	}
-	else if (sNodeName.find("Shutter") ) {
-	  bOnShutterIn = true;
-	}
+      if (getShadowIn(pos,dir)) {
 	returnFlag = false;
 	return returnFlag;
       }
@@ -674,17 +604,7 @@ bool GDCRayTracer::getPhotonLocCamera(ROOT::Math::XYZVector *pCam,
           ////////////////////////////////////////////////////////	  
 
           // position is a facet hit location
-          geoT->setPositionDirection(pos,dir);
-	  string sNodeName = geoT->getNextNodeName();
-	  if (sNodeName != "fFocBoxVol_1") {
-	    return false;
-	  }
-          // get current position after stepping to next node
-          double pos2[3],dir2[3];
-          geoT->getPositionDirection(pos2,dir2);
- 
-          // this removes photons striking side of focus box
-          if (pos2[2] > fTopVolOrigin2FocBox ) {
+          if (getShadowOut(pos,dir)) {
             return false;
           }
     	  
@@ -711,6 +631,85 @@ bool GDCRayTracer::getPhotonLocCamera(ROOT::Math::XYZVector *pCam,
   return returnFlag;
 };
 /************* end of getPhotonLocCamera *************/
+
+bool GDCRayTracer::getShadowIn(double *pos,double *dir) {
+
+  bool debug = false;
+  string sNodeName;
+
+  bool bShadowAnalytic = false;
+  if (iShadowModel != 1) {
+    double hitPos[3];
+    int nodeNum = geoT->getOccluder(pos,dir,hitPos);
+    bShadowAnalytic = (nodeNum != 0);
+    sNodeName = geoT->getOccluderName(nodeNum);
+  }
+  if (iShadowModel != 0) {
+    geoT->setTrackingDebug(false);
+    geoT->setPositionDirection(pos,dir);
+    sNodeName = geoT->getNextNodeName();
+  }
+  if (debug) *oLog << "sNodeName In Check" << sNodeName << endl;
+
+  bool bShadow = (sNodeName != "fTopVol_1");
+  if (iShadowModel == 2) {
+    lShadowChecksIn++;
+    if (bShadow != bShadowAnalytic) lShadowDiffIn++;
+  }
+
+  if (bShadow) {
+    if (sNodeName.find("FocBox") ) {
+      bOnFocusBoxIn = true;
+    }
+    else if (sNodeName.find("Quad") ) {
+      bOnQuadArmFlagIn = true;
+    }
+    else if (sNodeName.find("Cross") ) {
+      bOnCrossArmFlagIn = true;
+    }
+    else if (sNodeName.find("EdgeBox") ) {
+      bOnEdgeBoxFlagIn = true;
+    }
+    else if (sNodeName.find("Shutter") ) {
+      bOnShutterIn = true;
+    }
+  }
+  return bShadow;
+};
+/************* end of getShadowIn *************/
+
+bool GDCRayTracer::getShadowOut(double *pos,double *dir) {
+
+  // the photon has to reach the bottom of the focus box; hits on
+  // the side of the focus box are removed by the z test.
+  bool bShadowAnalytic = false;
+  if (iShadowModel != 1) {
+    double hitPos[3];
+    int nodeNum = geoT->getOccluder(pos,dir,hitPos);
+    bShadowAnalytic = ( (nodeNum != geoT->getFocusBoxNodeNumber()) ||
+                        (hitPos[2] > fTopVolOrigin2FocBox) );
+    if (iShadowModel == 0) {
+      return bShadowAnalytic;
+    }
+  }
+
+  geoT->setPositionDirection(pos,dir);
+  string sNodeName = geoT->getNextNodeName();
+  bool bShadow = (sNodeName != "fFocBoxVol_1");
+  if (!bShadow) {
+    // get current position after stepping to next node
+    double pos2[3],dir2[3];
+    geoT->getPositionDirection(pos2,dir2);
+    bShadow = (pos2[2] > fTopVolOrigin2FocBox);
+  }
+
+  if (iShadowModel == 2) {
+    lShadowChecksOut++;
+    if (bShadow != bShadowAnalytic) lShadowDiffOut++;
+  }
+  return bShadow;
+};
+/************* end of getShadowOut *************/
  
 void GDCRayTracer::printRayTracer() {
 
@@ -0,0 +1,471 @@
+/*
+VERSION3.1
+2March2015
+*/
+/*!  GDCShadowModel.cpp
+     analytic shadowing model for the DC telescope structure
+ */
+#include <iostream>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <cmath>
+#include <map>
+#include <iterator>
+#include <algorithm>
+#include <iomanip>
+#include <limits>
+
+using namespace std;
+
+#include "GDefinition.h"
+#include "GDCShadowModel.h"
+
+#define DEBUG(x) *oLog << #x << " = " << x << endl
+
+// all occluder index comparisons along one axis, for the bvh split
+struct OccCenterSort {
+  const double *center;
+  int axis;
+  bool operator()(const int &i1,const int &i2) const {
+    return (center[3*i1 + axis] < center[3*i2 + axis]);
+  }
+};
+
+// clip the ray to the region n.x <= d of each plane, tin/tout updated.
+// returns false if the ray misses the region
+static bool clipPlanes(const vector<double> &planes,
+                       const double *p,const double *u,
+                       double *tin,double *tout) {
+  for (unsigned i = 0;i < planes.size(); i += 4) {
+    const double *n = &planes[i];
+    double denom = n[0]*u[0] + n[1]*u[1] + n[2]*u[2];
+    double num = n[3] - (n[0]*p[0] + n[1]*p[1] + n[2]*p[2]);
+    if (denom == 0.0) {
+      if (num < 0.0) return false;
+      continue;
+    }
+    double t = num/denom;
+    if (denom > 0.0) {
+      if (t < *tout) *tout = t;
+    }
+    else {
+      if (t > *tin) *tin = t;
+    }
+    if (*tin > *tout) return false;
+  }
+  return true;
+};
+
+// clip the ray to the infinite cylinder x*x + y*y <= r*r
+static bool clipCylinder(const double &r,const double *p,const double *u,
+                         double *tin,double *tout) {
+  double a = u[0]*u[0] + u[1]*u[1];
+  double b = p[0]*u[0] + p[1]*u[1];
+  double c = p[0]*p[0] + p[1]*p[1] - r*r;
+  if (a == 0.0) {
+    return (c <= 0.0);
+  }
+  double disc = b*b - a*c;
+  if (disc < 0.0) return false;
+  disc = sqrt(disc);
+  double t1 = (-b - disc)/a;
+  double t2 = (-b + disc)/a;
+  if (t1 > *tin) *tin = t1;
+  if (t2 < *tout) *tout = t2;
+  return (*tin <= *tout);
+};
+
+// slab test of the ray against a box, limited to [tmin,tmax].
+// inv holds 1/u, infinite for u = 0
+static bool clipBox(const double *lo,const double *hi,
+                    const double *p,const double *inv,
+                    double tmin,double tmax) {
+  for (int k = 0;k < 3; k++) {
+    double t1 = (lo[k] - p[k])*inv[k];
+    double t2 = (hi[k] - p[k])*inv[k];
+    if (t1 > t2) swap(t1,t2);
+    if (t1 > tmin) tmin = t1;
+    if (t2 < tmax) tmax = t2;
+    if (tmin > tmax) return false;
+  }
+  return true;
+};
+
+GDCShadowModel::GDCShadowModel() {
+
+  for (int i = 0;i < 3; i++) {
+    fTopDim[i] = 0.0;
+  }
+};
+/****************** end of GDCShadowModel ******************/
+
+GDCShadowModel::~GDCShadowModel() {
+
+  bool debug = false;
+  if (debug) {
+    *oLog << "  -- GDCShadowModel::~GDCShadowModel" << endl;
+  }
+};
+/****************** end of ~GDCShadowModel ******************/
+
+void GDCShadowModel::setTopVolume(const double *halfDim) {
+
+  for (int i = 0;i < 3; i++) {
+    fTopDim[i] = halfDim[i];
+  }
+};
+/****************** end of setTopVolume ******************/
+
+void GDCShadowModel::setBoundingBox(Occluder *occ,const double *localLo,
+                                    const double *localHi) {
+  // transform the 8 corners of the local bounding box
+  for (int k = 0;k < 3; k++) {
+    occ->lo[k] = numeric_limits<double>::max();
+    occ->hi[k] = -numeric_limits<double>::max();
+  }
+  for (int c = 0;c < 8; c++) {
+    double loc[3];
+    loc[0] = (c & 1) ? localHi[0] : localLo[0];
+    loc[1] = (c & 2) ? localHi[1] : localLo[1];
+    loc[2] = (c & 4) ? localHi[2] : localLo[2];
+    for (int k = 0;k < 3; k++) {
+      double m = occ->tr[k] + occ->rot[3*k]*loc[0] +
+        occ->rot[3*k+1]*loc[1] + occ->rot[3*k+2]*loc[2];
+      if (m < occ->lo[k]) occ->lo[k] = m;
+      if (m > occ->hi[k]) occ->hi[k] = m;
+    }
+  }
+};
+/****************** end of setBoundingBox ******************/
+
+void GDCShadowModel::addTube(const int &id,const string &name,
+                             const double &rmin,const double &rmax,
+                             const double &dz,
+                             const double *rot,const double *tr) {
+  Occluder occ;
+  occ.id = id;
+  occ.name = name;
+  for (int i = 0;i < 9; i++) occ.rot[i] = rot[i];
+  for (int i = 0;i < 3; i++) occ.tr[i] = tr[i];
+  occ.bCylinder = true;
+  occ.rmax = rmax;
+  occ.rmin = rmin;
+
+  // z end caps
+  double caps[8] = {0.0,0.0,1.0,dz, 0.0,0.0,-1.0,dz};
+  occ.planes.assign(caps,caps + 8);
+
+  double lo[3] = {-rmax,-rmax,-dz};
+  double hi[3] = {rmax,rmax,dz};
+  setBoundingBox(&occ,lo,hi);
+
+  vOcc.push_back(occ);
+};
+/****************** end of addTube ******************/
+
+void GDCShadowModel::addPgon(const int &id,const string &name,
+                             const int &nedges,const double &phi1,
+                             const double &rmin,const double &rmax,
+                             const double &zmin,const double &zmax,
+                             const double *rot,const double *tr) {
+  Occluder occ;
+  occ.id = id;
+  occ.name = name;
+  for (int i = 0;i < 9; i++) occ.rot[i] = rot[i];
+  for (int i = 0;i < 3; i++) occ.tr[i] = tr[i];
+  occ.bCylinder = false;
+  occ.rmax = rmax;
+  occ.rmin = rmin;
+
+  double divphi = 2.0*M_PI/nedges;
+  for (int i = 0;i < nedges; i++) {
+    double phi = phi1*M_PI/180.0 + (i + 0.5)*divphi;
+    double nx = cos(phi);
+    double ny = sin(phi);
+    occ.planes.push_back(nx);
+    occ.planes.push_back(ny);
+    occ.planes.push_back(0.0);
+    occ.planes.push_back(rmax);
+    if (rmin > 0.0) {
+      occ.holePlanes.push_back(nx);
+      occ.holePlanes.push_back(ny);
+      occ.holePlanes.push_back(0.0);
+      occ.holePlanes.push_back(rmin);
+    }
+  }
+  double caps[8] = {0.0,0.0,1.0,zmax, 0.0,0.0,-1.0,-zmin};
+  occ.planes.insert(occ.planes.end(),caps,caps + 8);
+
+  // corner radius bounds the polygon
+  double rc = rmax/cos(divphi/2.0);
+  double lo[3] = {-rc,-rc,zmin};
+  double hi[3] = {rc,rc,zmax};
+  setBoundingBox(&occ,lo,hi);
+
+  vOcc.push_back(occ);
+};
+/****************** end of addPgon ******************/
+
+void GDCShadowModel::addArb8(const int &id,const string &name,
+                             const double *vertices,const double &dz,
+                             const double *rot,const double *tr) {
+  Occluder occ;
+  occ.id = id;
+  occ.name = name;
+  for (int i = 0;i < 9; i++) occ.rot[i] = rot[i];
+  for (int i = 0;i < 3; i++) occ.tr[i] = tr[i];
+  occ.bCylinder = false;
+  occ.rmax = 0.0;
+  occ.rmin = 0.0;
+
+  double v[8][3];
+  double cen[3] = {0.0,0.0,0.0};
+  double lo[3] = {numeric_limits<double>::max(),
+                  numeric_limits<double>::max(),-dz};
+  double hi[3] = {-numeric_limits<double>::max(),
+                  -numeric_limits<double>::max(),dz};
+  for (int i = 0;i < 8; i++) {
+    v[i][0] = vertices[2*i];
+    v[i][1] = vertices[2*i + 1];
+    v[i][2] = (i < 4) ? -dz : dz;
+    for (int k = 0;k < 3; k++) cen[k] += v[i][k]/8.0;
+    for (int k = 0;k < 2; k++) {
+      if (v[i][k] < lo[k]) lo[k] = v[i][k];
+      if (v[i][k] > hi[k]) hi[k] = v[i][k];
+    }
+  }
+
+  // lateral faces: i,i+1 at -dz and i+4,i+5 at +dz. The normal is
+  // the cross product of the face diagonals, which also works for
+  // faces with two coincident vertices.
+  for (int i = 0;i < 4; i++) {
+    int j = (i + 1) % 4;
+    double d1[3],d2[3],n[3];
+    for (int k = 0;k < 3; k++) {
+      d1[k] = v[j + 4][k] - v[i][k];
+      d2[k] = v[i + 4][k] - v[j][k];
+    }
+    n[0] = d1[1]*d2[2] - d1[2]*d2[1];
+    n[1] = d1[2]*d2[0] - d1[0]*d2[2];
+    n[2] = d1[0]*d2[1] - d1[1]*d2[0];
+    double mag = sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+    if (mag == 0.0) continue;   // face collapsed to a line
+    for (int k = 0;k < 3; k++) n[k] = n[k]/mag;
+
+    // plane through the face centre, normal pointing away from centroid
+    double d = 0.0;
+    double dc = 0.0;
+    for (int k = 0;k < 3; k++) {
+      double fc = (v[i][k] + v[j][k] + v[i + 4][k] + v[j + 4][k])/4.0;
+      d += n[k]*fc;
+      dc += n[k]*cen[k];
+    }
+    if (dc > d) {
+      for (int k = 0;k < 3; k++) n[k] = -n[k];
+      d = -d;
+    }
+    occ.planes.push_back(n[0]);
+    occ.planes.push_back(n[1]);
+    occ.planes.push_back(n[2]);
+    occ.planes.push_back(d);
+  }
+  double caps[8] = {0.0,0.0,1.0,dz, 0.0,0.0,-1.0,dz};
+  occ.planes.insert(occ.planes.end(),caps,caps + 8);
+
+  setBoundingBox(&occ,lo,hi);
+
+  vOcc.push_back(occ);
+};
+/****************** end of addArb8 ******************/
+
+void GDCShadowModel::build() {
+
+  bool debug = false;
+
+  vNode.clear();
+  vIndex.clear();
+  for (unsigned i = 0;i < vOcc.size(); i++) {
+    vIndex.push_back(i);
+  }
+  if (!vOcc.empty()) {
+    buildNode(0,vOcc.size());
+  }
+
+  if (debug) {
+    *oLog << "  -- GDCShadowModel::build" << endl;
+    *oLog << "       number of occluders: " << vOcc.size() << endl;
+    *oLog << "       number of bvh nodes: " << vNode.size() << endl;
+    for (unsigned i = 0;i < vOcc.size(); i++) {
+      *oLog << "       " << vOcc[i].id << " " << vOcc[i].name << "  lo: "
+            << vOcc[i].lo[0] << " " << vOcc[i].lo[1] << " "
+            << vOcc[i].lo[2] << "  hi: " << vOcc[i].hi[0] << " "
+            << vOcc[i].hi[1] << " " << vOcc[i].hi[2] << endl;
+    }
+  }
+};
+/****************** end of build ******************/
+
+int GDCShadowModel::buildNode(const int &first,const int &count) {
+
+  int inode = vNode.size();
+  vNode.push_back(BVHNode());
+
+  BVHNode node;
+  for (int k = 0;k < 3; k++) {
+    node.lo[k] = numeric_limits<double>::max();
+    node.hi[k] = -numeric_limits<double>::max();
+  }
+  for (int i = first;i < first + count; i++) {
+    const Occluder &occ = vOcc[vIndex[i]];
+    for (int k = 0;k < 3; k++) {
+      if (occ.lo[k] < node.lo[k]) node.lo[k] = occ.lo[k];
+      if (occ.hi[k] > node.hi[k]) node.hi[k] = occ.hi[k];
+    }
+  }
+  node.left = node.right = -1;
+  node.first = first;
+  node.count = count;
+
+  // leaves hold up to two occluders
+  if (count > 2) {
+    // split at the median of the box centers along the longest axis
+    int axis = 0;
+    for (int k = 1;k < 3; k++) {
+      if ( (node.hi[k] - node.lo[k]) > (node.hi[axis] - node.lo[axis]) ) {
+        axis = k;
+      }
+    }
+    vector<double> center(3*vOcc.size());
+    for (unsigned i = 0;i < vOcc.size(); i++) {
+      for (int k = 0;k < 3; k++) {
+        center[3*i + k] = (vOcc[i].lo[k] + vOcc[i].hi[k])/2.0;
+      }
+    }
+    OccCenterSort cmp;
+    cmp.center = &center[0];
+    cmp.axis = axis;
+    int half = count/2;
+    nth_element(vIndex.begin() + first,vIndex.begin() + first + half,
+                vIndex.begin() + first + count,cmp);
+
+    node.left = buildNode(first,half);
+    node.right = buildNode(first + half,count - half);
+    node.count = 0;
+  }
+  vNode[inode] = node;
+  return inode;
+};
+/****************** end of buildNode ******************/
+
+bool GDCShadowModel::intersect(const Occluder &occ,const double *pos,
+                               const double *dir,double *dist) const {
+  // to local coordinates: local = rot^T (master - tr)
+  double q[3];
+  for (int k = 0;k < 3; k++) q[k] = pos[k] - occ.tr[k];
+  double p[3],u[3];
+  for (int k = 0;k < 3; k++) {
+    p[k] = occ.rot[k]*q[0] + occ.rot[3 + k]*q[1] + occ.rot[6 + k]*q[2];
+    u[k] = occ.rot[k]*dir[0] + occ.rot[3 + k]*dir[1] +
+      occ.rot[6 + k]*dir[2];
+  }
+
+  double tin = -numeric_limits<double>::max();
+  double tout = numeric_limits<double>::max();
+  if (!clipPlanes(occ.planes,p,u,&tin,&tout)) return false;
+  if (occ.bCylinder) {
+    if (!clipCylinder(occ.rmax,p,u,&tin,&tout)) return false;
+  }
+  if (tout < 0.0) return false;
+
+  double s = (tin > 0.0) ? tin : 0.0;
+
+  // hollow occluders: skip the part of the ray inside the hole.
+  // The hole is convex, so the ray leaves it only once.
+  double hin = -numeric_limits<double>::max();
+  double hout = numeric_limits<double>::max();
+  bool bHole = false;
+  if (occ.bCylinder && (occ.rmin > 0.0) ) {
+    bHole = clipCylinder(occ.rmin,p,u,&hin,&hout);
+  }
+  else if (!occ.holePlanes.empty()) {
+    bHole = clipPlanes(occ.holePlanes,p,u,&hin,&hout);
+  }
+  if (bHole && (s >= hin) && (s < hout) ) {
+    s = hout;
+  }
+  if (s > tout) return false;
+
+  *dist = s;
+  return true;
+};
+/****************** end of intersect ******************/
+
+int GDCShadowModel::findOccluder(const double *pos,const double *dir,
+                                 double *dist) const {
+
+  // the part of the ray inside the top volume
+  double tmin = 0.0;
+  double tmax = numeric_limits<double>::max();
+  for (int k = 0;k < 3; k++) {
+    if (dir[k] == 0.0) {
+      if ( (pos[k] < -fTopDim[k]) || (pos[k] > fTopDim[k]) ) return 0;
+      continue;
+    }
+    double t1 = (-fTopDim[k] - pos[k])/dir[k];
+    double t2 = (fTopDim[k] - pos[k])/dir[k];
+    if (t1 > t2) swap(t1,t2);
+    if (t1 > tmin) tmin = t1;
+    if (t2 < tmax) tmax = t2;
+  }
+  if ( vNode.empty() || (tmin > tmax) ) return 0;
+
+  double inv[3];
+  for (int k = 0;k < 3; k++) {
+    inv[k] = (dir[k] != 0.0) ? 1.0/dir[k] : numeric_limits<double>::infinity();
+  }
+
+  int iHit = -1;
+  double tHit = tmax;
+
+  int stack[64];
+  int nstack = 0;
+  stack[nstack++] = 0;
+  while (nstack > 0) {
+    const BVHNode &node = vNode[stack[--nstack]];
+    if (!clipBox(node.lo,node.hi,pos,inv,tmin,tHit)) continue;
+
+    if (node.left < 0) {
+      for (int i = node.first;i < node.first + node.count; i++) {
+        double t = 0.0;
+        if (intersect(vOcc[vIndex[i]],pos,dir,&t) &&
+            (t >= tmin) && (t <= tHit) ) {
+          if ( (iHit < 0) || (t < tHit) ) {
+            iHit = vIndex[i];
+            tHit = t;
+          }
+        }
+      }
+    }
+    else {
+      stack[nstack++] = node.right;
+      stack[nstack++] = node.left;
+    }
+  }
+
+  if (iHit < 0) return 0;
+  *dist = tHit;
+  return vOcc[iHit].id;
+};
+/****************** end of findOccluder ******************/
+
+const char * GDCShadowModel::getOccluderName(const int &id) const {
+
+  for (unsigned i = 0;i < vOcc.size(); i++) {
+    if (vOcc[i].id == id) return vOcc[i].name.c_str();
+  }
+  return "";
+};
+/****************** end of getOccluderName ******************/
@@ -22,6 +22,7 @@ VERSION3.1
 #include <algorithm>
 #include <bitset>
 #include <iomanip>
+#include <cstdio>
 
 #include "TROOT.h"
 #include "TFile.h"
@@ -44,6 +45,8 @@ using namespace std;
 #include "GDCGeometry.h"
 #include "GRayTracerBase.h"
 #include "GDCRayTracer.h"
+#include "GOrderedGrid.h"
+#include "GPhotonHistoryFile.h"
 
 DCStdFacet::DCStdFacet() {
   type = 0;
@@ -58,6 +61,7 @@ DCStdFacet::DCStdFacet() {
   roughness = 0.0;
   reflect = 0.0;
   rflctid = 0;
+  reflTable = 0;
 };
 /**************** end of DCStdFacet::DCStdFacet()***********/
 
@@ -83,6 +87,7 @@ DCStdFacet::DCStdFacet(const DCStdFacet &dcf) {
   roughness = dcf.roughness;
   reflect = dcf.reflect;
   rflctid = dcf.rflctid;
+  reflTable = dcf.reflTable;
 };
 /******************* end of DCStdFacet::DCStdFacet **********/
 
@@ -263,6 +268,10 @@ GDCTelescope::GDCTelescope() {
   historyOption   = 0;
   hisF = 0;
   hisT = 0;
+  hisC = 0;
+  iHistorySample = 1;
+  iHistorySelect = -1;
+  iHistoryOffered = 0;
 
   vPhotonCameraLoc.SetCoordinates(0.0,0.0,0.0);
   vPhotonCameraDcos.SetCoordinates(0.0,0.0,0.0);
@@ -284,6 +293,7 @@ GDCTelescope::~GDCTelescope() {
 	  << iTelID << endl;
   }
   SafeDelete(rayTracer);
+  SafeDelete(hisC);  // closes the compact history file
   /*
     we've already closed the file in writePhotonHistory()
     if (hisF != 0) {
@@ -367,6 +377,152 @@ bool GDCTelescope::getCameraPhotonLocation(ROOT::Math::XYZVector *photonLoc,
 };
 /********************** end of getCameraPhotonLocation *****************/
 
+void GDCTelescope::makeFacetArrays(GOrderedGrid *grid) {
+
+  bool debug = false;
+  if (debug) {
+    *oLog << "  -- GDCTelescope::makeFacetArrays " << endl;
+  }
+
+  DCFacetArrays &fa = facetArrays;
+  fa = DCFacetArrays();
+
+  // facet numbers bin after bin
+  vector<int> vFacNum;
+  int nBins = 1;
+  if (grid != 0) {
+    nBins = grid->getNumGridBins();
+  }
+  fa.binStart.push_back(0);
+  for (int b = 0; b < nBins; b++) {
+    if (grid != 0) {
+      list<GridFacet> *gridList = grid->getGridBin(b);
+      list<GridFacet>::iterator gridIter;
+      for (gridIter = gridList->begin(); gridIter != gridList->end(); 
+           gridIter++) {
+        vFacNum.push_back( (*gridIter).facetNum );
+      }
+    }
+    else {
+      for (unsigned i = 0; i < facet.size(); i++) {
+        vFacNum.push_back(i);
+      }
+    }
+    int nFac = vFacNum.size() - fa.binStart.back();
+    if (nFac > fa.maxBinSize) fa.maxBinSize = nFac;
+    fa.binStart.push_back(vFacNum.size());
+  }
+
+  for (unsigned k = 0; k < vFacNum.size(); k++) {
+    DCStdFacet &fac = facet[vFacNum[k]];
+    fa.facNum.push_back(vFacNum[k]);
+    fa.sides.push_back(fac.sides);
+    fa.plX.push_back(fac.vFacPlLoc.X());
+    fa.plY.push_back(fac.vFacPlLoc.Y());
+    fa.plZ.push_back(fac.vFacPlLoc.Z());
+    fa.nX.push_back(fac.vUnitFacPlToCC.X());
+    fa.nY.push_back(fac.vUnitFacPlToCC.Y());
+    fa.nZ.push_back(fac.vUnitFacPlToCC.Z());
+    fa.ccX.push_back(fac.vFacCentrCurv.X());
+    fa.ccY.push_back(fac.vFacCentrCurv.Y());
+    fa.ccZ.push_back(fac.vFacCentrCurv.Z());
+    fa.radius.push_back(fac.radius);
+    fa.curv.push_back(fac.curv);
+    fa.alpha.push_back(fac.ftprot);
+    fa.poly.push_back(GUtilityFuncts::PolyEdges());
+    GUtilityFuncts::polyEdges(fac.sides,fac.ftprot,fac.radius,
+                              &(fa.poly.back()));
+  }
+
+  if (debug) {
+    *oLog << "        bins " << nBins << "  entries " << vFacNum.size()
+          << "  largest bin " << fa.maxBinSize << endl;
+  }
+};
+/********************** end of makeFacetArrays *****************/
+
+void GDCTelescope::makeReflTables() {
+
+  bool debug = false;
+  if (debug) {
+    *oLog << "  -- GDCTelescope::makeReflTables " << endl;
+  }
+
+  mReflTables.clear();
+  if ( (mVReflWaveLgts == 0) || (mVCoeffs == 0) ) {
+    *oLog << "  -- GDCTelescope::makeReflTables: no reflection curves " 
+          << "for telescope " << iTelID << endl;
+    *oLog << "     stopping code " << endl;
+    exit(0);
+  }
+
+  for (unsigned i = 0; i < facet.size(); i++) {
+    int id = facet[i].rflctid;
+
+    if (mReflTables.find(id) == mReflTables.end()) {
+      map<int, vector<double> >::iterator itWl = mVReflWaveLgts->find(id);
+      map<int, vector<double> >::iterator itC = mVCoeffs->find(id);
+      if ( (itWl == mVReflWaveLgts->end()) || (itC == mVCoeffs->end()) ) {
+        *oLog << "  -- GDCTelescope::makeReflTables: reflection curve " 
+              << id << " of facet " << i << " not found" << endl;
+        *oLog << "     stopping code " << endl;
+        exit(0);
+      }
+      GUtilityFuncts::makeReflTable(itC->second,itWl->second,
+                                    &(mReflTables[id]));
+    }
+    facet[i].reflTable = &(mReflTables[id]);
+  }
+
+  if (debug) {
+    *oLog << "        number of reflection curves " << mReflTables.size()
+          << endl;
+  }
+};
+/********************** end of makeReflTables *****************/
+
+bool GDCTelescope::getApertureEnvelope(double *envRadius, double *envZMin,
+                                       double *envZMax) {
+
+  if (bPhotonHistoryFlag) return false;
+  if (facet.size() == 0) return false;
+
+  // a photon reaches the camera only after a facet reflection and
+  // findFacet only accepts facet plane hits within the facet radius
+  // of the facet plane center. Facet locations are relative to the 
+  // rotation offset point.
+  double rMax = 0.0;
+  double zMin = 0.0;
+  double zMax = 0.0;
+  for (unsigned i = 0; i < facet.size(); i++) {
+    const ROOT::Math::XYZVector *vLoc[2] = {&(facet[i].vFacLoc),
+                                            &(facet[i].vFacPlLoc)};
+    for (int j = 0; j < 2; j++) {
+      double r = sqrt(vLoc[j]->X()*vLoc[j]->X() + 
+                      vLoc[j]->Y()*vLoc[j]->Y()) + facet[i].radius;
+      double zlo = vLoc[j]->Z() - facet[i].radius;
+      double zhi = vLoc[j]->Z() + facet[i].radius;
+      if ( (i == 0) && (j == 0) ) {
+        rMax = r;
+        zMin = zlo;
+        zMax = zhi;
+      }
+      if (r > rMax)   rMax = r;
+      if (zlo < zMin) zMin = zlo;
+      if (zhi > zMax) zMax = zhi;
+    }
+  }
+
+  // add a safety margin of 1% and 1cm 
+  double margin = 0.01*rMax + 0.01;
+  *envRadius = rMax + margin;
+  *envZMin = zMin - margin + vRotationOffsetT.Z();
+  *envZMax = zMax + margin + vRotationOffsetT.Z();
+
+  return true;
+};
+/********************** end of getApertureEnvelope *****************/
+
 void GDCTelescope::printTelescope() {
 
   bool debug = false;
@@ -499,7 +655,9 @@ void GDCTelescope::setPrintMode(ostream &oStr,const int prtMode) {
 
 void GDCTelescope::setPhotonHistory(const string &rootFile,
                                        const string &treeName,
-                                       const int &option) {
+                                       const int &option,
+                                       const int &sampleEvery,
+                                       const int &select) {
   bool debug = false;
 
   bPhotonHistoryFlag = true;
@@ -507,6 +665,9 @@ void GDCTelescope::setPhotonHistory(const string &rootFile,
   historyFileName = rootFile;
   historyTreeName = treeName;
   historyOption = option;
+  iHistorySample = (sampleEvery > 1) ? sampleEvery : 1;
+  iHistorySelect = select;
+  iHistoryOffered = 0;
   
   if (debug) {
     *oLog << "  -- setPhotonHistory " << endl;
@@ -531,14 +692,32 @@ void GDCTelescope::setPhotonHistory(const string &rootFile,
     historyFileName = historyFileName + strInsert;
   }
 
+  if (historyOption == 1) {
+    // compact history file
+    idx = historyFileName.rfind('.');
+    if (idx != string::npos) historyFileName.erase(idx);
+    historyFileName = historyFileName + ".phist";
+  }
+
   if (debug) {
     *oLog << "     opening photon history file / tree:  " 
           << historyFileName << " / " << historyTreeName << endl;
   }
-  hisF = new TFile(historyFileName.c_str(),"RECREATE");
-  hisT = new TTree(historyTreeName.c_str(),historyTreeName.c_str());
-
-  makePhotonHistoryBranches();
+  if (historyOption == 1) {
+    hisC = new GPhotonHistoryFile();
+    makePhotonHistoryBranches();
+    if (!hisC->openWrite(historyFileName,historyTreeName)) {
+      *oLog << "  -- GDCTelescope::setPhotonHistory " << endl;
+      *oLog << "     could not open " << historyFileName << endl;
+      *oLog << "     stopping code" << endl;
+      exit(0);
+    }
+  }
+  else {
+    hisF = new TFile(historyFileName.c_str(),"RECREATE");
+    hisT = new TTree(historyTreeName.c_str(),historyTreeName.c_str());
+    makePhotonHistoryBranches();
+  }
   initializePhotonHistoryParms();
 };
 /********************** end of setPhotonHistory *****************/
@@ -549,40 +728,64 @@ void GDCTelescope::makePhotonHistoryBranches() {
     *oLog << "  -- makePhotonHistoryBranches " << endl;
   }
 
-  hisT->Branch("injectXTC",&injectXTC,"injectXTC/D");
-  hisT->Branch("injectYTC",&injectYTC,"injectYTC/D");
-  hisT->Branch("injectZTC",&injectZTC,"injectZTC/D");
-  hisT->Branch("injectDcosXTC",&injectDcosXTC,"injectDcosXTC/D");
-  hisT->Branch("injectDcosYTC",&injectDcosYTC,"injectDcosYTC/D");
-  hisT->Branch("injectDcosZTC",&injectDcosZTC,"injectDcosZTC/D");
-
-  hisT->Branch("onTelFlag",&onTelFlag,"onTelFlag/I");
-  hisT->Branch("telX",&telX,"telX/D");
-  hisT->Branch("telY",&telY,"telY/D");
-  hisT->Branch("telZ",&telZ,"telZ/D");
-
-  hisT->Branch("onFacetFlag",&onFacetFlag,"onFacetFlag/I");
-  hisT->Branch("facetNum",&facetNum,"facetNum/I");
-  hisT->Branch("facetX",&facetX,"facetX/D");
-  hisT->Branch("facetY",&facetY,"facetY/D");
-  hisT->Branch("facetZ",&facetZ,"facetZ/D");
-  hisT->Branch("timeTelFac",&fTimeOnTelToFacet,"timeTelFac/D");
-  hisT->Branch("reflectFlag",&reflectFlag,"reflectFlag/I");
-  hisT->Branch("onCameraFlag",&onCameraFlag,"onCameraFlag/I");
-  hisT->Branch("cameraX",&cameraX,"cameraX/D");
-  hisT->Branch("cameraY",&cameraY,"cameraY/D");
-  hisT->Branch("cameraZ",&cameraZ,"cameraZ/D");
-  hisT->Branch("cameraDcosX",&cameraDcosXTC,"cameraDcosX/D");
-  hisT->Branch("cameraDcosY",&cameraDcosYTC,"cameraDcosY/D");
-  hisT->Branch("cameraDcosZ",&cameraDcosZTC,"cameraDcosZ/D");
-  hisT->Branch("timeFacetToCmra",&fTimeFacetToCamera,"timeFacetToCmra/D");
-  hisT->Branch("RayTracerTime",&fRayTracerTime,"RayTracerTime/D");
-  hisT->Branch("NetTimeToCamera",&fNetTimeToCamera,"NetTimeToCamera/D");
+  addHistoryField("injectXTC",&injectXTC);
+  addHistoryField("injectYTC",&injectYTC);
+  addHistoryField("injectZTC",&injectZTC);
+  addHistoryField("injectDcosXTC",&injectDcosXTC);
+  addHistoryField("injectDcosYTC",&injectDcosYTC);
+  addHistoryField("injectDcosZTC",&injectDcosZTC);
+
+  addHistoryField("onTelFlag",&onTelFlag);
+  addHistoryField("telX",&telX);
+  addHistoryField("telY",&telY);
+  addHistoryField("telZ",&telZ);
+
+  addHistoryField("onFacetFlag",&onFacetFlag);
+  addHistoryField("facetNum",&facetNum);
+  addHistoryField("facetX",&facetX);
+  addHistoryField("facetY",&facetY);
+  addHistoryField("facetZ",&facetZ);
+  addHistoryField("timeTelFac",&fTimeOnTelToFacet);
+  addHistoryField("reflectFlag",&reflectFlag);
+  addHistoryField("onCameraFlag",&onCameraFlag);
+  addHistoryField("cameraX",&cameraX);
+  addHistoryField("cameraY",&cameraY);
+  addHistoryField("cameraZ",&cameraZ);
+  addHistoryField("cameraDcosX",&cameraDcosXTC);
+  addHistoryField("cameraDcosY",&cameraDcosYTC);
+  addHistoryField("cameraDcosZ",&cameraDcosZTC);
+  addHistoryField("timeFacetToCmra",&fTimeFacetToCamera);
+  addHistoryField("RayTracerTime",&fRayTracerTime);
+  addHistoryField("NetTimeToCamera",&fNetTimeToCamera);
                
  
 };
 /************************* end of makePhotonHistoryBranches *****/
 
+void GDCTelescope::addHistoryField(const string &name,double *address) {
+
+  if (hisC != 0) {
+    hisC->addField(name,address);
+  }
+  else {
+    string leaf = name + "/D";
+    hisT->Branch(name.c_str(),address,leaf.c_str());
+  }
+};
+/************************* end of addHistoryField *****/
+
+void GDCTelescope::addHistoryField(const string &name,int *address) {
+
+  if (hisC != 0) {
+    hisC->addField(name,address);
+  }
+  else {
+    string leaf = name + "/I";
+    hisT->Branch(name.c_str(),address,leaf.c_str());
+  }
+};
+/************************* end of addHistoryField *****/
+
 void GDCTelescope::fillPhotonHistory() {
 
   if (bFacetReflectFlag) {
@@ -603,6 +806,16 @@ void GDCTelescope::fillPhotonHistory() {
   if (debug) {
     *oLog << "  -- fillPhotonHistory " << endl;
   }
+
+  // facet selection and sampling
+  if ( (iHistorySelect >= 0) && (facetNum != iHistorySelect) ) return;
+  iHistoryOffered++;
+  if ( (iHistoryOffered - 1) % iHistorySample != 0) return;
+
+  if (hisC != 0) {
+    hisC->fill();
+    return;
+  }
   hisF->cd();
   hisT->Fill();
 };
@@ -651,6 +864,12 @@ void GDCTelescope::writePhotonHistory() {
   if (debug) {
     *oLog << "  -- in GDCTelescope::writePhotonHistory " << endl;
   }
+  if (hisC != 0) {
+    hisC->close();
+    *oLog << "  -- GDCTelescope::writePhotonHistory: " 
+          << hisC->getNumRecords() << " photons in " << historyFileName 
+          << endl;
+  }
   // set hisF to zero after deleting so can also do the writing in
   // the destructor.
   if (hisF != 0) {
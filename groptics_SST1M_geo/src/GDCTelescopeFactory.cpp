@@ -324,9 +324,18 @@ GDCTelescope* GDCTelescopeFactory::makeTelescope(const int &id,
     DCTel->facet[i].findFacetCurvatureCenter(DCTel->dFocLgt);
   }
 
+  // pack the final facet parameters for the facet search
+  if (DCTel->bGridOption) {
+    DCTel->makeFacetArrays(opt->grid);
+  }
+  else {
+    DCTel->makeFacetArrays(0);
+  }
+
   // set reflection coefficient pointers to map with vector
   DCTel->mVReflWaveLgts = mVReflWaveLgts;
   DCTel->mVCoeffs = mVCoeffs;
+  DCTel->makeReflTables();
 
   iNumTelMake += 1;  // increment number of telescopes make
   return DCTel;
@@ -268,6 +268,23 @@ bool GOrderedGrid::getGridBinList(const double &x, const double &y,
 };
 /********************* end of getGridBinList ************************/
 
+bool GOrderedGrid::getGridBinKey(const double &x, const double &y,
+                                 int *gridKey) {
+
+  if ( (nbinsx==0) || (nbinsy==0) ) return false;
+
+  int xbin = (int)( floor( (x - fXmin)/fDelX ));
+  int ybin = (int)( floor( (y - fYmin)/fDelY ));
+
+  *gridKey = (xbin + (nbinsx*ybin) );
+
+  if ( (*gridKey < 0) || (*gridKey > (nbinsx*nbinsy) - 1) ) {
+    return false;
+  }
+  return true;
+};
+/********************* end of getGridBinKey ************************/
+
 bool GOrderedGrid::readGrid() {
 
   bool debug = false;
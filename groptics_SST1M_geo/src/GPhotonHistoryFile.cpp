@@ -0,0 +1,230 @@
+/*
+VERSION3.1
+2March2015
+*/
+/*!  GPhotonHistoryFile.cpp
+     compact photon history file
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "GDefinition.h"
+#include "GPhotonHistoryFile.h"
+
+#define DEBUG(x) *oLog << #x << " = " << x << endl
+#define DEBUGS(x) *oLog << "      " << #x << " = " << x << endl
+
+// file identifier and format version
+static const char historyMagic[9] = "GPHIST01";
+
+// records kept in memory before writing
+static const unsigned iRecordsPerWrite = 4096;
+
+GPhotonHistoryFile::GPhotonHistoryFile() {
+
+  pFile = 0;
+  bWrite = false;
+  sFileName = "";
+  sTreeName = "";
+  iBufferRecords = 0;
+  iNumRecords = 0;
+};
+/************** end of GPhotonHistoryFile ***************************/
+
+GPhotonHistoryFile::~GPhotonHistoryFile() {
+
+  close();
+};
+/************** end of ~GPhotonHistoryFile ***************************/
+
+void GPhotonHistoryFile::addField(const string &name,const double *address) {
+
+  vName.push_back(name);
+  vType.push_back('D');
+  vAddrD.push_back(address);
+  vAddrI.push_back(0);
+};
+/************** end of addField ***************************/
+
+void GPhotonHistoryFile::addField(const string &name,const int *address) {
+
+  vName.push_back(name);
+  vType.push_back('I');
+  vAddrD.push_back(0);
+  vAddrI.push_back(address);
+};
+/************** end of addField ***************************/
+
+void GPhotonHistoryFile::writeString(const string &str) {
+
+  int len = str.size();
+  fwrite(&len,sizeof(int),1,pFile);
+  fwrite(str.data(),1,len,pFile);
+};
+/************** end of writeString ***************************/
+
+bool GPhotonHistoryFile::readString(string *str) {
+
+  int len = 0;
+  if (fread(&len,sizeof(int),1,pFile) != 1) return false;
+  if ( (len < 0) || (len > 10000) ) return false;
+
+  vector<char> chars(len + 1,'\0');
+  if ( (len > 0) && ((int)fread(&chars[0],1,len,pFile) != len) ) {
+    return false;
+  }
+  str->assign(&chars[0],len);
+  return true;
+};
+/************** end of readString ***************************/
+
+bool GPhotonHistoryFile::openWrite(const string &fileName,
+                                   const string &treeName) {
+  bool debug = false;
+  if (debug) {
+    *oLog << "  -- GPhotonHistoryFile::openWrite " << fileName << endl;
+  }
+  close();
+
+  sFileName = fileName;
+  sTreeName = treeName;
+  pFile = fopen(sFileName.c_str(),"wb");
+  if (pFile == 0) {
+    return false;
+  }
+  bWrite = true;
+  iNumRecords = 0;
+  iBufferRecords = 0;
+  vBuffer.resize(iRecordsPerWrite*vName.size());
+
+  int numFields = vName.size();
+  fwrite(historyMagic,1,8,pFile);
+  fwrite(&numFields,sizeof(int),1,pFile);
+  writeString(sTreeName);
+  for (int i = 0;i<numFields;i++) {
+    fwrite(&vType[i],1,1,pFile);
+    writeString(vName[i]);
+  }
+  return (ferror(pFile) == 0);
+};
+/************** end of openWrite ***************************/
+
+void GPhotonHistoryFile::fill() {
+
+  if ( (pFile == 0) || (!bWrite) ) return;
+
+  unsigned numFields = vName.size();
+  float *rec = &vBuffer[iBufferRecords*numFields];
+  for (unsigned i = 0;i<numFields;i++) {
+    rec[i] = (vAddrD[i] != 0) ? (float)(*vAddrD[i]) : (float)(*vAddrI[i]);
+  }
+  iBufferRecords++;
+  iNumRecords++;
+
+  if (iBufferRecords == iRecordsPerWrite) {
+    flushBuffer();
+  }
+};
+/************** end of fill ***************************/
+
+void GPhotonHistoryFile::flushBuffer() {
+
+  if ( (pFile == 0) || (!bWrite) || (iBufferRecords == 0) ) return;
+
+  unsigned numFloats = iBufferRecords*vName.size();
+  if (fwrite(&vBuffer[0],sizeof(float),numFloats,pFile) != numFloats) {
+    *oLog << "  -- GPhotonHistoryFile::flushBuffer " << endl;
+    *oLog << "     error writing to " << sFileName << endl;
+    *oLog << "     stopping code" << endl;
+    exit(0);
+  }
+  iBufferRecords = 0;
+};
+/************** end of flushBuffer ***************************/
+
+bool GPhotonHistoryFile::openRead(const string &fileName) {
+
+  bool debug = false;
+  if (debug) {
+    *oLog << "  -- GPhotonHistoryFile::openRead " << fileName << endl;
+  }
+  close();
+
+  sFileName = fileName;
+  pFile = fopen(sFileName.c_str(),"rb");
+  if (pFile == 0) {
+    return false;
+  }
+  bWrite = false;
+  iNumRecords = 0;
+  vName.clear();
+  vType.clear();
+  vAddrD.clear();
+  vAddrI.clear();
+
+  char magic[8];
+  int numFields = 0;
+  if ( (fread(magic,1,8,pFile) != 8) ||
+       (memcmp(magic,historyMagic,8) != 0) ||
+       (fread(&numFields,sizeof(int),1,pFile) != 1) ||
+       (numFields < 0) || (numFields > 10000) ||
+       (!readString(&sTreeName)) ) {
+    close();
+    return false;
+  }
+  for (int i = 0;i<numFields;i++) {
+    char type = ' ';
+    string name;
+    if ( (fread(&type,1,1,pFile) != 1) || (!readString(&name)) ||
+         ( (type != 'D') && (type != 'I') ) ) {
+      close();
+      return false;
+    }
+    vType.push_back(type);
+    vName.push_back(name);
+    vAddrD.push_back(0);
+    vAddrI.push_back(0);
+  }
+  if (debug) {
+    DEBUGS(sTreeName);
+    DEBUGS(numFields);
+  }
+  return true;
+};
+/************** end of openRead ***************************/
+
+bool GPhotonHistoryFile::readRecord(vector<float> *record) {
+
+  if ( (pFile == 0) || (bWrite) ) return false;
+
+  unsigned numFields = vName.size();
+  record->resize(numFields);
+  if (numFields == 0) return false;
+
+  if (fread(&(*record)[0],sizeof(float),numFields,pFile) != numFields) {
+    return false;
+  }
+  iNumRecords++;
+  return true;
+};
+/************** end of readRecord ***************************/
+
+void GPhotonHistoryFile::close() {
+
+  if (pFile == 0) return;
+
+  if (bWrite) {
+    flushBuffer();
+  }
+  fclose(pFile);
+  pFile = 0;
+  bWrite = false;
+};
+/************** end of close ***************************/
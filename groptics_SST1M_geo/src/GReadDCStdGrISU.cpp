@@ -462,6 +462,15 @@ void GReadDCStdGrISU::makeStdGeometry() {
       else if (tokens[1]=="CAMERARADIUS") {
         gp->cameraRadius = atof(tokens[2].c_str());
       }
+      else if (tokens[1]=="SHADOWMODEL") {
+        gp->shadowModel = atoi(tokens[2].c_str());
+        if ( (gp->shadowModel < 0) || (gp->shadowModel > 2) ) {
+          *oLog << "    -- GReadDCStdGrISU::makeStdGeometry " << endl;
+          *oLog << "         SHADOWMODEL must be 0, 1, or 2: "
+                << gp->shadowModel << endl;
+          exit(0);
+        }
+      }
     }
 
   }
@@ -20,6 +20,8 @@ VERSION3.1
 #include <algorithm>
 #include <bitset>
 #include <iomanip>
+#include <cstring>
+#include <climits>
 
 using namespace std;
 #include "TMatrixD.h"
@@ -43,6 +45,149 @@ using namespace std;
 #define DEBUG(x) *oLog << #x << " = " << x << endl
 #define DEBUGS(x) *oLog << "      " << #x << " = " << x << endl
 
+// size of the blocks read from the input stream
+static const unsigned long iBlockSize = 1 << 20;
+
+/* Record fields are scanned in place, with the results of
+   istringstream >> : a field missing at the end of the record leaves
+   the variable unchanged, a field that is not a number sets it to 0,
+   and in both cases the following fields of the record are not read.
+   Each scan function returns false in these cases.
+*/
+static inline bool isBlank(const char &c) {
+  return (c == ' ') || (c == '\t') || (c == '\n') || (c == '\v') ||
+    (c == '\f') || (c == '\r');
+}
+
+static inline bool scanChar(const char **p,const char *end,char *c) {
+  const char *q = *p;
+  while ( (q < end) && isBlank(*q) ) q++;
+  if (q == end) return false;
+  *c = *q;
+  *p = q + 1;
+  return true;
+}
+
+/* the decimal mantissa is accumulated in an integer; if it has at most
+   19 digits, is below 2^53 and has at most 22 decimals, the single
+   division by the exact power of ten is correctly rounded, as strtod.
+   Other numbers (and exponents) are passed to strtod.
+ */
+static bool scanDouble(const char **p,const char *end,double *val) {
+  static const double pow10[23] = {1e0,1e1,1e2,1e3,1e4,1e5,1e6,1e7,
+                                   1e8,1e9,1e10,1e11,1e12,1e13,1e14,
+                                   1e15,1e16,1e17,1e18,1e19,1e20,1e21,
+                                   1e22};
+  const char *q = *p;
+  while ( (q < end) && isBlank(*q) ) q++;
+  if (q == end) return false;
+
+  const char *start = q;
+  bool neg = false;
+  if ( (*q == '-') || (*q == '+') ) {
+    neg = (*q == '-');
+    q++;
+  }
+  unsigned long long mant = 0;
+  int numDigits = 0;
+  int numDecimals = 0;
+  bool fast = true;
+  while ( (q < end) && (*q >= '0') && (*q <= '9') ) {
+    mant = 10*mant + (*q - '0');
+    numDigits++;
+    q++;
+  }
+  if ( (q < end) && (*q == '.') ) {
+    q++;
+    while ( (q < end) && (*q >= '0') && (*q <= '9') ) {
+      mant = 10*mant + (*q - '0');
+      numDigits++;
+      numDecimals++;
+      q++;
+    }
+  }
+  if (numDigits == 0) {
+    *val = 0.0;
+    return false;
+  }
+  if ( (q < end) && ( (*q == 'e') || (*q == 'E') ) ) fast = false;
+  if ( (numDigits > 19) || (mant > (1ULL << 53)) || (numDecimals > 22) ) {
+    fast = false;
+  }
+
+  if (fast) {
+    double v = (double)mant;
+    if (numDecimals > 0) v = v / pow10[numDecimals];
+    *val = (neg) ? -v : v;
+    *p = q;
+    return true;
+  }
+
+  // the record ends with '\n' or '\0', strtod stops there
+  char *stop = 0;
+  double v = strtod(start,&stop);
+  if (stop == start) {
+    *val = 0.0;
+    return false;
+  }
+  *val = v;
+  *p = stop;
+  return true;
+}
+
+// returns 1 if ok, 0 if the field is missing, -1 if it is not a number
+static int scanLong(const char **p,const char *end,long long *val) {
+  const char *q = *p;
+  while ( (q < end) && isBlank(*q) ) q++;
+  if (q == end) return 0;
+
+  bool neg = false;
+  if ( (*q == '-') || (*q == '+') ) {
+    neg = (*q == '-');
+    q++;
+  }
+  const char *digits = q;
+  long long v = 0;
+  while ( (q < end) && (*q >= '0') && (*q <= '9') ) {
+    if (v < LLONG_MAX/10) v = 10*v + (*q - '0');
+    q++;
+  }
+  if (q == digits) return -1;
+
+  *val = (neg) ? -v : v;
+  *p = q;
+  return 1;
+}
+
+static inline bool scanInt(const char **p,const char *end,int *val) {
+  long long v = 0;
+  int ok = scanLong(p,end,&v);
+  if (ok < 0) *val = 0;
+  if (ok <= 0) return false;
+
+  if ( (v > INT_MAX) || (v < INT_MIN) ) {
+    *val = (v > 0) ? INT_MAX : INT_MIN;
+    return false;
+  }
+  *val = (int)v;
+  return true;
+}
+
+static inline bool scanUInt(const char **p,const char *end,
+                            unsigned int *val) {
+  long long v = 0;
+  int ok = scanLong(p,end,&v);
+  if (ok < 0) *val = 0;
+  if (ok <= 0) return false;
+
+  if ( (v > UINT_MAX) || (v < -(long long)UINT_MAX) ) {
+    *val = UINT_MAX;
+    return false;
+  }
+  *val = (unsigned int)v;  // negative values wrap, as with >>
+  return true;
+}
+
 GReadPhotonGrISU::GReadPhotonGrISU() {
   bool debugG = false;
   if (debugG) {
@@ -54,7 +199,11 @@ GReadPhotonGrISU::GReadPhotonGrISU() {
   fObsHgt = 0.0;
   fGlobalEffic = 0.0;
   iParticleType = 0;
-  sFileLine = "";
+  iBufBeg = 0;
+  iBufEnd = 0;
+  bInputEOF = false;
+  pRec = 0;
+  pRecEnd = 0;
   eRecType = SREC;
   fSEnergy = 0.0;
   fSAz = 0.0;
@@ -110,6 +259,10 @@ bool GReadPhotonGrISU::setInputFile(const string &infile) {
       exit(0);  //<! stop code if file cannot be opened
     }
   }
+  vBuffer.assign(iBlockSize + 1,'\0');
+  iBufBeg = 0;
+  iBufEnd = 0;
+  bInputEOF = false;
 
   // read header input records
   string headerStart("* HEADF");  // start of header flag
@@ -120,7 +273,7 @@ bool GReadPhotonGrISU::setInputFile(const string &infile) {
   int recordCt = 0;     // set record counter
   sInFileHeader = "";   // set header string
 
-  while (getline(*pInStream,fileline,'\n')) {  
+  while (readLine(&fileline)) {  
     recordCt++;
 
     if (fileline=="") continue;  // check for blank lines
@@ -133,7 +286,7 @@ bool GReadPhotonGrISU::setInputFile(const string &infile) {
       sInFileHeader = "";
 
       // read lines, looking for end of header
-      while(getline(*pInStream,fileline,'\n') ) {
+      while(readLine(&fileline) ) {
 	if (fileline == "") continue;  // check for blank lines
        
         recordCt++;
@@ -169,7 +322,7 @@ bool GReadPhotonGrISU::setInputFile(const string &infile) {
 
   // now get R line, first check for blank lines
   // R line must be present
-  while (getline(*pInStream,fileline,'\n')) {
+  while (readLine(&fileline)) {
     recordCt++;
     if (fileline!="") break; 
   }
@@ -192,7 +345,7 @@ bool GReadPhotonGrISU::setInputFile(const string &infile) {
   }
 
   // get H line, H line must be present, no blank line check
-  getline(*pInStream,fileline,'\n');
+  readLine(&fileline);
   if (fileline[0] == 'H') {
 
     is.clear();
@@ -214,6 +367,72 @@ bool GReadPhotonGrISU::setInputFile(const string &infile) {
 };
 /*****************end of setInputFile ********************************/
 
+void GReadPhotonGrISU::fillBuffer() {
+
+  // move the unscanned data to the front of the buffer
+  unsigned long numLeft = iBufEnd - iBufBeg;
+  if ( (numLeft > 0) && (iBufBeg > 0) ) {
+    memmove(&vBuffer[0],&vBuffer[iBufBeg],numLeft);
+  }
+  iBufBeg = 0;
+  iBufEnd = numLeft;
+
+  // line longer than the buffer, make room for another block
+  if (vBuffer.size() - 1 - iBufEnd < iBlockSize/2) {
+    vBuffer.resize(vBuffer.size() + iBlockSize,'\0');
+  }
+
+  unsigned long numRead = 0;
+  if (!bInputEOF) {
+    pInStream->read(&vBuffer[iBufEnd],vBuffer.size() - 1 - iBufEnd);
+    numRead = pInStream->gcount();
+  }
+  if (numRead == 0) bInputEOF = true;
+
+  iBufEnd += numRead;
+  vBuffer[iBufEnd] = '\0';  // a number at the end of the input ends here
+};
+/*****************end of fillBuffer ********************************/
+
+bool GReadPhotonGrISU::nextLine(const char **beg,const char **end) {
+
+  while (1) {
+    char *first = &vBuffer[0] + iBufBeg;
+    char *last = &vBuffer[0] + iBufEnd;
+    char *newLine = (char *)memchr(first,'\n',last - first);
+
+    if (newLine != 0) {
+      *beg = first;
+      *end = newLine;
+      iBufBeg = newLine - &vBuffer[0] + 1;
+      return true;
+    }
+    if (bInputEOF) {
+      if (first == last) return false;
+      // last line without '\n'
+      *beg = first;
+      *end = last;
+      iBufBeg = iBufEnd;
+      return true;
+    }
+    fillBuffer();
+  }
+};
+/*****************end of nextLine ********************************/
+
+bool GReadPhotonGrISU::readLine(string *line) {
+
+  const char *beg = 0;
+  const char *end = 0;
+  if (!nextLine(&beg,&end)) {
+    line->clear();   // as getline at the end of the input
+    return false;
+  }
+  line->assign(beg,end);
+  return true;
+};
+/*****************end of readLine ********************************/
+
 bool GReadPhotonGrISU::getLine() {
 
   bool debugL = false;
@@ -224,8 +443,8 @@ bool GReadPhotonGrISU::getLine() {
     *oLog << "  -- GReadPhotonGrISU::getLine" << endl;
   }
 
-  if (getline(*pInStream,sFileLine,'\n')) {
-    char c = sFileLine[0];
+  if (nextLine(&pRec,&pRecEnd)) {
+    char c = (pRec < pRecEnd) ? *pRec : '\0';
     okLine = true;     // new record has been read
 
     if (c =='S') {       // primary record type
@@ -239,7 +458,7 @@ bool GReadPhotonGrISU::getLine() {
     }
     else {
       cerr << "  unknown record type in input file" << endl;
-      cerr << "  record:  " << sFileLine << endl;
+      cerr << "  record:  " << string(pRec,pRecEnd) << endl;
       cerr << "   STOPING CODE " << endl;
     }
   }
@@ -249,7 +468,7 @@ bool GReadPhotonGrISU::getLine() {
 
   if (debugL) {
     DEBUGS(eRecType);
-    DEBUGS(sFileLine);
+    DEBUGS(string(pRec,pRecEnd));
     *oLog << "  end of GReadPhotonGrISU::getLine" << endl;
   }
   
@@ -269,7 +488,7 @@ bool GReadPhotonGrISU::getPrimary(ROOT::Math::XYZVector *pCore,
 
   if (debugS) {
     *oLog << "  -- GReadPhotonGrISU::getPrimary" << endl;
-    *oLog << "      " << sFileLine << endl;
+    *oLog << "      " << string(pRec,pRecEnd) << endl;
   }
   
   bool okReadS = false;  // initialize to no S record
@@ -278,7 +497,6 @@ bool GReadPhotonGrISU::getPrimary(ROOT::Math::XYZVector *pCore,
     okReadS = true;   // S record in current record
     char c;
     double tmp = 0.0;
-    istringstream is(sFileLine);
     double fSXcore = 0.0;
     double fSYcore = 0.0;
     double fSZcore = 0.0;
@@ -291,9 +509,18 @@ bool GReadPhotonGrISU::getPrimary(ROOT::Math::XYZVector *pCore,
     fFirstIntDpt = -9999.9;
     iShowerID     = 99;
 
-    // read primary parameters from string stream 
-    is >> c >> fSEnergy >> fSXcore >> fSYcore >> fSXcos >> fSYcos
-       >> tmp >> iSSeed[0] >> iSSeed[1] >> iSSeed[2];
+    // read primary parameters from the record
+    const char *p = pRec;
+    bool ok = scanChar(&p,pRecEnd,&c);
+    ok = ok && scanDouble(&p,pRecEnd,&fSEnergy);
+    ok = ok && scanDouble(&p,pRecEnd,&fSXcore);
+    ok = ok && scanDouble(&p,pRecEnd,&fSYcore);
+    ok = ok && scanDouble(&p,pRecEnd,&fSXcos);
+    ok = ok && scanDouble(&p,pRecEnd,&fSYcos);
+    ok = ok && scanDouble(&p,pRecEnd,&tmp);
+    ok = ok && scanInt(&p,pRecEnd,&iSSeed[0]);
+    ok = ok && scanInt(&p,pRecEnd,&iSSeed[1]);
+    ok = ok && scanInt(&p,pRecEnd,&iSSeed[2]);
 
     // the input coordinate system has x-axis East, y-axis South,
     // and z-axis Down. Our ground coor. system has x-axis East,
@@ -348,16 +575,17 @@ bool GReadPhotonGrISU::getPrimary(ROOT::Math::XYZVector *pCore,
 
     // get C line if it's there
     getLine();
-    istringstream is1(sFileLine);
     char c1;
 
     if (eRecType == CREC) {
-      is1 >> c1 >> fFirstIntHgt >> fFirstIntDpt >> iShowerID;  // C line parms
+      p = pRec;   // C line parms
+      ok = scanChar(&p,pRecEnd,&c1);
+      ok = ok && scanDouble(&p,pRecEnd,&fFirstIntHgt);
+      ok = ok && scanDouble(&p,pRecEnd,&fFirstIntDpt);
+      ok = ok && scanUInt(&p,pRecEnd,&iShowerID);
       *firstIntHgt = fFirstIntHgt;
       *firstIntDpt = fFirstIntDpt;
       *showerid    = iShowerID;
-      is1.str("");
-      is1.clear();
       getLine();
     }
     //if C record is not present, set to default values
@@ -382,7 +610,7 @@ bool GReadPhotonGrISU::getPhoton(ROOT::Math::XYZVector *pGrd,
   bool debugP = false;
   if (debugP) {
     *oLog << "  -- GReadPhotonGrISU::getPhoton" << endl;
-    *oLog << "      " << sFileLine << endl;
+    *oLog << "      " << string(pRec,pRecEnd) << endl;
   }
   
   bool okReadP = false; // initialize to no P record
@@ -396,11 +624,19 @@ bool GReadPhotonGrISU::getPhoton(ROOT::Math::XYZVector *pGrd,
     double ycos = 0.0;
     double zcos = 0.0;
     
-    // read photon parameters from stringstream
+    // read photon parameters from the record
     char c;
-    istringstream is(sFileLine);
-    is >> c >> xGrd >> yGrd >> xcos >> ycos >> fPHgtEmiss
-       >> fPTime >> fPWaveLgt >> iPType >> iPTel;  
+    const char *p = pRec;
+    bool ok = scanChar(&p,pRecEnd,&c);
+    ok = ok && scanDouble(&p,pRecEnd,&xGrd);
+    ok = ok && scanDouble(&p,pRecEnd,&yGrd);
+    ok = ok && scanDouble(&p,pRecEnd,&xcos);
+    ok = ok && scanDouble(&p,pRecEnd,&ycos);
+    ok = ok && scanDouble(&p,pRecEnd,&fPHgtEmiss);
+    ok = ok && scanDouble(&p,pRecEnd,&fPTime);
+    ok = ok && scanDouble(&p,pRecEnd,&fPWaveLgt);
+    ok = ok && scanInt(&p,pRecEnd,&iPType);
+    ok = ok && scanInt(&p,pRecEnd,&iPTel);
     
     // convert to ground coordinate system from kascade system
     // input system has z down, y South rather than z up and y North
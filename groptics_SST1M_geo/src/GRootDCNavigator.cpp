@@ -37,6 +37,7 @@ using namespace std;
 #include "TPad.h"
 #include "TVector3.h"
 #include "TGeoPgon.h"
+#include "TGeoTube.h"
 
 //#include ".h"
 #include "GDefinition.h"
@@ -46,6 +47,7 @@ using namespace std;
 
 #include "GTelescope.h"
 #include "GDCTelescope.h"
+#include "GDCShadowModel.h"
 #include "GRootDCNavigator.h"
 
 ClassImp(GRootDCNavigator);
@@ -75,6 +77,8 @@ GRootDCNavigator:: GRootDCNavigator(GDCTelescope *dcTel,
   fAl = 0;
   fTopPosV = 0;
   fTopVol = 0;
+  fShadow = 0;
+  fFocBoxNum = 0;
 
   // initialize single variables
   fFL = 0.0;
@@ -192,6 +196,9 @@ GRootDCNavigator:: GRootDCNavigator(GDCTelescope *dcTel,
   
   //--- close the geometry
   fGeom->CloseGeometry();
+
+  // analytic copy of the volumes for the shadowing
+  makeShadowModel();
   //fTopVol->Draw("ogl");
    
    //drawTelescope();
@@ -213,6 +220,7 @@ GRootDCNavigator::  ~GRootDCNavigator() {
   }
   
   SafeDelete(fTopPosV);
+  SafeDelete(fShadow);
   
   for (int i = 0; i<3;i++) {
     SafeDelete(fQuadArmR2R1V[i]);
@@ -1084,7 +1092,7 @@ void GRootDCNavigator::makeSupportWires() {
   //quad arm bottoms {-0.95 1.8 -2.6} {0.95 -1.8 -2.6} {0.95 1.8 -2.6} {-0.95 -1.8 -2.6}
   //{-0.95 1.8 -2.6}->{-0.7 -1.15 0}
  
-  TGeoVolume *fSupportWireVol[16];
+  TGeoVolume *fSupportWireVol[17];
 
   Double_t rsize = 0.008/2.;
 
@@ -1628,22 +1636,14 @@ void GRootDCNavigator::movePositionToTopOfTopVol() {
 };
 //****************************************************
 
-const char * GRootDCNavigator::setPositionDirection( double *pos, double *dir) {
+void GRootDCNavigator::setTopVolPositionDirection(double *pos, double *dir) {
 
-  gGeoManager = fGeom;
   // position and direction: in telescope coordinates
   // translate to TOP coordinates
   for (int i = 0;i< 3;i++) {
     fPosC[i] = pos[i];
     fDirC[i] = dir[i];
   }
-  if (fDebugTr) {
-    *oLog << "  -- GRootDCNavigator::setPositionDirection " << endl;
-    *oLog << "       initial position, focal point coor: " << pos[0] 
-          << " " << pos[1] << " " << pos[2] << endl;
-    *oLog << "       initial direction: " << dir[0] 
-          << " " << dir[1] << " " << dir[2] << endl;
-  }
   // move position to intersection with topVol top surface
   if (dir[2] < 0) {
     fMoveToTop = true;
@@ -1653,6 +1653,20 @@ const char * GRootDCNavigator::setPositionDirection( double *pos, double *dir) {
 
   // this is z component of position relative to the topVol Center
   fPosC[2] = fPosC[2] +(*fTopPosV)[2] - fFocusBoxDim[2] - fepsil; 
+};
+//****************************************************
+
+const char * GRootDCNavigator::setPositionDirection( double *pos, double *dir) {
+
+  gGeoManager = fGeom;
+  if (fDebugTr) {
+    *oLog << "  -- GRootDCNavigator::setPositionDirection " << endl;
+    *oLog << "       initial position, focal point coor: " << pos[0] 
+          << " " << pos[1] << " " << pos[2] << endl;
+    *oLog << "       initial direction: " << dir[0] 
+          << " " << dir[1] << " " << dir[2] << endl;
+  }
+  setTopVolPositionDirection(pos,dir);
 
   fGeom->InitTrack(fPosC,fDirC);
   TGeoNode *cnode = fGeom->GetCurrentNode();
@@ -1748,6 +1762,97 @@ const char * GRootDCNavigator::getPositionDirection(double *pos1,
   return currnode;
 };
 
+//****************************************************
+void GRootDCNavigator::makeShadowModel() {
+
+  bool debug = fDebugT;
+  if (debug) {
+    *oLog << "  -- GRootDCNavigator::makeShadowModel" << endl;
+  }
+
+  fShadow = new GDCShadowModel();
+  fShadow->setTopVolume(fTopDim);
+
+  int numNodes = fTopVol->GetNdaughters();
+  for (int i = 0;i < numNodes;i++) {
+    TGeoNode *node = fTopVol->GetNode(i);
+    TGeoShape *shape = node->GetVolume()->GetShape();
+    const Double_t *rot = node->GetMatrix()->GetRotationMatrix();
+    const Double_t *tr = node->GetMatrix()->GetTranslation();
+    int nodeNum = node->GetNumber();
+    string nodeName = node->GetName();
+
+    if (nodeName == "fFocBoxVol_1") {
+      fFocBoxNum = nodeNum;
+    }
+
+    bool bKnown = false;
+    if (shape->IsA() == TGeoTube::Class()) {
+      TGeoTube *tube = (TGeoTube *)shape;
+      fShadow->addTube(nodeNum,nodeName,tube->GetRmin(),tube->GetRmax(),
+                       tube->GetDz(),rot,tr);
+      bKnown = true;
+    }
+    else if (shape->IsA() == TGeoPgon::Class()) {
+      // only full prisms of constant cross section
+      TGeoPgon *pgon = (TGeoPgon *)shape;
+      if ( (pgon->GetNz() == 2) && (pgon->GetDphi() >= 360.0) &&
+           (pgon->GetRmin(0) == pgon->GetRmin(1)) &&
+           (pgon->GetRmax(0) == pgon->GetRmax(1)) ) {
+        fShadow->addPgon(nodeNum,nodeName,pgon->GetNedges(),
+                         pgon->GetPhi1(),pgon->GetRmin(0),
+                         pgon->GetRmax(0),pgon->GetZ(0),pgon->GetZ(1),
+                         rot,tr);
+        bKnown = true;
+      }
+    }
+    else if (shape->InheritsFrom(TGeoArb8::Class())) {
+      TGeoArb8 *arb = (TGeoArb8 *)shape;
+      fShadow->addArb8(nodeNum,nodeName,arb->GetVertices(),arb->GetDz(),
+                       rot,tr);
+      bKnown = true;
+    }
+
+    if (!bKnown) {
+      *oLog << "  -- GRootDCNavigator::makeShadowModel" << endl;
+      *oLog << "       no analytic shape for node " << nodeName << endl;
+      *oLog << "       using root navigation for the shadowing" << endl;
+      SafeDelete(fShadow);
+      return;
+    }
+  }
+  fShadow->build();
+
+  if (debug) {
+    *oLog << "       number of occluders: " << fShadow->getNumOccluders()
+          << endl;
+    *oLog << "       focus box node number: " << fFocBoxNum << endl;
+  }
+};
+
+//****************************************************
+int GRootDCNavigator::getOccluder(double *pos, double *dir,
+                                  double *hitPos) {
+
+  setTopVolPositionDirection(pos,dir);
+
+  double dist = 0.0;
+  int nodeNum = fShadow->findOccluder(fPosC,fDirC,&dist);
+  for (int i = 0;i < 3;i++) {
+    hitPos[i] = fPosC[i] + dist*fDirC[i];
+  }
+  return nodeNum;
+};
+
+//****************************************************
+const char * GRootDCNavigator::getOccluderName(const int &nodeNum) {
+
+  if (nodeNum == 0) {
+    return "fTopVol_1";
+  }
+  return fShadow->getOccluderName(nodeNum);
+};
+
 //****************************************************
 void GRootDCNavigator::drawTelescope(const int &option) {
   gGeoManager = fGeom;
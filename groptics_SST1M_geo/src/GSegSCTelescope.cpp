@@ -26,6 +26,7 @@ VERSION3.1
 #include <algorithm>
 #include <bitset>
 #include <iomanip>
+#include <cstdio>
 
 using namespace std;
 
@@ -82,6 +83,7 @@ using namespace std;
 #include "GSegmentedObscuration.h"
 #include "GTelescope.h"
 #include "GSegSCTelescope.h"
+#include "GPhotonHistoryFile.h"
 
 #define DEBUG(x) *oLog << #x << " = " << x << endl
 #define DEBUGW(x) *oLog << "         " << #x << " = " << x << endl
@@ -114,6 +116,7 @@ GSegSCTelescope::~GSegSCTelescope() {
   }
 
   if (hisF != 0) SafeDelete(hisF);
+  SafeDelete(hisC);  // closes the compact history file
  
   map<int, TGraph *>::iterator itmGRefl; 
   for (itmGRefl=mGRefl->begin();
@@ -123,6 +126,15 @@ GSegSCTelescope::~GSegSCTelescope() {
   SafeDelete(mGRefl);
   SafeDelete(ray);
 
+  // with photon bundles the reflectivity graphs are no longer owned
+  // by the mirrors
+  if (bPhotonBundles) {
+    map<TGeoVolume *, TGraph *>::iterator itMir;
+    for (itMir = mMirrorRefl.begin();itMir != mMirrorRefl.end();itMir++) {
+      SafeDelete(itMir->second);
+    }
+  }
+
   if (fS != 0) delete[] fS;
   if (fP != 0) delete[] fP;
 };
@@ -365,6 +377,7 @@ void GSegSCTelescope::addPrimaryMirror(const char*name,
 
   TGraph * graph = makeReflectivityGraph(iReflect);
   mir->SetReflectivity(graph); // graph owned by AMirror (and deleted)
+  if (graph != 0) mMirrorRefl[mir] = graph;
   TGeoCombiTrans* combi = mirror->BuildMirrorCombiTrans(fPrimaryV, kTRUE);
 
   ABorderSurfaceCondition * condition
@@ -528,6 +541,7 @@ void GSegSCTelescope::addSecondaryMirror(const char*name, SegmentedMirror *mirro
   mir->SetLineColor(iSecondaryColor);
   TGraph * graph = makeReflectivityGraph(iReflect);
   mir->SetReflectivity(graph);
+  if (graph != 0) mMirrorRefl[mir] = graph;
 
   TGeoCombiTrans* combi = mirror->BuildMirrorCombiTrans(fSecondaryV, kFALSE);
 
@@ -773,6 +787,66 @@ void GSegSCTelescope::injectPhoton(const ROOT::Math::XYZVector &photonLocT,
     initializePhotonHistoryParms();    
   }
   
+  traceRay();
+
+  // the mirrors carry no reflectivity with photon bundles, apply it
+  // here to the wavelength of the photon
+  if (bPhotonBundles) {
+    vBundleLambda.assign(1,fphotWaveLgt);
+    vector<double> vWeight;
+    getMirrorWeights(vBundleLambda,&vWeight);
+    if (vWeight[0] < gRandom->Uniform(1)) ray->Absorb();
+  }
+};
+/********************** end of injectPhoton *****************/
+
+bool GSegSCTelescope::injectPhotonBundle(const ROOT::Math::XYZVector &photonLocT,
+                                         const ROOT::Math::XYZVector &photonDirT,
+                                         const vector<double> &vWaveLgt,
+                                         vector<double> *vWeight) {
+  gGeoManager = fManager;
+
+  bool debug = false;
+  if (debug) {
+    *oLog << " -- GSegSCTelescope::injectPhotonBundle " << vWaveLgt.size()
+          << endl;
+  }
+  if ( (!bPhotonBundles) || (vWaveLgt.size() == 0) ) return false;
+
+  photonLocT.GetCoordinates(fInitialInjectLoc);
+  photonLocT.GetCoordinates(fphotonInjectLoc);
+  photonDirT.GetCoordinates(fphotonInjectDir); 
+
+  // the geometric path does not depend on the wavelength, apart from
+  // the small dispersion in the MAPMT window: trace at the first one
+  fphotWaveLgt = vWaveLgt[0]*nm;
+
+  fphotonInjectLoc[2] = fphotonInjectLoc[2] + fRotationOffset;
+
+  movePositionToTopOfTopVol();
+ 
+  if (bPhotonHistoryFlag) {
+    initializePhotonHistoryParms();    
+  }
+
+  traceRay();
+
+  vBundleLambda.resize(vWaveLgt.size());
+  for (unsigned i = 0;i<vWaveLgt.size();i++) {
+    vBundleLambda[i] = vWaveLgt[i]*nm;
+  }
+  getMirrorWeights(vBundleLambda,vWeight);
+
+  return true;
+};
+/********************** end of injectPhotonBundle *****************/
+
+void GSegSCTelescope::traceRay() {
+
+  gGeoManager = fManager;
+
+  bool debug = false;
+
   // Assuming that three arguments are given in units of (m), (m), (nm)
   double t = 0;
   double x  = fphotonInjectLoc[0];
@@ -803,7 +877,78 @@ void GSegSCTelescope::injectPhoton(const ROOT::Math::XYZVector &photonLocT,
   }
 
 };
-/********************** end of injectPhoton *****************/
+/********************** end of traceRay *****************/
+
+void GSegSCTelescope::getMirrorWeights(const vector<double> &vLambda,
+                                       vector<double> *vWeight) {
+  gGeoManager = fManager;
+
+  vWeight->assign(vLambda.size(),1.0);
+
+  // a ray point followed, a short step further along the incoming
+  // direction, by a mirror volume is a reflection on that mirror. The
+  // step is well above the geometry tolerance and below the mirror 
+  // thickness.
+  const double step = 0.1*um;
+
+  double xPrev[3];
+  double x[3];
+  double t = 0.0;
+  int numPoints = ray->GetNpoints();
+  ray->GetPoint(0,xPrev[0],xPrev[1],xPrev[2],t);
+
+  for (int k = 1;k<numPoints;k++) {
+    ray->GetPoint(k,x[0],x[1],x[2],t);
+    double d[3];
+    for (int i = 0;i<3;i++) {
+      d[i] = x[i] - xPrev[i];
+    }
+    double len = sqrt(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+    if (len <= 0.0) continue;
+    for (int i = 0;i<3;i++) {
+      xPrev[i] = x[i];
+    }
+
+    TGeoNode *node = fManager->FindNode(x[0] + step*d[0]/len,
+                                        x[1] + step*d[1]/len,
+                                        x[2] + step*d[2]/len);
+    if (node == 0) continue;
+    map<TGeoVolume *, TGraph *>::iterator iter;
+    iter = mMirrorRefl.find(node->GetVolume());
+    if (iter == mMirrorRefl.end()) continue;
+
+    // limited to [0,1] as in AMirror::GetReflectivity
+    for (unsigned i = 0;i<vLambda.size();i++) {
+      double ref = iter->second->Eval(vLambda[i]);
+      if (ref > 1.0) ref = 1.0;
+      if (ref < 0.0) ref = 0.0;
+      (*vWeight)[i] *= ref;
+    }
+  }
+};
+/********************** end of getMirrorWeights *****************/
+
+bool GSegSCTelescope::setPhotonBundles() {
+
+  bool debug = false;
+  if (debug) {
+    *oLog << "  -- GSegSCTelescope::setPhotonBundles " << endl;
+  }
+  if (bPhotonBundles) return true;
+
+  // the mirrors keep a reflectivity of 1, the graphs are applied by
+  // getMirrorWeights
+  map<TGeoVolume *, TGraph *>::iterator iter;
+  for (iter = mMirrorRefl.begin();iter != mMirrorRefl.end();iter++) {
+    ((AMirror *)iter->first)->SetReflectivity((TGraph *)0);
+  }
+  bPhotonBundles = true;
+
+  *oLog << "  -- GSegSCTelescope::setPhotonBundles: " << mMirrorRefl.size()
+        << " mirror reflectivities applied per wavelength" << endl;
+  return true;
+};
+/********************** end of setPhotonBundles *****************/
 void GSegSCTelescope::movePositionToTopOfTopVol() {
 
   gGeoManager = fManager;
@@ -1087,7 +1232,9 @@ void GSegSCTelescope::setPrintMode(ostream &oStr,const int prtMode) {
 
 void GSegSCTelescope::setPhotonHistory(const string &rootFile,
                                        const string &treeName,
-                                       const int &option) {
+                                       const int &option,
+                                       const int &sampleEvery,
+                                       const int &select) {
   bool debug = true;
 
   
@@ -1096,6 +1243,9 @@ void GSegSCTelescope::setPhotonHistory(const string &rootFile,
   historyFileName = rootFile;
   historyTreeName = treeName;
   iHistoryOption = option;
+  iHistorySample = (sampleEvery > 1) ? sampleEvery : 1;
+  iHistorySelect = select;
+  iHistoryOffered = 0;
   
   if (debug) {
     *oLog << "  -- setPhotonHistory " << endl;
@@ -1120,14 +1270,32 @@ void GSegSCTelescope::setPhotonHistory(const string &rootFile,
     historyFileName = historyFileName + strInsert;
   }
 
+  if (iHistoryOption == 1) {
+    // compact history file
+    idx = historyFileName.rfind('.');
+    if (idx != string::npos) historyFileName.erase(idx);
+    historyFileName = historyFileName + ".phist";
+  }
+
   if (debug) {
     *oLog << "     opening photon history file / tree:  " 
           << historyFileName << " / " << historyTreeName << endl;
   }
-  hisF = new TFile(historyFileName.c_str(),"RECREATE");
-  hisT = new TTree(historyTreeName.c_str(),historyTreeName.c_str());
-
-  makePhotonHistoryBranches();
+  if (iHistoryOption == 1) {
+    hisC = new GPhotonHistoryFile();
+    makePhotonHistoryBranches();
+    if (!hisC->openWrite(historyFileName,historyTreeName)) {
+      *oLog << "  -- GSegSCTelescope::setPhotonHistory " << endl;
+      *oLog << "     could not open " << historyFileName << endl;
+      *oLog << "     stopping code" << endl;
+      exit(0);
+    }
+  }
+  else {
+    hisF = new TFile(historyFileName.c_str(),"RECREATE");
+    hisT = new TTree(historyTreeName.c_str(),historyTreeName.c_str());
+    makePhotonHistoryBranches();
+  }
   initializePhotonHistoryParms();
   
 };
@@ -1135,34 +1303,68 @@ void GSegSCTelescope::setPhotonHistory(const string &rootFile,
 
 void GSegSCTelescope::makePhotonHistoryBranches() {
 
-  hisF->cd();
+  if (hisF != 0) hisF->cd();
   bool debug = false;
   if (debug) {
     *oLog << "  -- makePhotonHistoryBranches " << endl;
   }
 
-  hisT->Branch("status",&fStatusLast,"status/I");
-  hisT->Branch("nPoints",&fNPoints,"nPoints/I");
-  hisT->Branch("injectX",&fInitialInjectLoc[0],"injectX/D");
-  hisT->Branch("injectY",&fInitialInjectLoc[1],"injectY/D");
-  hisT->Branch("injectZ",&fInitialInjectLoc[2],"injectZ/D");
-
-  hisT->Branch("xLast",&fLocLast[0],"xLast/D");
-  hisT->Branch("yLast",&fLocLast[1],"yLast/D");
-  hisT->Branch("zLast",&fLocLast[2],"zLast/D");
-  hisT->Branch("xLastDir",&fDirLast[0],"xLastDir/D");
-  hisT->Branch("yLastDir",&fDirLast[1],"yLastDir/D");
-  hisT->Branch("zLastDir",&fDirLast[2],"zLastDir/D");
-  hisT->Branch("timeLast",&fTimeLast,"timeLast/D");
+  addHistoryField("status",&fStatusLast);
+  addHistoryField("nPoints",&fNPoints);
+  addHistoryField("injectX",&fInitialInjectLoc[0]);
+  addHistoryField("injectY",&fInitialInjectLoc[1]);
+  addHistoryField("injectZ",&fInitialInjectLoc[2]);
+
+  addHistoryField("xLast",&fLocLast[0]);
+  addHistoryField("yLast",&fLocLast[1]);
+  addHistoryField("zLast",&fLocLast[2]);
+  addHistoryField("xLastDir",&fDirLast[0]);
+  addHistoryField("yLastDir",&fDirLast[1]);
+  addHistoryField("zLastDir",&fDirLast[2]);
+  addHistoryField("timeLast",&fTimeLast);
 };
 /************************* end of makePhotonHistoryBranches *****/
 
+void GSegSCTelescope::addHistoryField(const string &name,Double_t *address) {
+
+  if (hisC != 0) {
+    hisC->addField(name,address);
+  }
+  else {
+    string leaf = name + "/D";
+    hisT->Branch(name.c_str(),address,leaf.c_str());
+  }
+};
+/************************* end of addHistoryField *****/
+
+void GSegSCTelescope::addHistoryField(const string &name,Int_t *address) {
+
+  if (hisC != 0) {
+    hisC->addField(name,address);
+  }
+  else {
+    string leaf = name + "/I";
+    hisT->Branch(name.c_str(),address,leaf.c_str());
+  }
+};
+/************************* end of addHistoryField *****/
+
 void GSegSCTelescope::fillPhotonHistory() {
 
   bool debug = false;
   if (debug) {
     *oLog << "  -- fillPhotonHistory " << endl;
   }
+
+  // status selection and sampling
+  if ( (iHistorySelect >= 0) && (fStatusLast != iHistorySelect) ) return;
+  iHistoryOffered++;
+  if ( (iHistoryOffered - 1) % iHistorySample != 0) return;
+
+  if (hisC != 0) {
+    hisC->fill();
+    return;
+  }
   hisF->cd();
   hisT->Fill();
 
@@ -1180,6 +1382,12 @@ void GSegSCTelescope::writePhotonHistory() {
   if (debug) {
     *oLog << "  -- in GSegSCTelescope::writePhotonHistory " << endl;
   }
+  if (hisC != 0) {
+    hisC->close();
+    *oLog << "  -- GSegSCTelescope::writePhotonHistory: " 
+          << hisC->getNumRecords() << " photons in " << historyFileName 
+          << endl;
+  }
   if (hisF != 0) {
     hisF->cd();  
     hisT->Write();
@@ -1258,6 +1466,11 @@ void GSegSCTelescope::initialize() {
   ray = 0;
   hisF = 0;
   hisT = 0;
+  hisC = 0;
+  iHistorySample = 1;
+  iHistorySelect = -1;
+  iHistoryOffered = 0;
+  bPhotonBundles = false;
 
   iTelID = 0;
   iStdID = 0;
@@ -70,6 +70,8 @@ GSimulateOptics::GSimulateOptics(GReadPhotonBase *read,
 
   iterRootWriter = mRootWriter->begin();
   rootWriter = iterRootWriter->second;
+  iPhotonBatchSize = 10000;
+  iPhotonBundleSize = 1;
   vTelDcosGrd = 0;
   rotGrdToTel = 0;
   
@@ -170,6 +172,7 @@ bool GSimulateOptics::startSimulations(const int &numShowers,
             
     photonFlag = false;
     int nPhotons = 0;
+    int nCulled = 0;
     
     for (int j = 0;j<numPhTmp;++j) {
       if (iNPhotons < 0) ++numPhTmp;
@@ -181,52 +184,33 @@ bool GSimulateOptics::startSimulations(const int &numShowers,
                                      &fPhotWaveLgt,&iPhotType,
                                      &iPhotTelHitNum);
 
-      if (!photonFlag) break;  // no more photons available
+      if (photonFlag) {
+        if (debug) {
+          printDebugPhoton();
+        }
+         
+        // check for active telescope number, could be subarray
+        // skip if telescope not included in the array
+        map<int, GArrayTel *>::iterator iterAT;
+        iterAT = mArrayTel->find(iPhotTelHitNum);
+
+        if (iterAT != mArrayTel->end() ) {
+          nPhotons++;
+          addPhotonToBatch();
+        }
+      }
 
-      if (debug) {
-        printDebugPhoton();
+      // ray trace the batch when it is full or the shower is done
+      if ( (photonBatch.size() >= iPhotonBatchSize) || 
+           ( (!photonFlag) && (photonBatch.size() > 0) ) ||
+           ( (j == numPhTmp - 1) && (photonBatch.size() > 0) ) ) {
+        nCulled += traceBatch();
       }
-         
-      // check for active telescope number, could be subarray
-      // skip if telescope not included in the array
-       map<int, GArrayTel *>::iterator iterAT;
-       iterAT = mArrayTel->find(iPhotTelHitNum);
-
-       if (iterAT != mArrayTel->end() ) {
-	 nPhotons++;
-
-	 (*mArrayTel)[iPhotTelHitNum]->setPhoton(vPhotonGrdLoc,
-						 vPhotonDCosGd,
-						 fAzPhot,
-						 fZnPhot,
-						 fPhotHgtEmiss,
-						 fPhotGrdTime,
-						 fPhotWaveLgt,
-						 iPhotType,
-						 iPhotTelHitNum);     
-	 // get ray tracing results
-	 ROOT::Math::XYZVector vPhotonCameraLoc;
-	 ROOT::Math::XYZVector vPhotonCameraDcos;
-	 
-	 bool bPhotonOnCamera = 
-	   (*mArrayTel)[iPhotTelHitNum]->getCameraPhotonLocation(&vPhotonCameraLoc,
-								 &vPhotonCameraDcos,
-								 &fPhotonToCameraTime);
-
-	 if (bPhotonOnCamera) {
-	   // mRootWriter is passed in as a pointer so have to dereference
-	   // add photon to the appropriate writer if photon strikes the camera 
-	   (*mRootWriter)[iPhotTelHitNum]->addPhoton(vPhotonCameraLoc,
-						     vPhotonCameraDcos,
-						     fPhotonToCameraTime,
-						     fPhotWaveLgt);
-	   
-	 }
-	 
-       }      // end of photon loop
-    }
+
+      if (!photonFlag) break;  // no more photons available
+    }      // end of photon loop
     *oLog << "    EventNumber " << fEventNumber << "   nPhotons "
-	  << nPhotons << endl;     
+	  << nPhotons << "   nCulled " << nCulled << endl;     
     // add event to all writers here
 
     ROOT::Math::XYZVector vTmp;
@@ -292,6 +276,22 @@ bool GSimulateOptics::startSimulations(const int &numShowers,
   }  // end of shower loop
   
   
+  // culled fraction per telescope
+  *oLog << "    photons culled before ray tracing" << endl;
+  *oLog << "          telNum      photons      culled    fraction" << endl;
+  for (iterArrayTel=mArrayTel->begin();
+       iterArrayTel!=mArrayTel->end();
+       iterArrayTel++) {
+    unsigned long nChecked = iterArrayTel->second->getNumPhotonsChecked();
+    unsigned long nCull = iterArrayTel->second->getNumPhotonsCulled();
+    double frac = 0.0;
+    if (nChecked > 0) frac = (double)nCull/(double)nChecked;
+    *oLog << "            " << iterArrayTel->first 
+          << "           " << nChecked 
+          << "           " << nCull 
+          << "           " << frac << endl;
+  }
+
   // write all trees
   for (iterRootWriter = mRootWriter->begin(); 
        iterRootWriter != mRootWriter->end(); iterRootWriter++) {
@@ -303,6 +303,163 @@ bool GSimulateOptics::startSimulations(const int &numShowers,
 };
 /************** end of startSimulations******************/
 
+void GSimulateOptics::addPhotonToBatch() {
+
+  photonBatch.grdX.push_back(vPhotonGrdLoc.X());
+  photonBatch.grdY.push_back(vPhotonGrdLoc.Y());
+  photonBatch.grdZ.push_back(vPhotonGrdLoc.Z());
+  photonBatch.dcosX.push_back(vPhotonDCosGd.X());
+  photonBatch.dcosY.push_back(vPhotonDCosGd.Y());
+  photonBatch.dcosZ.push_back(vPhotonDCosGd.Z());
+  photonBatch.az.push_back(fAzPhot);
+  photonBatch.zn.push_back(fZnPhot);
+  photonBatch.hgtEmiss.push_back(fPhotHgtEmiss);
+  photonBatch.grdTime.push_back(fPhotGrdTime);
+  photonBatch.waveLgt.push_back(fPhotWaveLgt);
+  photonBatch.type.push_back(iPhotType);
+  photonBatch.tel.push_back(iPhotTelHitNum);
+  photonBatch.accept.push_back(1);
+};
+/************** end of addPhotonToBatch ******************/
+
+int GSimulateOptics::traceBatch() {
+
+  bool debug = false;
+  if (debug) {
+    *oLog << "  -- GSimulateOptics::traceBatch " << photonBatch.size() 
+          << endl;
+  }
+
+  // sort the photons by telescope and remove those that can not 
+  // reach the camera, telescope by telescope
+  for (iterArrayTel=mArrayTel->begin();
+       iterArrayTel!=mArrayTel->end();
+       iterArrayTel++) {
+    mBatchPhotons[iterArrayTel->first].clear();
+  }
+  for (unsigned i = 0; i < photonBatch.size(); i++) {
+    mBatchPhotons[photonBatch.tel[i]].push_back(i);
+  }
+  // all photons to the coordinates of their telescopes in one pass
+  int maxTelID = 0;
+  if (!mArrayTel->empty()) maxTelID = mArrayTel->rbegin()->first;
+  vTelTransform.assign(12*(maxTelID + 1),0.0);
+  for (iterArrayTel=mArrayTel->begin();
+       iterArrayTel!=mArrayTel->end();
+       iterArrayTel++) {
+    iterArrayTel->second->getTelTransform(&vTelTransform[12*iterArrayTel->first]);
+  }
+  photonBatch.makeTelCoor();
+  GArrayTel::transformPhotons(&photonBatch,vTelTransform);
+
+  for (iterArrayTel=mArrayTel->begin();
+       iterArrayTel!=mArrayTel->end();
+       iterArrayTel++) {
+    iterArrayTel->second->cullPhotons(&photonBatch,
+                                      mBatchPhotons[iterArrayTel->first]);
+  }
+
+  // ray trace the remaining photons in the order they were read
+  int nCulled = 0;
+  for (unsigned i = 0; i < photonBatch.size(); i++) {
+    if (!photonBatch.accept[i]) {
+      nCulled++;
+      continue;
+    }
+    iPhotTelHitNum = photonBatch.tel[i];
+    fPhotWaveLgt = photonBatch.waveLgt[i];
+
+    GArrayTel *aTel = (*mArrayTel)[iPhotTelHitNum];
+    // get ray tracing results
+    ROOT::Math::XYZVector vPhotonCameraLoc;
+    ROOT::Math::XYZVector vPhotonCameraDcos;
+
+    // one ray for the photons of a bundle, the survivors share the
+    // camera location
+    if (mBundleTel[iPhotTelHitNum]) {
+      unsigned num = findBundle(i);
+      if (aTel->setPhotonBundle(photonBatch,i,num,&vBundleSurvive)) {
+        aTel->getCameraPhotonLocation(&vPhotonCameraLoc,
+                                      &vPhotonCameraDcos,
+                                      &fPhotonToCameraTime);
+        for (unsigned k = 0; k < num; k++) {
+          if (vBundleSurvive[k]) {
+            (*mRootWriter)[iPhotTelHitNum]->addPhoton(vPhotonCameraLoc,
+                                                      vPhotonCameraDcos,
+                                                      fPhotonToCameraTime,
+                                                      photonBatch.waveLgt[i + k]);
+          }
+        }
+        i += num - 1;
+        continue;
+      }
+    }
+
+    aTel->setPhoton(photonBatch,i);
+	 
+    bool bPhotonOnCamera = 
+      aTel->getCameraPhotonLocation(&vPhotonCameraLoc,
+                                    &vPhotonCameraDcos,
+                                    &fPhotonToCameraTime);
+
+    if (bPhotonOnCamera) {
+      // mRootWriter is passed in as a pointer so have to dereference
+      // add photon to the appropriate writer if photon strikes the camera 
+      (*mRootWriter)[iPhotTelHitNum]->addPhoton(vPhotonCameraLoc,
+                                                vPhotonCameraDcos,
+                                                fPhotonToCameraTime,
+                                                fPhotWaveLgt);
+    }
+  }
+  photonBatch.clear();
+
+  return nCulled;
+};
+/************** end of traceBatch ******************/
+
+unsigned GSimulateOptics::findBundle(const unsigned &first) {
+
+  unsigned n = photonBatch.size();
+  unsigned last = first + 1;
+  while ( (last < n) && (last - first < iPhotonBundleSize) &&
+          (photonBatch.accept[last]) &&
+          (photonBatch.tel[last] == photonBatch.tel[first]) &&
+          (photonBatch.grdX[last] == photonBatch.grdX[first]) &&
+          (photonBatch.grdY[last] == photonBatch.grdY[first]) &&
+          (photonBatch.grdZ[last] == photonBatch.grdZ[first]) &&
+          (photonBatch.dcosX[last] == photonBatch.dcosX[first]) &&
+          (photonBatch.dcosY[last] == photonBatch.dcosY[first]) &&
+          (photonBatch.dcosZ[last] == photonBatch.dcosZ[first]) &&
+          (photonBatch.grdTime[last] == photonBatch.grdTime[first]) ) {
+    last++;
+  }
+  return last - first;
+};
+/************** end of findBundle ******************/
+
+void GSimulateOptics::setPhotonBundleSize(const int &bundleSize) {
+
+  iPhotonBundleSize = 1;
+  if (bundleSize > 1) iPhotonBundleSize = bundleSize;
+
+  mBundleTel.clear();
+  for (iterArrayTel=mArrayTel->begin();
+       iterArrayTel!=mArrayTel->end();
+       iterArrayTel++) {
+    bool bundles = false;
+    if (iPhotonBundleSize > 1) {
+      bundles = iterArrayTel->second->setPhotonBundles();
+    }
+    mBundleTel[iterArrayTel->first] = bundles;
+    if (bundles) {
+      *oLog << "    telescope " << iterArrayTel->first 
+            << ": photon bundles of up to " << iPhotonBundleSize 
+            << " photons" << endl;
+    }
+  }
+};
+/************** end of setPhotonBundleSize ******************/
+
 void GSimulateOptics::makeWobbleOffset() {
 
   bool debug = false;
@@ -49,25 +49,9 @@ bool GUtilityFuncts::polyInside(const int &sides, const double &alpha,
   double theta,dist;
   double phi;
 
-  static double delta[50],beta[50],gamma[50];
-  static int ifirst=0;
-  int iside;
   double x1,y1;
 
-  /* initialize constant parameters */
-  if (ifirst==0) {
-    ifirst = 1;
-    delta[0]=delta[1]=delta[2]=0.0;
-    beta[0] = beta[1]= beta[2]=0.0;
-    gamma[0]=gamma[1]=gamma[2]=0.0;
-
-    for (iside=3;iside<50;iside++) {
-      delta[iside] = (PI)*( 0.5 - (1/(double)iside) );
-      gamma[iside] = 2*PI/(double)iside;
-      beta[iside]  = gamma[iside]/2.;
-    }
-  }
-  /* number of valid sides determined by size of arrays 
+  /* number of valid sides kept from the old parameter arrays 
      I only went to 49.............. Maybe that's a circle....
   */
   if (sides > 49) {
@@ -92,9 +76,14 @@ bool GUtilityFuncts::polyInside(const int &sides, const double &alpha,
     /* if you use atan to get theta, phi will be incorrect */
     theta = acos(y1 / dist);
   
-    phi = fabs( (fmod((theta + beta[sides]), gamma[sides])) - beta[sides]); 
+    /* constant parameters for this number of sides */
+    double delta = (PI)*( 0.5 - (1/(double)sides) );
+    double gamma = 2*PI/(double)sides;
+    double beta  = gamma/2.;
+
+    phi = fabs( (fmod((theta + beta), gamma)) - beta); 
 
-    if (dist<=((sin(delta[sides])*radius)/sin(delta[sides] + phi))) 
+    if (dist<=((sin(delta)*radius)/sin(delta + phi))) 
       return true;
     
   }
@@ -112,6 +101,56 @@ bool GUtilityFuncts::polyInside(const int &sides, const double &alpha,
 
 /********************  end of polyInside ***************/
 
+void GUtilityFuncts::polyEdges(const int &sides, const double &alpha, 
+                               const double &radius, PolyEdges *edges) {
+
+  edges->sides = sides;
+  edges->radius2 = radius*radius;
+  edges->apothem = radius;
+  edges->nx.clear();
+  edges->ny.clear();
+
+  /* circle, or nothing for sides = 0: no edges */
+  if (sides <= 2) return;
+
+  /* the polygon rotated clockwise by alpha has a point at angle alpha 
+     from the y-axis; edge j has its normal at angle alpha + beta + 
+     j*gamma from the y-axis */
+  double gamma = 2*TMath::Pi()/(double)sides;
+  double beta  = gamma/2.;
+  edges->apothem = radius*cos(beta);
+  for (int j = 0; j < sides; j++) {
+    double angle = alpha + beta + j*gamma;
+    edges->nx.push_back(sin(angle));
+    edges->ny.push_back(cos(angle));
+  }
+}
+/********************  end of polyEdges ***************/
+
+void GUtilityFuncts::polyInside(const PolyEdges &edges, const int &n,
+                                const double *x, const double *y, 
+                                bool *inside) {
+
+  const double *nx = edges.nx.empty() ? 0 : &(edges.nx[0]);
+  const double *ny = edges.ny.empty() ? 0 : &(edges.ny[0]);
+  int nEdges = edges.nx.size();
+  double radius2 = edges.radius2;
+  double apothem = edges.apothem;
+  /* point after point, all the edges of the polygon for each */
+  bool valid = (edges.sides > 0);
+
+  for (int i = 0; i < n; i++) {
+    double xi = x[i];
+    double yi = y[i];
+    bool in = valid & ( (xi*xi + yi*yi) <= radius2);
+    for (int j = 0; j < nEdges; j++) {
+      in &= ( (xi*nx[j] + yi*ny[j]) <= apothem);
+    }
+    inside[i] = in;
+  }
+}
+/********************  end of polyInside (batch) ***************/
+
 //void GUtilityFuncts::tokenizer(const string& str, vector<string>& tokens) {
   
 //string buf; // Have a buffer string
@@ -1213,6 +1252,69 @@ bool GUtilityFuncts::photonReflect(const vector<double> &refCoeff,
 };
 /******************* end of photonReflect ***************/ 
 
+void GUtilityFuncts::makeReflTable(const vector<double> &refCoeff,
+                                   const vector<double> &refWaveLgt,
+                                   ReflTable *table) {
+
+  int numberRC = refCoeff.size();
+  if ( (int)refWaveLgt.size() != numberRC) {
+    *oLog << " GUtilityFuncts::makeReflTable: " << refWaveLgt.size() 
+          << " wavelengths for " << numberRC << " coefficients" << endl;
+    *oLog << " stopping code " << endl;
+    exit(0);
+  }
+
+  table->waveLgt = refWaveLgt;
+  table->slope.assign(numberRC,0.0);
+  table->intercept.assign(numberRC,0.0);
+
+  // same slope and intercept as in the loop of photonReflect
+  for (int n = 1;n<numberRC;n++) {
+    double loWl = refWaveLgt[n-1];
+    double hiWl = refWaveLgt[n];
+    if (hiWl < loWl) {
+      *oLog << " GUtilityFuncts::makeReflTable: wavelengths of the "
+            << "reflectivity curve not in increasing order at "
+            << loWl << "  " << hiWl << endl;
+      *oLog << " stopping code " << endl;
+      exit(0);
+    }
+    double loR = refCoeff[n-1];
+    double hiR = refCoeff[n];
+
+    double m = (hiR - loR)/(hiWl - loWl);
+    table->slope[n] = m;
+    table->intercept[n] = loR - (m*loWl);
+  }
+};
+/******************* end of makeReflTable ***************/ 
+
+bool GUtilityFuncts::photonReflect(const ReflTable &table,
+                                   const double &reflect,
+                                   const double &photonWaveLgt ) {
+
+  int numberRC = table.waveLgt.size();
+  if (numberRC < 2) return false;
+
+  const double *wl = &(table.waveLgt[0]);
+
+  // is the wavelength within range of the table
+  if ( (photonWaveLgt < wl[0]) ||
+       (photonWaveLgt > wl[numberRC - 1]) ) {
+    return false;
+  }
+
+  // first interval whose upper wavelength is not below photonWaveLgt,
+  // which is the first interval containing it
+  int n = lower_bound(wl + 1, wl + numberRC, photonWaveLgt) - wl;
+
+  double refl = ((table.slope[n]*photonWaveLgt) + table.intercept[n])
+    *reflect;
+
+  return (TR3.Rndm() < refl);
+};
+/******************* end of photonReflect (table) ***************/ 
+
 void GUtilityFuncts::reflectDirection(const ROOT::Math::XYZVector &vnormUnit,
                       const ROOT::Math::XYZVector &vphotonUnit,
                       ROOT::Math::XYZVector *vphotonReflDcos,
@@ -104,12 +104,17 @@ struct Pilot {
 
   string photonHistoryFile;  //!< 
   string photonHistoryTree;  //!< 
+  int photonHistoryOption;   //!< 0: root tree, 1: compact history file
+  int photonHistorySample;   //!< record every n-th photon
+  int photonHistorySelect;   //!< facet (DC) or status (SC) selection, -1 all
+  int photonBundleSize;      //!< max. photons traced as one ray (SC)
   UInt_t seed;  //!< 
 
   int telToDraw;
   int telDrawOption;
   int testTel;  //!< telescope number for test graphs (>0). if zero no test produced
   string testTelFile; //!< base filename for test output
+  GTelescopeTestScan testTelScan; //!< field angle scan for the test
   bool debugBranchesFlag; //!< if true, create debug branches in output root file
   unsigned iNInitEvents;
 };
@@ -395,7 +400,10 @@ int main(int argc, char *argv[]) {
       
       if (pilot.photonHistoryFile != "") {
         mArrayTel[telId]->setPhotonHistory(pilot.photonHistoryFile,
-                                           pilot.photonHistoryTree);
+                                           pilot.photonHistoryTree,
+                                           pilot.photonHistoryOption,
+                                           pilot.photonHistorySample,
+                                           pilot.photonHistorySelect);
       }                                               
     }
     else if (telType==SC) {
@@ -416,7 +424,10 @@ int main(int argc, char *argv[]) {
 
       if (pilot.photonHistoryFile != "") {
         mArrayTel[telId]->setPhotonHistory(pilot.photonHistoryFile,
-                                           pilot.photonHistoryTree);
+                                           pilot.photonHistoryTree,
+                                           pilot.photonHistoryOption,
+                                           pilot.photonHistorySample,
+                                           pilot.photonHistorySelect);
       }
       
     }
@@ -439,7 +450,10 @@ else if (telType==SEGSC) {
 
       if (pilot.photonHistoryFile != "") {
         mArrayTel[telId]->setPhotonHistory(pilot.photonHistoryFile,
-                                           pilot.photonHistoryTree);
+                                           pilot.photonHistoryTree,
+                                           pilot.photonHistoryOption,
+                                           pilot.photonHistorySample,
+                                           pilot.photonHistorySelect);
       }
       
     }
@@ -451,7 +465,8 @@ else if (telType==SEGSC) {
 
   // ready to run telescope test here using mArrayTel[telTestNum]
   if (pilot.testTel) {
-    mArrayTel[pilot.testTel]->makeTelescopeTest(pilot.testTelFile);
+    mArrayTel[pilot.testTel]->makeTelescopeTest(pilot.testTelFile,
+                                                pilot.testTelScan);
   }
   ////////////////////////////////////////////////////////////
   /////// make a photon reader (GReadPhotonBase)
@@ -502,6 +517,7 @@ else if (telType==SEGSC) {
 					     &mRootWriter,pilot.outFileHeaderTree);
   siO->setWobble(pilot.wobble[0],pilot.wobble[1],
 		 pilot.wobble[2],pilot.latitude);
+  siO->setPhotonBundleSize(pilot.photonBundleSize);
  
   /////////////////////////////////////////////////////////////
   /////// do the simulations (where do we create the output class).
@@ -699,12 +715,28 @@ int pilotPrint(const Pilot &pilot) {
         << pilot.latitude*(TMath::RadToDeg()) << endl;
   *oLog << "         photonHistoryFile/Tree " << pilot.photonHistoryFile
        << " / " << pilot.photonHistoryTree << endl;
+  *oLog << "         photonHistory option/sample/select " 
+        << pilot.photonHistoryOption << " / " 
+        << pilot.photonHistorySample << " / "
+        << pilot.photonHistorySelect << endl;
+  *oLog << "         photonBundleSize   " << pilot.photonBundleSize << endl;
   *oLog << "         random number seed " << pilot.seed << endl;
   *oLog << "         vector capacities  " << pilot.iNInitEvents << endl;
   *oLog << "         telToDraw " << pilot.telToDraw << endl;
   *oLog << "         telDrawOption " << pilot.telDrawOption << endl;
   *oLog << "         testTel   " << pilot.testTel << endl;
   *oLog << "         testTel base filename   " << pilot.testTelFile << endl;
+  *oLog << "         testTelScan angles/delta/photons/processes/psfTable  "
+        << pilot.testTelScan.numAngles << " / " 
+        << pilot.testTelScan.deltaDeg << " / "
+        << pilot.testTelScan.numPhotons << " / "
+        << pilot.testTelScan.numProcesses << " / "
+        << pilot.testTelScan.psfTable << endl;
+  *oLog << "         testTelScan wavelengths  ";
+  for (unsigned i = 0;i<pilot.testTelScan.vLambda.size();i++) {
+    *oLog << pilot.testTelScan.vLambda[i] << " ";
+  }
+  *oLog << endl;
   *oLog << "         debugBranchesFlag       " << pilot.debugBranchesFlag << endl;
   *oLog << endl;
 
@@ -733,6 +765,10 @@ int readPilot(Pilot *pilot) {
   pilot->latitude = 0.0;
   pilot->photonHistoryFile = "";
   pilot->photonHistoryTree = "";
+  pilot->photonHistoryOption = 0;
+  pilot->photonHistorySample = 1;
+  pilot->photonHistorySelect = -1;
+  pilot->photonBundleSize = 1;
   pilot->logFileName       = "";
 
   pilot->seed = 0;
@@ -800,9 +836,23 @@ int readPilot(Pilot *pilot) {
   pi->set_flag(flag);
   while (pi->get_line_vector(tokens) >=0) {
     pilot->photonHistoryFile = tokens.at(0);
-    if (tokens.size() == 2) {
+    if (tokens.size() >= 2) {
       pilot->photonHistoryTree = tokens.at(1);
     }
+    if (tokens.size() >= 3) {
+      pilot->photonHistoryOption = atoi(tokens.at(2).c_str());
+    }
+    if (tokens.size() >= 4) {
+      pilot->photonHistorySample = atoi(tokens.at(3).c_str());
+    }
+    if (tokens.size() >= 5) {
+      pilot->photonHistorySelect = atoi(tokens.at(4).c_str());
+    }
+  }  
+  flag = "PHOTONBUNDLE";
+  pi->set_flag(flag);
+  while (pi->get_line_vector(tokens) >=0) {
+    pilot->photonBundleSize = atoi(tokens.at(0).c_str());
   }  
   flag = "NSHOWER";
   pi->set_flag(flag);
@@ -849,6 +899,34 @@ int readPilot(Pilot *pilot) {
       pilot->testTelFile = tokens.at(1);
     }
   }  
+  flag = "TESTTELSCAN";
+  pi->set_flag(flag);
+  while (pi->get_line_vector(tokens) >=0) {
+    if (tokens.size() < 5) {
+      *oLog << "TESTTELSCAN RECORD NEEDS AT LEAST 5 ENTRIES" << endl;
+      *oLog << "    ending code now" << endl;
+      exit(0);
+    }
+    pilot->testTelScan.numAngles = atoi(tokens.at(0).c_str());
+    pilot->testTelScan.deltaDeg = atof(tokens.at(1).c_str());
+    pilot->testTelScan.numPhotons = atoi(tokens.at(2).c_str());
+    pilot->testTelScan.numProcesses = atoi(tokens.at(3).c_str());
+    pilot->testTelScan.psfTable = (atoi(tokens.at(4).c_str()) > 0);
+    pilot->testTelScan.reseedTasks = true;
+    if (tokens.size() > 5) {
+      pilot->testTelScan.vLambda.clear();
+      for (unsigned i = 5;i<tokens.size();i++) {
+        pilot->testTelScan.vLambda.push_back(atof(tokens.at(i).c_str()));
+      }
+    }
+    if ( (pilot->testTelScan.numPhotons < 1) || 
+         (pilot->testTelScan.numProcesses < 1) ) {
+      *oLog << "TESTTELSCAN RECORD: NUMBER OF PHOTONS AND PROCESSES "
+            << "MUST BE POSITIVE" << endl;
+      *oLog << "    ending code now" << endl;
+      exit(0);
+    }
+  }  
     
   delete pi;
   return 1;
@@ -0,0 +1,88 @@
+/*
+VERSION3.1
+2March2015
+*/
+/*!  photonHistoryToRoot.cpp
+
+     converts a compact photon history file (PHOTONHISTORY record with
+     option 1) to a root file with the photon history tree, in the
+     layout of the photon history tree of the telescope.
+
+     usage: photonHistoryToRoot <history file> <root file>
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "TFile.h"
+#include "TTree.h"
+
+#include "GDefinition.h"
+#include "GPhotonHistoryFile.h"
+
+ostream *oLog;
+
+int main(int argc, char *argv[]) {
+
+  oLog = &cout;
+
+  if (argc != 3) {
+    *oLog << "usage: photonHistoryToRoot <history file> <root file>" << endl;
+    return 1;
+  }
+  string historyFile = argv[1];
+  string rootFile = argv[2];
+
+  GPhotonHistoryFile his;
+  if (!his.openRead(historyFile)) {
+    *oLog << "  could not read photon history file " << historyFile << endl;
+    return 1;
+  }
+
+  int numFields = his.getNumFields();
+  string treeName = his.getTreeName();
+  if (treeName == "") treeName = "history";
+
+  TFile *fOut = new TFile(rootFile.c_str(),"RECREATE");
+  TTree *hisT = new TTree(treeName.c_str(),treeName.c_str());
+
+  // branch variables, same names and types as the telescope branches
+  vector<Double_t> vD(numFields,0.0);
+  vector<Int_t> vI(numFields,0);
+  for (int i = 0;i<numFields;i++) {
+    string name = his.getFieldName(i);
+    if (his.getFieldType(i) == 'D') {
+      string leaf = name + "/D";
+      hisT->Branch(name.c_str(),&vD[i],leaf.c_str());
+    }
+    else {
+      string leaf = name + "/I";
+      hisT->Branch(name.c_str(),&vI[i],leaf.c_str());
+    }
+  }
+
+  vector<float> record;
+  while (his.readRecord(&record)) {
+    for (int i = 0;i<numFields;i++) {
+      vD[i] = record[i];
+      vI[i] = (Int_t)record[i];
+    }
+    hisT->Fill();
+  }
+  *oLog << "  " << his.getNumRecords() << " photons from " << historyFile
+        << " to tree " << treeName << " in " << rootFile << endl;
+  his.close();
+
+  fOut->cd();
+  hisT->Write();
+  fOut->Close();
+  delete fOut;
+
+  return 0;
+};
+/************** end of main ***************************/
@@ -0,0 +1,385 @@
+/*! \file photonTransformBench.cpp
+    \brief benchmark and cross check of the batch transformation of
+    photons to telescope coordinates (GArrayTel::transformPhotons and
+    GArrayTel::cullPhotons)
+
+    The reference is the per photon path before the batch transformation:
+    cullPhotons rotating each photon of its telescope, then for each
+    accepted photon GArrayTel::setPhoton with ROOT::Math::Rotation3D
+    (rotGrdToTel*vPhotonGrdLocGC, rotGrdToTel*vPhotonDcosGC minus
+    telLocGrdTC). The batch path is a copy of transformPhotons (one pass
+    over the batch with the table of 12 values per telescope), of the
+    cull loop on the transformed photons and of setPhoton(batch,k). If
+    transformPhotons or cullPhotons are changed, the copies here have
+    to follow.
+
+    Both are run on the same random photons, with the telescopes of the
+    photons grouped (as read from the photon files) and interleaved.
+    Telescope coordinates have to be bit identical and the culled
+    photons the same. Throughput is given per core (one thread) for
+    both paths up to the ray tracing and for transformPhotons alone.
+
+    build and run (ROOT GenVector, no -ffast-math, no FMA contraction,
+    otherwise the results are not expected to be bit identical):
+
+      g++ -O2 -ffp-contract=off `root-config --cflags` photonTransformBench.cpp \
+          `root-config --libs` -lGenVector -o photonTransformBench
+      ./photonTransformBench
+
+    it returns 0 if no differences are found
+*/
+
+#include "Math/Vector3D.h"
+#include "Math/Rotation3D.h"
+#include "Math/RotationX.h"
+#include "Math/RotationZ.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+/*! \brief telescope: rotation and location as set in GArrayTel::setPrimary
+ */
+struct BenchTel {
+  ROOT::Math::Rotation3D rotGrdToTel;
+  ROOT::Math::XYZVector telLocGrdTC;
+};
+
+/*! \brief photons of a batch, as the GPhotonBatch arrays used here
+ */
+struct BenchBatch {
+  vector<double> grdX, grdY, grdZ;
+  vector<double> dcosX, dcosY, dcosZ;
+  vector<int> tel;
+  vector<char> accept;
+  vector<double> relLocX, relLocY, relLocZ;
+  vector<double> dcosTX, dcosTY, dcosTZ;
+
+  void makeTelCoor() {
+    unsigned n = grdX.size();
+    accept.assign(n,1);
+    relLocX.assign(n,0.0); relLocY.assign(n,0.0); relLocZ.assign(n,0.0);
+    dcosTX.assign(n,0.0); dcosTY.assign(n,0.0); dcosTZ.assign(n,0.0);
+  };
+};
+
+// aperture envelope of the telescope (cylinder along the optical axis)
+const double envR = 2.4;
+const double envZMin = -0.5;
+const double envZMax = 6.0;
+
+// bounding sphere of the envelope cylinder
+const double sphZ = 0.5*(envZMin + envZMax);
+const double sphR2 = envR*envR + 0.25*(envZMax - envZMin)*(envZMax - envZMin);
+const double envR2 = envR*envR;
+
+/*! \brief envelope test of cullPhotons for one photon (location
+    relative to the sphere center, tel.coor.), true if the photon can
+    not reach the camera
+ */
+static inline bool missEnvelope(double px,double py,double pz,
+                                double ux,double uy,double uz) {
+
+  double pu = px*ux + py*uy + pz*uz;
+  double pp = px*px + py*py + pz*pz;
+  bool bMiss = (pp - pu*pu/(ux*ux + uy*uy + uz*uz) > sphR2);
+
+  if ( (!bMiss) && (fabs(uz) > 1.0e-9) ) {
+    double t1 = (envZMin - sphZ - pz)/uz;
+    double t2 = (envZMax - sphZ - pz)/uz;
+    double ax = px + t1*ux;
+    double ay = py + t1*uy;
+    double bx = (t2 - t1)*ux;
+    double by = (t2 - t1)*uy;
+    double bb = bx*bx + by*by;
+    double s = 0.0;
+    if (bb > 0.0) {
+      s = -(ax*bx + ay*by)/bb;
+      if (s < 0.0) s = 0.0;
+      if (s > 1.0) s = 1.0;
+    }
+    double cx = ax + s*bx;
+    double cy = ay + s*by;
+    bMiss = (cx*cx + cy*cy > envR2);
+  }
+  return bMiss;
+};
+
+/*! \brief telescope coordinates of a photon as in GArrayTel::setPhoton
+ */
+static inline void setPhoton(const BenchTel &t,double gx,double gy,double gz,
+                             double ux,double uy,double uz,
+                             ROOT::Math::XYZVector *vPhotonRelLocTC,
+                             ROOT::Math::XYZVector *vPhotonDcosTC) {
+
+  ROOT::Math::XYZVector vPhotonGrdLocGC(gx,gy,gz);
+  ROOT::Math::XYZVector vPhotonDcosGC(ux,uy,uz);
+
+  ROOT::Math::XYZVector vPhotonGrdLocTC = t.rotGrdToTel*vPhotonGrdLocGC;
+  *vPhotonDcosTC = t.rotGrdToTel*vPhotonDcosGC;
+  *vPhotonRelLocTC = vPhotonGrdLocTC - t.telLocGrdTC;
+};
+
+/*! \brief per photon path before the batch transformation: cull loop
+    rotating each photon of the telescope, then setPhoton with
+    Rotation3D for each accepted photon in read order
+ */
+static double perPhotonPath(BenchBatch *b,const vector<BenchTel> &tels,
+                            const vector<vector<unsigned> > &telPhotons) {
+
+  double sum = 0.0;
+  for (unsigned t = 0; t < tels.size(); t++) {
+    double rot[9];
+    tels[t].rotGrdToTel.GetComponents(rot);
+    double telX = tels[t].telLocGrdTC.X();
+    double telY = tels[t].telLocGrdTC.Y();
+    double telZ = tels[t].telLocGrdTC.Z() + sphZ;
+    const vector<unsigned> &iPhot = telPhotons[t];
+    for (unsigned i = 0; i < iPhot.size(); i++) {
+      unsigned k = iPhot[i];
+      double px = rot[0]*b->grdX[k] + rot[1]*b->grdY[k] + rot[2]*b->grdZ[k] - telX;
+      double py = rot[3]*b->grdX[k] + rot[4]*b->grdY[k] + rot[5]*b->grdZ[k] - telY;
+      double pz = rot[6]*b->grdX[k] + rot[7]*b->grdY[k] + rot[8]*b->grdZ[k] - telZ;
+      double ux = rot[0]*b->dcosX[k] + rot[1]*b->dcosY[k] + rot[2]*b->dcosZ[k];
+      double uy = rot[3]*b->dcosX[k] + rot[4]*b->dcosY[k] + rot[5]*b->dcosZ[k];
+      double uz = rot[6]*b->dcosX[k] + rot[7]*b->dcosY[k] + rot[8]*b->dcosZ[k];
+      if (missEnvelope(px,py,pz,ux,uy,uz) ) b->accept[k] = 0;
+    }
+  }
+
+  unsigned n = b->grdX.size();
+  ROOT::Math::XYZVector vPhotonRelLocTC;
+  ROOT::Math::XYZVector vPhotonDcosTC;
+  for (unsigned k = 0; k < n; k++) {
+    if (b->accept[k] == 0) continue;
+    setPhoton(tels[b->tel[k]],b->grdX[k],b->grdY[k],b->grdZ[k],
+              b->dcosX[k],b->dcosY[k],b->dcosZ[k],
+              &vPhotonRelLocTC,&vPhotonDcosTC);
+    b->relLocX[k] = vPhotonRelLocTC.X();
+    b->relLocY[k] = vPhotonRelLocTC.Y();
+    b->relLocZ[k] = vPhotonRelLocTC.Z();
+    b->dcosTX[k] = vPhotonDcosTC.X();
+    b->dcosTY[k] = vPhotonDcosTC.Y();
+    b->dcosTZ[k] = vPhotonDcosTC.Z();
+    sum += vPhotonRelLocTC.X() + vPhotonDcosTC.Z();
+  }
+  return sum;
+};
+
+/*! \brief copy of GArrayTel::transformPhotons
+ */
+static void transformPhotons(BenchBatch *batch,
+                             const vector<double> &telTransform) {
+
+  const unsigned n = batch->grdX.size();
+  if (n == 0) return;
+
+  const double *grdX = &(batch->grdX[0]);
+  const double *grdY = &(batch->grdY[0]);
+  const double *grdZ = &(batch->grdZ[0]);
+  const double *dcosX = &(batch->dcosX[0]);
+  const double *dcosY = &(batch->dcosY[0]);
+  const double *dcosZ = &(batch->dcosZ[0]);
+  const int *tel = &(batch->tel[0]);
+  double *relX = &(batch->relLocX[0]);
+  double *relY = &(batch->relLocY[0]);
+  double *relZ = &(batch->relLocZ[0]);
+  double *dTX = &(batch->dcosTX[0]);
+  double *dTY = &(batch->dcosTY[0]);
+  double *dTZ = &(batch->dcosTZ[0]);
+  const double *trans = &telTransform[0];
+
+  for (unsigned k = 0; k < n; k++) {
+    const double *r = trans + 12*tel[k];
+    const double gx = grdX[k], gy = grdY[k], gz = grdZ[k];
+    const double ux = dcosX[k], uy = dcosY[k], uz = dcosZ[k];
+    relX[k] = (r[0]*gx + r[1]*gy + r[2]*gz) - r[9];
+    relY[k] = (r[3]*gx + r[4]*gy + r[5]*gz) - r[10];
+    relZ[k] = (r[6]*gx + r[7]*gy + r[8]*gz) - r[11];
+    dTX[k] = r[0]*ux + r[1]*uy + r[2]*uz;
+    dTY[k] = r[3]*ux + r[4]*uy + r[5]*uz;
+    dTZ[k] = r[6]*ux + r[7]*uy + r[8]*uz;
+  }
+};
+
+/*! \brief cull loop of GArrayTel::cullPhotons for the photons iPhot
+    of one telescope
+ */
+static void cullPhotons(BenchBatch *batch,const vector<unsigned> &iPhot) {
+
+  const double *relX = &(batch->relLocX[0]);
+  const double *relY = &(batch->relLocY[0]);
+  const double *relZ = &(batch->relLocZ[0]);
+  const double *dTX = &(batch->dcosTX[0]);
+  const double *dTY = &(batch->dcosTY[0]);
+  const double *dTZ = &(batch->dcosTZ[0]);
+  char *accept = &(batch->accept[0]);
+
+  for (unsigned i = 0; i < iPhot.size(); i++) {
+    unsigned k = iPhot[i];
+    if (missEnvelope(relX[k],relY[k],relZ[k] - sphZ,dTX[k],dTY[k],dTZ[k]) ) {
+      accept[k] = 0;
+    }
+  }
+};
+
+/*! \brief batch path as in GSimulateOptics::traceBatch: table of the
+    telescope transformations, one transformation of the batch, cull
+    per telescope, then setPhoton(batch,k) for each accepted photon
+ */
+static double batchPath(BenchBatch *b,const vector<BenchTel> &tels,
+                        const vector<vector<unsigned> > &telPhotons,
+                        vector<double> *telTransform) {
+
+  telTransform->assign(12*tels.size(),0.0);
+  for (unsigned t = 0; t < tels.size(); t++) {
+    tels[t].rotGrdToTel.GetComponents(&(*telTransform)[12*t]);
+    tels[t].telLocGrdTC.GetCoordinates(&(*telTransform)[12*t + 9]);
+  }
+
+  transformPhotons(b,*telTransform);
+  for (unsigned t = 0; t < tels.size(); t++) {
+    cullPhotons(b,telPhotons[t]);
+  }
+
+  double sum = 0.0;
+  unsigned n = b->grdX.size();
+  ROOT::Math::XYZVector vPhotonRelLocTC;
+  ROOT::Math::XYZVector vPhotonDcosTC;
+  for (unsigned k = 0; k < n; k++) {
+    if (b->accept[k] == 0) continue;
+    vPhotonRelLocTC.SetCoordinates(b->relLocX[k],b->relLocY[k],b->relLocZ[k]);
+    vPhotonDcosTC.SetCoordinates(b->dcosTX[k],b->dcosTY[k],b->dcosTZ[k]);
+    sum += vPhotonRelLocTC.X() + vPhotonDcosTC.Z();
+  }
+  return sum;
+};
+
+/*! \brief photons around the telescopes with directions about the
+    pointing direction, so that a part of them is culled. interleaved:
+    telescope of photon k is k%numTel, else blocks of 1000 photons
+ */
+static void makePhotons(BenchBatch *b,const vector<BenchTel> &tels,
+                        const vector<ROOT::Math::XYZVector> &telLocGrd,
+                        unsigned numPhotons,bool interleaved,
+                        mt19937 &rng) {
+
+  uniform_real_distribution<double> uni(-1.0,1.0);
+  unsigned numTel = tels.size();
+  ROOT::Math::XYZVector vPoint =
+    tels[0].rotGrdToTel.Inverse()*ROOT::Math::XYZVector(0.0,0.0,1.0);
+
+  *b = BenchBatch();
+  for (unsigned k = 0; k < numPhotons; k++) {
+    unsigned t = interleaved ? (k % numTel) : ((k/1000) % numTel);
+    b->tel.push_back(t);
+    b->grdX.push_back(telLocGrd[t].X() + 6.0*uni(rng));
+    b->grdY.push_back(telLocGrd[t].Y() + 6.0*uni(rng));
+    b->grdZ.push_back(telLocGrd[t].Z());
+    ROOT::Math::XYZVector d(-vPoint.X() + 0.03*uni(rng),
+                            -vPoint.Y() + 0.03*uni(rng),-vPoint.Z());
+    d = d.Unit();
+    b->dcosX.push_back(d.X());
+    b->dcosY.push_back(d.Y());
+    b->dcosZ.push_back(d.Z());
+  }
+  b->makeTelCoor();
+};
+
+int main() {
+
+  const unsigned numTel = 4;
+  const unsigned numPhotons = 1 << 20;
+  const unsigned numRepeat = 10;
+
+  mt19937 rng(7);
+  uniform_real_distribution<double> uni(-1.0,1.0);
+
+  // telescopes pointing near zenith angle 20 deg, locations in meters,
+  // rotation as GUtilityFuncts::AzZnToRotMat
+  vector<BenchTel> tels(numTel);
+  vector<ROOT::Math::XYZVector> telLocGrd(numTel);
+  for (unsigned t = 0; t < numTel; t++) {
+    double az = 0.3 + 0.01*uni(rng);
+    double zn = 0.35 + 0.01*uni(rng);
+    ROOT::Math::RotationZ rz(az);
+    ROOT::Math::RotationX rx(zn);
+    tels[t].rotGrdToTel = rx*rz;
+    telLocGrd[t].SetCoordinates(80.0*uni(rng),80.0*uni(rng),0.5*uni(rng));
+    tels[t].telLocGrdTC = tels[t].rotGrdToTel*telLocGrd[t];
+  }
+
+  long numDiff = 0;
+  long numAcceptDiff = 0;
+  vector<double> telTransform;
+
+  for (int order = 0; order < 2; order++) {
+    BenchBatch base;
+    makePhotons(&base,tels,telLocGrd,numPhotons,(order == 1),rng);
+
+    // photons of each telescope, filled by traceBatch for both paths
+    vector<vector<unsigned> > telPhotons(numTel);
+    for (unsigned k = 0; k < numPhotons; k++) {
+      telPhotons[base.tel[k]].push_back(k);
+    }
+
+    BenchBatch ref = base;
+    BenchBatch bat = base;
+    double tRef = 0.0;
+    double tBat = 0.0;
+    double tTrans = 0.0;
+    double sumRef = 0.0;
+    double sumBat = 0.0;
+    for (unsigned r = 0; r < numRepeat; r++) {
+      ref.accept.assign(numPhotons,1);
+      bat.accept.assign(numPhotons,1);
+      chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+      sumRef += perPhotonPath(&ref,tels,telPhotons);
+      chrono::steady_clock::time_point t1 = chrono::steady_clock::now();
+      sumBat += batchPath(&bat,tels,telPhotons,&telTransform);
+      chrono::steady_clock::time_point t2 = chrono::steady_clock::now();
+      tRef += chrono::duration<double>(t1 - t0).count();
+      tBat += chrono::duration<double>(t2 - t1).count();
+      transformPhotons(&bat,telTransform);
+      chrono::steady_clock::time_point t3 = chrono::steady_clock::now();
+      tTrans += chrono::duration<double>(t3 - t2).count();
+    }
+
+    // telescope coordinates of all photons: Rotation3D against the batch
+    long numCulled = 0;
+    for (unsigned k = 0; k < numPhotons; k++) {
+      ROOT::Math::XYZVector vRel;
+      ROOT::Math::XYZVector vDcos;
+      setPhoton(tels[base.tel[k]],base.grdX[k],base.grdY[k],base.grdZ[k],
+                base.dcosX[k],base.dcosY[k],base.dcosZ[k],&vRel,&vDcos);
+      double v[6] = { vRel.X(),vRel.Y(),vRel.Z(),
+                      vDcos.X(),vDcos.Y(),vDcos.Z() };
+      double w[6] = { bat.relLocX[k],bat.relLocY[k],bat.relLocZ[k],
+                      bat.dcosTX[k],bat.dcosTY[k],bat.dcosTZ[k] };
+      if (memcmp(v,w,sizeof(v)) != 0) numDiff++;
+      if (ref.accept[k] != bat.accept[k]) numAcceptDiff++;
+      if (bat.accept[k] == 0) numCulled++;
+    }
+    if (sumRef != sumBat) numDiff++;
+
+    double nTot = double(numPhotons)*numRepeat;
+    printf("telescopes %s, %u photons, %u telescopes (%.1f%% culled)\n",
+           (order == 0) ? "grouped" : "interleaved",numPhotons,numTel,
+           100.0*numCulled/numPhotons);
+    printf("   per photon Rotation3D:   %6.1f ns/photon  %6.1f M photons/s/core\n",
+           tRef/nTot*1.0e9,nTot/tRef*1.0e-6);
+    printf("   batch transform, cull:   %6.1f ns/photon  %6.1f M photons/s/core\n",
+           tBat/nTot*1.0e9,nTot/tBat*1.0e-6);
+    printf("   batch transform only:    %6.1f ns/photon  %6.1f M photons/s/core\n",
+           tTrans/nTot*1.0e9,nTot/tTrans*1.0e-6);
+  }
+  printf("differences: telescope coordinates %ld, culling %ld\n",
+         numDiff,numAcceptDiff);
+
+  return ( (numDiff == 0) && (numAcceptDiff == 0) ) ? 0 : 1;
+};